@@ -1,5 +1,8 @@
 //basicRender.cpp
 #include "basicRender.hpp"
+#include "drawList2D.hpp"
+#include "glyphAtlas.hpp"
+#include "scene2D.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -26,7 +29,43 @@ using SwapChainSupportDetails = BasicRenderer::SwapChainSupportDetails;
 const int WIDTH = 800;
 const int HEIGHT = 600;
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+//gpu profiler slot 0 times single time command buffers, slot 1+i the command
+//buffer of swapchain image i
+const uint32_t UPLOAD_PROFILER_SLOT = 0;
+const uint32_t MAX_PROFILED_IMAGES = 8;
+
+//the build compiles shaders/ into RENDERER_SHADER_DIR, fall back to the old
+//layout of running from a build directory next to the sources
+#ifndef RENDERER_SHADER_DIR
+#define RENDERER_SHADER_DIR "../shaders"
+#endif
+#ifndef RENDERER_SHADER_SOURCE_DIR
+#define RENDERER_SHADER_SOURCE_DIR "../shaders"
+#endif
+#ifndef RENDERER_GLSLC
+#define RENDERER_GLSLC "glslc"
+#endif
+
+static std::string shaderPath(const std::string& name){
+    return std::string(RENDERER_SHADER_DIR)+"/"+name;
+}
+static std::vector<char> readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file "+filename);
+    }
+
+    size_t fileSize = (size_t) file.tellg();
+    std::vector<char> buffer(fileSize);
+
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+
+    file.close();
+
+    return buffer;
+}
 
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -72,10 +111,16 @@ BasicRenderer::QueueFamilyIndices BasicRenderer::findQueueFamilies(VkPhysicalDev
         for (const auto& queueFamily : queueFamilies) {
             if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 indices.graphicsFamily = i;
+                if (d_headless) {
+                    //nothing is presented, the "present" queue is just the graphics queue
+                    indices.presentFamily = i;
+                }
             }
 
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, d_surface, &presentSupport);
+            if (!d_headless) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, d_surface, &presentSupport);
+            }
 
             if (presentSupport) {
                 indices.presentFamily = i;
@@ -120,7 +165,7 @@ BasicRenderer::BasicRenderer(std::vector<BasicRenderer::Vertex> verticies,
 #endif
 
  d_verticies = verticies;
- d_indicies = indicies;
+ d_indicies.assign(indicies, d_verticies.size());
 }
 
 //default_constructor
@@ -144,10 +189,10 @@ BasicRenderer::BasicRenderer(){
     {{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f, 1.0f},{1.0f,1.0f}}
 };
 
-d_indicies = {
+d_indicies.assign(std::vector<uint16_t>{
     0, 1, 2, 2, 3, 0,
     4, 5, 6, 6, 7, 4
-};
+}, d_verticies.size());
 std::string rootDir = "/Users/willchambers/Projects/321Vulkan";
 
 setTexturePath(rootDir+"/textures/chalet.jpg");
@@ -160,6 +205,8 @@ BasicRenderer::~BasicRenderer(){
 
 //publicly exposed setup and teardown functions for the renderer
 void BasicRenderer::initialize(){
+    CpuProfiler::setThreadName("main");
+    d_initStart = std::chrono::steady_clock::now();
     initWindow();
     initVulkan();
 }
@@ -175,7 +222,10 @@ void BasicRenderer::draw(){
     drawFrame();
 }
 
+//without a model path the geometry given to the constructor is drawn as is
 void BasicRenderer::loadModel(){
+  PROFILE_ZONE("loadModel");
+  if(d_modelPath.empty()) return;
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
@@ -185,7 +235,7 @@ void BasicRenderer::loadModel(){
         throw std::runtime_error(warn + err);
     }
   d_verticies.clear();
-  d_indicies.clear();
+  std::vector<uint32_t> indices;
   for (const auto& shape : shapes){
     for (const auto& index : shape.mesh.indices){
       Vertex vertex = {};
@@ -203,21 +253,34 @@ void BasicRenderer::loadModel(){
       vertex.color = {1.0,1.0,1.0};
 
       d_verticies.push_back(vertex);
-      d_indicies.push_back(d_indicies.size());
+      indices.push_back(static_cast<uint32_t>(indices.size()));
     } 
   }
+  d_indicies.assign(indices, d_verticies.size());
 
 }
 void BasicRenderer::update(std::vector<Vertex> verticies, std::vector<uint16_t> indicies){
-    if(verticies.size()!=d_verticies.size()) throw std::logic_error("cannot resize vertex buffer after creation");
-    if(indicies.size()!=d_indicies.size()) throw std::logic_error("cannot resize index buffer after creation");
+  IndexData packed(indicies, verticies.size());
+  replaceGeometry(verticies, std::move(packed));
+}
+void BasicRenderer::update(std::vector<Vertex> verticies, std::vector<uint32_t> indicies){
+  IndexData packed(indicies, verticies.size());
+  replaceGeometry(verticies, std::move(packed));
+}
+//the vertex count is unchanged, so is the index type and with it the buffer size.
+//The copy is recorded into the uploads of the next frame drawn
+void BasicRenderer::replaceGeometry(const std::vector<Vertex>& verticies, IndexData indicies){
+  if(verticies.size()!=d_verticies.size()) throw std::logic_error("cannot resize vertex buffer after creation");
+  if(indicies.count()!=d_indicies.count()) throw std::logic_error("cannot resize index buffer after creation");
+  d_verticies = verticies;
+  d_indicies = std::move(indicies);
+  d_geometryDirty = true;
+}
 
-    for(size_t i=0;i<verticies.size();i++){
-      d_verticies[i]= verticies[i]; 
-    }
-  updateVertexBuffer();
-  updateIndexBuffer();
-  }
+Aabb BasicRenderer::meshBounds() const{
+  if(d_verticies.empty()) return Aabb();
+  return Aabb::of(&d_verticies.data()->pos, d_verticies.size(), sizeof(Vertex));
+}
 
 void BasicRenderer::setTexturePath(std::string texturePath){
   d_texturePath = texturePath;
@@ -225,10 +288,288 @@ void BasicRenderer::setTexturePath(std::string texturePath){
 void BasicRenderer::setModelPath(std::string modelPath){
   d_modelPath = modelPath;
 }
+void BasicRenderer::setShaderHotReload(bool enabled){
+  d_shaderHotReload = enabled;
+}
+void BasicRenderer::setStartupTimeline(bool enabled){
+  d_startupTimeline = enabled;
+}
+void BasicRenderer::setHeadless(uint32_t width, uint32_t height){
+  d_headless = true;
+  d_headlessExtent = {width,height};
+}
+bool BasicRenderer::isHeadless() const{
+  return d_headless;
+}
+void BasicRenderer::resize(uint32_t width, uint32_t height){
+  if(!d_headless){
+    d_framebufferResized = true;
+    return;
+  }
+  d_headlessExtent = {width,height};
+  recreateSwapChain();
+}
+std::string BasicRenderer::deviceName() const{
+  if(d_physicalDevice == VK_NULL_HANDLE) return "";
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(d_physicalDevice, &properties);
+  return properties.deviceName;
+}
+void BasicRenderer::setReadback(uint32_t depth, ReadbackRing::Consumer consumer){
+  d_readbackDepth = depth;
+  d_readbackConsumer = consumer;
+}
+ReadbackRing::Stats BasicRenderer::readbackStats(){
+  return d_readback.stats();
+}
+void BasicRenderer::setCamera(const Camera& camera){
+  d_camera = camera;
+}
+void BasicRenderer::setFramePacketSource(TripleBuffer<FramePacket>* source){
+  d_packetSource = source;
+}
+void BasicRenderer::setSwapchainConfig(const SwapchainConfig& config){
+  if(config.framesInFlight < 1 || config.framesInFlight > 4){
+    throw std::invalid_argument("frames in flight must be between 1 and 4");
+  }
+  if(config.presentModes.empty()){
+    throw std::invalid_argument("swap chain config needs at least one present mode");
+  }
+  d_swapchainConfig = config;
+}
+VkPresentModeKHR BasicRenderer::presentMode() const{
+  return d_presentMode;
+}
+uint32_t BasicRenderer::swapchainImageCount() const{
+  return static_cast<uint32_t>(d_swapChainImages.size());
+}
+const char* BasicRenderer::presentModeName(VkPresentModeKHR mode){
+  switch(mode){
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+    default: return "unknown";
+  }
+}
+std::vector<double> BasicRenderer::takeLatencySamples(){
+  std::vector<double> samples(d_latencySamples.begin(), d_latencySamples.end());
+  d_latencySamples.clear();
+  return samples;
+}
+void BasicRenderer::recordFrameLatency(size_t frame){
+  if(!d_frameLatencyPending[frame]) return;
+  d_frameLatencyPending[frame] = false;
+  auto now = std::chrono::steady_clock::now();
+  d_latencySamples.push_back(std::chrono::duration<double,std::milli>(now-d_frameInputTimes[frame]).count());
+  if(d_latencySamples.size() > 4096) d_latencySamples.pop_front();
+  d_pacer.frameCompleted(frame, now);
+}
+void BasicRenderer::setFramePacing(const FramePacer::Settings& settings){
+  d_pacing = settings;
+}
+FramePacer::Stats BasicRenderer::framePacingStats() const{
+  return d_pacer.stats();
+}
+void BasicRenderer::setDrawList2DCapacity(uint32_t vertices, uint32_t indices, uint32_t quads, uint32_t segments){
+  d_arenaVertexCapacity = vertices;
+  d_arenaIndexCapacity = indices;
+  d_arenaQuadCapacity = quads;
+  d_arenaSegmentCapacity = segments;
+}
+DrawList2D& BasicRenderer::beginDrawList2D(){
+  if(!d_drawList2D) throw std::logic_error("no 2D arena, call setDrawList2DCapacity before initialize");
+  //the arena of this frame in flight was last read by the submission its fence guards
+  vkWaitForFences(d_device, 1, &d_inFlightFences[d_currentFrame], VK_TRUE, UINT64_MAX);
+  recordFrameLatency(d_currentFrame);
+  char* mapped = static_cast<char*>(d_arenaMapped[d_currentFrame]);
+  DrawList2D::Arena arena;
+  arena.vertices = reinterpret_cast<Vertex*>(mapped);
+  arena.vertexCapacity = d_arenaVertexCapacity;
+  arena.indices = reinterpret_cast<DrawList2D::Index*>(mapped+d_arenaIndexOffset);
+  arena.indexCapacity = d_arenaIndexCapacity;
+  arena.quads = reinterpret_cast<QuadInstance*>(mapped+d_arenaQuadOffset);
+  arena.quadCapacity = d_arenaQuadCapacity;
+  //the extent may change from frame to frame
+  arena.pixelSize = glm::vec2(2.0f/d_swapChainExtent.width, 2.0f/d_swapChainExtent.height);
+  if(d_arenaSegmentCapacity > 0){
+    //line.vert widens lines by whole pixels
+    float* pixelSize = reinterpret_cast<float*>(mapped+d_arenaSegmentOffset);
+    pixelSize[0] = arena.pixelSize.x;
+    pixelSize[1] = arena.pixelSize.y;
+    arena.segments = reinterpret_cast<LineSegment*>(pixelSize+2);
+    arena.segmentCapacity = d_arenaSegmentCapacity;
+  }
+  d_drawList2D->reset(arena);
+  if(d_glyphAtlas) d_glyphAtlas->beginFrame();
+  d_drawList2DBegun = true;
+  return *d_drawList2D;
+}
+void BasicRenderer::setTextFont(const std::string& path, float sdfPixelHeight){
+  d_fontPath = path;
+  d_fontPixelHeight = sdfPixelHeight;
+}
+GlyphAtlas& BasicRenderer::glyphAtlas(){
+  if(!d_glyphAtlas) throw std::logic_error("no glyph atlas, call setTextFont before initialize");
+  return *d_glyphAtlas;
+}
+void BasicRenderer::setScene2DCapacity(uint32_t vertices, uint32_t indices){
+  d_scene2DVertexCapacity = vertices;
+  d_scene2DIndexCapacity = indices;
+  //shapes can be added right away, they are uploaded by the first draw
+  if(vertices == 0 || indices == 0) d_scene2D.reset();
+  else if(!d_scene2D) d_scene2D.reset(new Scene2D());
+}
+Scene2D& BasicRenderer::scene2D(){
+  if(!d_scene2D) throw std::logic_error("no 2D scene, call setScene2DCapacity before initialize");
+  return *d_scene2D;
+}
+void BasicRenderer::setGpuProfiling(bool enabled){
+  d_gpuProfiling = enabled;
+}
+GpuProfiler& BasicRenderer::gpuProfiler(){
+  return d_gpuProfiler;
+}
+const MemoryTracker& BasicRenderer::memoryTracker() const{
+  return d_memory;
+}
+void BasicRenderer::setCpuProfiling(bool enabled){
+  CpuProfiler::setEnabled(enabled);
+}
+bool BasicRenderer::dumpTrace(const std::string& filename){
+  bool written = CpuProfiler::writeChromeTrace(filename, d_gpuProfiler.takeSamples());
+  if(written) std::cout<<"trace written to "<<filename<<std::endl;
+  return written;
+}
+
+void BasicRenderer::reportGpuTimes(){
+  auto now = std::chrono::steady_clock::now();
+  if(now-d_lastGpuSummary < std::chrono::seconds(2)) return;
+  d_lastGpuSummary = now;
+  d_gpuProfiler.printSummary(std::cout);
+  if(d_window != nullptr){
+    std::string title = "Vulkan";
+    for(const auto& zone : d_gpuProfiler.zones()){
+      if(zone.name == "render pass") title += " - gpu "+std::to_string(zone.averageMs).substr(0,5)+" ms";
+    }
+    glfwSetWindowTitle(d_window, title.c_str());
+  }
+}
+
+void BasicRenderer::createReadback(){
+  if(d_readbackDepth == 0) return;
+  QueueFamilyIndices indices = findQueueFamilies(d_physicalDevice);
+  d_readback.init(d_physicalDevice, d_device, indices.graphicsFamily.value(), d_swapChainExtent,
+      d_swapChainImageFormat, d_readbackDepth, d_readbackConsumer, &d_memory);
+}
+
+void BasicRenderer::startShaderWatcher(){
+  if(!d_shaderHotReload) return;
+  d_shaderWatcher.reset(new ShaderWatcher(RENDERER_SHADER_SOURCE_DIR, RENDERER_SHADER_DIR, RENDERER_GLSLC,
+        [this](const std::string& shaderName){ reloadShaders(shaderName); }));
+}
+
+//runs on the watcher thread: builds the replacement pipeline through the
+//pipeline cache and parks it for the render thread to pick up
+void BasicRenderer::reloadShaders(const std::string& shaderName){
+  try{
+    //quads, lines and text keep their pipeline layouts, only their library permutations have to go
+    if(shaderName == "text.frag"){
+      auto fragShaderCode = readFile(shaderPath("text.frag.spv"));
+      //quad.vert is only replaced on this thread
+      ShaderLayout layout = mergeReflections({reflectShader(d_quadVertShaderCode),reflectShader(fragShaderCode)});
+      if(!layout.compatibleWith(d_textShaderLayout)){
+        std::cerr<<"shader reload: "<<shaderName<<" changed its resource interface, restart to pick it up"<<std::endl;
+        return;
+      }
+      std::lock_guard<std::mutex> lock(d_pipelineMutex);
+      d_textFragShaderCode = std::move(fragShaderCode);
+      d_overlayShadersReloaded = true;
+      return;
+    }
+    bool quad = shaderName.compare(0,5,"quad.")==0;
+    if(quad || shaderName.compare(0,5,"line.")==0){
+      std::string stem = quad ? "quad" : "line";
+      auto vertShaderCode = readFile(shaderPath(stem+".vert.spv"));
+      auto fragShaderCode = readFile(shaderPath(stem+".frag.spv"));
+      ShaderLayout layout = mergeReflections({reflectShader(vertShaderCode),reflectShader(fragShaderCode)});
+      if(quad ? !layout.fitsIn(d_shaderLayout) : !layout.compatibleWith(d_lineShaderLayout)){
+        std::cerr<<"shader reload: "<<shaderName<<" changed its resource interface, restart to pick it up"<<std::endl;
+        return;
+      }
+      std::lock_guard<std::mutex> lock(d_pipelineMutex);
+      (quad ? d_quadVertShaderCode : d_lineVertShaderCode) = std::move(vertShaderCode);
+      (quad ? d_quadFragShaderCode : d_lineFragShaderCode) = std::move(fragShaderCode);
+      d_overlayShadersReloaded = true;
+      return;
+    }
+    auto vertShaderCode = readFile(shaderPath("shader.vert.spv"));
+    auto fragShaderCode = readFile(shaderPath("shader.frag.spv"));
+    ShaderLayout layout = mergeReflections({reflectShader(vertShaderCode),reflectShader(fragShaderCode)});
+    if(!layout.compatibleWith(d_shaderLayout)){
+      std::cerr<<"shader reload: "<<shaderName<<" changed its resource interface, restart to pick it up"<<std::endl;
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(d_pipelineMutex);
+    VkPipeline pipeline = buildGraphicsPipeline(vertShaderCode, fragShaderCode, PipelineKey());
+    if(d_pendingPipeline != VK_NULL_HANDLE){
+      //never bound, nothing can be using it
+      vkDestroyPipeline(d_device, d_pendingPipeline, nullptr);
+    }
+    d_pendingPipeline = pipeline;
+    d_pendingVertShaderCode = std::move(vertShaderCode);
+    d_pendingFragShaderCode = std::move(fragShaderCode);
+  }catch(const std::exception& e){
+    std::cerr<<"shader reload: "<<e.what()<<std::endl;
+  }
+}
+
+//called at the top of a frame, the old pipeline stays alive until every
+//command buffer that still references it has been re-recorded
+void BasicRenderer::swapPendingPipeline(){
+  std::lock_guard<std::mutex> lock(d_pipelineMutex);
+  if(d_overlayShadersReloaded){
+    d_overlayShadersReloaded = false;
+    d_pipelines.retireAll(d_retiredPipelines);
+    d_commandBufferDirty.assign(d_commandBuffers.size(), true);
+  }
+  if(d_pendingPipeline == VK_NULL_HANDLE) return;
+
+  d_retiredPipelines.push_back(d_graphicsPipeline);
+  d_graphicsPipeline = d_pendingPipeline;
+  d_pendingPipeline = VK_NULL_HANDLE;
+  d_vertShaderCode = std::move(d_pendingVertShaderCode);
+  d_fragShaderCode = std::move(d_pendingFragShaderCode);
+  //permutations were built from the old code, they get rebuilt lazily
+  d_pipelines.retireAll(d_retiredPipelines);
+  d_commandBufferDirty.assign(d_commandBuffers.size(), true);
+}
+
+void BasicRenderer::setPipelineState(const PipelineKey& key){
+  if(key == d_pipelineKey) return;
+  d_pipelineKey = key;
+  if(!d_commandBuffers.empty()){
+    d_commandBufferDirty.assign(d_commandBuffers.size(), true);
+  }
+}
+
+void BasicRenderer::releaseRetiredPipelines(){
+  //a command buffer is only re-recorded after its last submission finished, so once
+  //none are dirty no submission in flight can reference a retired pipeline
+  for(bool dirty : d_commandBufferDirty){
+    if(dirty) return;
+  }
+  for(auto pipeline : d_retiredPipelines){
+    vkDestroyPipeline(d_device, pipeline, nullptr);
+  }
+  d_retiredPipelines.clear();
+}
 
 
 void BasicRenderer::createImage(uint32_t width, uint32_t height,VkFormat format, VkImageTiling tiling,
-        VkImageUsageFlags usage,VkMemoryPropertyFlags properties,VkImage & image, VkDeviceMemory &imageMemory){
+        VkImageUsageFlags usage,VkMemoryPropertyFlags properties,VkImage & image, VkDeviceMemory &imageMemory,
+        MemoryCategory category){
 
   VkImageCreateInfo imageInfo = {};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -256,7 +597,7 @@ void BasicRenderer::createImage(uint32_t width, uint32_t height,VkFormat format,
   allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
   allocInfo.allocationSize = memRequirements.size;
   allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,properties);
-  if(vkAllocateMemory(d_device, &allocInfo,nullptr, &imageMemory)!=VK_SUCCESS){
+  if(d_memory.allocate(allocInfo, category, imageMemory)!=VK_SUCCESS){
       throw std::runtime_error("failed to allocate image memory") ;
   } 
    vkBindImageMemory(d_device, image, imageMemory,0);  
@@ -269,8 +610,6 @@ bool hasStencilComponent(VkFormat format){
 }
 void BasicRenderer::transitionImageLayout(VkImage image, VkFormat format,
         VkImageLayout oldLayout, VkImageLayout newLayout){
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-    
     VkImageMemoryBarrier barrier = {};
 
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -330,8 +669,10 @@ void BasicRenderer::transitionImageLayout(VkImage image, VkFormat format,
     throw std::runtime_error("Unsupported image Layout transition");
     }
 
+    //only once the transition is known to be supported
+    SingleTimeCommands commands(*this, "layout transition");
     vkCmdPipelineBarrier
-      (commandBuffer,
+      (commands.buffer(),
       sourceStage,destinationStage,
       0,
       0,nullptr,
@@ -340,11 +681,11 @@ void BasicRenderer::transitionImageLayout(VkImage image, VkFormat format,
        );
 
 
-    endSingleTimeCommands(commandBuffer);
+    commands.submit();
 
 }
 void BasicRenderer::copyBufferToImage(VkBuffer buffer, VkImage image,uint32_t width,uint32_t height){
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    SingleTimeCommands commands(*this, "image upload");
     VkBufferImageCopy region = {};
 
     region.bufferOffset = 0;
@@ -360,40 +701,49 @@ void BasicRenderer::copyBufferToImage(VkBuffer buffer, VkImage image,uint32_t wi
       1
     };
     vkCmdCopyBufferToImage(
-       commandBuffer,
+       commands.buffer(),
        buffer,
        image,
        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
        1,
        &region
         ); 
-   endSingleTimeCommands(commandBuffer);
+   commands.submit();
 
 }
-void BasicRenderer::createTextureImage(){
-  int texWidth, texHeight, texChannels;
+//decode only, needs no vulkan objects so it can run while the device comes up
+void BasicRenderer::loadTexture(){
+  PROFILE_ZONE("loadTexture");
+  int texChannels;
   std::string filepath = d_texturePath; 
-  stbi_uc* pixels = stbi_load(filepath.c_str(),&texWidth, &texHeight, &texChannels,
+  d_texturePixels = stbi_load(filepath.c_str(),&d_texWidth, &d_texHeight, &texChannels,
       STBI_rgb_alpha);
-  VkDeviceSize imageSize = texWidth*texHeight*4;//1 dimension for r, g, b, a
-  if(!pixels){
+  if(!d_texturePixels){
     throw std::runtime_error("failed to load image from filepath "+filepath);
   }
+}
+void BasicRenderer::createTextureImage(){
+  PROFILE_ZONE("createTextureImage");
+  int texWidth = d_texWidth, texHeight = d_texHeight;
+  stbi_uc* pixels = d_texturePixels;
+  VkDeviceSize imageSize = texWidth*texHeight*4;//1 dimension for r, g, b, a
 
   VkBuffer stagingBuffer;
   VkDeviceMemory stagingBufferMemory;
 
   void * data;
   createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,stagingBuffer, stagingBufferMemory);
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,stagingBuffer, stagingBufferMemory,
+      MemoryCategory::Staging);
   vkMapMemory(d_device, stagingBufferMemory, 0, imageSize, 0, &data);
       memcpy(data, pixels, static_cast<size_t>(imageSize));
   vkUnmapMemory(d_device, stagingBufferMemory);
   stbi_image_free(pixels);
+  d_texturePixels = nullptr;
 createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
     VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-    d_textureImage, d_textureImageMemory);
+    d_textureImage, d_textureImageMemory, MemoryCategory::Texture);
   transitionImageLayout(d_textureImage,VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED,
       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
   copyBufferToImage(stagingBuffer,d_textureImage,static_cast<uint32_t>(texWidth),
@@ -401,7 +751,7 @@ createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIM
   transitionImageLayout(d_textureImage,VK_FORMAT_R8G8B8A8_UNORM,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
   vkDestroyBuffer(d_device,stagingBuffer,nullptr);
-  vkFreeMemory(d_device,stagingBufferMemory,nullptr);
+  d_memory.free(stagingBufferMemory);
 }
 
 void BasicRenderer::createTextureImageView(){
@@ -415,7 +765,7 @@ void BasicRenderer::createTextureSampler(){
   samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
   samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
   samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  samplerInfo.anisotropyEnable = VK_TRUE;
+  samplerInfo.anisotropyEnable = d_samplerAnisotropy ? VK_TRUE : VK_FALSE;
   samplerInfo.maxAnisotropy = 16;
 
   samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
@@ -435,7 +785,11 @@ void BasicRenderer::createTextureSampler(){
 
 }
 void BasicRenderer::run(){
+        if(d_headless){
+          throw std::logic_error("a headless renderer has no window to run, drive it with draw()");
+        }
 
+        d_initStart = std::chrono::steady_clock::now();
         initWindow();
         initVulkan();
         mainLoop();
@@ -472,7 +826,7 @@ void BasicRenderer::createDepthResources(){
   VkFormat depthFormat = findDepthFormat();
   createImage(d_swapChainExtent.width, d_swapChainExtent.height,depthFormat,
         VK_IMAGE_TILING_OPTIMAL,VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,d_depthImage,d_depthImageMemory);
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,d_depthImage,d_depthImageMemory,MemoryCategory::Depth);
   d_depthImageView = createImageView(d_depthImage,depthFormat,VK_IMAGE_ASPECT_DEPTH_BIT);
   transitionImageLayout(d_depthImage,depthFormat,VK_IMAGE_LAYOUT_UNDEFINED,
         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
@@ -480,32 +834,451 @@ void BasicRenderer::createDepthResources(){
 }
 
 void BasicRenderer::initVulkan(){
+        //steps only wait on what they actually read, so decoding the texture and
+        //model overlaps with device creation. Uploads fill their staging buffers in
+        //parallel but submit one at a time, a SingleTimeCommands holds the pool and
+        //queue until the copy is done
+        d_workers.reset(new ThreadPool());
+        TaskGraph& graph = d_initGraph;
+
+        auto instance = graph.addOnCallingThread("createInstance", [this]{ createInstance(); });
+        graph.add("setupDebugMessenger", [this]{ setupDebugMessenger(); }, {instance});
+        auto surface = graph.addOnCallingThread("createSurface", [this]{ createSurface(); }, {instance});
+        auto physicalDevice = graph.add("pickPhysicalDevice", [this]{ pickPhysicalDevice(); }, {surface});
+        auto device = graph.add("createLogicalDevice", [this]{ createLogicalDevice(); }, {physicalDevice});
+        //asks glfw for the framebuffer size
+        auto swapChain = graph.addOnCallingThread("createSwapChain", [this]{ createSwapChain(); }, {device});
+        auto imageViews = graph.add("createImageViews", [this]{ createImageViews(); }, {swapChain});
+        auto renderPass = graph.add("createRenderPass", [this]{ createRenderPass(); }, {swapChain});
+        auto setLayout = graph.add("createDescriptorSetLayout", [this]{ createDescriptorSetLayout(); }, {device});
+        auto pipelineCache = graph.add("createPipelineCache", [this]{ createPipelineCache(); }, {device});
+        auto pipeline = graph.add("createGraphicsPipeline", [this]{ createGraphicsPipeline(); },
+            {renderPass, setLayout, pipelineCache});
+        auto pipelineLibrary = graph.add("createPipelineLibrary", [this]{ createPipelineLibrary(); }, {pipeline});
+        auto commandPool = graph.add("createCommandPool", [this]{ createCommandPool(); }, {device});
+        auto depth = graph.add("createDepthResources", [this]{ createDepthResources(); }, {swapChain, commandPool});
+        auto framebuffers = graph.add("createFramebuffers", [this]{ createFramebuffers(); },
+            {imageViews, renderPass, depth});
+        auto texturePixels = graph.add("loadTexture", [this]{ loadTexture(); });
+        auto texture = graph.add("createTextureImage", [this]{ createTextureImage(); }, {commandPool, texturePixels});
+        auto textureView = graph.add("createTextureImageView", [this]{ createTextureImageView(); }, {texture});
+        auto sampler = graph.add("createTextureSampler", [this]{ createTextureSampler(); }, {device});
+        auto model = graph.add("loadModel", [this]{ loadModel(); });
+        auto vertexBuffer = graph.add("createVertexBuffer", [this]{ createVertexBuffer(); }, {commandPool, model});
+        auto indexBuffer = graph.add("createIndexBuffer", [this]{ createIndexBuffer(); }, {commandPool, model});
+        auto uniformBuffers = graph.add("createUniformBuffers", [this]{ createUniformBuffers(); }, {swapChain});
+        auto descriptorSets = graph.add("createDescriptorSets", [this]{ createDescriptorSets(); },
+            {setLayout, uniformBuffers, textureView, sampler});
+        graph.add("createSyncObjects", [this]{ createSyncObjects(); }, {swapChain});
+        graph.add("createReadback", [this]{ createReadback(); }, {swapChain});
+        graph.add("createDrawList2DArenas", [this]{ createDrawList2DArenas(); }, {device, setLayout});
+        auto font = graph.add("loadFont", [this]{ loadFont(); });
+        auto glyphAtlas = graph.add("createGlyphAtlas", [this]{ createGlyphAtlas(); }, {commandPool, setLayout, font});
+        //every upload is finished by now, so the command pool is no longer shared
+        graph.add("createCommandBuffers", [this]{ createCommandBuffers(); },
+            {framebuffers, pipelineLibrary, descriptorSets, vertexBuffer, indexBuffer, glyphAtlas});
+        graph.add("createScene2DBuffers", [this]{ createScene2DBuffers(); }, {device});
+        graph.run(*d_workers);
+
+        //nothing here is needed to put the first frame on screen
+        d_deferredGraph.add("startShaderWatcher", [this]{ startShaderWatcher(); });
+        d_deferredGraph.add("warmPipelineLibrary", [this]{ warmPipelineLibrary(); });
+}
 
-        createInstance();
-        setupDebugMessenger();
-        createSurface();
-        pickPhysicalDevice();
-        createLogicalDevice();
-        createSwapChain();
-        createImageViews();
-        createRenderPass();
-        createDescriptorSetLayout();
-        createGraphicsPipeline();
-        createCommandPool();
-        createDepthResources();
-        createFramebuffers();
-        createTextureImage();
-        createTextureImageView();
-        createTextureSampler();
-        loadModel();
-        createVertexBuffer();
-        createIndexBuffer();
-        createUniformBuffers();
-        createDescriptorPool();
-        createDescriptorSets();
-        createCommandBuffers();
-        createSyncObjects();
+//queue every shader permutation so switching to one later does not show the default pipeline first
+void BasicRenderer::warmPipelineLibrary(){
+  const ShaderVariant variants[] = {ShaderVariant::Textured, ShaderVariant::VertexColor,
+    ShaderVariant::AlphaTest, ShaderVariant::DebugTexCoord, ShaderVariant::DebugDepth};
+  for(ShaderVariant variant : variants){
+    PipelineKey key = d_pipelineKey;
+    key.variant = variant;
+    d_pipelines.prefetch(key);
+  }
+  if(d_drawList2D){
+    PipelineKey key = DrawList2D::defaultPipeline();
+    d_pipelines.prefetch(key);
+    if(d_arenaQuadCapacity > 0){
+      key.source = VertexSource::InstancedQuads;
+      d_pipelines.prefetch(key);
+    }
+    if(d_arenaSegmentCapacity > 0){
+      key.source = VertexSource::LineSegments;
+      d_pipelines.prefetch(key);
+    }
+    if(d_arenaQuadCapacity > 0 && d_glyphAtlas){
+      key.source = VertexSource::Glyphs;
+      d_pipelines.prefetch(key);
+    }
+  }
+  if(d_scene2D){
+    d_pipelines.prefetch(DrawList2D::defaultPipeline());
+  }
+}
+
+//host visible and mapped for the renderer's lifetime, DrawList2D writes vertices
+//where the GPU reads them and no upload is involved
+void BasicRenderer::createDrawList2DArenas(){
+  if(d_arenaVertexCapacity == 0 || d_arenaIndexCapacity == 0) return;
+  d_arenaIndexOffset = sizeof(Vertex)*static_cast<VkDeviceSize>(d_arenaVertexCapacity);
+  //instances are read as a vertex buffer, 4 byte alignment is enough for their attributes
+  d_arenaQuadOffset = d_arenaIndexOffset+sizeof(DrawList2D::Index)*static_cast<VkDeviceSize>(d_arenaIndexCapacity);
+  d_arenaQuadOffset = (d_arenaQuadOffset+3)/4*4;
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(d_physicalDevice, &properties);
+  VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+  d_arenaSegmentOffset = d_arenaQuadOffset+sizeof(QuadInstance)*static_cast<VkDeviceSize>(d_arenaQuadCapacity);
+  d_arenaSegmentOffset = (d_arenaSegmentOffset+alignment-1)/alignment*alignment;
+  VkDeviceSize segmentsSize = 2*sizeof(float)+sizeof(LineSegment)*static_cast<VkDeviceSize>(d_arenaSegmentCapacity);
+  VkDeviceSize size = d_arenaSegmentOffset+(d_arenaSegmentCapacity > 0 ? segmentsSize : 0);
+  size_t framesInFlight = d_swapchainConfig.framesInFlight;
+  d_arenaBuffers.resize(framesInFlight);
+  d_arenaBuffersMemory.resize(framesInFlight);
+  d_arenaMapped.resize(framesInFlight);
+  for(size_t i = 0; i < framesInFlight; i++){
+    createBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+        | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        d_arenaBuffers[i], d_arenaBuffersMemory[i], MemoryCategory::Dynamic);
+    vkMapMemory(d_device, d_arenaBuffersMemory[i], 0, VK_WHOLE_SIZE, 0, &d_arenaMapped[i]);
+  }
+  d_drawList2D.reset(new DrawList2D());
+  if(d_arenaSegmentCapacity == 0) return;
+
+  //set 1 of the line pipelines, one per arena
+  d_lineDescriptorSets.resize(framesInFlight);
+  d_layoutCache.allocateSets(d_lineSetLayout, static_cast<uint32_t>(framesInFlight), d_lineDescriptorSets.data());
+  for(size_t i = 0; i < framesInFlight; i++){
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.buffer = d_arenaBuffers[i];
+    bufferInfo.offset = d_arenaSegmentOffset;
+    bufferInfo.range = segmentsSize;
+    VkWriteDescriptorSet writeInfo = {};
+    writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeInfo.dstSet = d_lineDescriptorSets[i];
+    writeInfo.dstBinding = 0;
+    writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writeInfo.descriptorCount = 1;
+    writeInfo.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(d_device, 1, &writeInfo, 0, nullptr);
+  }
+}
+
+//parsing the font needs no vulkan objects, it overlaps with device creation
+void BasicRenderer::loadFont(){
+  if(d_fontPath.empty()) return;
+  PROFILE_ZONE("loadFont");
+  d_glyphAtlas.reset(new GlyphAtlas());
+  d_glyphAtlas->load(d_fontPath, d_fontPixelHeight);
+}
+
+//the atlas starts out empty, uploadGlyphAtlas fills in cells as glyphs are first used
+void BasicRenderer::createGlyphAtlas(){
+  if(!d_glyphAtlas) return;
+  PROFILE_ZONE("createGlyphAtlas");
+  uint32_t size = d_glyphAtlas->size();
+  VkDeviceSize imageSize = static_cast<VkDeviceSize>(size)*size;
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingMemory;
+  createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      stagingBuffer, stagingMemory, MemoryCategory::Staging);
+  void* data;
+  vkMapMemory(d_device, stagingMemory, 0, imageSize, 0, &data);
+  memset(data, 0, static_cast<size_t>(imageSize));
+  vkUnmapMemory(d_device, stagingMemory);
+  createImage(size, size, VK_FORMAT_R8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, d_glyphImage, d_glyphImageMemory, MemoryCategory::Texture);
+  transitionImageLayout(d_glyphImage, VK_FORMAT_R8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  copyBufferToImage(stagingBuffer, d_glyphImage, size, size);
+  transitionImageLayout(d_glyphImage, VK_FORMAT_R8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  vkDestroyBuffer(d_device, stagingBuffer, nullptr);
+  d_memory.free(stagingMemory);
+  d_glyphImageView = createImageView(d_glyphImage, VK_FORMAT_R8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+
+  //bilinear between distance samples is what keeps magnified glyphs smooth
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.anisotropyEnable = VK_FALSE;
+  samplerInfo.maxAnisotropy = 1.0f;
+  samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+  samplerInfo.compareEnable = VK_FALSE;
+  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = 0.0f;
+  if(vkCreateSampler(d_device, &samplerInfo, nullptr, &d_glyphSampler) != VK_SUCCESS){
+    throw std::runtime_error("failed to create glyph sampler");
+  }
 
+  //set 1 of the glyph pipelines, the atlas never moves so one is enough
+  d_layoutCache.allocateSets(d_glyphSetLayout, 1, &d_glyphDescriptorSet);
+  VkDescriptorImageInfo imageInfo = {};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = d_glyphImageView;
+  imageInfo.sampler = d_glyphSampler;
+  VkWriteDescriptorSet writeInfo = {};
+  writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writeInfo.dstSet = d_glyphDescriptorSet;
+  writeInfo.dstBinding = 0;
+  writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writeInfo.descriptorCount = 1;
+  writeInfo.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(d_device, 1, &writeInfo, 0, nullptr);
+}
+
+//records a copy of the cells the atlas rewrote into the frame's uploads, one region
+//each. Frames still in flight may sample the atlas, the barrier orders the copy after
+//their fragment shaders. Cells used by the frame being built are never evicted, so it
+//sees what it laid out
+void BasicRenderer::uploadGlyphAtlas(){
+  GlyphAtlas& atlas = *d_glyphAtlas;
+  const std::vector<uint32_t>& cells = atlas.dirtyCells();
+  uint32_t size = atlas.size();
+  uint32_t cellSize = atlas.cellSize();
+  VkDeviceSize cellBytes = static_cast<VkDeviceSize>(cellSize)*cellSize;
+  UploadSlice slice = stageUpload(cells.size()*cellBytes);
+  unsigned char* staging = reinterpret_cast<unsigned char*>(slice.data);
+  std::vector<VkBufferImageCopy> regions(cells.size());
+  for(size_t i = 0; i < cells.size(); i++){
+    glm::uvec2 origin = atlas.cellOrigin(cells[i]);
+    for(uint32_t row = 0; row < cellSize; row++){
+      memcpy(staging+i*cellBytes+row*cellSize, atlas.pixels()+static_cast<size_t>(origin.y+row)*size+origin.x,
+          cellSize);
+    }
+    VkBufferImageCopy& region = regions[i];
+    region.bufferOffset = slice.offset+i*cellBytes;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {static_cast<int32_t>(origin.x), static_cast<int32_t>(origin.y), 0};
+    region.imageExtent = {cellSize, cellSize, 1};
+  }
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = d_glyphImage;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+
+  VkCommandBuffer commandBuffer = uploadCommands();
+  barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0, 0, nullptr, 0, nullptr, 1, &barrier);
+  vkCmdCopyBufferToImage(commandBuffer, slice.buffer, d_glyphImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      static_cast<uint32_t>(regions.size()), regions.data());
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      0, 0, nullptr, 0, nullptr, 1, &barrier);
+  atlas.clearDirty();
+}
+
+//empty until the first draw uploads what the scene holds by then. Also creates new
+//buffers at the current capacity when the scene outgrew the old ones
+void BasicRenderer::createScene2DBuffers(){
+  if(!d_scene2D) return;
+  createBuffer(sizeof(Vertex)*static_cast<VkDeviceSize>(d_scene2DVertexCapacity),
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      d_scene2DVertexBuffer, d_scene2DVertexMemory, MemoryCategory::Vertex);
+  d_scene2DIndexBytes = IndexData::indexSize(d_scene2DIndexType)*static_cast<VkDeviceSize>(d_scene2DIndexCapacity);
+  createBuffer(d_scene2DIndexBytes,
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      d_scene2DIndexBuffer, d_scene2DIndexMemory, MemoryCategory::Index);
+}
+
+//flushes the scene and records the copy of what it wrote into the frame's uploads.
+//Frames still in flight keep drawing from the same buffers, the barrier orders the
+//copy after their vertex input
+void BasicRenderer::syncScene2D(){
+  Scene2D& scene = *d_scene2D;
+  scene.flush();
+  //picked like IndexData does, by the vertices in use
+  VkIndexType indexType = IndexData::typeFor(scene.vertexEnd());
+  bool grow = scene.vertexEnd() > d_scene2DVertexCapacity || scene.indexEnd() > d_scene2DIndexCapacity;
+  if(grow || IndexData::indexSize(indexType)*d_scene2DIndexCapacity > d_scene2DIndexBytes){
+    //frames in flight still draw from the old buffers, they go once this frame's fence
+    //has signalled and with it every submission before it
+    if(d_scene2DVertexBuffer != VK_NULL_HANDLE){
+      std::vector<std::pair<VkBuffer,VkDeviceMemory>>& retired = d_frameUploads[d_currentFrame].retired;
+      retired.push_back({d_scene2DVertexBuffer, d_scene2DVertexMemory});
+      retired.push_back({d_scene2DIndexBuffer, d_scene2DIndexMemory});
+    }
+    if(grow){
+      d_scene2DVertexCapacity = std::max(scene.vertexEnd(), d_scene2DVertexCapacity*2);
+      d_scene2DIndexCapacity = std::max(scene.indexEnd(), d_scene2DIndexCapacity*2);
+    }
+    d_scene2DIndexType = indexType;
+    createScene2DBuffers();
+    scene.markAllDirty();
+    d_commandBufferDirty.assign(d_commandBuffers.size(), true);
+  }else if(indexType != d_scene2DIndexType){
+    //narrower indices fit the buffer as it is, they only have to be written again
+    d_scene2DIndexType = indexType;
+    scene.markAllDirty();
+    d_commandBufferDirty.assign(d_commandBuffers.size(), true);
+  }
+  if(scene.indexEnd() != d_scene2DIndexCount){
+    d_scene2DIndexCount = scene.indexEnd();
+    d_commandBufferDirty.assign(d_commandBuffers.size(), true);
+  }
+  //counts this frame's upload at the index size just picked
+  scene.setIndexSize(static_cast<uint32_t>(IndexData::indexSize(d_scene2DIndexType)));
+  const std::vector<Scene2D::Range>& vertexRanges = scene.dirtyVertices();
+  const std::vector<Scene2D::Range>& indexRanges = scene.dirtyIndices();
+  if(vertexRanges.empty() && indexRanges.empty()) return;
+
+  UploadSlice slice = stageUpload(scene.stats().uploadBytes);
+  char* staging = slice.data;
+  VkDeviceSize offset = 0;
+  VkDeviceSize indexSize = IndexData::indexSize(d_scene2DIndexType);
+  std::vector<VkBufferCopy> vertexCopies(vertexRanges.size()), indexCopies(indexRanges.size());
+  //indices first, the slice is aligned for them
+  for(size_t i = 0; i < indexRanges.size(); i++){
+    const uint32_t* indices = scene.indices().data()+indexRanges[i].first;
+    VkDeviceSize size = indexSize*indexRanges[i].count;
+    if(d_scene2DIndexType == VK_INDEX_TYPE_UINT16){
+      uint16_t* narrow = reinterpret_cast<uint16_t*>(staging+offset);
+      for(uint32_t j = 0; j < indexRanges[i].count; j++) narrow[j] = static_cast<uint16_t>(indices[j]);
+    }else{
+      memcpy(staging+offset, indices, static_cast<size_t>(size));
+    }
+    indexCopies[i] = {slice.offset+offset, indexSize*indexRanges[i].first, size};
+    offset += size;
+  }
+  for(size_t i = 0; i < vertexRanges.size(); i++){
+    VkDeviceSize size = sizeof(Vertex)*static_cast<VkDeviceSize>(vertexRanges[i].count);
+    memcpy(staging+offset, scene.vertices().data()+vertexRanges[i].first, static_cast<size_t>(size));
+    vertexCopies[i] = {slice.offset+offset, sizeof(Vertex)*static_cast<VkDeviceSize>(vertexRanges[i].first), size};
+    offset += size;
+  }
+  scene.clearDirty();
+
+  VkCommandBuffer commandBuffer = uploadCommands();
+  //write after read, only the execution has to wait
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+  if(!vertexCopies.empty()){
+    vkCmdCopyBuffer(commandBuffer, slice.buffer, d_scene2DVertexBuffer,
+        static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+  }
+  if(!indexCopies.empty()){
+    vkCmdCopyBuffer(commandBuffer, slice.buffer, d_scene2DIndexBuffer,
+        static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+  }
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+//called once the frame's fence has been waited on
+void BasicRenderer::beginFrameUploads(){
+  if(d_frameUploads.empty()){
+    size_t framesInFlight = d_swapchainConfig.framesInFlight;
+    std::vector<VkCommandBuffer> commands(framesInFlight);
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = d_commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(framesInFlight);
+    {
+      std::lock_guard<std::mutex> lock(d_singleTimeCommandsMutex);
+      if(vkAllocateCommandBuffers(d_device, &allocInfo, commands.data()) != VK_SUCCESS){
+        throw std::runtime_error("failed to allocate upload command buffers");
+      }
+    }
+    d_frameUploads.resize(framesInFlight);
+    for(size_t i = 0; i < framesInFlight; i++){
+      d_frameUploads[i].commands = commands[i];
+    }
+  }
+  FrameUpload& upload = d_frameUploads[d_currentFrame];
+  for(const auto& buffer : upload.retired){
+    vkDestroyBuffer(d_device, buffer.first, nullptr);
+    d_memory.free(buffer.second);
+  }
+  upload.retired.clear();
+  upload.stagingUsed = 0;
+  upload.recording = false;
+}
+
+//size bytes of the frame's staging buffer. It is grown for good when a frame needs
+//more, copies recorded before keep the old one until the frame has finished
+BasicRenderer::UploadSlice BasicRenderer::stageUpload(VkDeviceSize size){
+  FrameUpload& upload = d_frameUploads[d_currentFrame];
+  VkDeviceSize offset = (upload.stagingUsed+15) & ~static_cast<VkDeviceSize>(15);
+  if(offset+size > upload.stagingSize){
+    if(upload.staging != VK_NULL_HANDLE){
+      vkUnmapMemory(d_device, upload.stagingMemory);
+      upload.retired.push_back({upload.staging, upload.stagingMemory});
+    }
+    upload.stagingSize = std::max<VkDeviceSize>(size, 2*upload.stagingSize);
+    createBuffer(upload.stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        upload.staging, upload.stagingMemory, MemoryCategory::Staging);
+    vkMapMemory(d_device, upload.stagingMemory, 0, VK_WHOLE_SIZE, 0, &upload.stagingMapped);
+    offset = 0;
+  }
+  upload.stagingUsed = offset+size;
+  return {upload.staging, offset, static_cast<char*>(upload.stagingMapped)+offset};
+}
+
+VkCommandBuffer BasicRenderer::uploadCommands(){
+  FrameUpload& upload = d_frameUploads[d_currentFrame];
+  if(!upload.recording){
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if(vkBeginCommandBuffer(upload.commands, &beginInfo) != VK_SUCCESS){
+      throw std::runtime_error("failed to begin recording uploads!");
+    }
+    upload.recording = true;
+  }
+  return upload.commands;
+}
+
+//null when the frame copies nothing
+VkCommandBuffer BasicRenderer::endFrameUploads(){
+  FrameUpload& upload = d_frameUploads[d_currentFrame];
+  if(!upload.recording) return VK_NULL_HANDLE;
+  upload.recording = false;
+  if(vkEndCommandBuffer(upload.commands) != VK_SUCCESS){
+    throw std::runtime_error("failed to record uploads!");
+  }
+  return upload.commands;
+}
+
+void BasicRenderer::finishStartup(){
+  d_firstFramePresented = true;
+  double firstFrame = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-d_initStart).count();
+  if(d_startupTimeline){
+    d_initGraph.printTimeline(std::cout, "initVulkan");
+    std::cout<<"first frame presented after "<<firstFrame<<" ms"<<std::endl;
+  }
+  d_deferredGraph.run(*d_workers);
+  if(d_startupTimeline){
+    d_deferredGraph.printTimeline(std::cout, "deferred startup");
+  }
 }
 
 static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
@@ -513,7 +1286,15 @@ static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
     app->d_framebufferResized = true;
 }
 
+static void keyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/) {
+    auto app = reinterpret_cast<BasicRenderer*>(glfwGetWindowUserPointer(window));
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS) {
+        app->dumpTrace("trace_"+std::to_string(app->d_traceCount++)+".json");
+    }
+}
+
 void BasicRenderer::initWindow(){
+        if (d_headless) return;
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -521,6 +1302,7 @@ void BasicRenderer::initWindow(){
         d_window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
         glfwSetWindowUserPointer(d_window, this);
         glfwSetFramebufferSizeCallback(d_window, framebufferResizeCallback);
+        glfwSetKeyCallback(d_window, keyCallback);
 }
 
 void BasicRenderer::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo) {
@@ -584,6 +1366,7 @@ if (result != VK_SUCCESS) {
 }
 
 void BasicRenderer::createSurface(){
+if (d_headless) return;
 
 if (glfwCreateWindowSurface(d_instance, d_window, nullptr, &d_surface) != VK_SUCCESS) {
     throw std::runtime_error("failed to create window surface!");
@@ -594,6 +1377,9 @@ if (glfwCreateWindowSurface(d_instance, d_window, nullptr, &d_surface) != VK_SUC
 
 bool BasicRenderer::isDeviceSuitable(VkPhysicalDevice device) {
   QueueFamilyIndices indices = findQueueFamilies(device);
+    if (d_headless) {
+        return indices.isComplete();
+    }
 
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
@@ -604,8 +1390,7 @@ bool BasicRenderer::isDeviceSuitable(VkPhysicalDevice device) {
     }
     VkPhysicalDeviceFeatures deviceFeatures;
     vkGetPhysicalDeviceFeatures(device,&deviceFeatures);
-    return indices.isComplete() && extensionsSupported && swapChainAdequate
-      &&deviceFeatures.samplerAnisotropy;
+    return indices.isComplete() && extensionsSupported && swapChainAdequate;
 }
 void BasicRenderer::pickPhysicalDevice(){
 
@@ -649,8 +1434,13 @@ void BasicRenderer::createLogicalDevice(){
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        //software rasterizers such as lavapipe may lack anisotropic filtering
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(d_physicalDevice, &supportedFeatures);
+        d_samplerAnisotropy = supportedFeatures.samplerAnisotropy == VK_TRUE;
+
         VkPhysicalDeviceFeatures deviceFeatures = {};
-        deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.samplerAnisotropy = d_samplerAnisotropy ? VK_TRUE : VK_FALSE;
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
@@ -659,8 +1449,32 @@ void BasicRenderer::createLogicalDevice(){
 
         createInfo.pEnabledFeatures = &deviceFeatures;
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        //headless needs no swapchain extension
+        std::vector<const char*> extensions;
+        if (!d_headless) {
+            extensions = deviceExtensions;
+        }
+        //the pacer's present timing extensions only matter with a window to present to
+        FramePacer::Support pacing;
+        if (d_pacing.enabled && !d_headless) {
+            pacing = FramePacer::querySupport(d_instance, d_physicalDevice, d_physicalDeviceProperties2);
+            createInfo.pNext = d_pacer.enableDeviceSupport(pacing, extensions, createInfo.pNext);
+        }
+        bool memoryBudget = false;
+        if (d_physicalDeviceProperties2) {
+            uint32_t extensionCount = 0;
+            vkEnumerateDeviceExtensionProperties(d_physicalDevice, nullptr, &extensionCount, nullptr);
+            std::vector<VkExtensionProperties> available(extensionCount);
+            vkEnumerateDeviceExtensionProperties(d_physicalDevice, nullptr, &extensionCount, available.data());
+            for (const auto& extension : available) {
+                if (strcmp(extension.extensionName, MemoryTracker::budgetExtension()) == 0) {
+                    extensions.push_back(MemoryTracker::budgetExtension());
+                    memoryBudget = true;
+                }
+            }
+        }
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         if (d_enableValidationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -675,6 +1489,14 @@ void BasicRenderer::createLogicalDevice(){
 
         vkGetDeviceQueue(d_device, indices.graphicsFamily.value(), 0, &d_graphicsQueue);
         vkGetDeviceQueue(d_device, indices.presentFamily.value(), 0, &d_presentQueue);
+        d_layoutCache.init(d_device);
+        d_memory.init(d_instance, d_physicalDevice, d_device, memoryBudget);
+        d_pacer.init(d_device, pacing, d_pacing, !d_headless);
+        if (d_gpuProfiling) {
+            d_gpuProfiler.init(d_physicalDevice, d_device, indices.graphicsFamily.value(), 1+MAX_PROFILED_IMAGES);
+            //puts gpu samples on the steady clock so traces line them up with cpu zones
+            d_gpuProfiler.calibrate(d_graphicsQueue);
+        }
     }
 
 
@@ -688,10 +1510,11 @@ void BasicRenderer::createLogicalDevice(){
         return availableFormats[0];
     }
 
-    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-        for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                return availablePresentMode;
+    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes,
+            const std::vector<VkPresentModeKHR>& preferredPresentModes) {
+        for (const auto& preferredPresentMode : preferredPresentModes) {
+            if (std::find(availablePresentModes.begin(), availablePresentModes.end(), preferredPresentMode) != availablePresentModes.end()) {
+                return preferredPresentMode;
             }
         }
 
@@ -741,16 +1564,31 @@ void BasicRenderer::createLogicalDevice(){
     }
 
 void BasicRenderer::createSwapChain(){
+        if (d_headless) {
+            createOffscreenImages();
+            return;
+        }
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(d_physicalDevice);
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes, d_swapchainConfig.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
         uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        if (d_swapchainConfig.minImageCount > 0) {
+            imageCount = std::max(d_swapchainConfig.minImageCount, swapChainSupport.capabilities.minImageCount);
+        }
         if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
             imageCount = swapChainSupport.capabilities.maxImageCount;
         }
+        if (d_swapchainConfig.minImageCount > 0 && imageCount != d_swapchainConfig.minImageCount) {
+            std::cerr<<"swap chain: "<<d_swapchainConfig.minImageCount<<" images requested, surface allows "
+                <<imageCount<<std::endl;
+        }
+        if (presentMode != d_swapchainConfig.presentModes.front()) {
+            std::cerr<<"swap chain: "<<presentModeName(d_swapchainConfig.presentModes.front())
+                <<" not supported, presenting with "<<presentModeName(presentMode)<<std::endl;
+        }
 
         VkSwapchainCreateInfoKHR createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -762,6 +1600,12 @@ void BasicRenderer::createSwapChain(){
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if (d_readbackDepth > 0) {
+            if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+                throw std::runtime_error("swap chain images cannot be read back on this surface");
+            }
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
 
         QueueFamilyIndices indices = findQueueFamilies(d_physicalDevice);
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
@@ -789,10 +1633,28 @@ void BasicRenderer::createSwapChain(){
 
         d_swapChainImageFormat = surfaceFormat.format;
         d_swapChainExtent = extent;
+        d_presentMode = presentMode;
+        d_pacer.setSwapchain(d_swapChain);
     
 }
 
 
+//one color image per frame in flight stands in for the swapchain images, everything
+//downstream (views, framebuffers, uniform buffers) is created for them unchanged
+void BasicRenderer::createOffscreenImages(){
+        d_swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        d_swapChainExtent = d_headlessExtent;
+        d_swapChainImages.resize(d_swapchainConfig.framesInFlight);
+        d_offscreenImagesMemory.resize(d_swapchainConfig.framesInFlight);
+        for (size_t i = 0; i < d_swapChainImages.size(); i++) {
+            createImage(d_swapChainExtent.width, d_swapChainExtent.height, d_swapChainImageFormat,
+                VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, d_swapChainImages[i], d_offscreenImagesMemory[i],
+                MemoryCategory::Swapchain);
+        }
+}
+
+
 VkImageView BasicRenderer::createImageView(VkImage image, VkFormat format,
     VkImageAspectFlags aspectFlags){
         VkImageViewCreateInfo viewInfo = {};
@@ -860,7 +1722,8 @@ void BasicRenderer::createRenderPass(){
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        //offscreen images are left ready to be copied out
+        colorAttachment.finalLayout = d_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentRef = {};
         colorAttachmentRef.attachment = 0;
@@ -898,23 +1761,6 @@ void BasicRenderer::createRenderPass(){
             throw std::runtime_error("failed to create render pass!");
         }
 }
-    static std::vector<char> readFile(const std::string& filename) {
-        std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-        if (!file.is_open()) {
-            throw std::runtime_error("failed to open file!");
-        }
-
-        size_t fileSize = (size_t) file.tellg();
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-
-        file.close();
-
-        return buffer;
-    }
     VkShaderModule BasicRenderer::createShaderModule(const std::vector<char>& code) {
         VkShaderModuleCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -930,28 +1776,52 @@ void BasicRenderer::createRenderPass(){
     }
 
 void BasicRenderer::createDescriptorSetLayout(){
-  VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-  uboLayoutBinding.binding = 0;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uboLayoutBinding.descriptorCount = 1;
-  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-  samplerLayoutBinding.binding = 1;
-  samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  samplerLayoutBinding.descriptorCount =1;
-  samplerLayoutBinding.pImmutableSamplers = nullptr;
-  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-  std::array<VkDescriptorSetLayoutBinding,2> bindings = {uboLayoutBinding,
-    samplerLayoutBinding};
-  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-  layoutInfo.pBindings = bindings.data(); 
-
-  if(vkCreateDescriptorSetLayout(d_device, &layoutInfo,nullptr,&d_descriptorSetLayout)!=VK_SUCCESS){
-    throw std::runtime_error("failed to create descriptor set layout");
+  //the set layout, push constants and vertex input are all derived from the
+  //shader binaries themselves so they can never drift out of sync
+  d_vertShaderCode = readFile(shaderPath("shader.vert.spv"));
+  d_fragShaderCode = readFile(shaderPath("shader.frag.spv"));
+  d_shaderLayout = mergeReflections({reflectShader(d_vertShaderCode),
+      reflectShader(d_fragShaderCode)});
+  d_quadVertShaderCode = readFile(shaderPath("quad.vert.spv"));
+  d_quadFragShaderCode = readFile(shaderPath("quad.frag.spv"));
+  if(!mergeReflections({reflectShader(d_quadVertShaderCode),
+      reflectShader(d_quadFragShaderCode)}).fitsIn(d_shaderLayout)){
+    throw std::runtime_error("quad shaders use resources shader.vert/shader.frag do not declare");
+  }
+  d_lineVertShaderCode = readFile(shaderPath("line.vert.spv"));
+  d_lineFragShaderCode = readFile(shaderPath("line.frag.spv"));
+  d_lineShaderLayout = mergeReflections({reflectShader(d_lineVertShaderCode),
+      reflectShader(d_lineFragShaderCode)});
+  if(d_lineShaderLayout.sets.size()!=1 || d_lineShaderLayout.sets.count(1)==0
+      || d_lineShaderLayout.sets[1].size()!=1
+      || d_lineShaderLayout.sets[1][0].descriptorType!=VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+      || !d_lineShaderLayout.pushConstantRanges.empty()){
+    throw std::runtime_error("line shaders are expected to read one storage buffer in set 1 and nothing else");
+  }
+  d_textFragShaderCode = readFile(shaderPath("text.frag.spv"));
+  d_textShaderLayout = mergeReflections({reflectShader(d_quadVertShaderCode),
+      reflectShader(d_textFragShaderCode)});
+  if(d_textShaderLayout.sets.size()!=1 || d_textShaderLayout.sets.count(1)==0
+      || d_textShaderLayout.sets[1].size()!=1
+      || d_textShaderLayout.sets[1][0].descriptorType!=VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+      || !d_textShaderLayout.pushConstantRanges.empty()){
+    throw std::runtime_error("text shaders are expected to sample one texture in set 1 and nothing else");
   }
+
+  if(d_shaderLayout.sets.size()!=1 || d_shaderLayout.sets.count(0)==0){
+    throw std::runtime_error("renderer expects shaders to use exactly descriptor set 0");
+  }
+  d_descriptorSetLayout = d_layoutCache.getSetLayout(d_shaderLayout.sets[0]);
+  //created once here, pipelines are built on worker threads that only read it
+  d_pipelineLayout = d_layoutCache.getPipelineLayout({d_descriptorSetLayout},
+      d_shaderLayout.pushConstantRanges);
+  //set 0 and the push constants match the scene's, so its descriptor set stays bound
+  d_lineSetLayout = d_layoutCache.getSetLayout(d_lineShaderLayout.sets[1]);
+  d_linePipelineLayout = d_layoutCache.getPipelineLayout({d_descriptorSetLayout, d_lineSetLayout},
+      d_shaderLayout.pushConstantRanges);
+  d_glyphSetLayout = d_layoutCache.getSetLayout(d_textShaderLayout.sets[1]);
+  d_glyphPipelineLayout = d_layoutCache.getPipelineLayout({d_descriptorSetLayout, d_glyphSetLayout},
+      d_shaderLayout.pushConstantRanges);
 }
 void BasicRenderer::createUniformBuffers() {
   VkDeviceSize bufferSize = sizeof(UniformBufferObject);
@@ -962,14 +1832,40 @@ void BasicRenderer::createUniformBuffers() {
   for (size_t i=0; i< d_swapChainImages.size();i++){
     createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-        d_uniformBuffers[i],d_uniformBuffersMemory[i]);
+        d_uniformBuffers[i],d_uniformBuffersMemory[i],MemoryCategory::Uniform);
   }
 
 }
-void BasicRenderer::createGraphicsPipeline(){
+void BasicRenderer::createPipelineCache(){
+        VkPipelineCacheCreateInfo cacheInfo = {};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 
-        auto vertShaderCode = readFile("../shaders/vert.spv");
-        auto fragShaderCode = readFile("../shaders/frag.spv");
+        if (vkCreatePipelineCache(d_device, &cacheInfo, nullptr, &d_pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+}
+void BasicRenderer::createGraphicsPipeline(){
+        d_graphicsPipeline = buildGraphicsPipeline(d_vertShaderCode, d_fragShaderCode, PipelineKey());
+}
+void BasicRenderer::createPipelineLibrary(){
+        //permutations other than the default are compiled on demand off the render thread
+        d_pipelines.init(d_device, [this](const PipelineKey& key){
+            std::lock_guard<std::mutex> lock(d_pipelineMutex);
+            if (key.source == VertexSource::InstancedQuads) {
+                return buildGraphicsPipeline(d_quadVertShaderCode, d_quadFragShaderCode, key);
+            }
+            if (key.source == VertexSource::LineSegments) {
+                return buildGraphicsPipeline(d_lineVertShaderCode, d_lineFragShaderCode, key);
+            }
+            if (key.source == VertexSource::Glyphs) {
+                return buildGraphicsPipeline(d_quadVertShaderCode, d_textFragShaderCode, key);
+            }
+            return buildGraphicsPipeline(d_vertShaderCode, d_fragShaderCode, key);
+        });
+}
+//may run on the shader watcher thread, callers must hold d_pipelineMutex
+VkPipeline BasicRenderer::buildGraphicsPipeline(const std::vector<char>& vertShaderCode,
+        const std::vector<char>& fragShaderCode, const PipelineKey& key){
 
         VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
         VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
@@ -986,42 +1882,80 @@ void BasicRenderer::createGraphicsPipeline(){
         fragShaderStageInfo.module = fragShaderModule;
         fragShaderStageInfo.pName = "main";
 
+        //shader.frag picks its permutation from these specialization constants
+        VkBool32 antialias = key.antialias ? VK_TRUE : VK_FALSE;
+        struct {
+            int32_t variant;
+            float alphaCutoff;
+            VkBool32 antialias;
+        } specializationData = {static_cast<int32_t>(key.variant), key.alphaCutoff, antialias};
+        VkSpecializationMapEntry specializationEntries[] = {
+            {0, offsetof(decltype(specializationData), variant), sizeof(int32_t)},
+            {1, offsetof(decltype(specializationData), alphaCutoff), sizeof(float)},
+            {3, offsetof(decltype(specializationData), antialias), sizeof(VkBool32)}
+        };
+        VkSpecializationInfo specializationInfo = {};
+        specializationInfo.mapEntryCount = 3;
+        specializationInfo.pMapEntries = specializationEntries;
+        specializationInfo.dataSize = sizeof(specializationData);
+        specializationInfo.pData = &specializationData;
+        fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
+        VkBool32 screenSpace = key.screenSpace ? VK_TRUE : VK_FALSE;
+        VkBool32 vertexSpecializationData[] = {screenSpace, antialias};
+        VkSpecializationMapEntry vertexSpecializationEntries[] = {
+            {2, 0, sizeof(VkBool32)},
+            {3, sizeof(VkBool32), sizeof(VkBool32)}
+        };
+        VkSpecializationInfo vertexSpecializationInfo = {};
+        vertexSpecializationInfo.mapEntryCount = 2;
+        vertexSpecializationInfo.pMapEntries = vertexSpecializationEntries;
+        vertexSpecializationInfo.dataSize = sizeof(vertexSpecializationData);
+        vertexSpecializationInfo.pData = vertexSpecializationData;
+        vertShaderStageInfo.pSpecializationInfo = &vertexSpecializationInfo;
+
         VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
         VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        VkVertexInputBindingDescription bindingDescription;
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        if (key.source == VertexSource::LineSegments) {
+            //line.vert reads its segments out of the storage buffer itself
+            bindingDescription = {};
+        } else if (key.source == VertexSource::InstancedQuads || key.source == VertexSource::Glyphs) {
+            //packed formats the reflection cannot infer from the shader's vec4 inputs
+            bindingDescription = QuadInstance::getBindingDescription();
+            attributeDescriptions = QuadInstance::getAttributeDescriptions();
+        } else {
+            bindingDescription = Vertex::getBindingDescription();
+            if(d_shaderLayout.vertexAttributes(0, attributeDescriptions) != bindingDescription.stride){
+                throw std::runtime_error("vertex shader inputs do not match the Vertex layout");
+            }
+        }
 
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.vertexBindingDescriptionCount = key.source == VertexSource::LineSegments ? 0 : 1;
         vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
         vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
         VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
         inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        inputAssembly.topology = key.topology;
         inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-        VkViewport viewport = {};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float) d_swapChainExtent.width;
-        viewport.height = (float) d_swapChainExtent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        VkRect2D scissor = {};
-        scissor.offset = {0, 0};
-        scissor.extent = d_swapChainExtent;
-
+        //viewport and scissor are set while recording so pipelines do not depend
+        //on the swap chain extent and can be built off the render thread
         VkPipelineViewportStateCreateInfo viewportState = {};
         viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
         viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
+
+        std::array<VkDynamicState,2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamicState = {};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+        dynamicState.pDynamicStates = dynamicStates.data();
 
         VkPipelineRasterizationStateCreateInfo rasterizer = {};
         rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -1029,7 +1963,7 @@ void BasicRenderer::createGraphicsPipeline(){
         rasterizer.rasterizerDiscardEnable = VK_FALSE;
         rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
         rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+        rasterizer.cullMode = key.screenSpace ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
         rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
         rasterizer.depthBiasEnable = VK_FALSE;
 
@@ -1040,7 +1974,13 @@ void BasicRenderer::createGraphicsPipeline(){
 
         VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
         colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
+        colorBlendAttachment.blendEnable = key.blend == BlendMode::Opaque ? VK_FALSE : VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor = key.blend == BlendMode::Alpha ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstColorBlendFactor = key.blend == BlendMode::Alpha ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = key.blend == BlendMode::Alpha ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
         VkPipelineColorBlendStateCreateInfo colorBlending = {};
         colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -1053,19 +1993,10 @@ void BasicRenderer::createGraphicsPipeline(){
         colorBlending.blendConstants[2] = 0.0f;
         colorBlending.blendConstants[3] = 0.0f;
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;
-        pipelineLayoutInfo.pSetLayouts = &d_descriptorSetLayout;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-        if (vkCreatePipelineLayout(d_device, &pipelineLayoutInfo, nullptr, &d_pipelineLayout) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create pipeline layout!");
-        }
         VkPipelineDepthStencilStateCreateInfo depthStencil = {};
         depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-        depthStencil.depthTestEnable = VK_TRUE;
-        depthStencil.depthWriteEnable = VK_TRUE;
+        depthStencil.depthTestEnable = key.depthTest ? VK_TRUE : VK_FALSE;
+        depthStencil.depthWriteEnable = key.depthWrite ? VK_TRUE : VK_FALSE;
         depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
         depthStencil.depthBoundsTestEnable = VK_FALSE;
         depthStencil.minDepthBounds = 0.0f;
@@ -1084,18 +2015,24 @@ void BasicRenderer::createGraphicsPipeline(){
         pipelineInfo.pRasterizationState = &rasterizer;
         pipelineInfo.pMultisampleState = &multisampling;
         pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.layout = d_pipelineLayout;
+        pipelineInfo.layout = key.source == VertexSource::LineSegments ? d_linePipelineLayout
+            : key.source == VertexSource::Glyphs ? d_glyphPipelineLayout : d_pipelineLayout;
         pipelineInfo.renderPass = d_renderPass;
         pipelineInfo.subpass = 0;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
         pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pDynamicState = &dynamicState;
 
-        if (vkCreateGraphicsPipelines(d_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &d_graphicsPipeline) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create graphics pipeline!");
-        }
+        VkPipeline pipeline;
+        VkResult result = vkCreateGraphicsPipelines(d_device, d_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
 
         vkDestroyShaderModule(d_device, fragShaderModule, nullptr);
         vkDestroyShaderModule(d_device, vertShaderModule, nullptr);
+
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create graphics pipeline!");
+        }
+        return pipeline;
 }
 void BasicRenderer::createFramebuffers(){
 
@@ -1129,6 +2066,8 @@ void BasicRenderer::createCommandPool(){
         VkCommandPoolCreateInfo poolInfo = {};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+        //command buffers get re-recorded individually when the pipeline is swapped
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
         if (vkCreateCommandPool(d_device, &poolInfo, nullptr, &d_commandPool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create graphics command pool!");
@@ -1148,7 +2087,8 @@ void BasicRenderer::createCommandPool(){
 
         throw std::runtime_error("failed to find suitable memory type!");
     }
-    void BasicRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+    void BasicRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+            MemoryCategory category) {
         VkBufferCreateInfo bufferInfo = {};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
@@ -1167,47 +2107,59 @@ void BasicRenderer::createCommandPool(){
         allocInfo.allocationSize = memRequirements.size;
         allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
-        if (vkAllocateMemory(d_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+        if (d_memory.allocate(allocInfo, category, bufferMemory) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate buffer memory!");
         }
 
         vkBindBufferMemory(d_device, buffer, bufferMemory, 0);
     }
   
-    VkCommandBuffer BasicRenderer::beginSingleTimeCommands(){
+    BasicRenderer::SingleTimeCommands::SingleTimeCommands(BasicRenderer& renderer, const char* zone)
+        : d_renderer(renderer), d_lock(renderer.d_singleTimeCommandsMutex), d_zone(zone){
         VkCommandBufferAllocateInfo allocInfo = {};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = d_commandPool;
+        allocInfo.commandPool = renderer.d_commandPool;
         allocInfo.commandBufferCount = 1;
 
-        VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(d_device, &allocInfo, &commandBuffer);
+        if(vkAllocateCommandBuffers(renderer.d_device, &allocInfo, &d_buffer) != VK_SUCCESS){
+            d_buffer = VK_NULL_HANDLE;
+            throw std::runtime_error("failed to allocate a single time command buffer");
+        }
 
         VkCommandBufferBeginInfo beginInfo = {};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
-       
-        return commandBuffer; 
+        vkBeginCommandBuffer(d_buffer, &beginInfo);
+        renderer.d_gpuProfiler.beginSlot(d_buffer, UPLOAD_PROFILER_SLOT);
+        renderer.d_gpuProfiler.begin(d_buffer, UPLOAD_PROFILER_SLOT, zone);
     }
 
+    BasicRenderer::SingleTimeCommands::~SingleTimeCommands(){
+        //a buffer that was never submitted is not pending, so it can be freed as is
+        if(d_buffer != VK_NULL_HANDLE){
+            vkFreeCommandBuffers(d_renderer.d_device, d_renderer.d_commandPool, 1, &d_buffer);
+        }
+    }
 
-
-    void BasicRenderer::endSingleTimeCommands(VkCommandBuffer commandBuffer){
-        vkEndCommandBuffer(commandBuffer);
+    void BasicRenderer::SingleTimeCommands::submit(){
+        d_renderer.d_gpuProfiler.end(d_buffer, UPLOAD_PROFILER_SLOT, d_zone);
+        vkEndCommandBuffer(d_buffer);
     
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.pCommandBuffers = &d_buffer;
 
-        vkQueueSubmit(d_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(d_graphicsQueue);
+        vkQueueSubmit(d_renderer.d_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(d_renderer.d_graphicsQueue);
+        //already waited for, reading the timestamps back costs nothing extra
+        d_renderer.d_gpuProfiler.collect(UPLOAD_PROFILER_SLOT);
 
-        vkFreeCommandBuffers(d_device, d_commandPool, 1, &commandBuffer);
-    
+        vkFreeCommandBuffers(d_renderer.d_device, d_renderer.d_commandPool, 1, &d_buffer);
+        d_buffer = VK_NULL_HANDLE;
+        d_lock.unlock();
     }
 
 
@@ -1216,9 +2168,9 @@ void BasicRenderer::createCommandPool(){
 
         VkBufferCopy copyRegion = {};
         copyRegion.size = size;
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-        endSingleTimeCommands(commandBuffer);
+        SingleTimeCommands commands(*this, "buffer upload");
+        vkCmdCopyBuffer(commands.buffer(), srcBuffer, dstBuffer, 1, &copyRegion);
+        commands.submit();
 
 
     }
@@ -1230,63 +2182,82 @@ void BasicRenderer::createVertexBuffer(){
 
         VkBuffer stagingBuffer;
         VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, MemoryCategory::Staging);
 
         void* data;
         vkMapMemory(d_device, stagingBufferMemory, 0, bufferSize, 0, &data);
             memcpy(data, d_verticies.data(), (size_t) bufferSize);
         vkUnmapMemory(d_device, stagingBufferMemory);
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, d_vertexBuffer, d_vertexBufferMemory);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, d_vertexBuffer, d_vertexBufferMemory, MemoryCategory::Vertex);
 
         copyBuffer(stagingBuffer, d_vertexBuffer, bufferSize);
 
         vkDestroyBuffer(d_device, stagingBuffer, nullptr);
-        vkFreeMemory(d_device, stagingBufferMemory, nullptr);
+        d_memory.free(stagingBufferMemory);
 }
 
-void BasicRenderer::updateVertexBuffer(){
-        VkDeviceSize bufferSize = sizeof(d_verticies[0]) * d_verticies.size();
-
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-        void* data;
-        vkMapMemory(d_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-            memcpy(data, d_verticies.data(), (size_t) bufferSize);
-        vkUnmapMemory(d_device, stagingBufferMemory);
-
-        copyBuffer(stagingBuffer, d_vertexBuffer, bufferSize);
-
-        vkDestroyBuffer(d_device, stagingBuffer, nullptr);
-        vkFreeMemory(d_device, stagingBufferMemory, nullptr);
-}
-
-
-
 void BasicRenderer::createIndexBuffer(){
-        VkDeviceSize bufferSize = sizeof(d_indicies[0]) * d_indicies.size();
+        VkDeviceSize bufferSize = d_indicies.byteSize();
 
         VkBuffer stagingBuffer;
         VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, MemoryCategory::Staging);
 
         void* data;
         vkMapMemory(d_device, stagingBufferMemory, 0, bufferSize, 0, &data);
             memcpy(data, d_indicies.data(), (size_t) bufferSize);
         vkUnmapMemory(d_device, stagingBufferMemory);
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, d_indexBuffer, d_indexBufferMemory);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, d_indexBuffer, d_indexBufferMemory, MemoryCategory::Index);
 
         copyBuffer(stagingBuffer, d_indexBuffer, bufferSize);
 
         vkDestroyBuffer(d_device, stagingBuffer, nullptr);
-        vkFreeMemory(d_device, stagingBufferMemory, nullptr);
+        d_memory.free(stagingBufferMemory);
 }
 
-void BasicRenderer::updateIndexBuffer(){
-    //TODO
+//frames still in flight draw the old mesh, the barrier orders the copy after their
+//vertex input
+void BasicRenderer::recordGeometryUpload(){
+  d_geometryDirty = false;
+  VkDeviceSize vertexBytes = sizeof(Vertex)*static_cast<VkDeviceSize>(d_verticies.size());
+  VkDeviceSize indexBytes = d_indicies.byteSize();
+  if(vertexBytes == 0 || indexBytes == 0) return;
+  UploadSlice slice = stageUpload(vertexBytes+indexBytes);
+  memcpy(slice.data, d_verticies.data(), static_cast<size_t>(vertexBytes));
+  memcpy(slice.data+vertexBytes, d_indicies.data(), static_cast<size_t>(indexBytes));
+
+  VkCommandBuffer commandBuffer = uploadCommands();
+  //write after read, only the execution has to wait
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+  VkBufferCopy vertexCopy = {slice.offset, 0, vertexBytes};
+  vkCmdCopyBuffer(commandBuffer, slice.buffer, d_vertexBuffer, 1, &vertexCopy);
+  VkBufferCopy indexCopy = {slice.offset+vertexBytes, 0, indexBytes};
+  vkCmdCopyBuffer(commandBuffer, slice.buffer, d_indexBuffer, 1, &indexCopy);
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void BasicRenderer::consumeFramePacket(){
+  //never waits, with nothing new the last packet stays in effect
+  if(d_packetSource==nullptr || !d_packetSource->update()) return;
+  const FramePacket& packet = d_packetSource->front();
+  if(packet.camera) d_camera = packet.camera;
+  d_model = packet.model;
+  if(packet.geometry && packet.geometry!=d_packetGeometry){
+    PROFILE_ZONE("packet geometry");
+    const Geometry& geometry = *packet.geometry;
+    replaceGeometry(geometry.verticies, IndexData(geometry.indicies, geometry.verticies.size()));
+    d_packetGeometry = packet.geometry;
+  }
 }
 
 void BasicRenderer::createCommandBuffers(){
@@ -1301,7 +2272,14 @@ void BasicRenderer::createCommandBuffers(){
             throw std::runtime_error("failed to allocate command buffers!");
         }
 
+        d_commandBufferDirty.assign(d_commandBuffers.size(), false);
+        d_imageDraws2D.assign(d_commandBuffers.size(), false);
         for (size_t i = 0; i < d_commandBuffers.size(); i++) {
+            recordCommandBuffer(i);
+        }
+
+}
+void BasicRenderer::recordCommandBuffer(size_t i){
             VkCommandBufferBeginInfo beginInfo = {};
             beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -1323,35 +2301,141 @@ void BasicRenderer::createCommandBuffers(){
             renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
             renderPassInfo.pClearValues = clearValues.data();
 
+            uint32_t profilerSlot = 1+static_cast<uint32_t>(i);
+            d_gpuProfiler.beginSlot(d_commandBuffers[i], profilerSlot);
+            d_gpuProfiler.begin(d_commandBuffers[i], profilerSlot, "render pass");
             vkCmdBeginRenderPass(d_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-                vkCmdBindPipeline(d_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, d_graphicsPipeline);
+                //draw with the default pipeline until the requested permutation has compiled
+                VkPipeline pipeline = d_graphicsPipeline;
+                if (d_pipelineKey != PipelineKey()) {
+                    VkPipeline variant = d_pipelines.get(d_pipelineKey);
+                    if (variant != VK_NULL_HANDLE) {
+                        pipeline = variant;
+                    } else {
+                        d_waitingForPipeline = true;
+                    }
+                }
+                vkCmdBindPipeline(d_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+                VkViewport viewport = {};
+                viewport.x = 0.0f;
+                viewport.y = 0.0f;
+                viewport.width = (float) d_swapChainExtent.width;
+                viewport.height = (float) d_swapChainExtent.height;
+                viewport.minDepth = 0.0f;
+                viewport.maxDepth = 1.0f;
+                vkCmdSetViewport(d_commandBuffers[i], 0, 1, &viewport);
+
+                VkRect2D scissor = {};
+                scissor.offset = {0, 0};
+                scissor.extent = d_swapChainExtent;
+                vkCmdSetScissor(d_commandBuffers[i], 0, 1, &scissor);
 
                 VkBuffer vertexBuffers[] = {d_vertexBuffer};
                 VkDeviceSize offsets[] = {0};
                 vkCmdBindVertexBuffers(d_commandBuffers[i], 0, 1, vertexBuffers, offsets);
 
-                vkCmdBindIndexBuffer(d_commandBuffers[i], d_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+                vkCmdBindIndexBuffer(d_commandBuffers[i], d_indexBuffer, 0, d_indicies.type());
                 
                 vkCmdBindDescriptorSets(d_commandBuffers[i],VK_PIPELINE_BIND_POINT_GRAPHICS, d_pipelineLayout, 
                     0, 1, &d_descriptorSets[i],0, nullptr);
 
-                vkCmdDrawIndexed(d_commandBuffers[i], static_cast<uint32_t>(d_indicies.size()), 1, 0, 0, 0);
+                vkCmdDrawIndexed(d_commandBuffers[i], d_indicies.count(), 1, 0, 0, 0);
+
+                if (d_scene2D && d_scene2DIndexCount > 0) {
+                    recordScene2D(d_commandBuffers[i]);
+                }
+
+                //on top of the scene, from the arena of the frame being recorded
+                d_imageDraws2D[i] = d_drawList2DBegun;
+                if (d_drawList2DBegun && !d_drawList2D->empty()) {
+                    recordDrawList2D(d_commandBuffers[i]);
+                }
 
             vkCmdEndRenderPass(d_commandBuffers[i]);
+            d_gpuProfiler.end(d_commandBuffers[i], profilerSlot, "render pass");
 
             if (vkEndCommandBuffer(d_commandBuffers[i]) != VK_SUCCESS) {
                 throw std::runtime_error("failed to record command buffer!");
             }
+}
+//the whole index range in one draw, free ranges in it are degenerate triangles
+void BasicRenderer::recordScene2D(VkCommandBuffer commandBuffer){
+        VkPipeline pipeline = d_pipelines.get(DrawList2D::defaultPipeline());
+        if (pipeline == VK_NULL_HANDLE) {
+            d_waitingForScene2DPipeline = true;
+            return;
+        }
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &d_scene2DVertexBuffer, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, d_scene2DIndexBuffer, 0, d_scene2DIndexType);
+        vkCmdDrawIndexed(commandBuffer, d_scene2DIndexCount, 1, 0, 0, 0);
+}
+void BasicRenderer::recordDrawList2D(VkCommandBuffer commandBuffer){
+        VkBuffer arena = d_arenaBuffers[d_currentFrame];
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &arena, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, arena, d_arenaIndexOffset, VK_INDEX_TYPE_UINT16);
+        VkDeviceSize quadOffset = d_arenaQuadOffset;
+        bool instancesBound = false;
+        //lines and glyphs both use set 1, for segments and the atlas
+        VertexSource set1Bound = VertexSource::Mesh;
+
+        //set 0 is compatible across every 2D pipeline layout, the scene's descriptor set stays bound
+        VkPipeline bound = VK_NULL_HANDLE;
+        for (const DrawList2D::Batch& batch : d_drawList2D->batches()) {
+            VkPipeline pipeline = d_pipelines.get(batch.key);
+            if (pipeline == VK_NULL_HANDLE) {
+                d_waitingForPipeline = true;
+                continue;
+            }
+            if (pipeline != bound) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                bound = pipeline;
+            }
+            if (batch.key.source == VertexSource::LineSegments) {
+                if (set1Bound != VertexSource::LineSegments) {
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, d_linePipelineLayout,
+                        1, 1, &d_lineDescriptorSets[d_currentFrame], 0, nullptr);
+                    set1Bound = VertexSource::LineSegments;
+                }
+                //six vertices per segment, line.vert finds its segment from gl_VertexIndex
+                vkCmdDraw(commandBuffer, 6*batch.instanceCount, 1, 6*batch.firstInstance, 0);
+                continue;
+            }
+            if (batch.key.source == VertexSource::Glyphs && !d_glyphAtlas) {
+                continue;
+            }
+            if (batch.key.source == VertexSource::Glyphs && set1Bound != VertexSource::Glyphs) {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, d_glyphPipelineLayout,
+                    1, 1, &d_glyphDescriptorSet, 0, nullptr);
+                set1Bound = VertexSource::Glyphs;
+            }
+            //quads and glyphs read the same instances
+            bool instanced = batch.key.source != VertexSource::Mesh;
+            if (instanced != instancesBound) {
+                instancesBound = instanced;
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, &arena, instanced ? &quadOffset : &offset);
+            }
+            if (instanced) {
+                //the unit quad comes from gl_VertexIndex, only the instances are read
+                vkCmdDraw(commandBuffer, 6, batch.instanceCount, 0, batch.firstInstance);
+            } else {
+                vkCmdDrawIndexed(commandBuffer, batch.indexCount, 1, batch.firstIndex, batch.vertexOffset, 0);
+            }
         }
-
 }
 void BasicRenderer::createSyncObjects(){
 
-        d_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        d_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        d_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        size_t framesInFlight = d_swapchainConfig.framesInFlight;
+        d_imageAvailableSemaphores.resize(framesInFlight);
+        d_renderFinishedSemaphores.resize(framesInFlight);
+        d_inFlightFences.resize(framesInFlight);
         d_imagesInFlight.resize(d_swapChainImages.size(), VK_NULL_HANDLE);
+        d_frameInputTimes.resize(framesInFlight);
+        d_frameLatencyPending.assign(framesInFlight, false);
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -1360,7 +2444,7 @@ void BasicRenderer::createSyncObjects(){
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < framesInFlight; i++) {
             if (vkCreateSemaphore(d_device, &semaphoreInfo, nullptr, &d_imageAvailableSemaphores[i]) != VK_SUCCESS ||
                 vkCreateSemaphore(d_device, &semaphoreInfo, nullptr, &d_renderFinishedSemaphores[i]) != VK_SUCCESS ||
                 vkCreateFence(d_device, &fenceInfo, nullptr, &d_inFlightFences[i]) != VK_SUCCESS) {
@@ -1370,11 +2454,32 @@ void BasicRenderer::createSyncObjects(){
 }
 
 void BasicRenderer::drawFrame(){
-
-        vkWaitForFences(d_device, 1, &d_inFlightFences[d_currentFrame], VK_TRUE, UINT64_MAX);
-
-        uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(d_device, d_swapChain, UINT64_MAX, d_imageAvailableSemaphores[d_currentFrame], VK_NULL_HANDLE, &imageIndex);
+        PROFILE_ZONE("drawFrame");
+        //frames that finished while the CPU was busy, their latency is accurate to a frame
+        for (size_t i = 0; i < d_inFlightFences.size(); i++) {
+            if (d_frameLatencyPending[i] && vkGetFenceStatus(d_device, d_inFlightFences[i]) == VK_SUCCESS) {
+                recordFrameLatency(i);
+            }
+        }
+        {
+            PROFILE_ZONE("fence wait");
+            vkWaitForFences(d_device, 1, &d_inFlightFences[d_currentFrame], VK_TRUE, UINT64_MAX);
+            recordFrameLatency(d_currentFrame);
+        }
+        beginFrameUploads();
+        {
+            PROFILE_ZONE("pacing");
+            d_pacer.beginFrame(d_currentFrame);
+        }
+        swapPendingPipeline();
+
+        //headless there is one offscreen image per frame in flight, nothing to acquire
+        uint32_t imageIndex = static_cast<uint32_t>(d_currentFrame);
+        VkResult result = VK_SUCCESS;
+        if (!d_headless) {
+            PROFILE_ZONE("acquire");
+            result = vkAcquireNextImageKHR(d_device, d_swapChain, UINT64_MAX, d_imageAvailableSemaphores[d_currentFrame], VK_NULL_HANDLE, &imageIndex);
+        }
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapChain();
@@ -1384,32 +2489,120 @@ void BasicRenderer::drawFrame(){
         }
 
         if (d_imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+            PROFILE_ZONE("image fence wait");
             vkWaitForFences(d_device, 1, &d_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+            //results of the previous submission of this image, frames in flight late
+            d_gpuProfiler.collect(1+imageIndex);
         }
         d_imagesInFlight[imageIndex] = d_inFlightFences[d_currentFrame];
+
+        //before recording, growing the scene's buffers dirties every command buffer
+        if (d_scene2D) {
+            PROFILE_ZONE("scene2D sync");
+            syncScene2D();
+        }
+
+        if (d_waitingForPipeline && d_pipelines.ready(d_pipelineKey)) {
+            d_waitingForPipeline = false;
+            d_commandBufferDirty.assign(d_commandBuffers.size(), true);
+        }
+        if (d_waitingForScene2DPipeline && d_pipelines.ready(DrawList2D::defaultPipeline())) {
+            d_waitingForScene2DPipeline = false;
+            d_commandBufferDirty.assign(d_commandBuffers.size(), true);
+        }
+        //a 2D list differs every frame, and a recording that drew one reads a stale arena
+        if (d_drawList2DBegun || d_imageDraws2D[imageIndex]) {
+            d_commandBufferDirty[imageIndex] = true;
+        }
+        if (d_commandBufferDirty[imageIndex]) {
+            PROFILE_ZONE("record");
+            recordCommandBuffer(imageIndex);
+            d_commandBufferDirty[imageIndex] = false;
+            releaseRetiredPipelines();
+        }
         
-        //updateVertexBuffer();
-        updateUniformBuffer(imageIndex);
+        //the copy is recorded before submitting so a full ring holds back this frame,
+        //not the GPU
+        VkCommandBuffer readbackCommands = VK_NULL_HANDLE;
+        VkFence readbackFence = VK_NULL_HANDLE;
+        if (d_readback.active()) {
+            PROFILE_ZONE("readback record");
+            VkImageLayout layout = d_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            readbackCommands = d_readback.record(d_swapChainImages[imageIndex], layout, d_frameCount, readbackFence);
+        }
+        d_frameCount++;
+        if (d_gpuProfiler.enabled()) {
+            reportGpuTimes();
+        }
+
+        //glyphs added since the last frame, before the submission that draws them
+        if (d_glyphAtlas && !d_glyphAtlas->dirtyCells().empty()) {
+            PROFILE_ZONE("glyph upload");
+            uploadGlyphAtlas();
+        }
+
+        {
+            PROFILE_ZONE("ubo update");
+            consumeFramePacket();
+            updateUniformBuffer(imageIndex);
+            d_frameInputTimes[d_currentFrame] = std::chrono::steady_clock::now();
+        }
+        if (d_geometryDirty) {
+            PROFILE_ZONE("geometry upload");
+            recordGeometryUpload();
+        }
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
         VkSemaphore waitSemaphores[] = {d_imageAvailableSemaphores[d_currentFrame]};
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.waitSemaphoreCount = d_headless ? 0 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
 
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &d_commandBuffers[imageIndex];
+        //the frame's copies go first, in the same submission
+        VkCommandBuffer uploads = endFrameUploads();
+        VkCommandBuffer commandBuffers[] = {uploads, d_commandBuffers[imageIndex]};
+        uint32_t firstCommandBuffer = uploads != VK_NULL_HANDLE ? 0 : 1;
+        submitInfo.commandBufferCount = 2-firstCommandBuffer;
+        submitInfo.pCommandBuffers = commandBuffers+firstCommandBuffer;
 
         VkSemaphore signalSemaphores[] = {d_renderFinishedSemaphores[d_currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
+        //with readback it is the copy that has to finish before presenting
+        submitInfo.signalSemaphoreCount = d_headless || readbackCommands != VK_NULL_HANDLE ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         vkResetFences(d_device, 1, &d_inFlightFences[d_currentFrame]);
 
-        if (vkQueueSubmit(d_graphicsQueue, 1, &submitInfo, d_inFlightFences[d_currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
+        {
+            PROFILE_ZONE("submit");
+            if (vkQueueSubmit(d_graphicsQueue, 1, &submitInfo, d_inFlightFences[d_currentFrame]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit draw command buffer!");
+            }
+            d_frameLatencyPending[d_currentFrame] = true;
+            d_drawList2DBegun = false;
+        }
+
+        if (readbackCommands != VK_NULL_HANDLE) {
+            PROFILE_ZONE("readback submit");
+            VkSubmitInfo readbackInfo = {};
+            readbackInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            readbackInfo.commandBufferCount = 1;
+            readbackInfo.pCommandBuffers = &readbackCommands;
+            readbackInfo.signalSemaphoreCount = d_headless ? 0 : 1;
+            readbackInfo.pSignalSemaphores = signalSemaphores;
+            if (vkQueueSubmit(d_graphicsQueue, 1, &readbackInfo, readbackFence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit readback command buffer!");
+            }
+        }
+
+        if (d_headless) {
+            d_pacer.presented();
+            d_currentFrame = (d_currentFrame + 1) % d_inFlightFences.size();
+            if (!d_firstFramePresented) {
+                finishStartup();
+            }
+            return;
         }
 
         VkPresentInfoKHR presentInfo = {};
@@ -1423,8 +2616,13 @@ void BasicRenderer::drawFrame(){
         presentInfo.pSwapchains = d_swapChains;
 
         presentInfo.pImageIndices = &imageIndex;
+        presentInfo.pNext = d_pacer.presentChain(presentInfo.pNext);
 
-        result = vkQueuePresentKHR(d_presentQueue, &presentInfo);
+        {
+            PROFILE_ZONE("present");
+            result = vkQueuePresentKHR(d_presentQueue, &presentInfo);
+            d_pacer.presented();
+        }
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || d_framebufferResized) {
             d_framebufferResized = false;
@@ -1433,7 +2631,10 @@ void BasicRenderer::drawFrame(){
             throw std::runtime_error("failed to present swap chain image!");
         }
 
-        d_currentFrame = (d_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        d_currentFrame = (d_currentFrame + 1) % d_inFlightFences.size();
+        if (!d_firstFramePresented) {
+            finishStartup();
+        }
 }
 void BasicRenderer::mainLoop(){
 
@@ -1446,26 +2647,65 @@ void BasicRenderer::mainLoop(){
 }
 
 void BasicRenderer::cleanup(){
+        d_workers.reset();
+        d_shaderWatcher.reset();
+        if (d_pendingPipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(d_device, d_pendingPipeline, nullptr);
+            d_pendingPipeline = VK_NULL_HANDLE;
+        }
+        d_pipelines.shutdown();
+        d_readback.shutdown();
 cleanupSwapChain();
+        vkDestroyPipelineCache(d_device, d_pipelineCache, nullptr);
         vkDestroySampler(d_device,d_textureSampler,nullptr);
         vkDestroyImageView(d_device,d_textureImageView,nullptr);
         vkDestroyImage(d_device,d_textureImage,nullptr);
-        vkFreeMemory(d_device,d_textureImageMemory,nullptr);
-        vkDestroyDescriptorSetLayout(d_device, d_descriptorSetLayout, nullptr);
+        d_memory.free(d_textureImageMemory);
+        d_layoutCache.destroy();
         
         vkDestroyBuffer(d_device, d_indexBuffer, nullptr);
-        vkFreeMemory(d_device, d_indexBufferMemory, nullptr);
+        d_memory.free(d_indexBufferMemory);
 
         vkDestroyBuffer(d_device, d_vertexBuffer, nullptr);
-        vkFreeMemory(d_device, d_vertexBufferMemory, nullptr);
+        d_memory.free(d_vertexBufferMemory);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (d_glyphAtlas) {
+            vkDestroySampler(d_device, d_glyphSampler, nullptr);
+            vkDestroyImageView(d_device, d_glyphImageView, nullptr);
+            vkDestroyImage(d_device, d_glyphImage, nullptr);
+            d_memory.free(d_glyphImageMemory);
+        }
+        if (d_scene2DVertexBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(d_device, d_scene2DVertexBuffer, nullptr);
+            d_memory.free(d_scene2DVertexMemory);
+            vkDestroyBuffer(d_device, d_scene2DIndexBuffer, nullptr);
+            d_memory.free(d_scene2DIndexMemory);
+        }
+        for (auto& upload : d_frameUploads) {
+            for (const auto& buffer : upload.retired) {
+                vkDestroyBuffer(d_device, buffer.first, nullptr);
+                d_memory.free(buffer.second);
+            }
+            if (upload.staging == VK_NULL_HANDLE) continue;
+            vkUnmapMemory(d_device, upload.stagingMemory);
+            vkDestroyBuffer(d_device, upload.staging, nullptr);
+            d_memory.free(upload.stagingMemory);
+        }
+        for (size_t i = 0; i < d_arenaBuffers.size(); i++) {
+            vkUnmapMemory(d_device, d_arenaBuffersMemory[i]);
+            vkDestroyBuffer(d_device, d_arenaBuffers[i], nullptr);
+            d_memory.free(d_arenaBuffersMemory[i]);
+        }
+
+        for (size_t i = 0; i < d_inFlightFences.size(); i++) {
             vkDestroySemaphore(d_device, d_renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(d_device, d_imageAvailableSemaphores[i], nullptr);
             vkDestroyFence(d_device, d_inFlightFences[i], nullptr);
         }
 
         vkDestroyCommandPool(d_device, d_commandPool, nullptr);
+        d_gpuProfiler.destroy();
+        d_memory.reportLeaks(std::cerr);
 
         vkDestroyDevice(d_device, nullptr);
 
@@ -1476,16 +2716,18 @@ cleanupSwapChain();
         vkDestroySurfaceKHR(d_instance, d_surface, nullptr);
         vkDestroyInstance(d_instance, nullptr);
 
-        glfwDestroyWindow(d_window);
+        if (!d_headless) {
+            glfwDestroyWindow(d_window);
 
-        glfwTerminate();
+            glfwTerminate();
+        }
 }
 
 void BasicRenderer::cleanupSwapChain(){
 
         vkDestroyImageView(d_device, d_depthImageView, nullptr);
         vkDestroyImage(d_device, d_depthImage, nullptr);
-        vkFreeMemory(d_device, d_depthImageMemory, nullptr);
+        d_memory.free(d_depthImageMemory);
 
         for (auto framebuffer : d_swapChainFramebuffers) {
             vkDestroyFramebuffer(d_device, framebuffer, nullptr);
@@ -1495,19 +2737,29 @@ void BasicRenderer::cleanupSwapChain(){
 
  
         vkDestroyPipeline(d_device, d_graphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(d_device, d_pipelineLayout, nullptr);
+        for (auto pipeline : d_retiredPipelines) {
+            vkDestroyPipeline(d_device, pipeline, nullptr);
+        }
+        d_retiredPipelines.clear();
         vkDestroyRenderPass(d_device, d_renderPass, nullptr);
 
         for (auto imageView : d_swapChainImageViews) {
             vkDestroyImageView(d_device, imageView, nullptr);
         }
 
-        vkDestroySwapchainKHR(d_device, d_swapChain, nullptr);
+        if (d_headless) {
+            for (size_t i = 0; i < d_swapChainImages.size(); i++) {
+                vkDestroyImage(d_device, d_swapChainImages[i], nullptr);
+                d_memory.free(d_offscreenImagesMemory[i]);
+            }
+        } else {
+            vkDestroySwapchainKHR(d_device, d_swapChain, nullptr);
+        }
         for(size_t i=0;i<d_swapChainImages.size();i++){
           vkDestroyBuffer(d_device,d_uniformBuffers[i],nullptr);
-          vkFreeMemory(d_device,d_uniformBuffersMemory[i],nullptr);
+          d_memory.free(d_uniformBuffersMemory[i]);
         }
-        vkDestroyDescriptorPool(d_device, d_descriptorPool, nullptr);
+        d_layoutCache.freeSets(d_descriptorSets.data(), static_cast<uint32_t>(d_descriptorSets.size()));
 }
 
 
@@ -1518,11 +2770,18 @@ void BasicRenderer::updateUniformBuffer(uint32_t currentImage){
   float time = std::chrono::duration<float, std::chrono::seconds::period>(
                                                     currentTime-startTime).count();
   UniformBufferObject ubo;
-  ubo.model = glm::rotate(glm::mat4(1.0f),time*glm::radians(90.0f),
+  Camera camera;
+  if(d_camera) camera = *d_camera;
+  if(d_model){
+    ubo.model = *d_model;
+  }else if(d_camera){
+    ubo.model = glm::mat4(1.0f);
+  }else{
+    ubo.model = glm::rotate(glm::mat4(1.0f),time*glm::radians(90.0f),
                                   glm::vec3(0.0f,0.0f,1.0f));
-  ubo.view = glm::lookAt(glm::vec3(2.0f,2.0f,2.0f),glm::vec3(0.0f,0.0f,0.0f),
-        glm::vec3(0.0f,0.0f,1.0f));
-  ubo.proj = glm::perspective(glm::radians(45.0f),d_swapChainExtent.width/(float) d_swapChainExtent.height,0.1f,10.0f);
+  }
+  ubo.view = glm::lookAt(camera.eye,camera.center,camera.up);
+  ubo.proj = glm::perspective(camera.fovY,d_swapChainExtent.width/(float) d_swapChainExtent.height,0.1f,10.0f);
   
   ubo.proj[1][1] *=-1;
 
@@ -1532,40 +2791,10 @@ void BasicRenderer::updateUniformBuffer(uint32_t currentImage){
   vkUnmapMemory(d_device, d_uniformBuffersMemory[currentImage]);
 }
 
-void BasicRenderer::createDescriptorPool(){
-    std::array<VkDescriptorPoolSize,2> poolSizes = {};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(d_swapChainImages.size());
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(d_swapChainImages.size());
-    
-
-    VkDescriptorPoolCreateInfo poolInfo = {};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(d_swapChainImages.size());
-
-
-    if(vkCreateDescriptorPool(d_device, &poolInfo,nullptr, &d_descriptorPool)!=VK_SUCCESS){
-      throw std::runtime_error("failed to create descriptor pool");
-    }
-    
-
-}
 void BasicRenderer::createDescriptorSets(){
-    std::vector<VkDescriptorSetLayout> layouts(d_swapChainImages.size(), d_descriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = d_descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(d_swapChainImages.size());
-    allocInfo.pSetLayouts = layouts.data();
-
     d_descriptorSets.resize(d_swapChainImages.size());
-
-    if(vkAllocateDescriptorSets(d_device, &allocInfo, d_descriptorSets.data())!=VK_SUCCESS){
-      throw std::runtime_error("failed to allocate descriptor sets");
-    }
+    d_layoutCache.allocateSets(d_descriptorSetLayout, static_cast<uint32_t>(d_descriptorSets.size()),
+        d_descriptorSets.data());
 
     for(size_t i=0;i<d_swapChainImages.size();i++){
         VkDescriptorBufferInfo bufferInfo = {};
@@ -1578,23 +2807,26 @@ void BasicRenderer::createDescriptorSets(){
         imageInfo.imageView = d_textureImageView;
         imageInfo.sampler = d_textureSampler;
 
-        std::array<VkWriteDescriptorSet,2> writeInfos = {};
-        writeInfos[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writeInfos[0].dstSet = d_descriptorSets[i];
-        writeInfos[0].dstBinding = 0;
-        writeInfos[0].dstArrayElement = 0;
-        writeInfos[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        writeInfos[0].descriptorCount = 1;
-        writeInfos[0].pBufferInfo = &bufferInfo;
-
-        writeInfos[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writeInfos[1].dstSet = d_descriptorSets[i];
-        writeInfos[1].dstBinding = 1;
-        writeInfos[1].dstArrayElement = 0;
-        writeInfos[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        writeInfos[1].descriptorCount = 1;
-        writeInfos[1].pImageInfo = &imageInfo;
-      
+        //the renderer owns exactly one resource of each kind, bind it wherever the shaders ask for it
+        std::vector<VkWriteDescriptorSet> writeInfos;
+        for(const auto& binding : d_layoutCache.bindings(d_descriptorSetLayout)){
+          VkWriteDescriptorSet writeInfo = {};
+          writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+          writeInfo.dstSet = d_descriptorSets[i];
+          writeInfo.dstBinding = binding.binding;
+          writeInfo.dstArrayElement = 0;
+          writeInfo.descriptorType = binding.descriptorType;
+          writeInfo.descriptorCount = 1;
+          if(binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER){
+            writeInfo.pBufferInfo = &bufferInfo;
+          }else if(binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER){
+            writeInfo.pImageInfo = &imageInfo;
+          }else{
+            throw std::runtime_error("shader requests a descriptor the renderer cannot provide");
+          }
+          writeInfos.push_back(writeInfo);
+        }
+
         vkUpdateDescriptorSets(d_device, static_cast<uint32_t>(writeInfos.size()),
             writeInfos.data() , 0, nullptr);
 
@@ -1630,38 +2862,68 @@ bool BasicRenderer::checkValidationLayerSupport(){
 
 }
 void BasicRenderer::recreateSwapChain(){
+        PROFILE_ZONE("recreateSwapChain");
         int width = 0, height = 0;
-        while (width == 0 || height == 0) {
+        while (!d_headless && (width == 0 || height == 0)) {
             glfwGetFramebufferSize(d_window, &width, &height);
             glfwWaitEvents();
         }
 
         vkDeviceWaitIdle(d_device);
 
+        std::lock_guard<std::mutex> lock(d_pipelineMutex);
+        //a reload that has not been swapped in yet is rebuilt against the new render pass
+        if (d_pendingPipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(d_device, d_pendingPipeline, nullptr);
+            d_pendingPipeline = VK_NULL_HANDLE;
+            d_vertShaderCode = std::move(d_pendingVertShaderCode);
+            d_fragShaderCode = std::move(d_pendingFragShaderCode);
+        }
+        d_pipelines.retireAll(d_retiredPipelines);
+        //the queue is idle so this delivers every pending frame at the old size
+        d_readback.shutdown();
+
         cleanupSwapChain();
 
         createSwapChain();
+        //the image count can change with the surface
+        d_imagesInFlight.assign(d_swapChainImages.size(), VK_NULL_HANDLE);
         createImageViews();
         createRenderPass();
         createGraphicsPipeline();
         createDepthResources();
         createFramebuffers();
         createUniformBuffers();
-        createDescriptorPool();
         createDescriptorSets();
         createCommandBuffers();
+        createReadback();
 }
 std::vector<const char*> BasicRenderer::getRequiredExtensions(){
- uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> extensions;
+    if (!d_headless) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (d_enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     }
 
+    //optional, lets the memory tracker query VK_EXT_memory_budget on a 1.0 instance
+    uint32_t availableCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, nullptr);
+    std::vector<VkExtensionProperties> available(availableCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, available.data());
+    d_physicalDeviceProperties2 = false;
+    for (const auto& extension : available) {
+        if (strcmp(extension.extensionName, MemoryTracker::requiredInstanceExtension()) == 0) {
+            extensions.push_back(MemoryTracker::requiredInstanceExtension());
+            d_physicalDeviceProperties2 = true;
+        }
+    }
+
     return extensions; 
 
 }
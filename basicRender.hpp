@@ -1,4 +1,5 @@
 //basicRender.hpp
+#pragma once
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -12,7 +13,29 @@
 #include <optional>
 #include <vector>
 
-
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "aabb.hpp"
+#include "cpuProfiler.hpp"
+#include "framePacer.hpp"
+#include "gpuProfiler.hpp"
+#include "indexData.hpp"
+#include "memoryTracker.hpp"
+#include "pipelineLibrary.hpp"
+#include "readbackRing.hpp"
+#include "shaderReflect.hpp"
+#include "shaderWatcher.hpp"
+#include "taskGraph.hpp"
+#include "threadPool.hpp"
+#include "tripleBuffer.hpp"
+
+
+class DrawList2D;
+class Scene2D;
+class GlyphAtlas;
 
 class BasicRenderer{
   public: 
@@ -37,27 +60,39 @@ struct Vertex {
         return bindingDescription;
     }
 
-    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
-
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-        attributeDescriptions[2].binding = 0;
-        attributeDescriptions[2].location = 2;
-        attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-
-        return attributeDescriptions;
-    }
+    //attribute layout is reflected from the vertex shader, see ShaderLayout::vertexAttributes
+};
+//latency against throughput: more frames in flight and images keep the GPU busy,
+//fewer keep the frame on screen closer to the input it was rendered from
+struct SwapchainConfig{
+    //frames the CPU records ahead of the GPU, 1 to 4
+    uint32_t framesInFlight = 2;
+    //the first one the surface supports is used, FIFO is the fallback every surface
+    //has. Must not be empty
+    std::vector<VkPresentModeKHR> presentModes = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR};
+    //0 asks for one more than the surface minimum, anything else is clamped to the surface limits
+    uint32_t minImageCount = 0;
+};
+//an explicit viewpoint, replaces the default turntable animation once set
+struct Camera{
+    glm::vec3 eye = glm::vec3(2.0f,2.0f,2.0f);
+    glm::vec3 center = glm::vec3(0.0f,0.0f,0.0f);
+    glm::vec3 up = glm::vec3(0.0f,0.0f,1.0f);
+    float fovY = glm::radians(45.0f);
+};
+//geometry replacing the initial vertices and indices, same counts as those
+struct Geometry{
+    std::vector<Vertex> verticies;
+    std::vector<uint32_t> indicies;
+};
+//what the simulation hands to the renderer for one tick, never modified once
+//published; geometry is shared between packets and only uploaded when it changes
+struct FramePacket{
+    uint64_t tick = 0;
+    double time = 0.0;
+    std::optional<Camera> camera;
+    std::optional<glm::mat4> model;
+    std::shared_ptr<const Geometry> geometry;
 };
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
@@ -78,26 +113,101 @@ struct SwapChainSupportDetails {
     ~BasicRenderer(); 
     void initialize();
     void shutdown();
+    //same vertex and index counts as before, indices are stored 16 bit when the vertices allow it.
+    //Copied to the GPU ahead of the next draw()
     void update(std::vector<Vertex> verticies, std::vector<uint16_t> indicies);
+    void update(std::vector<Vertex> verticies, std::vector<uint32_t> indicies);
     void draw();//publicly exposed draw frame method
     GLFWwindow* getWindow();
     void run();
     bool d_framebufferResized = false;
+    uint32_t d_traceCount = 0;
     VkShaderModule createShaderModule(const std::vector<char>& code);
     void setTexturePath(std::string texturePath);
     void setModelPath(std::string modelPath);
+    //recompile and swap in shaders edited on disk while running, call before initialize
+    void setShaderHotReload(bool enabled);
+    //selects the shader permutation and fixed function state used to draw, permutations
+    //compile in the background and the default pipeline is shown until they are ready
+    void setPipelineState(const PipelineKey& key);
+    //print which init step ran on which thread and how long it took once the first frame is up
+    void setStartupTimeline(bool enabled);
+    //render into offscreen images instead of a window, no GLFW or presentation is
+    //involved so this runs without a display (e.g. on lavapipe). frames are only
+    //produced by calling draw(), call before initialize
+    void setHeadless(uint32_t width, uint32_t height);
+    bool isHeadless() const;
+    //headless, recreates the offscreen images at the new size right away; with a
+    //window the next frame picks up whatever size glfw reports
+    void resize(uint32_t width, uint32_t height);
+    std::string deviceName() const;
+    //copy every rendered frame back through a ring of depth host buffers, consumer
+    //runs on the readback thread. Call before initialize
+    void setReadback(uint32_t depth, ReadbackRing::Consumer consumer);
+    ReadbackRing::Stats readbackStats();
+    //used from the next draw() on
+    void setCamera(const Camera& camera);
+    //every frame takes the newest packet published to source, if there is one, before
+    //writing its uniforms. The renderer only reads, the source must outlive it
+    void setFramePacketSource(TripleBuffer<FramePacket>* source);
+    //call before initialize, throws std::invalid_argument for an out of range frame
+    //count or an empty present mode list
+    void setSwapchainConfig(const SwapchainConfig& config);
+    //what the surface actually granted, valid after initialize
+    VkPresentModeKHR presentMode() const;
+    uint32_t swapchainImageCount() const;
+    static const char* presentModeName(VkPresentModeKHR mode);
+    //milliseconds from the uniform update of a frame (where it samples camera and
+    //input) until its fence signaled, measured since the last call
+    std::vector<double> takeLatencySamples();
+    //start frames just in time for the display instead of as soon as a frame in
+    //flight frees up, call before initialize
+    void setFramePacing(const FramePacer::Settings& settings);
+    //present intervals, jitter and the pacer's frame cost prediction
+    FramePacer::Stats framePacingStats() const;
+    //timestamp the render pass and uploads, prints a rolling summary every couple
+    //of seconds. Call before initialize
+    void setGpuProfiling(bool enabled);
+    GpuProfiler& gpuProfiler();
+    //record CPU zones (only compiled in with RENDERER_PROFILING), F12 dumps a trace
+    void setCpuProfiling(bool enabled);
+    //chrome://tracing JSON of the recorded CPU zones and the GPU samples not yet dumped
+    bool dumpTrace(const std::string& filename);
+    //every device allocation of the renderer by category, leaks are reported at shutdown
+    const MemoryTracker& memoryTracker() const;
+    //room for 2D geometry, instanced quads and GPU expanded line segments per frame
+    //in flight, 0 vertices (the default) leaves the 2D layer out. Call before initialize
+    void setDrawList2DCapacity(uint32_t vertices, uint32_t indices, uint32_t quads = 0, uint32_t segments = 0);
+    //the 2D list of the next draw(), emptied and drawn on top of the scene. Waits
+    //until the GPU is done with the frame that last used this arena
+    DrawList2D& beginDrawList2D();
+    //signed distance field glyphs of a TrueType font for TextLayout, baked at
+    //sdfPixelHeight and drawn through the 2D layer's quads. Call before initialize
+    void setTextFont(const std::string& path, float sdfPixelHeight = 32.0f);
+    //throws without a font. New glyphs reach the GPU with the next draw()
+    GlyphAtlas& glyphAtlas();
+    //retained 2D shapes drawn between the scene and the 2D list, with room for this
+    //many vertices and indices to start with. Call before initialize
+    void setScene2DCapacity(uint32_t vertices, uint32_t indices);
+    //throws without a capacity. Changes reach the GPU with the next draw()
+    Scene2D& scene2D();
+    //of the mesh's vertex positions as last set, what physics bodies standing in
+    //for it are built from
+    Aabb meshBounds() const;
   private:
     std::string d_texturePath;
     std::string d_modelPath;
-    std::vector<uint32_t> d_indicies;
+    IndexData d_indicies;
     std::vector<Vertex> d_verticies; 
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData);
     bool d_enableValidationLayers;
-    GLFWwindow* d_window;
+    GLFWwindow* d_window = nullptr;
+    bool d_headless = false;
+    VkExtent2D d_headlessExtent = {0,0};
 
     VkInstance d_instance;
     VkDebugUtilsMessengerEXT d_debugMessenger;
-    VkSurfaceKHR d_surface;
+    VkSurfaceKHR d_surface = VK_NULL_HANDLE;
 
     VkPhysicalDevice d_physicalDevice = VK_NULL_HANDLE;
     VkDevice d_device;
@@ -110,12 +220,52 @@ struct SwapChainSupportDetails {
     VkFormat d_swapChainImageFormat;
     VkExtent2D d_swapChainExtent;
     std::vector<VkImageView> d_swapChainImageViews;
+    //backing memory of the images standing in for the swapchain when headless
+    std::vector<VkDeviceMemory> d_offscreenImagesMemory;
+    bool d_samplerAnisotropy = false;
     std::vector<VkFramebuffer> d_swapChainFramebuffers;
 
     VkRenderPass d_renderPass;
+    std::vector<char> d_vertShaderCode;
+    std::vector<char> d_fragShaderCode;
+    //quad.vert/quad.frag, the VertexSource::InstancedQuads permutations
+    std::vector<char> d_quadVertShaderCode;
+    std::vector<char> d_quadFragShaderCode;
+    //line.vert/line.frag, the VertexSource::LineSegments permutations. Their segments
+    //are bound as set 1, set 0 stays the scene's
+    std::vector<char> d_lineVertShaderCode;
+    std::vector<char> d_lineFragShaderCode;
+    ShaderLayout d_lineShaderLayout;
+    VkDescriptorSetLayout d_lineSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout d_linePipelineLayout = VK_NULL_HANDLE;
+    //text.frag, the VertexSource::Glyphs permutations with quad.vert. The atlas is set 1
+    std::vector<char> d_textFragShaderCode;
+    ShaderLayout d_textShaderLayout;
+    VkDescriptorSetLayout d_glyphSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout d_glyphPipelineLayout = VK_NULL_HANDLE;
+    //quad, line or text shaders changed, their library permutations have to go
+    bool d_overlayShadersReloaded = false;
+    ShaderLayout d_shaderLayout;
+    DescriptorLayoutCache d_layoutCache;
     VkDescriptorSetLayout d_descriptorSetLayout;
-    VkPipelineLayout d_pipelineLayout;
+    VkPipelineLayout d_pipelineLayout = VK_NULL_HANDLE;
     VkPipeline d_graphicsPipeline;
+    VkPipelineCache d_pipelineCache;
+    PipelineKey d_pipelineKey;
+    PipelineLibrary d_pipelines;
+    bool d_waitingForPipeline = false;
+
+    bool d_shaderHotReload = false;
+    std::unique_ptr<ShaderWatcher> d_shaderWatcher;
+    //guards the render pass and the pending pipeline, the watcher thread builds
+    //pipelines while the render thread draws
+    std::mutex d_pipelineMutex;
+    VkPipeline d_pendingPipeline = VK_NULL_HANDLE;
+    std::vector<char> d_pendingVertShaderCode;
+    std::vector<char> d_pendingFragShaderCode;
+    //replaced pipelines live until no command buffer references them anymore
+    std::vector<VkPipeline> d_retiredPipelines;
+    std::vector<bool> d_commandBufferDirty;
 
     VkCommandPool d_commandPool;
 
@@ -126,9 +276,11 @@ struct SwapChainSupportDetails {
     
     std::vector<VkBuffer> d_uniformBuffers;
     std::vector<VkDeviceMemory> d_uniformBuffersMemory;
-    VkDescriptorPool d_descriptorPool;
     std::vector<VkDescriptorSet> d_descriptorSets;
 
+    unsigned char* d_texturePixels = nullptr;
+    int d_texWidth = 0;
+    int d_texHeight = 0;
     VkImage d_textureImage;
     VkDeviceMemory d_textureImageMemory;
     VkImageView d_textureImageView;
@@ -147,6 +299,115 @@ struct SwapChainSupportDetails {
     std::vector<VkFence> d_imagesInFlight;
 
     size_t d_currentFrame = 0;
+    SwapchainConfig d_swapchainConfig;
+    VkPresentModeKHR d_presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    //per frame in flight: when its uniforms were written, and whether its fence is still awaited
+    std::vector<std::chrono::steady_clock::time_point> d_frameInputTimes;
+    std::vector<bool> d_frameLatencyPending;
+    std::deque<double> d_latencySamples;
+    void recordFrameLatency(size_t frame);
+    FramePacer::Settings d_pacing;
+    FramePacer d_pacer;
+    std::optional<Camera> d_camera;
+    std::optional<glm::mat4> d_model;
+    TripleBuffer<FramePacket>* d_packetSource = nullptr;
+    std::shared_ptr<const Geometry> d_packetGeometry;
+    void consumeFramePacket();
+
+    bool d_gpuProfiling = false;
+    GpuProfiler d_gpuProfiler;
+    std::chrono::steady_clock::time_point d_lastGpuSummary;
+    uint64_t d_frameCount = 0;
+
+    MemoryTracker d_memory;
+    //VK_KHR_get_physical_device_properties2 is enabled, a precondition of the budget extension
+    bool d_physicalDeviceProperties2 = false;
+
+    //2D layer, one persistently mapped arena per frame in flight: vertices, indices, quads
+    uint32_t d_arenaVertexCapacity = 0;
+    uint32_t d_arenaIndexCapacity = 0;
+    uint32_t d_arenaQuadCapacity = 0;
+    uint32_t d_arenaSegmentCapacity = 0;
+    VkDeviceSize d_arenaIndexOffset = 0;
+    VkDeviceSize d_arenaQuadOffset = 0;
+    //storage buffer aligned, the pixel size header of line.vert comes before the segments
+    VkDeviceSize d_arenaSegmentOffset = 0;
+    std::vector<VkDescriptorSet> d_lineDescriptorSets;
+    std::vector<VkBuffer> d_arenaBuffers;
+    std::vector<VkDeviceMemory> d_arenaBuffersMemory;
+    std::vector<void*> d_arenaMapped;
+    std::unique_ptr<DrawList2D> d_drawList2D;
+    bool d_drawList2DBegun = false;
+    //images whose command buffer draws an arena and has to be recorded again next time
+    std::vector<bool> d_imageDraws2D;
+
+    //text, cells the atlas rewrote are copied through the uploads of the next frame
+    std::string d_fontPath;
+    float d_fontPixelHeight = 32.0f;
+    std::unique_ptr<GlyphAtlas> d_glyphAtlas;
+    VkImage d_glyphImage = VK_NULL_HANDLE;
+    VkDeviceMemory d_glyphImageMemory = VK_NULL_HANDLE;
+    VkImageView d_glyphImageView = VK_NULL_HANDLE;
+    VkSampler d_glyphSampler = VK_NULL_HANDLE;
+    VkDescriptorSet d_glyphDescriptorSet = VK_NULL_HANDLE;
+
+    //per frame in flight, a command buffer submitted ahead of the frame's own that
+    //every copy of the frame is recorded into, and the staging memory they read. Both
+    //are free again once the frame's fence has been waited on
+    struct FrameUpload{
+      VkCommandBuffer commands = VK_NULL_HANDLE;
+      bool recording = false;
+      VkBuffer staging = VK_NULL_HANDLE;
+      VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+      void* stagingMapped = nullptr;
+      VkDeviceSize stagingSize = 0;
+      VkDeviceSize stagingUsed = 0;
+      //replaced while the frame was being built, destroyed after its fence
+      std::vector<std::pair<VkBuffer,VkDeviceMemory>> retired;
+    };
+    struct UploadSlice{
+      VkBuffer buffer;
+      VkDeviceSize offset;
+      char* data;
+    };
+    std::vector<FrameUpload> d_frameUploads;
+    void beginFrameUploads();
+    UploadSlice stageUpload(VkDeviceSize size);
+    VkCommandBuffer uploadCommands();
+    VkCommandBuffer endFrameUploads();
+    //the mesh changed since it was last copied to d_vertexBuffer/d_indexBuffer
+    bool d_geometryDirty = false;
+
+    //retained 2D scene in device local buffers, grown on demand. The ranges a flush
+    //wrote are copied through the frame's uploads
+    std::unique_ptr<Scene2D> d_scene2D;
+    uint32_t d_scene2DVertexCapacity = 0;
+    uint32_t d_scene2DIndexCapacity = 0;
+    VkBuffer d_scene2DVertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory d_scene2DVertexMemory = VK_NULL_HANDLE;
+    VkBuffer d_scene2DIndexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory d_scene2DIndexMemory = VK_NULL_HANDLE;
+    VkDeviceSize d_scene2DIndexBytes = 0;
+    //what the recorded command buffers draw, 16 bit indices while the vertices allow it
+    uint32_t d_scene2DIndexCount = 0;
+    VkIndexType d_scene2DIndexType = VK_INDEX_TYPE_UINT16;
+    bool d_waitingForScene2DPipeline = false;
+
+    uint32_t d_readbackDepth = 0;
+    ReadbackRing::Consumer d_readbackConsumer;
+    ReadbackRing d_readback;
+
+    //init runs as a dependency graph on these workers, whatever the first frame
+    //does not need is queued in d_deferredGraph and run once it is presented
+    std::unique_ptr<ThreadPool> d_workers;
+    TaskGraph d_initGraph;
+    TaskGraph d_deferredGraph;
+    std::chrono::steady_clock::time_point d_initStart;
+    bool d_firstFramePresented = false;
+    bool d_startupTimeline = false;
+    //the command pool and graphics queue are externally synchronized, held by a
+    //SingleTimeCommands for as long as it lives
+    std::mutex d_singleTimeCommandsMutex;
 
     
     void initVulkan();
@@ -157,13 +418,17 @@ struct SwapChainSupportDetails {
       void pickPhysicalDevice();
       void createLogicalDevice();
       void createSwapChain();
+      void createOffscreenImages();
       void createImageViews();
       void createRenderPass();
       void createDescriptorSetLayout();
+      void createPipelineCache();
       void createGraphicsPipeline();
+      void createPipelineLibrary();
       void createFramebuffers();
       void createCommandPool();
       void createDepthResources();
+      void loadTexture();
       void createTextureImage();
       void createTextureImageView();
       void createTextureSampler();
@@ -171,27 +436,48 @@ struct SwapChainSupportDetails {
       void createVertexBuffer();
       void createIndexBuffer();
       void createUniformBuffers();
-      void createDescriptorPool();
       void createDescriptorSets();
       void createCommandBuffers();
       void createSyncObjects();
+      void createReadback();
+      void createDrawList2DArenas();
+      void loadFont();
+      void createGlyphAtlas();
+      void createScene2DBuffers();
+      void startShaderWatcher();
+      void warmPipelineLibrary();
+      void finishStartup();
 
     void mainLoop();
       void drawFrame();
+      void reportGpuTimes();
 
     void cleanup();
       void cleanupSwapChain();
     
 
 
-    void updateVertexBuffer();
-    void updateIndexBuffer();
+    VkPipeline buildGraphicsPipeline(const std::vector<char>& vertShaderCode,
+        const std::vector<char>& fragShaderCode, const PipelineKey& key);
+    void recordCommandBuffer(size_t i);
+    void recordDrawList2D(VkCommandBuffer commandBuffer);
+    void uploadGlyphAtlas();
+    void recordScene2D(VkCommandBuffer commandBuffer);
+    void syncScene2D();
+    void reloadShaders(const std::string& shaderName);
+    void swapPendingPipeline();
+    void releaseRetiredPipelines();
+
+    void replaceGeometry(const std::vector<Vertex>& verticies, IndexData indicies);
+    void recordGeometryUpload();
     void updateUniformBuffer(uint32_t currentImage);
 
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+        MemoryCategory category);
     void createImage(uint32_t width, uint32_t height,VkFormat format, VkImageTiling tiling,
-        VkImageUsageFlags usage,VkMemoryPropertyFlags properties,VkImage & image, VkDeviceMemory &imageMemory);
+        VkImageUsageFlags usage,VkMemoryPropertyFlags properties,VkImage & image, VkDeviceMemory &imageMemory,
+        MemoryCategory category);
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     void recreateSwapChain();
@@ -201,8 +487,23 @@ struct SwapChainSupportDetails {
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-    VkCommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(VkCommandBuffer );
+    //a command buffer recorded and submitted while holding d_singleTimeCommandsMutex.
+    //Unwinding before submit() frees the buffer and releases the lock
+    class SingleTimeCommands{
+      public:
+        SingleTimeCommands(BasicRenderer& renderer, const char* zone = "upload");
+        ~SingleTimeCommands();
+        SingleTimeCommands(const SingleTimeCommands&) = delete;
+        SingleTimeCommands& operator=(const SingleTimeCommands&) = delete;
+        VkCommandBuffer buffer() const { return d_buffer; }
+        //submits and waits for the commands to finish
+        void submit();
+      private:
+        BasicRenderer& d_renderer;
+        std::unique_lock<std::mutex> d_lock;
+        const char* d_zone;
+        VkCommandBuffer d_buffer = VK_NULL_HANDLE;
+    };
 
 
     VkFormat findSupportedFormat(const std::vector<VkFormat> & ,VkImageTiling ,VkFormatFeatureFlags );
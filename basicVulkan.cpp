@@ -1,5 +1,12 @@
 #include "basicRender.hpp"
+#include "bodyQuads.hpp"
+#include "contactSolver.hpp"
+#include "drawList2D.hpp"
+#include "frameExport.hpp"
+#include "text.hpp"
+#include "updateLoop.hpp"
 #include<vector>
+#include<chrono>
 #include<cmath>
 #include<iostream>
 #include<string>
@@ -10,143 +17,204 @@ using std::string;
 using std::to_string;
 using glm::vec2;
 using glm::vec3;
+using glm::vec4;
 
 
-//NOTE:: all shapes are drawn counter-clockwise, so keep that in mind
-//The verticies are drawn using indexed rendering, each new primitive (triangles and squares for now) handles its own indicies
-BasicRenderer::Vertex  make_vertex(glm::vec3 point,glm::vec3 color){
-  BasicRenderer::Vertex vertex = {point,color};
-  return vertex; 
-
+int main(int argc, char** argv){
+ BasicRenderer renderer;
+//--hot-reload, --startup-timeline, --gpu-profile and --cpu-profile may go anywhere
+//and combine with any mode below, they are taken out before the modes read argv
+int kept = 1;
+for(int i=1;i<argc;i++){
+  string arg = argv[i];
+  if(arg=="--hot-reload") renderer.setShaderHotReload(true);
+  else if(arg=="--startup-timeline") renderer.setStartupTimeline(true);
+  else if(arg=="--gpu-profile") renderer.setGpuProfiling(true);
+  else if(arg=="--cpu-profile") renderer.setCpuProfiling(true);
+  else argv[kept++] = argv[i];
 }
-//uint16_t get_max_index(vector<uint16_t> indicies){
-//    uint16_t max = 0;
-//    for(size_t i=0;i<indicies.size();i++){
-//      if(indicies[i]>max) max = indicies[i];
-//    }
-//  return max;
-//}
-
-//adds a triangle to the vertex and index buffers provided
-void add_triangle(glm::vec3 x1, glm::vec3 x2, glm::vec3 x3, glm::vec3 c,vector<BasicRenderer::Vertex>& vertexBuffer,vector<uint16_t>& indicies){
-        size_t offset = vertexBuffer.size(); 
-    //first, create verticies for each point, with color c
-       vertexBuffer.push_back(make_vertex(x1,c));
-       vertexBuffer.push_back(make_vertex(x2,c)); 
-       vertexBuffer.push_back(make_vertex(x3,c)); 
-       indicies.push_back(offset);
-       indicies.push_back(offset+1);
-       indicies.push_back(offset+2);
+argc = kept;
+//--draw2d <primitives> redraws that many spinning squares, triangles and lines every
+//frame through the 2D draw list, the squares as instanced quads
+if(argc>2 && string(argv[1])=="--draw2d"){
+  uint32_t primitives = std::stoul(argv[2]);
+  renderer.setDrawList2DCapacity(primitives*4,primitives*6,primitives/3+1);
+  renderer.initialize();
+  GLFWwindow* window = renderer.getWindow();
+  uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(primitives))));
+  float cell = 2.0f/columns;
+  float time = 0.0f;
+  while(!glfwWindowShouldClose(window)){
+    glfwPollEvents();
+    DrawList2D& list = renderer.beginDrawList2D();
+    //alternating between vertices and instances would split every primitive into its own draw
+    for(uint32_t i=0;i<primitives;i++){
+      vec2 origin(-1.0f+(i%columns)*cell,-1.0f+(i/columns)*cell);
+      vec3 color(0.5f+0.5f*std::sin(time+i*0.01f),0.5f,0.5f+0.5f*std::cos(time+i*0.01f));
+      switch(i%3){
+        case 0: break;
+        case 1: list.addTriangle(origin,origin+vec2(cell*0.8f,0.0f),origin+vec2(0.4f*cell,0.8f*cell),color); break;
+        default: list.addLine(origin,origin+vec2(0.8f*cell*std::cos(time),0.8f*cell*std::sin(time)),cell*0.1f,color);
+      }
+    }
+    for(uint32_t i=0;i<primitives;i+=3){
+      vec2 center(-1.0f+(i%columns+0.4f)*cell,-1.0f+(i/columns+0.4f)*cell);
+      vec4 color(0.5f+0.5f*std::sin(time+i*0.01f),0.5f,0.5f+0.5f*std::cos(time+i*0.01f),1.0f);
+      list.addQuad(QuadInstance::make(center,vec2(cell*0.8f),color,vec4(0.0f,0.0f,1.0f,1.0f),time));
+    }
+    renderer.draw();
+    time += 0.01f;
   }
-//accepts a point in screen space,used as the bottom left of the square with origin at the center of the screen, bounds +1 to -1 
-void add_square(glm::vec3 bottom_left,float length, glm::vec3 c, vector<BasicRenderer::Vertex>& vertexBuffer, vector<uint16_t>& indicies){
-        size_t offset = vertexBuffer.size();//get the size off the vertex buffer, this gives us the correct starting index
-        //create the other three points
-      glm::vec3 bottom_right {bottom_left.x+length,bottom_left.y,bottom_left.z};
-      glm::vec3 top_right {bottom_left.x+length,bottom_left.y+length,bottom_left.z};
-      glm::vec3  top_left {bottom_left.x,bottom_left.y+length,bottom_left.z};
-      //push them to the vectors
-       vertexBuffer.push_back(make_vertex(bottom_left,c));
-       vertexBuffer.push_back(make_vertex(bottom_right,c));
-       vertexBuffer.push_back(make_vertex(top_right,c));
-       vertexBuffer.push_back(make_vertex(top_left,c));
-       // populate indicies in counter_clockwise fashion 
-       // first triangle
-       indicies.push_back(offset+0);
-       indicies.push_back(offset+1);
-       indicies.push_back(offset+2);
-        //second triangle
-       indicies.push_back(offset+2);
-       indicies.push_back(offset+3);
-       indicies.push_back(offset+0);
+  renderer.shutdown();
+  return 0;
 }
-string string_point(glm::vec2 point){
-  return "("+to_string(point.x)+","+to_string(point.y)+")";
+//--physics <bodies> drops that many boxes onto the ground of a planar world stepped
+//at its fixed rate, drawn as one instanced quad per body between the last two steps
+if(argc>2 && string(argv[1])=="--physics"){
+  uint32_t bodies = std::stoul(argv[2]);
+  //the bodies and the three sides of the bin
+  renderer.setDrawList2DCapacity(4,6,bodies+3);
+  renderer.initialize();
+  GLFWwindow* window = renderer.getWindow();
+  RigidBodyWorld::Settings settings;
+  settings.planar = true;
+  RigidBodyWorld world(settings);
+  ContactSolver solver;
+  world.setVelocitySolver([&](float dt){ solver.solve(world, dt); });
+  uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(bodies))));
+  float spacing = 1.5f;
+  //a bin: the ground and a wall either side
+  float half = 0.5f*columns*spacing+2.0f;
+  RigidBodyWorld::BodyDesc ground;
+  ground.position = vec3(0.0f,-1.0f,0.0f);
+  ground.halfExtents = vec3(half+1.0f,1.0f,1.0f);
+  ground.mass = 0.0f;
+  world.add(ground);
+  for(float side : {-1.0f,1.0f}){
+    RigidBodyWorld::BodyDesc wall = ground;
+    wall.position = vec3(side*half,columns*spacing*0.5f,0.0f);
+    wall.halfExtents = vec3(1.0f,columns*spacing*0.5f+1.0f,1.0f);
+    world.add(wall);
+  }
+  for(uint32_t i=0;i<bodies;i++){
+    RigidBodyWorld::BodyDesc body;
+    body.position = vec3(((i%columns)-0.5f*columns+0.25f*((i/columns)%2))*spacing,1.0f+(i/columns)*spacing,0.0f);
+    body.angularVelocity = vec3(0.0f,0.0f,0.5f*static_cast<float>(i%7)-1.5f);
+    world.add(body);
+  }
+  BodyQuadView view;
+  view.scale = 1.8f/(2.0f*half+2.0f);
+  view.offset = vec2(0.0f,-0.9f);
+  view.color = vec4(0.8f,0.6f,0.3f,1.0f);
+  auto last = std::chrono::steady_clock::now();
+  while(!glfwWindowShouldClose(window)){
+    glfwPollEvents();
+    auto now = std::chrono::steady_clock::now();
+    world.advance(std::chrono::duration<double>(now-last).count());
+    last = now;
+    DrawList2D& list = renderer.beginDrawList2D();
+    addBodyQuads(list,world,world.alpha(),view);
+    renderer.draw();
+  }
+  renderer.shutdown();
+  return 0;
 }
-
-glm::vec3 get_unit_norm(glm::vec2 vec){
-  float x = vec.x;
-  float y = vec.y;
-  float c, x2,y2;
-  if(x!=0){
-  c = pow((y/x),2); // c = 1-(x2/x1)^2) 
-  x2 = sqrt(c/1+c);
-  y2 = -sqrt( 1/c )*x2;
-} else{
-  c=0;
-  x2 = 1;
-  y2 = 0;
+//--text <font.ttf> draws a paragraph and a label that keeps zooming in and out,
+//both from the same 32 pixel distance fields
+if(argc>2 && string(argv[1])=="--text"){
+  renderer.setDrawList2DCapacity(4,6,4096);
+  renderer.setTextFont(argv[2]);
+  renderer.initialize();
+  GLFWwindow* window = renderer.getWindow();
+  TextLayout layout(renderer.glyphAtlas());
+  float time = 0.0f;
+  while(!glfwWindowShouldClose(window)){
+    glfwPollEvents();
+    DrawList2D& list = renderer.beginDrawList2D();
+    TextStyle style;
+    style.maxWidth = 360.0f;
+    layout.add(list,"Signed distance field text, wrapped at 360 pixels. Kerning: AVAWAY To. "
+        "Non ASCII: \xc3\xa5 \xc3\xa9 \xc3\xbc \xe2\x82\xac",vec2(-0.95f,0.95f),style);
+    style = TextStyle();
+    style.size = 12.0f+150.0f*(0.5f+0.5f*std::sin(time));
+    style.align = TextAlign::Center;
+    style.color = vec4(1.0f,0.8f,0.3f,1.0f);
+    layout.add(list,"Zoom",vec2(0.0f,0.2f),style);
+    renderer.draw();
+    time += 0.01f;
+  }
+  renderer.shutdown();
+  return 0;
 }
-  glm::vec3 out(x2,y2,0);
-  return out;
+//--export <frames> <directory> [raw|png|qoi] [--direct] [--path camera.txt] renders
+//a camera path offscreen and writes every frame to disk
+if(argc>3 && string(argv[1])=="--export"){
+  uint32_t frames = std::stoul(argv[2]);
+  ExportSettings settings;
+  settings.directory = argv[3];
+  CameraPath path = CameraPath::orbit(3.0f,1.5f);
+  for(int i=4;i<argc;i++){
+    string arg = argv[i];
+    if(arg=="raw") settings.encoding = ImageEncoding::Raw;
+    else if(arg=="png") settings.encoding = ImageEncoding::Png;
+    else if(arg=="qoi") settings.encoding = ImageEncoding::Qoi;
+    else if(arg=="--direct") settings.directIO = true;
+    else if(arg=="--path" && i+1<argc) path = CameraPath::load(argv[++i]);
+  }
+  ExportReport report = exportFrames(renderer,path,frames,settings);
+  report.print(cout);
+  return 0;
 }
-//draws a body centered rectangle from start to end
-void add_line(glm::vec3 start, glm::vec3  end,float thickness, glm::vec3 c,vector<BasicRenderer::Vertex>& vertexBuffer, vector<uint16_t>& indicies){  
-    vec3 path = end-start;
-    cout<<"path"<<string_point(path)<<endl;
-    vec3 orth = get_unit_norm(path)*(thickness/2);//get a vector orthogonal to the center line path
-    cout<<"norm"<<string_point(orth)<<endl;
-
-    vec3 p0 = start -orth;
-    vec3 p1 = start +orth;
-    vec3 p2 = end -orth;
-    vec3 p3 = end +orth;
-    size_t offset = vertexBuffer.size(); 
-    vertexBuffer.push_back(make_vertex(p0,c));
-    vertexBuffer.push_back(make_vertex(p1,c));
-    vertexBuffer.push_back(make_vertex(p2,c));
-    vertexBuffer.push_back(make_vertex(p3,c));
-    
-    //debugging prints
-    cout<<"p0"<<string_point(p0)<<endl;
-    cout<<"p1"<<string_point(p1)<<endl;
-    cout<<"p2"<<string_point(p2)<<endl;
-    cout<<"p3"<<string_point(p3)<<endl;
-
-
-
-
-    indicies.push_back(offset+0);
-    indicies.push_back(offset+1); 
-    indicies.push_back(offset+2); 
-
-    indicies.push_back(offset+2); 
-    indicies.push_back(offset+3);
-    indicies.push_back(offset+0);
+//--headless <frames> [--trace file.json] renders offscreen without a window, e.g. on lavapipe
+if(argc>2 && string(argv[1])=="--headless"){
+  int frames = std::stoi(argv[2]);
+  renderer.setShaderHotReload(false);
+  renderer.setHeadless(800,600);
+  renderer.setReadback(3,[](const ReadbackRing::Frame& frame){
+    if(frame.index%100==0) cout<<"read back frame "<<frame.index<<endl;
+  });
+  renderer.initialize();
+  for(int i=0;i<frames;i++){
+    renderer.draw();
   }
-
-
-int main(){
-  std::vector<BasicRenderer::Vertex> verticies;
-  std::vector<uint16_t> indicies;
-  glm::vec3 red(1.0,0.0,0.0);
-  glm::vec3 green(0.0,1.0,0.0);
-  glm::vec3 bottomLeft(0,0,0);
-  add_square(bottomLeft,.1,red,verticies,indicies);
-
-
-
-//BasicRenderer renderer(verticies,indicies);
- BasicRenderer renderer;
-//renderer.initialize();
-//GLFWwindow* window = renderer.getWindow();
-//size_t counter = 1;
-//float length = 1;
-//while(!glfwWindowShouldClose(window)){
-//  glfwPollEvents();
-//  if(counter%300==0){
-//    length+=1;
-//    length = length>=10? 1 : length;
-//    verticies.clear();
-//    indicies.clear();
-//    add_square(bottomLeft,length/10,green,verticies,indicies);
-//    renderer.update(verticies,indicies); 
-//  }
-//  counter++;
-//
-//
-//  renderer.draw();
-//}
+  if(argc>4 && string(argv[3])=="--trace"){
+    renderer.dumpTrace(argv[4]);
+  }
+  renderer.memoryTracker().printReport(cout);
+  renderer.shutdown();
+  ReadbackRing::Stats stats = renderer.readbackStats();
+  cout<<stats.delivered<<" frames read back, "<<stats.stalls<<" stalls ("<<stats.stallMs<<" ms)"<<endl;
+  return 0;
+}
+//--simulate <hz> orbits the camera from a fixed rate update thread while the window renders
+if(argc>2 && string(argv[1])=="--simulate"){
+  UpdateLoop simulation(std::stod(argv[2]),[](double dt, BasicRenderer::FramePacket& packet){
+    float angle = static_cast<float>(packet.time+dt)*glm::radians(45.0f);
+    BasicRenderer::Camera camera;
+    camera.eye = glm::vec3(3.0f*std::cos(angle),3.0f*std::sin(angle),1.5f);
+    packet.camera = camera;
+  });
+  renderer.setFramePacketSource(&simulation.packets());
+  simulation.start();
+  renderer.run();
+  simulation.stop();
+  UpdateLoop::Stats stats = simulation.stats();
+  cout<<stats.ticks<<" ticks, "<<stats.skipped<<" skipped, slowest "<<stats.maxStepMs<<" ms"<<endl;
+  return 0;
+}
+//--pace <targetMs> starts frames just in time for the display, 0 for the lowest latency
+if(argc>2 && string(argv[1])=="--pace"){
+  FramePacer::Settings pacing;
+  pacing.enabled = true;
+  pacing.targetLatencyMs = std::stod(argv[2]);
+  renderer.setFramePacing(pacing);
+  renderer.run();
+  FramePacer::Stats stats = renderer.framePacingStats();
+  cout<<"pacing from "<<FramePacer::sourceName(stats.source)<<": refresh "<<stats.refreshMs<<" ms, interval "
+    <<stats.intervalMeanMs<<" ms, jitter "<<stats.jitterMs<<" ms (worst "<<stats.maxDeviationMs<<" ms), "
+    <<stats.sleptMs<<" ms slept over "<<stats.presents<<" presents"<<endl;
+  return 0;
+}
 renderer.run();
 
 }
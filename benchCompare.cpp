@@ -0,0 +1,411 @@
+//benchCompare.cpp
+//performance gate for renderer_bench: runs one scene several times, compares the
+//runs against a stored baseline and fails when a gated metric got slower (or
+//bigger) by more than its threshold and the difference is significant.
+//
+//  bench_compare --bench path/to/renderer_bench --scene name --baseline file.json
+//      [--runs n] [--work dir] [--threshold x] [--threshold metric=x] [--alpha p]
+//      [--update] [-- extra renderer_bench arguments]
+//
+//every metric is reduced to one value per run; runs are summarized by their median
+//and MAD, and a one sided Mann-Whitney U test decides whether the current runs are
+//really larger than the baseline ones. A metric regresses when its median grew by
+//more than the threshold and p < alpha. --update stores the runs as the new baseline.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//ctest reports this as skipped, see SKIP_RETURN_CODE in CMakeLists.txt
+static const int EXIT_SKIPPED = 77;
+
+//just enough JSON for the files renderer_bench writes
+struct JsonValue{
+  enum class Type{Null, Number, String, Array, Object} type = Type::Null;
+  double number = 0.0;
+  std::string text;
+  std::vector<JsonValue> items;
+  std::map<std::string,JsonValue> members;
+
+  const JsonValue* find(const std::string& path) const{
+    const JsonValue* value = this;
+    std::stringstream parts(path);
+    std::string part;
+    while(std::getline(parts,part,'.')){
+      if(value->type!=Type::Object) return nullptr;
+      auto found = value->members.find(part);
+      if(found==value->members.end()) return nullptr;
+      value = &found->second;
+    }
+    return value;
+  }
+};
+
+class JsonParser{
+  public:
+    explicit JsonParser(const std::string& text) : d_text(text){}
+
+    JsonValue parse(){
+      JsonValue value = parseValue();
+      skipSpace();
+      if(d_pos!=d_text.size()) fail("trailing characters");
+      return value;
+    }
+
+  private:
+    const std::string& d_text;
+    size_t d_pos = 0;
+
+    [[noreturn]] void fail(const std::string& what){
+      throw std::runtime_error("json: "+what+" at offset "+std::to_string(d_pos));
+    }
+    void skipSpace(){
+      while(d_pos<d_text.size() && isspace(static_cast<unsigned char>(d_text[d_pos]))) d_pos++;
+    }
+    bool consume(char c){
+      skipSpace();
+      if(d_pos<d_text.size() && d_text[d_pos]==c){
+        d_pos++;
+        return true;
+      }
+      return false;
+    }
+    void expect(char c){
+      if(!consume(c)) fail(std::string("expected '")+c+"'");
+    }
+    std::string parseString(){
+      expect('"');
+      std::string out;
+      while(d_pos<d_text.size() && d_text[d_pos]!='"'){
+        if(d_text[d_pos]=='\\' && d_pos+1<d_text.size()) d_pos++;
+        out += d_text[d_pos++];
+      }
+      expect('"');
+      return out;
+    }
+    JsonValue parseValue(){
+      skipSpace();
+      if(d_pos>=d_text.size()) fail("unexpected end");
+      JsonValue value;
+      char c = d_text[d_pos];
+      if(c=='{'){
+        value.type = JsonValue::Type::Object;
+        d_pos++;
+        if(consume('}')) return value;
+        do{
+          std::string key = parseString();
+          expect(':');
+          value.members[key] = parseValue();
+        }while(consume(','));
+        expect('}');
+      }else if(c=='['){
+        value.type = JsonValue::Type::Array;
+        d_pos++;
+        if(consume(']')) return value;
+        do{
+          value.items.push_back(parseValue());
+        }while(consume(','));
+        expect(']');
+      }else if(c=='"'){
+        value.type = JsonValue::Type::String;
+        value.text = parseString();
+      }else if(d_text.compare(d_pos,4,"null")==0){
+        d_pos += 4;
+      }else{
+        char* end = nullptr;
+        value.type = JsonValue::Type::Number;
+        value.number = strtod(d_text.c_str()+d_pos,&end);
+        if(end==d_text.c_str()+d_pos) fail("unexpected character");
+        d_pos = end-d_text.c_str();
+      }
+      return value;
+    }
+};
+
+static JsonValue loadJson(const std::string& filename){
+  std::ifstream file(filename);
+  if(!file.is_open()) throw std::runtime_error("cannot open "+filename);
+  std::stringstream contents;
+  contents<<file.rdbuf();
+  std::string text = contents.str();
+  return JsonParser(text).parse();
+}
+
+struct Metric{
+  const char* name;
+  const char* path;
+  //only gated metrics can fail the comparison, the rest is context for the table
+  bool gated;
+};
+
+static const Metric METRICS[] = {
+  {"frame p95 ms", "frameMs.p95", true},
+  {"frame p50 ms", "frameMs.p50", false},
+  {"cpu p95 ms", "cpuMs.p95", false},
+  {"gpu render pass p95 ms", "gpuMs.render pass.p95", false},
+  {"startup ms", "startupMs", true},
+  {"first frame ms", "firstFrameMs", false},
+  {"present jitter ms", "pacing.jitterMs", false},
+  {"peak rss MB", "memory.rssPeakMb", true},
+  {"peak device MB", "memory.gpuPeakMb", true},
+};
+
+//the key used with --threshold metric=x
+static std::string thresholdKey(const Metric& metric){
+  std::string key = metric.path;
+  return key.substr(0,key.find('.'));
+}
+
+static double median(std::vector<double> values){
+  if(values.empty()) return 0.0;
+  std::sort(values.begin(),values.end());
+  size_t middle = values.size()/2;
+  return values.size()%2 ? values[middle] : (values[middle-1]+values[middle])/2;
+}
+
+//median absolute deviation, scaled to estimate a standard deviation
+static double mad(const std::vector<double>& values){
+  double center = median(values);
+  std::vector<double> deviations;
+  for(double value : values) deviations.push_back(std::fabs(value-center));
+  return 1.4826*median(deviations);
+}
+
+//one sided Mann-Whitney U: probability of seeing current rank this high if both
+//samples came from the same distribution. Normal approximation with tie and
+//continuity correction, which stays close to the exact test from about 4 runs each
+static double mannWhitneyGreater(const std::vector<double>& baseline, const std::vector<double>& current){
+  size_t n1 = current.size(), n2 = baseline.size();
+  if(n1==0 || n2==0) return 1.0;
+  std::vector<std::pair<double,int>> all;
+  for(double value : current) all.push_back({value,1});
+  for(double value : baseline) all.push_back({value,0});
+  std::sort(all.begin(),all.end());
+
+  double rankSum = 0.0, tieTerm = 0.0;
+  for(size_t i = 0; i<all.size();){
+    size_t j = i;
+    while(j<all.size() && all[j].first==all[i].first) j++;
+    double rank = (i+1+j)/2.0;
+    for(size_t k = i; k<j; k++){
+      if(all[k].second==1) rankSum += rank;
+    }
+    double ties = static_cast<double>(j-i);
+    tieTerm += ties*ties*ties-ties;
+    i = j;
+  }
+  double n = static_cast<double>(n1+n2);
+  double u = rankSum-n1*(n1+1)/2.0;
+  double mean = n1*n2/2.0;
+  double variance = n1*n2/12.0*((n+1)-tieTerm/(n*(n-1)));
+  if(variance<=0.0) return u>mean ? 0.0 : 1.0;
+  double z = (u-mean-0.5)/std::sqrt(variance);
+  return 0.5*std::erfc(z/std::sqrt(2.0));
+}
+
+struct Options{
+  std::string bench;
+  std::string scene;
+  std::string baseline;
+  std::string work = "bench_gate";
+  int runs = 5;
+  double threshold = 0.10;
+  std::map<std::string,double> thresholds;
+  double alpha = 0.05;
+  bool update = false;
+  std::vector<std::string> benchArguments;
+};
+
+static std::string quote(const std::string& argument){
+  std::string out = "'";
+  for(char c : argument){
+    if(c=='\'') out += "'\\''";
+    else out += c;
+  }
+  return out+"'";
+}
+
+//the scene objects of every run, empty when the bench skipped the scene
+static std::vector<JsonValue> runBench(const Options& options, std::string& device){
+  std::filesystem::create_directories(options.work);
+  std::vector<JsonValue> runs;
+  for(int run = 0; run<options.runs; run++){
+    std::string output = options.work+"/"+options.scene+"_run"+std::to_string(run)+".json";
+    std::string command = quote(options.bench)+" --scene "+quote(options.scene)+" --out "+quote(output);
+    for(const auto& argument : options.benchArguments) command += " "+quote(argument);
+    std::cout<<"run "<<run+1<<"/"<<options.runs<<": "<<command<<std::endl;
+    if(std::system(command.c_str())!=0){
+      throw std::runtime_error("benchmark run failed");
+    }
+    JsonValue result = loadJson(output);
+    if(const JsonValue* name = result.find("device")) device = name->text;
+    const JsonValue* scenes = result.find("scenes");
+    if(scenes==nullptr || scenes->items.empty()) throw std::runtime_error(output+" has no scenes");
+    const JsonValue& scene = scenes->items.front();
+    if(scene.find("skipped")!=nullptr){
+      std::cout<<"scene skipped: "<<scene.find("skipped")->text<<std::endl;
+      return {};
+    }
+    runs.push_back(scene);
+  }
+  return runs;
+}
+
+static void writeBaseline(const std::string& filename, const std::string& scene, const std::string& device,
+    const std::vector<JsonValue>& runs){
+  std::filesystem::path path(filename);
+  if(path.has_parent_path()) std::filesystem::create_directories(path.parent_path());
+  std::ofstream out(filename);
+  out<<std::setprecision(9);
+  out<<"{\n  \"scene\": \""<<scene<<"\",\n  \"device\": \""<<device<<"\",\n  \"runs\": [";
+  for(size_t run = 0; run<runs.size(); run++){
+    out<<(run==0 ? "\n" : ",\n")<<"    {";
+    bool first = true;
+    for(const Metric& metric : METRICS){
+      const JsonValue* value = runs[run].find(metric.path);
+      if(value==nullptr) continue;
+      out<<(first ? "" : ", ")<<"\""<<metric.path<<"\": "<<value->number;
+      first = false;
+    }
+    out<<"}";
+  }
+  out<<"\n  ]\n}\n";
+  if(!out.good()) throw std::runtime_error("failed to write "+filename);
+}
+
+//per metric values of every run; baseline runs store them under the flattened path
+static std::vector<double> values(const std::vector<JsonValue>& runs, const Metric& metric, bool flattened){
+  std::vector<double> out;
+  for(const JsonValue& run : runs){
+    const JsonValue* value = nullptr;
+    if(flattened){
+      auto found = run.members.find(metric.path);
+      if(found!=run.members.end()) value = &found->second;
+    }else{
+      value = run.find(metric.path);
+    }
+    if(value!=nullptr && value->type==JsonValue::Type::Number) out.push_back(value->number);
+  }
+  return out;
+}
+
+static bool parseArguments(int argc, char** argv, Options& options){
+  for(int i = 1; i<argc; i++){
+    std::string arg = argv[i];
+    bool hasValue = i+1<argc;
+    if(arg=="--"){
+      options.benchArguments.assign(argv+i+1,argv+argc);
+      break;
+    }
+    else if(arg=="--bench" && hasValue) options.bench = argv[++i];
+    else if(arg=="--scene" && hasValue) options.scene = argv[++i];
+    else if(arg=="--baseline" && hasValue) options.baseline = argv[++i];
+    else if(arg=="--work" && hasValue) options.work = argv[++i];
+    else if(arg=="--runs" && hasValue) options.runs = std::stoi(argv[++i]);
+    else if(arg=="--alpha" && hasValue) options.alpha = std::stod(argv[++i]);
+    else if(arg=="--update") options.update = true;
+    else if(arg=="--threshold" && hasValue){
+      std::string value = argv[++i];
+      size_t equals = value.find('=');
+      if(equals==std::string::npos) options.threshold = std::stod(value);
+      else options.thresholds[value.substr(0,equals)] = std::stod(value.substr(equals+1));
+    }
+    else return false;
+  }
+  return !options.bench.empty() && !options.scene.empty() && !options.baseline.empty() && options.runs>0;
+}
+
+int main(int argc, char** argv){
+  Options options;
+  if(!parseArguments(argc,argv,options)){
+    std::cerr<<"usage: bench_compare --bench renderer_bench --scene name --baseline file.json [--runs n]"
+      " [--work dir] [--threshold x|metric=x] [--alpha p] [--update] [-- bench arguments]"<<std::endl;
+    return 2;
+  }
+
+  try{
+    std::string device;
+    std::vector<JsonValue> current = runBench(options,device);
+    if(current.empty()) return EXIT_SKIPPED;
+
+    if(options.update){
+      writeBaseline(options.baseline,options.scene,device,current);
+      std::cout<<"baseline written to "<<options.baseline<<std::endl;
+      return 0;
+    }
+    if(!std::filesystem::exists(options.baseline)){
+      std::cout<<"no baseline at "<<options.baseline<<", rerun with --update to record one"<<std::endl;
+      return EXIT_SKIPPED;
+    }
+    JsonValue baseline = loadJson(options.baseline);
+    const JsonValue* baselineDevice = baseline.find("device");
+    if(baselineDevice!=nullptr && baselineDevice->text!=device){
+      std::cout<<"baseline was recorded on \""<<baselineDevice->text<<"\", this is \""<<device
+        <<"\"; not comparable"<<std::endl;
+      return EXIT_SKIPPED;
+    }
+    const JsonValue* baselineRuns = baseline.find("runs");
+    if(baselineRuns==nullptr) throw std::runtime_error(options.baseline+" has no runs");
+
+    std::cout<<std::endl<<options.scene<<": "<<baselineRuns->items.size()<<" baseline runs vs "
+      <<current.size()<<" current runs on "<<device<<std::endl;
+    std::cout<<std::left<<std::setw(24)<<"metric"<<std::right
+      <<std::setw(20)<<"baseline (MAD)"<<std::setw(20)<<"current (MAD)"
+      <<std::setw(10)<<"change"<<std::setw(9)<<"p"<<std::setw(11)<<"limit"<<"  verdict"<<std::endl;
+
+    int regressions = 0;
+    for(const Metric& metric : METRICS){
+      std::vector<double> before = values(baselineRuns->items,metric,true);
+      std::vector<double> after = values(current,metric,false);
+      if(before.empty() || after.empty()) continue;
+
+      double baseMedian = median(before), currentMedian = median(after);
+      double change = baseMedian!=0.0 ? (currentMedian-baseMedian)/baseMedian : 0.0;
+      double p = mannWhitneyGreater(before,after);
+      auto custom = options.thresholds.find(thresholdKey(metric));
+      double threshold = custom!=options.thresholds.end() ? custom->second : options.threshold;
+
+      std::string verdict = "ok";
+      if(!metric.gated){
+        verdict = "info";
+      }else if(change>threshold && p<options.alpha){
+        verdict = "REGRESSION";
+        regressions++;
+      }else if(change>threshold){
+        verdict = "not significant";
+      }else if(baseMedian!=0.0 && mad(before)/baseMedian>threshold){
+        //the baseline scatters more than the threshold, a regression that size can hide in it
+        verdict = "noisy";
+      }
+
+      std::ostringstream baseText, currentText, changeText, limitText;
+      baseText<<std::fixed<<std::setprecision(3)<<baseMedian<<" ("<<mad(before)<<")";
+      currentText<<std::fixed<<std::setprecision(3)<<currentMedian<<" ("<<mad(after)<<")";
+      changeText<<std::showpos<<std::fixed<<std::setprecision(1)<<change*100<<"%";
+      limitText<<(metric.gated ? "+"+std::to_string(static_cast<int>(std::lround(threshold*100)))+"%" : "-");
+      std::cout<<std::left<<std::setw(24)<<metric.name<<std::right
+        <<std::setw(20)<<baseText.str()<<std::setw(20)<<currentText.str()
+        <<std::setw(10)<<changeText.str()<<std::setw(9)<<std::fixed<<std::setprecision(4)<<p
+        <<std::setw(11)<<limitText.str()<<"  "<<verdict<<std::endl;
+    }
+
+    if(regressions>0){
+      std::cout<<regressions<<" metric(s) regressed"<<std::endl;
+      return 1;
+    }
+    return 0;
+  }catch(const std::exception& e){
+    std::cerr<<"bench_compare: "<<e.what()<<std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,23 @@
+//bodyQuads.cpp
+#include "bodyQuads.hpp"
+
+#include <cmath>
+
+uint32_t addBodyQuads(DrawList2D& list, const RigidBodyWorld& world, float alpha, const BodyQuadView& view){
+  uint32_t count = world.size();
+  if(count == 0) return 0;
+  QuadInstance* quads = list.reserveQuads(count);
+  if(!quads) return 0;
+  const BodyArrays& b = world.bodies();
+  float keep = 1.0f-alpha;
+  for(uint32_t i = 0; i < count; i++){
+    glm::vec2 position(b.ox[i]*keep+b.px[i]*alpha,b.oy[i]*keep+b.py[i]*alpha);
+    //the yaw of the orientation, all of it for planar worlds
+    float rotation = std::atan2(2.0f*(b.qw[i]*b.qz[i]+b.qx[i]*b.qy[i]),
+      1.0f-2.0f*(b.qy[i]*b.qy[i]+b.qz[i]*b.qz[i]));
+    quads[i] = QuadInstance::make(view.offset+position*view.scale,
+      glm::vec2(b.hx[i],b.hy[i])*(2.0f*view.scale),view.color,
+      glm::vec4(0.0f,0.0f,1.0f,1.0f),rotation,view.depth);
+  }
+  return count;
+}
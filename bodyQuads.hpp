@@ -0,0 +1,20 @@
+//bodyQuads.hpp
+#pragma once
+
+#include "drawList2D.hpp"
+#include "rigidBodyWorld.hpp"
+
+//where the xy plane of a physics world lands in the screen space of DrawList2D
+struct BodyQuadView{
+  glm::vec2 offset = glm::vec2(0.0f);
+  //screen space units per world unit
+  float scale = 1.0f;
+  glm::vec4 color = glm::vec4(1.0f);
+  float depth = 0.0f;
+};
+
+//one instanced quad per body, written from the world's arrays straight into the
+//instance arena: its box seen along z, at the position blended by alpha between
+//the last two steps and turned by its rotation about z. Returns the quads written,
+//0 when the arena cannot fit them all
+uint32_t addBodyQuads(DrawList2D& list, const RigidBodyWorld& world, float alpha, const BodyQuadView& view);
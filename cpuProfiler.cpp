@@ -0,0 +1,129 @@
+//cpuProfiler.cpp
+#include "cpuProfiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+std::atomic<bool> CpuProfiler::s_enabled{false};
+
+namespace{
+  std::string escape(const std::string& text){
+    std::string out;
+    for(char c : text){
+      if(c=='"' || c=='\\') out += '\\';
+      out += c;
+    }
+    return out;
+  }
+}
+
+//buffers outlive their threads so zones of finished workers still make it into
+//a trace, the registry itself is leaked to stay valid during static destruction
+CpuProfiler::Registry& CpuProfiler::registry(){
+  static Registry* instance = new Registry();
+  return *instance;
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::threadBuffer(){
+  thread_local ThreadBuffer* buffer = nullptr;
+  if(buffer==nullptr){
+    auto& buffers = registry();
+    std::lock_guard<std::mutex> lock(buffers.mutex);
+    buffers.buffers.emplace_back(new ThreadBuffer());
+    buffer = buffers.buffers.back().get();
+    buffer->id = static_cast<uint32_t>(buffers.buffers.size());
+    buffer->name = "thread "+std::to_string(buffer->id);
+  }
+  return *buffer;
+}
+
+void CpuProfiler::setEnabled(bool enabled){
+  s_enabled.store(enabled,std::memory_order_relaxed);
+}
+
+void CpuProfiler::setThreadName(const std::string& name){
+  ThreadBuffer& buffer = threadBuffer();
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  buffer.name = name;
+}
+
+void CpuProfiler::record(const char* name, uint64_t startNs, uint64_t endNs){
+  ThreadBuffer& buffer = threadBuffer();
+  uint64_t index = buffer.written.load(std::memory_order_relaxed);
+  Slot& slot = buffer.slots[index%Capacity];
+  slot.sequence.store(0,std::memory_order_relaxed);
+  //keeps the fields below from becoming visible before the slot reads as rewritten
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(name,std::memory_order_relaxed);
+  slot.startNs.store(startNs,std::memory_order_relaxed);
+  slot.endNs.store(endNs,std::memory_order_relaxed);
+  slot.sequence.store(index+1,std::memory_order_release);
+  buffer.written.store(index+1,std::memory_order_release);
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string& filename,
+    const std::vector<GpuProfiler::Sample>& gpuSamples){
+  struct Track{
+    uint32_t id;
+    std::string name;
+    std::vector<Event> events;
+  };
+  std::vector<Track> tracks;
+  {
+    auto& buffers = registry();
+    std::lock_guard<std::mutex> lock(buffers.mutex);
+    for(const auto& buffer : buffers.buffers){
+      uint64_t end = buffer->written.load(std::memory_order_acquire);
+      uint64_t begin = end>Capacity ? end-Capacity : 0;
+      Track track = {buffer->id,buffer->name,{}};
+      for(uint64_t i = begin; i<end; i++){
+        const Slot& slot = buffer->slots[i%Capacity];
+        //the owner may lap us while we copy, a slot it touched meanwhile is skipped
+        if(slot.sequence.load(std::memory_order_acquire)!=i+1) continue;
+        Event event = {slot.name.load(std::memory_order_relaxed),slot.startNs.load(std::memory_order_relaxed),
+          slot.endNs.load(std::memory_order_relaxed)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.sequence.load(std::memory_order_relaxed)!=i+1) continue;
+        track.events.push_back(event);
+      }
+      tracks.push_back(std::move(track));
+    }
+  }
+
+  uint64_t origin = UINT64_MAX;
+  for(const auto& track : tracks){
+    for(const auto& event : track.events) origin = std::min(origin,event.startNs);
+  }
+  for(const auto& sample : gpuSamples){
+    origin = std::min(origin,static_cast<uint64_t>(std::max(0.0,sample.startMs*1e6)));
+  }
+  if(origin==UINT64_MAX) origin = 0;
+
+  std::ofstream out(filename);
+  if(!out.is_open()) return false;
+  char number[64];
+  auto microseconds = [&](double ns){
+    snprintf(number,sizeof(number),"%.3f",ns/1000.0);
+    return std::string(number);
+  };
+
+  out<<"{\"traceEvents\":[\n";
+  out<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"gpu\"}}";
+  for(const auto& track : tracks){
+    out<<",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<track.id
+      <<",\"args\":{\"name\":\""<<escape(track.name)<<"\"}}";
+    for(const auto& event : track.events){
+      out<<",\n{\"name\":\""<<escape(event.name)<<"\",\"ph\":\"X\",\"pid\":1,\"tid\":"<<track.id
+        <<",\"ts\":"<<microseconds(static_cast<double>(event.startNs-origin))
+        <<",\"dur\":"<<microseconds(static_cast<double>(event.endNs-event.startNs))<<"}";
+    }
+  }
+  for(const auto& sample : gpuSamples){
+    out<<",\n{\"name\":\""<<escape(sample.name)<<"\",\"ph\":\"X\",\"pid\":1,\"tid\":0"
+      <<",\"ts\":"<<microseconds(sample.startMs*1e6-static_cast<double>(origin))
+      <<",\"dur\":"<<microseconds((sample.endMs-sample.startMs)*1e6)<<"}";
+  }
+  out<<"\n]}\n";
+  return out.good();
+}
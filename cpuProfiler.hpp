@@ -0,0 +1,93 @@
+//cpuProfiler.hpp
+#pragma once
+
+#include "gpuProfiler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//scoped CPU zones recorded into a ring buffer per thread. Recording takes no
+//locks: each thread only ever appends to its own buffer, writing a slot's fields
+//as relaxed atomics between clearing its sequence and publishing it with a release
+//store. writeChromeTrace() snapshots every buffer and keeps a slot only if its
+//sequence read the same before and after the copy.
+class CpuProfiler{
+  public:
+    static const size_t Capacity = 1<<16;
+
+    struct Event{
+      const char* name;
+      uint64_t startNs;
+      uint64_t endNs;
+    };
+
+    //name has to outlive the profiler, in practice a string literal
+    class Scope{
+      public:
+        explicit Scope(const char* name)
+          : d_name(name), d_startNs(s_enabled.load(std::memory_order_relaxed) ? now() : 0){}
+        ~Scope(){
+          if(d_startNs!=0) record(d_name,d_startNs,now());
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+      private:
+        const char* d_name;
+        uint64_t d_startNs;
+    };
+
+    static void setEnabled(bool enabled);
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    //shows up as the track name in the trace viewer
+    static void setThreadName(const std::string& name);
+
+    //nanoseconds on the steady clock, the same timeline GpuProfiler::calibrate maps to
+    static uint64_t now(){
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+    //chrome://tracing / Perfetto JSON of every buffered zone, plus the gpu
+    //samples on their own track. Returns false if the file could not be written
+    static bool writeChromeTrace(const std::string& filename,
+        const std::vector<GpuProfiler::Sample>& gpuSamples = {});
+
+  private:
+    struct Slot{
+      std::atomic<const char*> name{nullptr};
+      std::atomic<uint64_t> startNs{0};
+      std::atomic<uint64_t> endNs{0};
+      //1 + the index of the event held, 0 while it is being rewritten
+      std::atomic<uint64_t> sequence{0};
+    };
+
+    struct ThreadBuffer{
+      std::vector<Slot> slots = std::vector<Slot>(Capacity);
+      std::atomic<uint64_t> written{0};
+      uint32_t id = 0;
+      std::string name;
+    };
+
+    struct Registry{
+      std::mutex mutex;
+      std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    };
+
+    static std::atomic<bool> s_enabled;
+    static Registry& registry();
+    static ThreadBuffer& threadBuffer();
+};
+
+#ifdef RENDERER_PROFILING
+#define PROFILER_CONCAT_(a,b) a##b
+#define PROFILER_CONCAT(a,b) PROFILER_CONCAT_(a,b)
+#define PROFILE_ZONE(name) CpuProfiler::Scope PROFILER_CONCAT(profileZone,__LINE__)(name)
+#else
+#define PROFILE_ZONE(name) do{}while(0)
+#endif
@@ -0,0 +1,155 @@
+//drawList2D.cpp
+#include "drawList2D.hpp"
+
+#include <cmath>
+
+PipelineKey DrawList2D::defaultPipeline(){
+  PipelineKey key;
+  key.variant = ShaderVariant::VertexColor;
+  key.blend = BlendMode::Alpha;
+  key.depthTest = false;
+  key.depthWrite = false;
+  key.screenSpace = true;
+  return key;
+}
+
+void DrawList2D::reset(const Arena& arena){
+  d_arena = arena;
+  d_vertexCount = 0;
+  d_indexCount = 0;
+  d_quadCount = 0;
+  d_segmentCount = 0;
+  d_dropped = 0;
+  d_chunkBase = 0;
+  d_key = defaultPipeline();
+  d_batchOpen = false;
+  //keeps its capacity, a frame with as many pipeline switches as the last allocates nothing
+  d_batches.clear();
+}
+
+void DrawList2D::setPipeline(const PipelineKey& key){
+  if(key==d_key) return;
+  d_key = key;
+  d_batchOpen = false;
+}
+
+bool DrawList2D::reserve(uint32_t vertexCount, uint32_t indexCount, Vertex*& vertices, Index*& indices,
+    uint32_t& baseVertex){
+  if(vertexCount>d_arena.vertexCapacity-d_vertexCount || indexCount>d_arena.indexCapacity-d_indexCount
+      || vertexCount>CHUNK_VERTICES){
+    d_dropped++;
+    return false;
+  }
+  if(d_vertexCount+vertexCount-d_chunkBase>CHUNK_VERTICES){
+    //the draw of the next chunk gets its own vertex offset
+    d_chunkBase = d_vertexCount;
+    if(d_batchSource==VertexSource::Mesh) d_batchOpen = false;
+  }
+  batch(VertexSource::Mesh).indexCount += indexCount;
+  vertices = d_arena.vertices+d_vertexCount;
+  indices = d_arena.indices+d_indexCount;
+  baseVertex = d_vertexCount-d_chunkBase;
+  d_vertexCount += vertexCount;
+  d_indexCount += indexCount;
+  return true;
+}
+
+QuadInstance* DrawList2D::reserveQuads(uint32_t count){
+  return reserveInstances(count,VertexSource::InstancedQuads);
+}
+
+QuadInstance* DrawList2D::reserveGlyphs(uint32_t count){
+  return reserveInstances(count,VertexSource::Glyphs);
+}
+
+QuadInstance* DrawList2D::reserveInstances(uint32_t count, VertexSource source){
+  if(count>d_arena.quadCapacity-d_quadCount){
+    d_dropped++;
+    return nullptr;
+  }
+  batch(source).instanceCount += count;
+  QuadInstance* quads = d_arena.quads+d_quadCount;
+  d_quadCount += count;
+  return quads;
+}
+
+LineSegment* DrawList2D::reserveSegments(uint32_t count){
+  if(count>d_arena.segmentCapacity-d_segmentCount){
+    d_dropped++;
+    return nullptr;
+  }
+  batch(VertexSource::LineSegments).instanceCount += count;
+  LineSegment* segments = d_arena.segments+d_segmentCount;
+  d_segmentCount += count;
+  return segments;
+}
+
+void DrawList2D::addSegment(const LineSegment& segment){
+  LineSegment* slot = reserveSegments(1);
+  if(slot!=nullptr) *slot = segment;
+}
+
+void DrawList2D::addQuad(const QuadInstance& quad){
+  QuadInstance* slot = reserveQuads(1);
+  if(slot!=nullptr) *slot = quad;
+}
+
+DrawList2D::Batch& DrawList2D::batch(VertexSource source){
+  if(!d_batchOpen || d_batchSource!=source){
+    Batch batch;
+    batch.key = d_key;
+    batch.key.source = source;
+    batch.firstIndex = d_indexCount;
+    batch.vertexOffset = static_cast<int32_t>(d_chunkBase);
+    batch.firstInstance = source==VertexSource::LineSegments ? d_segmentCount : d_quadCount;
+    d_batches.push_back(batch);
+    d_batchOpen = true;
+    d_batchSource = source;
+  }
+  return d_batches.back();
+}
+
+//the arena is write combined memory, vertices are written whole and never read back
+void DrawList2D::addTriangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec3 color){
+  Vertex* vertices;
+  Index* indices;
+  uint32_t base;
+  if(!reserve(3,3,vertices,indices,base)) return;
+  vertices[0] = {glm::vec3(a,0.0f),color,glm::vec2(0.0f,0.0f)};
+  vertices[1] = {glm::vec3(b,0.0f),color,glm::vec2(1.0f,0.0f)};
+  vertices[2] = {glm::vec3(c,0.0f),color,glm::vec2(0.0f,1.0f)};
+  indices[0] = base;
+  indices[1] = base+1;
+  indices[2] = base+2;
+}
+
+void DrawList2D::addRect(glm::vec2 bottomLeft, glm::vec2 size, glm::vec3 color){
+  addQuad(bottomLeft,glm::vec2(bottomLeft.x+size.x,bottomLeft.y),bottomLeft+size,
+      glm::vec2(bottomLeft.x,bottomLeft.y+size.y),color);
+}
+
+void DrawList2D::addQuad(glm::vec2 p0, glm::vec2 p1, glm::vec2 p2, glm::vec2 p3, glm::vec3 color){
+  Vertex* vertices;
+  Index* indices;
+  uint32_t base;
+  if(!reserve(4,6,vertices,indices,base)) return;
+  vertices[0] = {glm::vec3(p0,0.0f),color,glm::vec2(0.0f,0.0f)};
+  vertices[1] = {glm::vec3(p1,0.0f),color,glm::vec2(1.0f,0.0f)};
+  vertices[2] = {glm::vec3(p2,0.0f),color,glm::vec2(1.0f,1.0f)};
+  vertices[3] = {glm::vec3(p3,0.0f),color,glm::vec2(0.0f,1.0f)};
+  indices[0] = base;
+  indices[1] = base+1;
+  indices[2] = base+2;
+  indices[3] = base+2;
+  indices[4] = base+3;
+  indices[5] = base;
+}
+
+void DrawList2D::addLine(glm::vec2 start, glm::vec2 end, float thickness, glm::vec3 color){
+  glm::vec2 direction = end-start;
+  float length = std::sqrt(direction.x*direction.x+direction.y*direction.y);
+  if(length==0.0f) return;
+  //left of the direction of travel, half the thickness long
+  glm::vec2 normal = glm::vec2(-direction.y,direction.x)*(0.5f*thickness/length);
+  addQuad(start-normal,end-normal,end+normal,start+normal,color);
+}
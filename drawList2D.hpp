@@ -0,0 +1,111 @@
+//drawList2D.hpp
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "basicRender.hpp"
+#include "lineSegment.hpp"
+#include "quadInstance.hpp"
+
+//immediate mode 2D geometry for one frame, written straight into the mapped arena
+//of the frame being built (see BasicRenderer::beginDrawList2D). Coordinates are
+//screen space, x right and y up from -1 to 1. Nothing is allocated per primitive,
+//once the arena is full further primitives are dropped and counted. Consecutive
+//primitives with the same pipeline end up in one draw: indexed for vertices,
+//instanced for QuadInstances and glyphs, expanded on the GPU for LineSegments.
+//Indices are 16 bit, relative to a chunk of at most CHUNK_VERTICES vertices; a
+//primitive that does not fit the current chunk starts the next one, and a draw.
+class DrawList2D{
+  public:
+    using Vertex = BasicRenderer::Vertex;
+    using Index = uint16_t;
+    static const uint32_t CHUNK_VERTICES = 65536;
+    //key.source tells which range is drawn, instances are quads, glyphs or line segments
+    struct Batch{
+      PipelineKey key;
+      uint32_t firstIndex = 0;
+      uint32_t indexCount = 0;
+      //first vertex of the chunk the indices count from
+      int32_t vertexOffset = 0;
+      uint32_t firstInstance = 0;
+      uint32_t instanceCount = 0;
+    };
+    //where one frame's primitives go, capacities in elements
+    struct Arena{
+      Vertex* vertices = nullptr;
+      uint32_t vertexCapacity = 0;
+      Index* indices = nullptr;
+      uint32_t indexCapacity = 0;
+      QuadInstance* quads = nullptr;
+      uint32_t quadCapacity = 0;
+      LineSegment* segments = nullptr;
+      uint32_t segmentCapacity = 0;
+      //one pixel of the target in screen space units, for writers that size things in pixels
+      glm::vec2 pixelSize = glm::vec2(0.0f);
+    };
+
+    //vertex colored and alpha blended, without depth
+    static PipelineKey defaultPipeline();
+
+    //an empty list writing to the given arena, called by the renderer every frame
+    void reset(const Arena& arena);
+    //primitives added from now on are drawn with key, which should be screen space;
+    //quads and segments use it with the source switched to theirs
+    void setPipeline(const PipelineKey& key);
+
+    void addTriangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec3 color);
+    //axis aligned, from bottomLeft to bottomLeft+size
+    void addRect(glm::vec2 bottomLeft, glm::vec2 size, glm::vec3 color);
+    //corners counter-clockwise from the one mapped to texture coordinate (0,0)
+    void addQuad(glm::vec2 p0, glm::vec2 p1, glm::vec2 p2, glm::vec2 p3, glm::vec3 color);
+    //a single segment, thickness wide and centered on the line
+    void addLine(glm::vec2 start, glm::vec2 end, float thickness, glm::vec3 color);
+
+    //room for writers that fill in vertices themselves; their indices are relative
+    //to baseVertex. False, and nothing reserved, when the arena cannot fit them or
+    //there are more than CHUNK_VERTICES of them
+    bool reserve(uint32_t vertexCount, uint32_t indexCount, Vertex*& vertices, Index*& indices,
+        uint32_t& baseVertex);
+
+    //rectangles and sprites through the instanced path, no vertices are generated
+    void addQuad(const QuadInstance& quad);
+    //room for count instances to fill in, null (and nothing reserved) when full
+    QuadInstance* reserveQuads(uint32_t count);
+    //quads sampling the glyph atlas through text.frag, uvRect addresses the atlas.
+    //They share the room of reserveQuads
+    QuadInstance* reserveGlyphs(uint32_t count);
+    //lines that never touch the CPU vertex path, see line.vert
+    void addSegment(const LineSegment& segment);
+    //room for count segments to fill in, null (and nothing reserved) when full
+    LineSegment* reserveSegments(uint32_t count);
+
+    uint32_t vertexCount() const { return d_vertexCount; }
+    uint32_t quadCount() const { return d_quadCount; }
+    uint32_t segmentCount() const { return d_segmentCount; }
+    uint32_t indexCount() const { return d_indexCount; }
+    glm::vec2 pixelSize() const { return d_arena.pixelSize; }
+    //primitives that did not fit since the last reset
+    uint32_t dropped() const { return d_dropped; }
+    bool empty() const { return d_indexCount==0 && d_quadCount==0 && d_segmentCount==0; }
+    const std::vector<Batch>& batches() const { return d_batches; }
+
+  private:
+    Arena d_arena;
+    uint32_t d_vertexCount = 0;
+    uint32_t d_indexCount = 0;
+    uint32_t d_quadCount = 0;
+    uint32_t d_segmentCount = 0;
+    uint32_t d_dropped = 0;
+    //vertex the indices written from now on count from
+    uint32_t d_chunkBase = 0;
+
+    PipelineKey d_key = defaultPipeline();
+    //the last batch is still drawn with d_key and this source
+    bool d_batchOpen = false;
+    VertexSource d_batchSource = VertexSource::Mesh;
+    std::vector<Batch> d_batches;
+
+    Batch& batch(VertexSource source);
+    QuadInstance* reserveInstances(uint32_t count, VertexSource source);
+};
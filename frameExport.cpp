@@ -0,0 +1,381 @@
+//frameExport.cpp
+#include "frameExport.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t nanosecondsSince(Clock::time_point start){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now()-start).count();
+}
+
+void CameraPath::add(float t, const BasicRenderer::Camera& camera){
+  auto position = std::upper_bound(d_keys.begin(),d_keys.end(),t,
+      [](float value, const std::pair<float,BasicRenderer::Camera>& key){ return value<key.first; });
+  d_keys.insert(position,{t,camera});
+}
+
+BasicRenderer::Camera CameraPath::at(float t) const{
+  if(d_keys.empty()) return BasicRenderer::Camera();
+  if(t<=d_keys.front().first) return d_keys.front().second;
+  if(t>=d_keys.back().first) return d_keys.back().second;
+
+  size_t next = 1;
+  while(d_keys[next].first<t) next++;
+  const auto& a = d_keys[next-1];
+  const auto& b = d_keys[next];
+  float f = (t-a.first)/(b.first-a.first);
+  BasicRenderer::Camera camera;
+  camera.eye = a.second.eye+(b.second.eye-a.second.eye)*f;
+  camera.center = a.second.center+(b.second.center-a.second.center)*f;
+  camera.up = a.second.up+(b.second.up-a.second.up)*f;
+  camera.fovY = a.second.fovY+(b.second.fovY-a.second.fovY)*f;
+  return camera;
+}
+
+CameraPath CameraPath::orbit(float radius, float height){
+  CameraPath path;
+  const int steps = 64;
+  for(int i = 0; i<=steps; i++){
+    float t = i/static_cast<float>(steps);
+    float angle = t*glm::radians(360.0f);
+    BasicRenderer::Camera camera;
+    camera.eye = glm::vec3(radius*std::cos(angle),radius*std::sin(angle),height);
+    path.add(t,camera);
+  }
+  return path;
+}
+
+CameraPath CameraPath::load(const std::string& filename){
+  std::ifstream file(filename);
+  if(!file.is_open()){
+    throw std::runtime_error("failed to open camera path "+filename);
+  }
+  CameraPath path;
+  std::string line;
+  int lineNumber = 0;
+  while(std::getline(file,line)){
+    lineNumber++;
+    if(line.empty() || line[0]=='#') continue;
+    std::istringstream fields(line);
+    float t;
+    BasicRenderer::Camera camera;
+    if(!(fields>>t>>camera.eye.x>>camera.eye.y>>camera.eye.z
+          >>camera.center.x>>camera.center.y>>camera.center.z)){
+      throw std::runtime_error(filename+":"+std::to_string(lineNumber)+": expected t, eye and center");
+    }
+    float fovDegrees;
+    if(fields>>fovDegrees) camera.fovY = glm::radians(fovDegrees);
+    path.add(t,camera);
+  }
+  if(path.empty()){
+    throw std::runtime_error("camera path "+filename+" has no keyframes");
+  }
+  return path;
+}
+
+void ExportReport::print(std::ostream& out) const{
+  double seconds = wallMs/1000.0;
+  out<<std::fixed<<std::setprecision(1);
+  out<<"exported "<<frames<<" frames in "<<wallMs<<" ms: "
+    <<(seconds>0 ? frames/seconds : 0.0)<<" frames/s, "
+    <<(seconds>0 ? bytesWritten/seconds/(1<<20) : 0.0)<<" MB/s written"<<std::endl;
+
+  auto row = [&](const char* stage, double ms){
+    out<<"  "<<std::left<<std::setw(18)<<stage<<std::right<<std::setw(10)<<ms<<" ms"
+      <<std::setprecision(3)<<std::setw(10)<<(frames>0 ? ms/frames : 0.0)<<" ms/frame"
+      <<std::setprecision(1)<<std::endl;
+  };
+  row("render",renderMs);
+  row("  readback stall",readbackStallMs);
+  row("budget wait",budgetWaitMs);
+  row("copy out",copyMs);
+  row("encode",encodeMs);
+  row("write",writeMs);
+}
+
+FrameExporter::FrameExporter(const ExportSettings& settings)
+  : d_settings(settings), d_pool(settings.encoderThreads){
+}
+
+FrameExporter::~FrameExporter(){
+  d_pool.wait();
+}
+
+void FrameExporter::submit(const ReadbackRing::Frame& frame){
+  size_t size = static_cast<size_t>(frame.width)*frame.height*4;
+  auto waitStart = Clock::now();
+  {
+    std::unique_lock<std::mutex> lock(d_mutex);
+    //a single frame larger than the budget still goes through on its own
+    d_released.wait(lock,[&]{ return d_budgetUsed==0 || d_budgetUsed+size<=d_settings.memoryBudget; });
+    d_budgetUsed += size;
+  }
+  d_budgetWaitNs += nanosecondsSince(waitStart);
+
+  //tightly packed RGBA, whatever the row pitch and channel order of the image
+  auto copyStart = Clock::now();
+  std::vector<uint8_t> pixels(size);
+  bool bgra = frame.format==VK_FORMAT_B8G8R8A8_UNORM || frame.format==VK_FORMAT_B8G8R8A8_SRGB;
+  for(uint32_t y = 0; y<frame.height; y++){
+    const uint8_t* src = frame.pixels+y*frame.rowPitch;
+    uint8_t* dst = pixels.data()+static_cast<size_t>(y)*frame.width*4;
+    if(!bgra){
+      memcpy(dst,src,static_cast<size_t>(frame.width)*4);
+      continue;
+    }
+    for(uint32_t x = 0; x<frame.width; x++){
+      dst[4*x+0] = src[4*x+2];
+      dst[4*x+1] = src[4*x+1];
+      dst[4*x+2] = src[4*x+0];
+      dst[4*x+3] = src[4*x+3];
+    }
+  }
+  d_copyNs += nanosecondsSince(copyStart);
+
+  uint64_t index = frame.index;
+  uint32_t width = frame.width;
+  uint32_t height = frame.height;
+  //std::function needs a copyable callable, so the buffer travels in a shared_ptr
+  auto owned = std::make_shared<std::vector<uint8_t>>(std::move(pixels));
+  d_pool.submit([this,index,owned,width,height]{
+    process(index,std::move(*owned),width,height);
+  });
+}
+
+void FrameExporter::process(uint64_t index, std::vector<uint8_t> pixels, uint32_t width, uint32_t height){
+  size_t size = pixels.size();
+  try{
+    auto encodeStart = Clock::now();
+    std::vector<uint8_t> encoded = encode(d_settings.encoding,pixels.data(),width,height);
+    d_encodeNs += nanosecondsSince(encodeStart);
+    //drop the raw pixels before writing, the budget is released once the frame is on disk
+    pixels = std::vector<uint8_t>();
+
+    std::ostringstream name;
+    name<<d_settings.directory<<"/frame_"<<std::setw(6)<<std::setfill('0')<<index
+      <<"."<<extension(d_settings.encoding);
+    auto writeStart = Clock::now();
+    writeFile(name.str(),encoded,d_settings.directIO);
+    d_writeNs += nanosecondsSince(writeStart);
+    d_bytesWritten += encoded.size();
+    d_frames++;
+  }catch(const std::exception& e){
+    std::lock_guard<std::mutex> lock(d_mutex);
+    if(d_error.empty()) d_error = e.what();
+  }
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_budgetUsed -= size;
+  }
+  d_released.notify_all();
+}
+
+void FrameExporter::finish(ExportReport& report){
+  d_pool.wait();
+  report.frames = d_frames;
+  report.bytesWritten = d_bytesWritten;
+  report.budgetWaitMs = d_budgetWaitNs/1e6;
+  report.copyMs = d_copyNs/1e6;
+  report.encodeMs = d_encodeNs/1e6;
+  report.writeMs = d_writeNs/1e6;
+  std::lock_guard<std::mutex> lock(d_mutex);
+  if(!d_error.empty()){
+    throw std::runtime_error("frame export: "+d_error);
+  }
+}
+
+const char* FrameExporter::extension(ImageEncoding encoding){
+  switch(encoding){
+    case ImageEncoding::Raw: return "rgba";
+    case ImageEncoding::Png: return "png";
+    case ImageEncoding::Qoi: return "qoi";
+  }
+  return "bin";
+}
+
+static void appendPng(void* context, void* data, int size){
+  auto out = static_cast<std::vector<uint8_t>*>(context);
+  auto bytes = static_cast<uint8_t*>(data);
+  out->insert(out->end(),bytes,bytes+size);
+}
+
+//https://qoiformat.org/qoi-specification.pdf
+static std::vector<uint8_t> encodeQoi(const uint8_t* rgba, uint32_t width, uint32_t height){
+  std::vector<uint8_t> out;
+  size_t pixelCount = static_cast<size_t>(width)*height;
+  out.reserve(14+pixelCount*2+8);
+  auto put32 = [&out](uint32_t value){
+    out.push_back(value>>24); out.push_back(value>>16); out.push_back(value>>8); out.push_back(value);
+  };
+  out.insert(out.end(),{'q','o','i','f'});
+  put32(width);
+  put32(height);
+  out.push_back(4);//channels
+  out.push_back(0);//sRGB with linear alpha
+
+  uint8_t index[64][4] = {};
+  uint8_t previous[4] = {0,0,0,255};
+  int run = 0;
+  for(size_t i = 0; i<pixelCount; i++){
+    const uint8_t* px = rgba+4*i;
+    if(memcmp(px,previous,4)==0){
+      run++;
+      if(run==62 || i+1==pixelCount){
+        out.push_back(0xc0|(run-1));
+        run = 0;
+      }
+      continue;
+    }
+    if(run>0){
+      out.push_back(0xc0|(run-1));
+      run = 0;
+    }
+
+    int slot = (px[0]*3+px[1]*5+px[2]*7+px[3]*11)%64;
+    if(memcmp(index[slot],px,4)==0){
+      out.push_back(slot);
+    }else{
+      memcpy(index[slot],px,4);
+      if(px[3]==previous[3]){
+        int8_t dr = static_cast<int8_t>(px[0]-previous[0]);
+        int8_t dg = static_cast<int8_t>(px[1]-previous[1]);
+        int8_t db = static_cast<int8_t>(px[2]-previous[2]);
+        int drg = dr-dg;
+        int dbg = db-dg;
+        if(dr>=-2 && dr<=1 && dg>=-2 && dg<=1 && db>=-2 && db<=1){
+          out.push_back(0x40|(dr+2)<<4|(dg+2)<<2|(db+2));
+        }else if(dg>=-32 && dg<=31 && drg>=-8 && drg<=7 && dbg>=-8 && dbg<=7){
+          out.push_back(0x80|(dg+32));
+          out.push_back((drg+8)<<4|(dbg+8));
+        }else{
+          out.insert(out.end(),{0xfe,px[0],px[1],px[2]});
+        }
+      }else{
+        out.insert(out.end(),{0xff,px[0],px[1],px[2],px[3]});
+      }
+    }
+    memcpy(previous,px,4);
+  }
+  out.insert(out.end(),{0,0,0,0,0,0,0,1});
+  return out;
+}
+
+std::vector<uint8_t> FrameExporter::encode(ImageEncoding encoding, const uint8_t* rgba,
+    uint32_t width, uint32_t height){
+  switch(encoding){
+    case ImageEncoding::Raw:
+      return std::vector<uint8_t>(rgba,rgba+static_cast<size_t>(width)*height*4);
+    case ImageEncoding::Png:{
+      std::vector<uint8_t> out;
+      if(!stbi_write_png_to_func(appendPng,&out,width,height,4,rgba,width*4)){
+        throw std::runtime_error("failed to encode png");
+      }
+      return out;
+    }
+    case ImageEncoding::Qoi:
+      return encodeQoi(rgba,width,height);
+  }
+  throw std::logic_error("unknown image encoding");
+}
+
+#ifdef __linux__
+//O_DIRECT wants block aligned buffers and lengths, the tail padding is cut off
+//again with ftruncate. Returns false if the file system does not support it.
+static bool writeDirect(const std::string& filename, const std::vector<uint8_t>& data){
+  const size_t alignment = 4096;
+  int fd = open(filename.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_DIRECT,0644);
+  if(fd<0) return false;
+
+  size_t padded = (data.size()+alignment-1)/alignment*alignment;
+  void* buffer = nullptr;
+  if(posix_memalign(&buffer,alignment,std::max(padded,alignment))!=0){
+    close(fd);
+    throw std::runtime_error("failed to allocate aligned write buffer");
+  }
+  memcpy(buffer,data.data(),data.size());
+  memset(static_cast<uint8_t*>(buffer)+data.size(),0,padded-data.size());
+
+  size_t written = 0;
+  while(written<padded){
+    ssize_t result = write(fd,static_cast<uint8_t*>(buffer)+written,padded-written);
+    if(result<=0) break;
+    written += result;
+  }
+  free(buffer);
+  bool ok = written==padded && ftruncate(fd,data.size())==0;
+  close(fd);
+  if(!ok) throw std::runtime_error("failed to write "+filename);
+  return true;
+}
+#endif
+
+void FrameExporter::writeFile(const std::string& filename, const std::vector<uint8_t>& data, bool direct){
+#ifdef __linux__
+  if(direct && writeDirect(filename,data)) return;
+#else
+  (void)direct;
+#endif
+  FILE* file = fopen(filename.c_str(),"wb");
+  if(!file){
+    throw std::runtime_error("failed to open "+filename+" for writing");
+  }
+  //one frame per call, a large stdio buffer turns it into a handful of syscalls
+  std::vector<char> buffer(1<<20);
+  setvbuf(file,buffer.data(),_IOFBF,buffer.size());
+  size_t written = fwrite(data.data(),1,data.size(),file);
+  bool ok = fclose(file)==0 && written==data.size();
+  if(!ok){
+    throw std::runtime_error("failed to write "+filename);
+  }
+}
+
+ExportReport exportFrames(BasicRenderer& renderer, const CameraPath& path,
+    uint32_t frameCount, const ExportSettings& settings){
+  FrameExporter exporter(settings);
+  renderer.setShaderHotReload(false);
+  renderer.setHeadless(settings.width,settings.height);
+  //the ring thread blocks in submit once the encoders fall behind, which in turn
+  //makes draw() wait for a free readback buffer
+  renderer.setReadback(settings.readbackDepth,[&exporter](const ReadbackRing::Frame& frame){
+    exporter.submit(frame);
+  });
+  renderer.initialize();
+
+  ExportReport report;
+  auto start = Clock::now();
+  uint64_t renderNs = 0;
+  for(uint32_t i = 0; i<frameCount; i++){
+    float t = frameCount>1 ? i/static_cast<float>(frameCount-1) : 0.0f;
+    renderer.setCamera(path.at(t));
+    auto frameStart = Clock::now();
+    renderer.draw();
+    renderNs += nanosecondsSince(frameStart);
+  }
+  //waits for the GPU and delivers the frames still in the ring
+  renderer.shutdown();
+  exporter.finish(report);
+
+  report.wallMs = nanosecondsSince(start)/1e6;
+  report.renderMs = renderNs/1e6;
+  report.readbackStallMs = renderer.readbackStats().stallMs;
+  return report;
+}
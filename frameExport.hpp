@@ -0,0 +1,107 @@
+//frameExport.hpp
+#pragma once
+
+#include "basicRender.hpp"
+#include "readbackRing.hpp"
+#include "threadPool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum class ImageEncoding{ Raw, Png, Qoi };
+
+//keyframed camera, positions are interpolated linearly over t in [0,1]
+class CameraPath{
+  public:
+    void add(float t, const BasicRenderer::Camera& camera);
+    BasicRenderer::Camera at(float t) const;
+    bool empty() const { return d_keys.empty(); }
+
+    //circles the origin once at the given radius and height
+    static CameraPath orbit(float radius, float height);
+    //one keyframe per line: t eyeX eyeY eyeZ centerX centerY centerZ [fovYDegrees],
+    //lines starting with # are ignored
+    static CameraPath load(const std::string& filename);
+
+  private:
+    std::vector<std::pair<float,BasicRenderer::Camera>> d_keys;
+};
+
+struct ExportSettings{
+  std::string directory = ".";
+  ImageEncoding encoding = ImageEncoding::Png;
+  uint32_t width = 1920;
+  uint32_t height = 1080;
+  uint32_t readbackDepth = 3;
+  size_t encoderThreads = std::thread::hardware_concurrency();
+  //frames copied out of the readback ring but not yet written hold at most this
+  //much memory, readback (and through it rendering) blocks beyond it
+  size_t memoryBudget = size_t(512)<<20;
+  //O_DIRECT writes that bypass the page cache, falls back to buffered writes
+  //where the file system refuses them
+  bool directIO = false;
+};
+
+//total time spent in each stage, stages on the encoder pool overlap so their
+//sum can exceed the wall time
+struct ExportReport{
+  uint64_t frames = 0;
+  double wallMs = 0.0;
+  double renderMs = 0.0;
+  double readbackStallMs = 0.0;
+  double budgetWaitMs = 0.0;
+  double copyMs = 0.0;
+  double encodeMs = 0.0;
+  double writeMs = 0.0;
+  uint64_t bytesWritten = 0;
+
+  void print(std::ostream& out) const;
+};
+
+//takes frames from the readback thread, encodes and writes them on a pool
+class FrameExporter{
+  public:
+    explicit FrameExporter(const ExportSettings& settings);
+    ~FrameExporter();
+
+    //copies the frame out so the ring buffer can be reused, blocks while the
+    //memory budget is exhausted
+    void submit(const ReadbackRing::Frame& frame);
+    //waits for every submitted frame to reach the disk, rethrows the first write error
+    void finish(ExportReport& report);
+
+    static std::vector<uint8_t> encode(ImageEncoding encoding, const uint8_t* rgba,
+        uint32_t width, uint32_t height);
+    static void writeFile(const std::string& filename, const std::vector<uint8_t>& data, bool direct);
+    static const char* extension(ImageEncoding encoding);
+
+  private:
+    ExportSettings d_settings;
+    ThreadPool d_pool;
+
+    std::mutex d_mutex;
+    std::condition_variable d_released;
+    size_t d_budgetUsed = 0;
+    std::string d_error;
+
+    std::atomic<uint64_t> d_frames{0};
+    std::atomic<uint64_t> d_bytesWritten{0};
+    //stage timings in nanoseconds, updated from several threads
+    std::atomic<uint64_t> d_budgetWaitNs{0};
+    std::atomic<uint64_t> d_copyNs{0};
+    std::atomic<uint64_t> d_encodeNs{0};
+    std::atomic<uint64_t> d_writeNs{0};
+
+    void process(uint64_t index, std::vector<uint8_t> pixels, uint32_t width, uint32_t height);
+};
+
+//renders frameCount frames along path headlessly and writes them to
+//settings.directory as frame_<n>.<ext>
+ExportReport exportFrames(BasicRenderer& renderer, const CameraPath& path,
+    uint32_t frameCount, const ExportSettings& settings);
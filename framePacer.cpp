@@ -0,0 +1,271 @@
+//framePacer.cpp
+#include "framePacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace{
+  const size_t PRESENT_HISTORY = 128;
+  const size_t COST_HISTORY = 64;
+  //until enough presents were seen
+  const double DEFAULT_REFRESH_MS = 1000.0/60.0;
+  //a present wait returning quicker than this found the present long done, its time is unknown
+  const double MIN_BLOCKING_WAIT_MS = 0.2;
+
+  FramePacer::Clock::duration toDuration(double ms){
+    return std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::duration<double,std::milli>(ms));
+  }
+
+  double toMs(FramePacer::Clock::duration duration){
+    return std::chrono::duration<double,std::milli>(duration).count();
+  }
+
+  bool hasExtension(const std::vector<VkExtensionProperties>& available, const char* name){
+    for(const auto& extension : available){
+      if(strcmp(extension.extensionName,name)==0) return true;
+    }
+    return false;
+  }
+}
+
+const char* FramePacer::sourceName(Source source){
+  switch(source){
+    case Source::DisplayTiming: return "display timing";
+    case Source::PresentWait: return "present wait";
+    default: return "model";
+  }
+}
+
+FramePacer::Support FramePacer::querySupport(VkInstance instance, VkPhysicalDevice physicalDevice,
+    bool getPhysicalDeviceProperties2){
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(physicalDevice,nullptr,&extensionCount,nullptr);
+  std::vector<VkExtensionProperties> available(extensionCount);
+  vkEnumerateDeviceExtensionProperties(physicalDevice,nullptr,&extensionCount,available.data());
+
+  Support support;
+  support.displayTiming = hasExtension(available,VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+  if(getPhysicalDeviceProperties2 && hasExtension(available,VK_KHR_PRESENT_ID_EXTENSION_NAME)
+      && hasExtension(available,VK_KHR_PRESENT_WAIT_EXTENSION_NAME)){
+    auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+        vkGetInstanceProcAddr(instance,"vkGetPhysicalDeviceFeatures2KHR"));
+    if(getFeatures2!=nullptr){
+      VkPhysicalDevicePresentIdFeaturesKHR presentId = {};
+      presentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+      VkPhysicalDevicePresentWaitFeaturesKHR presentWait = {};
+      presentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+      presentWait.pNext = &presentId;
+      VkPhysicalDeviceFeatures2 features = {};
+      features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features.pNext = &presentWait;
+      getFeatures2(physicalDevice,&features);
+      support.presentWait = presentId.presentId==VK_TRUE && presentWait.presentWait==VK_TRUE;
+    }
+  }
+  return support;
+}
+
+const void* FramePacer::enableDeviceSupport(const Support& support, std::vector<const char*>& extensions,
+    const void* next){
+  if(support.displayTiming){
+    extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+  }
+  if(!support.presentWait) return next;
+  extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+  extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+  d_presentIdFeatures = {};
+  d_presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  d_presentIdFeatures.pNext = const_cast<void*>(next);
+  d_presentIdFeatures.presentId = VK_TRUE;
+  d_presentWaitFeatures = {};
+  d_presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  d_presentWaitFeatures.pNext = &d_presentIdFeatures;
+  d_presentWaitFeatures.presentWait = VK_TRUE;
+  return &d_presentWaitFeatures;
+}
+
+void FramePacer::init(VkDevice device, const Support& support, const Settings& settings, bool display){
+  d_device = device;
+  d_settings = settings;
+  d_display = display;
+  d_source = Source::Model;
+  if(!display) return;
+  //present wait blocks until the present is on screen, the most direct of the three
+  if(support.presentWait){
+    d_waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device,"vkWaitForPresentKHR"));
+    if(d_waitForPresent!=nullptr) d_source = Source::PresentWait;
+  }
+  if(d_source==Source::Model && support.displayTiming){
+    d_getRefreshCycleDuration = reinterpret_cast<PFN_vkGetRefreshCycleDurationGOOGLE>(
+        vkGetDeviceProcAddr(device,"vkGetRefreshCycleDurationGOOGLE"));
+    d_getPastPresentationTiming = reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(
+        vkGetDeviceProcAddr(device,"vkGetPastPresentationTimingGOOGLE"));
+    if(d_getRefreshCycleDuration!=nullptr && d_getPastPresentationTiming!=nullptr) d_source = Source::DisplayTiming;
+  }
+}
+
+void FramePacer::setSwapchain(VkSwapchainKHR swapchain){
+  d_swapchain = swapchain;
+  d_swapchainFirstId = d_presentId+1;
+  d_lastWaitedId = d_presentId;
+  d_refreshMs = 0.0;
+  if(d_source==Source::DisplayTiming){
+    VkRefreshCycleDurationGOOGLE refresh = {};
+    if(d_getRefreshCycleDuration(d_device,swapchain,&refresh)==VK_SUCCESS){
+      d_refreshMs = refresh.refreshDuration/1.0e6;
+    }
+  }
+}
+
+void FramePacer::beginFrame(size_t frame){
+  if(d_frameStarts.size()<=frame) d_frameStarts.resize(frame+1);
+  if(d_source==Source::DisplayTiming) pollPresentTimes();
+
+  if(d_display && d_settings.enabled){
+    double period = refreshMs();
+    double budget = std::max(d_settings.targetLatencyMs,predictedCostMs()+d_settings.marginMs);
+
+    if(d_source==Source::PresentWait){
+      //block on the newest present that still leaves this frame inside the budget,
+      //a budget over a refresh allows that many presents to stay queued
+      uint64_t queued = budget>period ? static_cast<uint64_t>(std::ceil(budget/period))-1 : 0;
+      if(d_presentId>queued){
+        uint64_t id = d_presentId-queued;
+        if(id>=d_swapchainFirstId && id>d_lastWaitedId){
+          Clock::time_point before = Clock::now();
+          VkResult result = d_waitForPresent(d_device,d_swapchain,id,100000000);
+          Clock::time_point after = Clock::now();
+          d_lastWaitedId = id;
+          d_sleptMs += toMs(after-before);
+          if(result==VK_SUCCESS && toMs(after-before)>MIN_BLOCKING_WAIT_MS) record(id,after);
+        }
+      }
+    }
+
+    if(!d_presents.empty()){
+      //this frame is displayed no earlier than the refresh after those still queued
+      const Present& last = d_presents.back();
+      Clock::time_point deadline = last.time+toDuration(period*(d_presentId-last.id+1));
+      Clock::time_point start = deadline-toDuration(budget);
+      Clock::time_point now = Clock::now();
+      //a stale timestamp must not hold a frame back for long
+      if(start>now && start-now<toDuration(2.0*period)){
+        std::this_thread::sleep_until(start);
+        d_sleptMs += toMs(Clock::now()-now);
+      }
+    }
+  }
+  d_frameStarts[frame] = Clock::now();
+}
+
+const void* FramePacer::presentChain(const void* next){
+  d_presentId++;
+  if(d_source==Source::PresentWait){
+    d_presentIdInfo = {};
+    d_presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    d_presentIdInfo.pNext = next;
+    d_presentIdInfo.swapchainCount = 1;
+    d_presentIdInfo.pPresentIds = &d_presentId;
+    return &d_presentIdInfo;
+  }
+  if(d_source==Source::DisplayTiming){
+    d_presentTime.presentID = static_cast<uint32_t>(d_presentId);
+    d_presentTime.desiredPresentTime = 0;
+    d_presentTimesInfo = {};
+    d_presentTimesInfo.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+    d_presentTimesInfo.pNext = next;
+    d_presentTimesInfo.swapchainCount = 1;
+    d_presentTimesInfo.pTimes = &d_presentTime;
+    return &d_presentTimesInfo;
+  }
+  return next;
+}
+
+void FramePacer::presented(){
+  d_presentCount++;
+  if(!d_display){
+    //headless there is no present chain, the counter still numbers the frames
+    d_presentId++;
+  }
+  if(d_source==Source::Model) record(d_presentId,Clock::now());
+}
+
+void FramePacer::frameCompleted(size_t frame, Clock::time_point signaled){
+  if(frame>=d_frameStarts.size() || d_frameStarts[frame]==Clock::time_point()) return;
+  d_costsMs.push_back(toMs(signaled-d_frameStarts[frame]));
+  if(d_costsMs.size()>COST_HISTORY) d_costsMs.pop_front();
+}
+
+void FramePacer::record(uint64_t id, Clock::time_point time){
+  if(!d_presents.empty() && id<=d_presents.back().id) return;
+  d_presents.push_back({id,time});
+  if(d_presents.size()>PRESENT_HISTORY) d_presents.pop_front();
+}
+
+void FramePacer::pollPresentTimes(){
+  uint32_t count = 0;
+  if(d_getPastPresentationTiming(d_device,d_swapchain,&count,nullptr)!=VK_SUCCESS || count==0) return;
+  std::vector<VkPastPresentationTimingGOOGLE> timings(count);
+  if(d_getPastPresentationTiming(d_device,d_swapchain,&count,timings.data())!=VK_SUCCESS) return;
+
+  int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+  for(uint32_t i = 0; i<count; i++){
+    int64_t actual = static_cast<int64_t>(timings[i].actualPresentTime);
+    //usually CLOCK_MONOTONIC like the steady clock, anchor on the first sample otherwise
+    if(!d_timingOffsetKnown){
+      d_timingOffsetNs = std::abs(actual-now)<1000000000 ? 0 : actual-now;
+      d_timingOffsetKnown = true;
+    }
+    record(timings[i].presentID,Clock::time_point(std::chrono::nanoseconds(actual-d_timingOffsetNs)));
+  }
+}
+
+std::vector<double> FramePacer::intervalsMs() const{
+  std::vector<double> intervals;
+  for(size_t i = 1; i<d_presents.size(); i++){
+    intervals.push_back(toMs(d_presents[i].time-d_presents[i-1].time)/(d_presents[i].id-d_presents[i-1].id));
+  }
+  return intervals;
+}
+
+double FramePacer::refreshMs() const{
+  if(d_refreshMs>0.0) return d_refreshMs;
+  std::vector<double> intervals = intervalsMs();
+  if(intervals.size()<8) return DEFAULT_REFRESH_MS;
+  std::nth_element(intervals.begin(),intervals.begin()+intervals.size()/2,intervals.end());
+  return std::max(intervals[intervals.size()/2],1.0);
+}
+
+double FramePacer::predictedCostMs() const{
+  if(d_costsMs.empty()) return 0.0;
+  //a frame late once in ten tolerates the occasional slow one without paying for it every frame
+  std::vector<double> costs(d_costsMs.begin(),d_costsMs.end());
+  size_t p90 = costs.size()*9/10;
+  std::nth_element(costs.begin(),costs.begin()+p90,costs.end());
+  return costs[p90];
+}
+
+FramePacer::Stats FramePacer::stats() const{
+  Stats stats;
+  stats.source = d_source;
+  stats.refreshMs = refreshMs();
+  stats.predictedCostMs = predictedCostMs();
+  stats.sleptMs = d_sleptMs;
+  stats.presents = d_presentCount;
+
+  std::vector<double> intervals = intervalsMs();
+  if(intervals.empty()) return stats;
+  double sum = 0.0;
+  for(double interval : intervals) sum += interval;
+  stats.intervalMeanMs = sum/intervals.size();
+  double squares = 0.0;
+  for(double interval : intervals){
+    double deviation = interval-stats.intervalMeanMs;
+    squares += deviation*deviation;
+    stats.maxDeviationMs = std::max(stats.maxDeviationMs,std::abs(deviation));
+  }
+  stats.jitterMs = std::sqrt(squares/intervals.size());
+  return stats;
+}
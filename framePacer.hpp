@@ -0,0 +1,114 @@
+//framePacer.hpp
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+//delays the start of a frame until just before the GPU has to have it for the next
+//refresh, instead of starting as soon as a fence frees up. Present timestamps come
+//from VK_KHR_present_wait or VK_GOOGLE_display_timing when the device has one of
+//them, otherwise from a model fitted to when vkQueuePresentKHR returned. How long a
+//frame takes from start to fence is predicted from recent frames.
+class FramePacer{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Source{ Model, DisplayTiming, PresentWait };
+    struct Settings{
+      //without pacing frames start right away, presents are still measured
+      bool enabled = false;
+      //from frame start to display, 0 is as short as the predicted frame cost allows;
+      //a target below the frame cost is raised to it
+      double targetLatencyMs = 0.0;
+      //slack added to the predicted frame cost
+      double marginMs = 1.0;
+    };
+    //what the physical device offers, see querySupport
+    struct Support{
+      bool displayTiming = false;
+      bool presentWait = false;
+    };
+    struct Stats{
+      Source source = Source::Model;
+      double refreshMs = 0.0;
+      //present to present, per refresh when presents were skipped
+      double intervalMeanMs = 0.0;
+      //standard deviation of the intervals and the worst single one off the mean
+      double jitterMs = 0.0;
+      double maxDeviationMs = 0.0;
+      double predictedCostMs = 0.0;
+      double sleptMs = 0.0;
+      uint64_t presents = 0;
+    };
+
+    static const char* sourceName(Source source);
+    //getPhysicalDeviceProperties2 is whether the instance has VK_KHR_get_physical_device_properties2,
+    //present wait features cannot be queried without it
+    static Support querySupport(VkInstance instance, VkPhysicalDevice physicalDevice, bool getPhysicalDeviceProperties2);
+    //adds the extensions and returns the feature chain to put in front of next in
+    //VkDeviceCreateInfo::pNext, it lives as long as the pacer
+    const void* enableDeviceSupport(const Support& support, std::vector<const char*>& extensions, const void* next);
+
+    //display is false headless, frames are then measured but never delayed
+    void init(VkDevice device, const Support& support, const Settings& settings, bool display);
+    //after every swapchain (re)creation, presents to an old swapchain are no longer waited on
+    void setSwapchain(VkSwapchainKHR swapchain);
+
+    //after the frame's fence was waited on, sleeps until the paced start
+    void beginFrame(size_t frame);
+    //chains the present id or time of the next present in front of next for VkPresentInfoKHR::pNext
+    const void* presentChain(const void* next);
+    //right after vkQueuePresentKHR, or where it would be called headless
+    void presented();
+    //when the fence of a frame started by beginFrame was seen signaled
+    void frameCompleted(size_t frame, Clock::time_point signaled);
+
+    Stats stats() const;
+
+  private:
+    struct Present{
+      uint64_t id;
+      Clock::time_point time;
+    };
+
+    VkDevice d_device = VK_NULL_HANDLE;
+    VkSwapchainKHR d_swapchain = VK_NULL_HANDLE;
+    Settings d_settings;
+    Source d_source = Source::Model;
+    bool d_display = false;
+
+    PFN_vkWaitForPresentKHR d_waitForPresent = nullptr;
+    PFN_vkGetRefreshCycleDurationGOOGLE d_getRefreshCycleDuration = nullptr;
+    PFN_vkGetPastPresentationTimingGOOGLE d_getPastPresentationTiming = nullptr;
+    VkPhysicalDevicePresentIdFeaturesKHR d_presentIdFeatures = {};
+    VkPhysicalDevicePresentWaitFeaturesKHR d_presentWaitFeatures = {};
+    VkPresentIdKHR d_presentIdInfo = {};
+    VkPresentTimeGOOGLE d_presentTime = {};
+    VkPresentTimesInfoGOOGLE d_presentTimesInfo = {};
+
+    uint64_t d_presentId = 0;
+    //first id presented to the current swapchain, earlier ones are never waited on
+    uint64_t d_swapchainFirstId = 1;
+    uint64_t d_lastWaitedId = 0;
+    double d_refreshMs = 0.0;
+    //display timing clock minus the steady clock, when they are not the same
+    int64_t d_timingOffsetNs = 0;
+    bool d_timingOffsetKnown = false;
+
+    std::deque<Present> d_presents;
+    std::vector<Clock::time_point> d_frameStarts;
+    std::deque<double> d_costsMs;
+    double d_sleptMs = 0.0;
+    uint64_t d_presentCount = 0;
+
+    void record(uint64_t id, Clock::time_point time);
+    void pollPresentTimes();
+    //present to present of the recorded presents, divided by the presents in between
+    std::vector<double> intervalsMs() const;
+    double refreshMs() const;
+    double predictedCostMs() const;
+};
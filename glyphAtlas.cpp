@@ -0,0 +1,208 @@
+//glyphAtlas.cpp
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "glyphAtlas.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+//distance values of the field, the outline sits at ON_EDGE of 255
+static const unsigned char ON_EDGE = 128;
+
+void GlyphAtlas::load(const std::string& path, float pixelHeight, uint32_t atlasSize, uint32_t padding){
+  if(pixelHeight < 1.0f || padding == 0) throw std::logic_error("glyph atlas needs a pixel height and some padding");
+  std::ifstream file(path, std::ios::binary);
+  if(!file.is_open()) throw std::runtime_error("failed to open font "+path);
+  d_fontData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  int offset = stbtt_GetFontOffsetForIndex(d_fontData.data(), 0);
+  if(offset < 0 || !stbtt_InitFont(&d_font, d_fontData.data(), offset)){
+    d_fontData.clear();
+    throw std::runtime_error(path+" is not a TrueType font");
+  }
+
+  d_pixelHeight = pixelHeight;
+  d_scale = stbtt_ScaleForPixelHeight(&d_font, pixelHeight);
+  d_padding = padding;
+  float unit = d_scale/d_pixelHeight;
+  int ascent, descent, lineGap;
+  stbtt_GetFontVMetrics(&d_font, &ascent, &descent, &lineGap);
+  d_ascent = ascent*unit;
+  d_lineHeight = (ascent-descent+lineGap)*unit;
+
+  d_entries.clear();
+  d_entryIndex.clear();
+  d_latin.fill(-1);
+  d_kerning.clear();
+  //stb_truetype walks the kern or GPOS tables on every call, printable ASCII is looked up once
+  d_kerned = d_font.kern != 0 || d_font.gpos != 0;
+  d_asciiKerning.assign(d_kerned ? KERNING_TABLE*KERNING_TABLE : 0, 0.0f);
+  if(d_kerned){
+    for(uint32_t left = ' '; left < KERNING_TABLE-1; left++){
+      int leftGlyph = stbtt_FindGlyphIndex(&d_font, left);
+      for(uint32_t right = ' '; right < KERNING_TABLE-1; right++){
+        int advance = stbtt_GetGlyphKernAdvance(&d_font, leftGlyph, stbtt_FindGlyphIndex(&d_font, right));
+        d_asciiKerning[left*KERNING_TABLE+right] = advance*unit;
+      }
+    }
+  }
+
+  d_cellSize = static_cast<uint32_t>(std::ceil(pixelHeight))+2*padding;
+  if(atlasSize < d_cellSize) throw std::logic_error("glyph atlas is smaller than one glyph");
+  d_size = atlasSize;
+  d_columns = d_size/d_cellSize;
+  d_pixels.assign(static_cast<size_t>(d_size)*d_size, 0);
+  d_cells.assign(static_cast<size_t>(d_columns)*d_columns, Cell());
+  d_freeCells.clear();
+  for(size_t i = d_cells.size(); i > 0; i--) d_freeCells.push_back(static_cast<int32_t>(i-1));
+  d_newest = -1;
+  d_oldest = -1;
+  d_dirtyCells.clear();
+  d_stats = Stats();
+}
+
+void GlyphAtlas::clearDirty(){
+  for(uint32_t cell : d_dirtyCells) d_cells[cell].dirty = false;
+  d_dirtyCells.clear();
+}
+
+glm::uvec2 GlyphAtlas::cellOrigin(uint32_t cell) const{
+  return glm::uvec2(cell%d_columns*d_cellSize, cell/d_columns*d_cellSize);
+}
+
+const GlyphAtlas::Glyph& GlyphAtlas::lookup(uint32_t codepoint){
+  int32_t index;
+  auto found = d_entryIndex.find(codepoint);
+  if(found != d_entryIndex.end()){
+    index = found->second;
+  }else{
+    if(!loaded()) throw std::logic_error("glyph atlas used before a font was loaded");
+    Entry entry;
+    entry.codepoint = codepoint;
+    entry.glyphIndex = stbtt_FindGlyphIndex(&d_font, static_cast<int>(codepoint));
+    int advance, leftBearing;
+    stbtt_GetGlyphHMetrics(&d_font, entry.glyphIndex, &advance, &leftBearing);
+    entry.glyph.advance = advance*d_scale/d_pixelHeight;
+    entry.needsCell = !stbtt_IsGlyphEmpty(&d_font, entry.glyphIndex);
+    index = static_cast<int32_t>(d_entries.size());
+    d_entries.push_back(entry);
+    d_entryIndex[codepoint] = index;
+    if(codepoint < LATIN_GLYPHS) d_latin[codepoint] = index;
+  }
+
+  Entry& entry = d_entries[index];
+  if(!entry.needsCell) return entry.glyph;
+  if(entry.cell >= 0){
+    touch(entry);
+    return entry.glyph;
+  }
+  if(entry.droppedFrame != d_frame){
+    d_stats.misses++;
+    if(rasterize(entry)) return entry.glyph;
+    entry.droppedFrame = d_frame;
+  }
+  d_stats.dropped++;
+  d_droppedGlyph = entry.glyph;
+  d_droppedGlyph.visible = false;
+  return d_droppedGlyph;
+}
+
+float GlyphAtlas::kerningSlow(uint32_t left, uint32_t right){
+  uint64_t key = static_cast<uint64_t>(left)<<32 | right;
+  auto found = d_kerning.find(key);
+  if(found != d_kerning.end()) return found->second;
+  float kerning = stbtt_GetCodepointKernAdvance(&d_font, static_cast<int>(left), static_cast<int>(right))
+    *d_scale/d_pixelHeight;
+  d_kerning.emplace(key, kerning);
+  return kerning;
+}
+
+void GlyphAtlas::unlink(int32_t index){
+  Cell& cell = d_cells[index];
+  if(cell.newer >= 0) d_cells[cell.newer].older = cell.older;
+  else if(d_newest == index) d_newest = cell.older;
+  if(cell.older >= 0) d_cells[cell.older].newer = cell.newer;
+  else if(d_oldest == index) d_oldest = cell.newer;
+  cell.newer = -1;
+  cell.older = -1;
+}
+
+void GlyphAtlas::pushNewest(int32_t index){
+  Cell& cell = d_cells[index];
+  cell.older = d_newest;
+  cell.newer = -1;
+  if(d_newest >= 0) d_cells[d_newest].newer = index;
+  d_newest = index;
+  if(d_oldest < 0) d_oldest = index;
+}
+
+int32_t GlyphAtlas::acquireCell(){
+  int32_t index;
+  if(!d_freeCells.empty()){
+    index = d_freeCells.back();
+    d_freeCells.pop_back();
+  }else{
+    //ordered by frame, if the oldest was used this frame so was every other
+    index = d_oldest;
+    if(index < 0 || d_cells[index].lastUsed == d_frame) return NO_CELL;
+    d_entries[d_cells[index].entry].cell = NO_CELL;
+    unlink(index);
+    d_stats.evictions++;
+  }
+  Cell& cell = d_cells[index];
+  cell.lastUsed = d_frame;
+  pushNewest(index);
+  if(!cell.dirty){
+    cell.dirty = true;
+    d_dirtyCells.push_back(static_cast<uint32_t>(index));
+  }
+  return index;
+}
+
+bool GlyphAtlas::rasterize(Entry& entry){
+  int32_t index = acquireCell();
+  if(index == NO_CELL) return false;
+  d_cells[index].entry = static_cast<int32_t>(&entry-d_entries.data());
+  entry.cell = index;
+
+  //stb rounds the box outwards by up to a pixel on each side, glyphs that would
+  //not fit the cell are baked smaller and still drawn at their full size
+  int x0, y0, x1, y1;
+  stbtt_GetGlyphBox(&d_font, entry.glyphIndex, &x0, &y0, &x1, &y1);
+  float extent = static_cast<float>(std::max(x1-x0, y1-y0));
+  float inner = static_cast<float>(d_cellSize-2*d_padding)-2.0f;
+  float scale = extent*d_scale > inner ? inner/extent : d_scale;
+  int width = 0, height = 0, xoff = 0, yoff = 0;
+  unsigned char* sdf = stbtt_GetGlyphSDF(&d_font, scale, entry.glyphIndex, static_cast<int>(d_padding),
+      ON_EDGE, static_cast<float>(ON_EDGE)/d_padding, &width, &height, &xoff, &yoff);
+  int stride = width;
+  width = std::min(width, static_cast<int>(d_cellSize));
+  height = std::min(height, static_cast<int>(d_cellSize));
+
+  //the whole cell is rewritten, filtering must not pick up what was there before
+  glm::uvec2 origin = cellOrigin(static_cast<uint32_t>(index));
+  for(uint32_t row = 0; row < d_cellSize; row++){
+    uint8_t* destination = d_pixels.data()+static_cast<size_t>(origin.y+row)*d_size+origin.x;
+    if(sdf != nullptr && row < static_cast<uint32_t>(height)){
+      std::memcpy(destination, sdf+static_cast<size_t>(row)*stride, width);
+      std::memset(destination+width, 0, d_cellSize-width);
+    }else{
+      std::memset(destination, 0, d_cellSize);
+    }
+  }
+  if(sdf == nullptr){
+    entry.glyph.visible = false;
+    return true;
+  }
+  stbtt_FreeSDF(sdf, nullptr);
+
+  float unit = d_scale/(scale*d_pixelHeight);
+  entry.glyph.offset = glm::vec2(xoff*unit, -yoff*unit);
+  entry.glyph.size = glm::vec2(width*unit, height*unit);
+  float texel = 1.0f/d_size;
+  entry.glyph.uvRect = glm::vec4(origin.x*texel, (origin.y+height)*texel, (origin.x+width)*texel, origin.y*texel);
+  entry.glyph.visible = true;
+  return true;
+}
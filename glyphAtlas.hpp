@@ -0,0 +1,158 @@
+//glyphAtlas.hpp
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "stb/stb_truetype.h"
+
+//signed distance fields of a TrueType font's glyphs, rendered on first use into
+//fixed size cells of a single channel atlas. The distance is 0.5 on the outline
+//and falls off over padding pixels to either side, so a glyph baked once at
+//pixelHeight stays sharp drawn at any size (see shaders/text.frag). When every
+//cell is taken the least recently used one is reused, though never one used
+//during the current frame: those glyphs are dropped and counted instead.
+//
+//Metrics are in units of the text size, a glyph of a 20 pixel font is 20 times
+//them in pixels. Uploading the cells listed in dirtyCells() is up to the owner.
+class GlyphAtlas{
+  public:
+    struct Glyph{
+      //origin to origin, kerning aside
+      float advance = 0.0f;
+      //top left corner of the quad from the pen position, y up
+      glm::vec2 offset = glm::vec2(0.0f);
+      glm::vec2 size = glm::vec2(0.0f);
+      //u0 v0 u1 v1 of the quad's bottom left and top right corners, see QuadInstance
+      glm::vec4 uvRect = glm::vec4(0.0f);
+      //false for whitespace, and for glyphs there was no cell for this frame
+      bool visible = false;
+    };
+    struct Stats{
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0;
+      //glyphs not drawn because every cell was in use this frame
+      uint64_t dropped = 0;
+    };
+
+    //throws when the file cannot be read or is not a font. Cells are pixelHeight
+    //plus twice the padding on a side, atlasSize should hold a few hundred of them
+    void load(const std::string& path, float pixelHeight = 32.0f, uint32_t atlasSize = 1024,
+        uint32_t padding = 4);
+    bool loaded() const { return !d_fontData.empty(); }
+
+    //glyphs used from now on belong to a new frame and may evict any used before
+    void beginFrame(){ d_frame++; }
+    //the glyph of codepoint, rendered into a cell if it is not resident. Fonts
+    //without the codepoint give their missing glyph box. Valid until the next call
+    const Glyph& glyph(uint32_t codepoint){
+      if(codepoint < LATIN_GLYPHS && d_latin[codepoint] >= 0){
+        Entry& entry = d_entries[d_latin[codepoint]];
+        if(entry.cell >= 0 || !entry.needsCell){
+          touch(entry);
+          return entry.glyph;
+        }
+      }
+      return lookup(codepoint);
+    }
+    //added to the advance of left when right follows it
+    float kerning(uint32_t left, uint32_t right){
+      if(!d_kerned) return 0.0f;
+      if(left < KERNING_TABLE && right < KERNING_TABLE) return d_asciiKerning[left*KERNING_TABLE+right];
+      return kerningSlow(left,right);
+    }
+    //baseline to baseline, including the font's line gap
+    float lineHeight() const { return d_lineHeight; }
+    float ascent() const { return d_ascent; }
+
+    uint32_t size() const { return d_size; }
+    uint32_t cellSize() const { return d_cellSize; }
+    //size*size, row by row from the top
+    const uint8_t* pixels() const { return d_pixels.data(); }
+    //cells written since the last clearDirty, each listed once
+    const std::vector<uint32_t>& dirtyCells() const { return d_dirtyCells; }
+    void clearDirty();
+    //pixel position of the cell's top left corner
+    glm::uvec2 cellOrigin(uint32_t cell) const;
+    const Stats& stats() const { return d_stats; }
+
+  private:
+    static const uint32_t LATIN_GLYPHS = 256;
+    static const uint32_t KERNING_TABLE = 128;
+    static const int32_t NO_CELL = -1;
+
+    struct Entry{
+      uint32_t codepoint = 0;
+      int glyphIndex = 0;
+      Glyph glyph;
+      //whitespace never needs one
+      bool needsCell = true;
+      int32_t cell = NO_CELL;
+      //no cell could be found this frame, not worth trying again until the next
+      uint64_t droppedFrame = 0;
+    };
+    //cells form a list from most to least recently used, only moved on the first
+    //use in a frame so the ordering is by frame
+    struct Cell{
+      int32_t entry = -1;
+      uint64_t lastUsed = 0;
+      int32_t newer = -1;
+      int32_t older = -1;
+      bool dirty = false;
+    };
+
+    std::vector<unsigned char> d_fontData;
+    stbtt_fontinfo d_font;
+    float d_pixelHeight = 0.0f;
+    //font units to pixels at pixelHeight
+    float d_scale = 0.0f;
+    uint32_t d_padding = 0;
+    float d_lineHeight = 0.0f;
+    float d_ascent = 0.0f;
+    bool d_kerned = false;
+    std::vector<float> d_asciiKerning;
+    std::unordered_map<uint64_t,float> d_kerning;
+
+    std::vector<Entry> d_entries;
+    std::unordered_map<uint32_t,int32_t> d_entryIndex;
+    std::array<int32_t,LATIN_GLYPHS> d_latin;
+
+    uint32_t d_size = 0;
+    uint32_t d_cellSize = 0;
+    uint32_t d_columns = 0;
+    std::vector<uint8_t> d_pixels;
+    std::vector<Cell> d_cells;
+    std::vector<int32_t> d_freeCells;
+    int32_t d_newest = -1;
+    int32_t d_oldest = -1;
+    std::vector<uint32_t> d_dirtyCells;
+    uint64_t d_frame = 1;
+    Stats d_stats;
+    //what glyph() hands out for a dropped glyph, it still advances the pen
+    Glyph d_droppedGlyph;
+
+    const Glyph& lookup(uint32_t codepoint);
+    float kerningSlow(uint32_t left, uint32_t right);
+    void touch(Entry& entry){
+      if(entry.cell < 0) return;
+      Cell& cell = d_cells[entry.cell];
+      d_stats.hits++;
+      if(cell.lastUsed == d_frame) return;
+      cell.lastUsed = d_frame;
+      unlink(entry.cell);
+      pushNewest(entry.cell);
+    }
+    void unlink(int32_t cell);
+    void pushNewest(int32_t cell);
+    //a free or evicted cell, NO_CELL when all of them are in use this frame
+    int32_t acquireCell();
+    bool rasterize(Entry& entry);
+};
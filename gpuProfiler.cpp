@@ -0,0 +1,201 @@
+//gpuProfiler.cpp
+#include "gpuProfiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+
+void GpuProfiler::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
+    uint32_t slotCount, uint32_t zonesPerSlot){
+  d_device = device;
+  d_queueFamily = queueFamily;
+  d_zonesPerSlot = zonesPerSlot;
+  d_slotCount = slotCount;
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,&familyCount,nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,&familyCount,families.data());
+  uint32_t validBits = queueFamily<familyCount ? families[queueFamily].timestampValidBits : 0;
+  if(validBits==0) return;
+  d_validMask = validBits>=64 ? ~0ull : (1ull<<validBits)-1;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice,&properties);
+  d_periodNs = properties.limits.timestampPeriod;
+
+  VkQueryPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  //one extra query after the slots for calibrate()
+  poolInfo.queryCount = slotCount*zonesPerSlot*2+1;
+  if(vkCreateQueryPool(d_device,&poolInfo,nullptr,&d_pool)!=VK_SUCCESS){
+    throw std::runtime_error("failed to create timestamp query pool");
+  }
+  d_records.assign(slotCount,{});
+}
+
+void GpuProfiler::destroy(){
+  if(d_pool!=VK_NULL_HANDLE){
+    vkDestroyQueryPool(d_device,d_pool,nullptr);
+    d_pool = VK_NULL_HANDLE;
+  }
+  d_records.clear();
+}
+
+void GpuProfiler::calibrate(VkQueue queue){
+  if(!enabled()) return;
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = d_queueFamily;
+  VkCommandPool commandPool;
+  if(vkCreateCommandPool(d_device,&poolInfo,nullptr,&commandPool)!=VK_SUCCESS){
+    throw std::runtime_error("failed to create calibration command pool");
+  }
+
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  VkCommandBuffer commandBuffer;
+  vkAllocateCommandBuffers(d_device,&allocInfo,&commandBuffer);
+
+  uint32_t calibrationQuery = d_slotCount*d_zonesPerSlot*2;
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(commandBuffer,&beginInfo);
+  vkCmdResetQueryPool(commandBuffer,d_pool,calibrationQuery,1);
+  vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,d_pool,calibrationQuery);
+  vkEndCommandBuffer(commandBuffer);
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence;
+  vkCreateFence(d_device,&fenceInfo,nullptr,&fence);
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+  //the timestamp lands somewhere between submitting and the fence wait returning,
+  //the midpoint is within the submission latency of the truth
+  auto before = std::chrono::steady_clock::now();
+  vkQueueSubmit(queue,1,&submitInfo,fence);
+  vkWaitForFences(d_device,1,&fence,VK_TRUE,UINT64_MAX);
+  auto after = std::chrono::steady_clock::now();
+
+  uint64_t timestamp = 0;
+  if(vkGetQueryPoolResults(d_device,d_pool,calibrationQuery,1,sizeof(timestamp),&timestamp,
+        sizeof(timestamp),VK_QUERY_RESULT_64_BIT)==VK_SUCCESS){
+    double cpuNs = std::chrono::duration<double,std::nano>((before+(after-before)/2).time_since_epoch()).count();
+    d_clockOffsetNs = cpuNs-static_cast<double>(timestamp & d_validMask)*d_periodNs;
+  }
+
+  vkDestroyFence(d_device,fence,nullptr);
+  vkDestroyCommandPool(d_device,commandPool,nullptr);
+}
+
+void GpuProfiler::beginSlot(VkCommandBuffer commandBuffer, uint32_t slot){
+  if(!enabled() || slot>=d_records.size()) return;
+  d_records[slot].clear();
+  vkCmdResetQueryPool(commandBuffer,d_pool,query(slot,0),d_zonesPerSlot*2);
+}
+
+void GpuProfiler::begin(VkCommandBuffer commandBuffer, uint32_t slot, const std::string& name){
+  if(!enabled() || slot>=d_records.size()) return;
+  auto& records = d_records[slot];
+  if(records.size()>=d_zonesPerSlot) return;
+  uint32_t index = static_cast<uint32_t>(records.size())*2;
+  records.push_back({name,index,index+1});
+  vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,d_pool,query(slot,index));
+}
+
+void GpuProfiler::end(VkCommandBuffer commandBuffer, uint32_t slot, const std::string& name){
+  if(!enabled() || slot>=d_records.size()) return;
+  auto& records = d_records[slot];
+  //innermost open zone with that name
+  for(auto record = records.rbegin(); record!=records.rend(); ++record){
+    if(record->name==name){
+      vkCmdWriteTimestamp(commandBuffer,VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,d_pool,query(slot,record->end));
+      return;
+    }
+  }
+}
+
+void GpuProfiler::collect(uint32_t slot){
+  if(!enabled() || slot>=d_records.size() || d_records[slot].empty()) return;
+  const auto& records = d_records[slot];
+  uint32_t used = static_cast<uint32_t>(records.size())*2;
+  std::vector<uint64_t> timestamps(used);
+  //no WAIT bit, if any query was never written (a zone that was not ended) the slot is skipped
+  VkResult result = vkGetQueryPoolResults(d_device,d_pool,query(slot,0),used,
+      timestamps.size()*sizeof(uint64_t),timestamps.data(),sizeof(uint64_t),VK_QUERY_RESULT_64_BIT);
+  if(result!=VK_SUCCESS) return;
+
+  std::lock_guard<std::mutex> lock(d_mutex);
+  for(const auto& record : records){
+    uint64_t begin = timestamps[record.begin] & d_validMask;
+    uint64_t end = timestamps[record.end] & d_validMask;
+    double ms = static_cast<double>((end-begin) & d_validMask)*d_periodNs/1e6;
+
+    auto found = d_history.find(record.name);
+    if(found==d_history.end()){
+      d_order.push_back(record.name);
+      found = d_history.emplace(record.name,History()).first;
+    }
+    History& history = found->second;
+    if(history.samples.size()<Window){
+      history.samples.push_back(ms);
+    }else{
+      history.samples[history.next] = ms;
+    }
+    history.next = (history.next+1)%Window;
+    history.total++;
+    history.last = ms;
+
+    //bounded, nobody may be draining them
+    d_samples.push_back({record.name,(begin*d_periodNs+d_clockOffsetNs)/1e6,
+        (end*d_periodNs+d_clockOffsetNs)/1e6});
+    if(d_samples.size()>4096) d_samples.pop_front();
+  }
+}
+
+std::vector<GpuProfiler::Zone> GpuProfiler::zones() const{
+  std::lock_guard<std::mutex> lock(d_mutex);
+  std::vector<Zone> zones;
+  for(const auto& name : d_order){
+    const History& history = d_history.at(name);
+    Zone zone;
+    zone.name = name;
+    zone.lastMs = history.last;
+    zone.samples = history.total;
+    zone.minMs = *std::min_element(history.samples.begin(),history.samples.end());
+    zone.maxMs = *std::max_element(history.samples.begin(),history.samples.end());
+    double sum = 0.0;
+    for(double sample : history.samples) sum += sample;
+    zone.averageMs = sum/history.samples.size();
+    zones.push_back(zone);
+  }
+  return zones;
+}
+
+std::vector<GpuProfiler::Sample> GpuProfiler::takeSamples(){
+  std::lock_guard<std::mutex> lock(d_mutex);
+  std::vector<Sample> samples(d_samples.begin(),d_samples.end());
+  d_samples.clear();
+  return samples;
+}
+
+void GpuProfiler::printSummary(std::ostream& out) const{
+  out<<"gpu zone                     avg ms    min ms    max ms   samples"<<std::endl;
+  out<<std::fixed<<std::setprecision(3);
+  for(const auto& zone : zones()){
+    out<<"  "<<std::left<<std::setw(24)<<zone.name<<std::right
+      <<std::setw(10)<<zone.averageMs<<std::setw(10)<<zone.minMs<<std::setw(10)<<zone.maxMs
+      <<std::setw(10)<<zone.samples<<std::endl;
+  }
+}
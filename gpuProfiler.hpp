@@ -0,0 +1,90 @@
+//gpuProfiler.hpp
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//timestamp queries around named zones of a command buffer. Every command buffer
+//that is in flight at the same time records into its own slot; a slot is read
+//back with collect() once the fence of its last submission has been waited on,
+//so results arrive a few frames late but reading them never blocks.
+class GpuProfiler{
+  public:
+    struct Zone{
+      std::string name;
+      double lastMs = 0.0;
+      double averageMs = 0.0;
+      double minMs = 0.0;
+      double maxMs = 0.0;
+      uint64_t samples = 0;
+    };
+    //a single resolved sample, for merging into other timelines. Times are in
+    //milliseconds of the steady clock once calibrate() ran, of the device
+    //timestamp clock before that
+    struct Sample{
+      std::string name;
+      double startMs;
+      double endMs;
+    };
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
+        uint32_t slotCount, uint32_t zonesPerSlot = 16);
+    void destroy();
+    //false when the queue cannot write timestamps, every call is then a no-op
+    bool enabled() const { return d_pool!=VK_NULL_HANDLE; }
+    //estimates the offset between the device timestamp clock and the steady
+    //clock with one timestamp written on queue, blocks until it executed
+    void calibrate(VkQueue queue);
+
+    //start of recording a slot, outside any render pass
+    void beginSlot(VkCommandBuffer commandBuffer, uint32_t slot);
+    void begin(VkCommandBuffer commandBuffer, uint32_t slot, const std::string& name);
+    void end(VkCommandBuffer commandBuffer, uint32_t slot, const std::string& name);
+    //reads back the last execution of slot, the caller guarantees it finished
+    void collect(uint32_t slot);
+
+    //statistics over the last window of samples of each zone, in first seen order
+    std::vector<Zone> zones() const;
+    //samples resolved since the last call, only the most recent few thousand are kept
+    std::vector<Sample> takeSamples();
+    void printSummary(std::ostream& out) const;
+
+  private:
+    static const size_t Window = 128;
+    struct Record{
+      std::string name;
+      uint32_t begin;
+      uint32_t end;
+    };
+    struct History{
+      std::vector<double> samples;
+      size_t next = 0;
+      uint64_t total = 0;
+      double last = 0.0;
+    };
+
+    VkDevice d_device = VK_NULL_HANDLE;
+    VkQueryPool d_pool = VK_NULL_HANDLE;
+    uint32_t d_queueFamily = 0;
+    uint32_t d_zonesPerSlot = 0;
+    uint32_t d_slotCount = 0;
+    double d_periodNs = 1.0;
+    uint64_t d_validMask = ~0ull;
+    double d_clockOffsetNs = 0.0;
+
+    //per slot, the zones its current recording writes
+    std::vector<std::vector<Record>> d_records;
+    mutable std::mutex d_mutex;
+    std::vector<std::string> d_order;
+    std::map<std::string,History> d_history;
+    std::deque<Sample> d_samples;
+
+    uint32_t query(uint32_t slot, uint32_t index) const { return slot*d_zonesPerSlot*2+index; }
+};
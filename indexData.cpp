@@ -0,0 +1,40 @@
+//indexData.cpp
+#include "indexData.hpp"
+
+#include <stdexcept>
+
+void IndexData::assign(const uint16_t* indices, size_t count, size_t vertexCount){
+  pack(indices, count, vertexCount);
+}
+
+void IndexData::assign(const uint32_t* indices, size_t count, size_t vertexCount){
+  pack(indices, count, vertexCount);
+}
+
+const void* IndexData::data() const{
+  return d_type == VK_INDEX_TYPE_UINT16 ? static_cast<const void*>(d_indices16.data())
+    : static_cast<const void*>(d_indices32.data());
+}
+
+template<typename Index>
+void IndexData::pack(const Index* indices, size_t count, size_t vertexCount){
+  if(count > UINT32_MAX) throw std::length_error("more than 2^32 indices");
+  //narrows or widens and checks the range in one pass
+  uint32_t largest = 0;
+  d_type = typeFor(vertexCount);
+  if(d_type == VK_INDEX_TYPE_UINT16){
+    d_indices32.clear();
+    d_indices16.resize(count);
+    for(size_t i = 0; i < count; i++){
+      uint32_t index = indices[i];
+      largest = index > largest ? index : largest;
+      d_indices16[i] = static_cast<uint16_t>(index);
+    }
+  }else{
+    d_indices16.clear();
+    d_indices32.assign(indices, indices+count);
+    for(size_t i = 0; i < count; i++) largest = d_indices32[i] > largest ? d_indices32[i] : largest;
+  }
+  d_count = static_cast<uint32_t>(count);
+  if(count > 0 && largest >= vertexCount) throw std::out_of_range("index past the last vertex");
+}
@@ -0,0 +1,49 @@
+//indexData.hpp
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+//indices of one mesh in the narrowest type that addresses all of its vertices:
+//16 bit up to 65536 vertices, 32 bit beyond. Whatever type they come in, the
+//stored copy is what gets uploaded and type() is what the draw binds
+class IndexData{
+  public:
+    IndexData() = default;
+    template<typename Index>
+    IndexData(const std::vector<Index>& indices, size_t vertexCount){ assign(indices, vertexCount); }
+
+    //throws when an index does not address one of the vertexCount vertices
+    void assign(const uint16_t* indices, size_t count, size_t vertexCount);
+    void assign(const uint32_t* indices, size_t count, size_t vertexCount);
+    template<typename Index>
+    void assign(const std::vector<Index>& indices, size_t vertexCount){
+      assign(indices.data(), indices.size(), vertexCount);
+    }
+
+    static VkIndexType typeFor(size_t vertexCount){
+      return vertexCount <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
+    static VkDeviceSize indexSize(VkIndexType type){ return type == VK_INDEX_TYPE_UINT16 ? 2 : 4; }
+
+    VkIndexType type() const { return d_type; }
+    uint32_t count() const { return d_count; }
+    bool empty() const { return d_count == 0; }
+    VkDeviceSize byteSize() const { return indexSize(d_type)*d_count; }
+    const void* data() const;
+    uint32_t operator[](size_t i) const {
+      return d_type == VK_INDEX_TYPE_UINT16 ? d_indices16[i] : d_indices32[i];
+    }
+
+  private:
+    VkIndexType d_type = VK_INDEX_TYPE_UINT16;
+    uint32_t d_count = 0;
+    //only the one of d_type is filled
+    std::vector<uint16_t> d_indices16;
+    std::vector<uint32_t> d_indices32;
+
+    template<typename Index>
+    void pack(const Index* indices, size_t count, size_t vertexCount);
+};
@@ -0,0 +1,27 @@
+//lineSegment.hpp
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+//one line of the GPU expanded path, read by line.vert straight out of a storage
+//buffer and turned into a quad there. 24 bytes against the 4 vertices and 6 indices
+//DrawList2D::addLine writes
+struct LineSegment{
+  glm::vec2 start;
+  glm::vec2 end;
+  //full width in screen space units, like DrawList2D::addLine
+  float width;
+  //RGBA8, red in the lowest byte
+  uint32_t color;
+
+  static LineSegment make(glm::vec2 start, glm::vec2 end, float width, glm::vec4 color){
+    auto unorm8 = [](float value){
+      return static_cast<uint32_t>(std::min(std::max(value,0.0f),1.0f)*255.0f+0.5f);
+    };
+    return {start,end,width,unorm8(color.x)|unorm8(color.y)<<8|unorm8(color.z)<<16|unorm8(color.w)<<24};
+  }
+};
+static_assert(sizeof(LineSegment)==24, "line.vert reads LineSegment with the std430 layout");
@@ -0,0 +1,161 @@
+//memoryTracker.cpp
+#include "memoryTracker.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace{
+  double megabytes(uint64_t bytes){
+    return bytes/(1024.0*1024.0);
+  }
+
+  void add(MemoryTracker::Usage& usage, VkDeviceSize size){
+    usage.liveBytes += size;
+    usage.peakBytes = std::max(usage.peakBytes,usage.liveBytes);
+    usage.liveAllocations++;
+    usage.totalAllocations++;
+  }
+
+  void remove(MemoryTracker::Usage& usage, VkDeviceSize size){
+    usage.liveBytes -= size;
+    usage.liveAllocations--;
+  }
+}
+
+const char* MemoryTracker::categoryName(MemoryCategory category){
+  switch(category){
+    case MemoryCategory::Vertex: return "vertex";
+    case MemoryCategory::Index: return "index";
+    case MemoryCategory::Uniform: return "uniform";
+    case MemoryCategory::Texture: return "texture";
+    case MemoryCategory::Staging: return "staging";
+    case MemoryCategory::Depth: return "depth";
+    case MemoryCategory::Swapchain: return "swapchain";
+    case MemoryCategory::Readback: return "readback";
+    case MemoryCategory::Dynamic: return "dynamic";
+    default: return "unknown";
+  }
+}
+
+const char* MemoryTracker::requiredInstanceExtension(){
+  return VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
+}
+
+const char* MemoryTracker::budgetExtension(){
+  return VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+}
+
+void MemoryTracker::init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, bool budget){
+  d_physicalDevice = physicalDevice;
+  d_device = device;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice,&d_properties);
+  if(budget){
+    d_getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+        vkGetInstanceProcAddr(instance,"vkGetPhysicalDeviceMemoryProperties2KHR"));
+  }
+}
+
+VkResult MemoryTracker::allocate(const VkMemoryAllocateInfo& allocInfo, MemoryCategory category,
+    VkDeviceMemory& memory){
+  VkResult result = vkAllocateMemory(d_device,&allocInfo,nullptr,&memory);
+  if(result!=VK_SUCCESS) return result;
+
+  uint32_t heap = d_properties.memoryTypes[allocInfo.memoryTypeIndex].heapIndex;
+  std::lock_guard<std::mutex> lock(d_mutex);
+  d_allocations[memory] = {category,allocInfo.allocationSize,heap,d_serial++};
+  add(d_categories[static_cast<size_t>(category)],allocInfo.allocationSize);
+  add(d_total,allocInfo.allocationSize);
+  d_heapBytes[heap] += allocInfo.allocationSize;
+  return result;
+}
+
+void MemoryTracker::free(VkDeviceMemory memory){
+  if(memory==VK_NULL_HANDLE) return;
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    auto found = d_allocations.find(memory);
+    if(found!=d_allocations.end()){
+      const Allocation& allocation = found->second;
+      remove(d_categories[static_cast<size_t>(allocation.category)],allocation.size);
+      remove(d_total,allocation.size);
+      d_heapBytes[allocation.heap] -= allocation.size;
+      d_allocations.erase(found);
+    }
+  }
+  vkFreeMemory(d_device,memory,nullptr);
+}
+
+MemoryTracker::Usage MemoryTracker::total() const{
+  std::lock_guard<std::mutex> lock(d_mutex);
+  return d_total;
+}
+
+MemoryTracker::Usage MemoryTracker::usage(MemoryCategory category) const{
+  std::lock_guard<std::mutex> lock(d_mutex);
+  return d_categories[static_cast<size_t>(category)];
+}
+
+std::vector<MemoryTracker::Heap> MemoryTracker::heaps() const{
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+  budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  if(d_getProperties2!=nullptr){
+    VkPhysicalDeviceMemoryProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budget;
+    d_getProperties2(d_physicalDevice,&properties);
+  }
+
+  std::lock_guard<std::mutex> lock(d_mutex);
+  std::vector<Heap> heaps(d_properties.memoryHeapCount);
+  for(uint32_t i = 0; i<d_properties.memoryHeapCount; i++){
+    heaps[i].size = d_properties.memoryHeaps[i].size;
+    heaps[i].deviceLocal = (d_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)!=0;
+    heaps[i].trackedBytes = d_heapBytes[i];
+    heaps[i].usage = budget.heapUsage[i];
+    heaps[i].budget = budget.heapBudget[i];
+  }
+  return heaps;
+}
+
+void MemoryTracker::printReport(std::ostream& out) const{
+  out<<"device memory            live MB   peak MB  allocations"<<std::endl;
+  out<<std::fixed<<std::setprecision(2);
+  for(size_t i = 0; i<static_cast<size_t>(MemoryCategory::Count); i++){
+    Usage category = usage(static_cast<MemoryCategory>(i));
+    if(category.totalAllocations==0) continue;
+    out<<"  "<<std::left<<std::setw(20)<<categoryName(static_cast<MemoryCategory>(i))<<std::right
+      <<std::setw(10)<<megabytes(category.liveBytes)<<std::setw(10)<<megabytes(category.peakBytes)
+      <<std::setw(13)<<category.liveAllocations<<std::endl;
+  }
+  Usage all = total();
+  out<<"  "<<std::left<<std::setw(20)<<"total"<<std::right<<std::setw(10)<<megabytes(all.liveBytes)
+    <<std::setw(10)<<megabytes(all.peakBytes)<<std::setw(13)<<all.liveAllocations<<std::endl;
+
+  const auto heapList = heaps();
+  for(size_t i = 0; i<heapList.size(); i++){
+    const Heap& heap = heapList[i];
+    out<<"  heap "<<i<<(heap.deviceLocal ? " (device local)" : " (host)")
+      <<": "<<megabytes(heap.trackedBytes)<<" MB tracked";
+    if(hasBudget()){
+      out<<", "<<megabytes(heap.usage)<<" MB used of "<<megabytes(heap.budget)<<" MB budget";
+    }
+    out<<", "<<megabytes(heap.size)<<" MB heap"<<std::endl;
+  }
+}
+
+size_t MemoryTracker::reportLeaks(std::ostream& out) const{
+  std::lock_guard<std::mutex> lock(d_mutex);
+  if(d_allocations.empty()) return 0;
+  //in allocation order, the first one leaked is usually the interesting one
+  std::vector<Allocation> leaked;
+  for(const auto& entry : d_allocations) leaked.push_back(entry.second);
+  std::sort(leaked.begin(),leaked.end(),
+      [](const Allocation& a, const Allocation& b){ return a.serial<b.serial; });
+  out<<"device memory leak: "<<leaked.size()<<" allocation(s), "<<megabytes(d_total.liveBytes)
+    <<" MB still allocated"<<std::endl;
+  for(const auto& allocation : leaked){
+    out<<"  #"<<allocation.serial<<" "<<categoryName(allocation.category)<<" "
+      <<allocation.size<<" bytes"<<std::endl;
+  }
+  return leaked.size();
+}
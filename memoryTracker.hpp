@@ -0,0 +1,76 @@
+//memoryTracker.hpp
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+enum class MemoryCategory{ Vertex, Index, Uniform, Texture, Staging, Depth, Swapchain, Readback, Dynamic, Count };
+
+//every vkAllocateMemory of the renderer goes through allocate() and every
+//vkFreeMemory through free(), so live bytes, high-water marks and whatever is
+//still allocated at shutdown are known per category. With VK_EXT_memory_budget
+//the driver's own per heap usage and budget are reported next to it.
+class MemoryTracker{
+  public:
+    struct Usage{
+      uint64_t liveBytes = 0;
+      uint64_t peakBytes = 0;
+      uint32_t liveAllocations = 0;
+      uint64_t totalAllocations = 0;
+    };
+    struct Heap{
+      VkDeviceSize size = 0;
+      bool deviceLocal = false;
+      //what this tracker allocated from the heap
+      VkDeviceSize trackedBytes = 0;
+      //driver's view including other processes, only with the budget extension
+      VkDeviceSize usage = 0;
+      VkDeviceSize budget = 0;
+    };
+
+    static const char* categoryName(MemoryCategory category);
+    //instance extension memory budget queries need on a Vulkan 1.0 instance
+    static const char* requiredInstanceExtension();
+    static const char* budgetExtension();
+
+    //budget only when the instance and device were created with the extensions above
+    void init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, bool budget);
+
+    VkResult allocate(const VkMemoryAllocateInfo& allocInfo, MemoryCategory category, VkDeviceMemory& memory);
+    //frees and forgets memory, VK_NULL_HANDLE is ignored like vkFreeMemory does
+    void free(VkDeviceMemory memory);
+
+    Usage total() const;
+    Usage usage(MemoryCategory category) const;
+    bool hasBudget() const { return d_getProperties2!=nullptr; }
+    std::vector<Heap> heaps() const;
+
+    void printReport(std::ostream& out) const;
+    //lists every allocation not freed yet, returns how many there are
+    size_t reportLeaks(std::ostream& out) const;
+
+  private:
+    struct Allocation{
+      MemoryCategory category;
+      VkDeviceSize size;
+      uint32_t heap;
+      uint64_t serial;
+    };
+
+    VkPhysicalDevice d_physicalDevice = VK_NULL_HANDLE;
+    VkDevice d_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties d_properties = {};
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR d_getProperties2 = nullptr;
+
+    mutable std::mutex d_mutex;
+    std::unordered_map<VkDeviceMemory,Allocation> d_allocations;
+    Usage d_categories[static_cast<size_t>(MemoryCategory::Count)];
+    Usage d_total;
+    VkDeviceSize d_heapBytes[VK_MAX_MEMORY_HEAPS] = {};
+    uint64_t d_serial = 0;
+};
@@ -0,0 +1,51 @@
+//aabb.hpp
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+//axis aligned bounds. The renderer measures its mesh and 2D shapes with these and
+//physics builds bodies and broadphase bounds from them, so both agree on extents.
+//Default constructed it is empty and grows with every point added
+struct Aabb{
+  glm::vec3 min = glm::vec3(FLT_MAX);
+  glm::vec3 max = glm::vec3(-FLT_MAX);
+
+  bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+  void add(glm::vec3 point){
+    min = glm::vec3(std::min(min.x,point.x),std::min(min.y,point.y),std::min(min.z,point.z));
+    max = glm::vec3(std::max(max.x,point.x),std::max(max.y,point.y),std::max(max.z,point.z));
+  }
+  void add(const Aabb& other){
+    if(other.empty()) return;
+    add(other.min);
+    add(other.max);
+  }
+  //grown by margin on every side
+  Aabb expanded(float margin) const{
+    if(empty()) return *this;
+    Aabb grown;
+    grown.min = glm::vec3(min.x-margin,min.y-margin,min.z-margin);
+    grown.max = glm::vec3(max.x+margin,max.y+margin,max.z+margin);
+    return grown;
+  }
+  glm::vec3 center() const { return glm::vec3(0.5f*(min.x+max.x),0.5f*(min.y+max.y),0.5f*(min.z+max.z)); }
+  glm::vec3 halfExtents() const { return glm::vec3(0.5f*(max.x-min.x),0.5f*(max.y-min.y),0.5f*(max.z-min.z)); }
+  //touching counts as overlapping
+  bool overlaps(const Aabb& other) const{
+    return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y
+      && min.z <= other.max.z && other.min.z <= max.z;
+  }
+
+  //of count points, each stride bytes after the last, so positions can be read
+  //straight out of vertex structs
+  static Aabb of(const glm::vec3* points, size_t count, size_t stride = sizeof(glm::vec3)){
+    Aabb bounds;
+    const char* p = reinterpret_cast<const char*>(points);
+    for(size_t i = 0; i < count; i++) bounds.add(*reinterpret_cast<const glm::vec3*>(p+i*stride));
+    return bounds;
+  }
+};
@@ -0,0 +1,32 @@
+//bodyBounds.cpp
+#include "bodyBounds.hpp"
+
+#include <cmath>
+
+void BoundsArrays::resize(uint32_t count){
+  for(std::vector<float>* array : {&minX,&minY,&minZ,&maxX,&maxY,&maxZ}) array->resize(count);
+  movable.resize(count);
+}
+
+void computeBounds(const BodyArrays& bodies, uint32_t count, float margin, BoundsArrays& bounds){
+  bounds.resize(count);
+  const BodyArrays& b = bodies;
+  //straight line code over the arrays, which compilers vectorize
+  for(uint32_t i = 0; i < count; i++){
+    float x = b.qx[i], y = b.qy[i], z = b.qz[i], w = b.qw[i];
+    //rows of the rotation matrix, absolute, project the half extents onto each axis
+    float r00 = std::fabs(1.0f-2.0f*(y*y+z*z)), r01 = std::fabs(2.0f*(x*y-w*z)), r02 = std::fabs(2.0f*(x*z+w*y));
+    float r10 = std::fabs(2.0f*(x*y+w*z)), r11 = std::fabs(1.0f-2.0f*(x*x+z*z)), r12 = std::fabs(2.0f*(y*z-w*x));
+    float r20 = std::fabs(2.0f*(x*z-w*y)), r21 = std::fabs(2.0f*(y*z+w*x)), r22 = std::fabs(1.0f-2.0f*(x*x+y*y));
+    float ex = r00*b.hx[i]+r01*b.hy[i]+r02*b.hz[i]+margin;
+    float ey = r10*b.hx[i]+r11*b.hy[i]+r12*b.hz[i]+margin;
+    float ez = r20*b.hx[i]+r21*b.hy[i]+r22*b.hz[i]+margin;
+    bounds.minX[i] = b.px[i]-ex;
+    bounds.minY[i] = b.py[i]-ey;
+    bounds.minZ[i] = b.pz[i]-ez;
+    bounds.maxX[i] = b.px[i]+ex;
+    bounds.maxY[i] = b.py[i]+ey;
+    bounds.maxZ[i] = b.pz[i]+ez;
+    bounds.movable[i] = b.invMass[i] > 0.0f;
+  }
+}
@@ -0,0 +1,28 @@
+//bodyBounds.hpp
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "aabb.hpp"
+#include "rigidBodyWorld.hpp"
+
+//world space bounds of every body, one array per bound like BodyArrays, plus
+//whether the body moves: pairs of two static bodies are never reported
+struct BoundsArrays{
+  std::vector<float> minX, minY, minZ;
+  std::vector<float> maxX, maxY, maxZ;
+  std::vector<uint8_t> movable;
+
+  void resize(uint32_t count);
+  Aabb bounds(uint32_t i) const{
+    Aabb box;
+    box.min = glm::vec3(minX[i],minY[i],minZ[i]);
+    box.max = glm::vec3(maxX[i],maxY[i],maxZ[i]);
+    return box;
+  }
+};
+
+//the box of each of the first count bodies turned by its orientation, fattened by
+//margin on every side
+void computeBounds(const BodyArrays& bodies, uint32_t count, float margin, BoundsArrays& bounds);
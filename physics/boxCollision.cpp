@@ -0,0 +1,222 @@
+//boxCollision.cpp
+#include "boxCollision.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace{
+  //face axes win over slightly deeper alternatives so manifolds do not flip
+  //between axes from one step to the next
+  const float RELATIVE_TOLERANCE = 0.95f;
+  const float ABSOLUTE_TOLERANCE = 0.01f;
+  const uint32_t MAX_CLIPPED = 8;
+
+  float radiusAlong(const Box& box, glm::vec3 axis){
+    return box.halfExtents.x*std::fabs(glm::dot(box.axis[0],axis))
+      +box.halfExtents.y*std::fabs(glm::dot(box.axis[1],axis))
+      +box.halfExtents.z*std::fabs(glm::dot(box.axis[2],axis));
+  }
+
+  //keeps the part of polygon on the side of the plane where dot(x,normal) <= offset
+  uint32_t clip(const glm::vec3* in, uint32_t count, glm::vec3 normal, float offset, glm::vec3* out){
+    uint32_t written = 0;
+    for(uint32_t i = 0; i < count; i++){
+      glm::vec3 from = in[i];
+      glm::vec3 to = in[(i+1)%count];
+      float dFrom = glm::dot(from,normal)-offset;
+      float dTo = glm::dot(to,normal)-offset;
+      //points on the plane count as inside, so coincident faces keep their corners once
+      bool inFrom = dFrom <= 0.0f, inTo = dTo <= 0.0f;
+      if(inFrom && written < MAX_CLIPPED) out[written++] = from;
+      if(inFrom != inTo && written < MAX_CLIPPED){
+        out[written++] = from+(to-from)*(dFrom/(dFrom-dTo));
+      }
+    }
+    return written;
+  }
+
+  //a face of reference against the most opposed face of incident, normal points
+  //out of reference's face towards incident
+  uint32_t clipFaces(const Box& reference, uint32_t face, glm::vec3 normal, const Box& incident,
+      float margin, glm::vec3* positions, float* separations){
+    uint32_t k = 0;
+    float most = -1.0f;
+    for(uint32_t i = 0; i < 3; i++){
+      float alignment = std::fabs(glm::dot(incident.axis[i],normal));
+      if(alignment > most){
+        most = alignment;
+        k = i;
+      }
+    }
+    float side = glm::dot(incident.axis[k],normal) > 0.0f ? -1.0f : 1.0f;
+    uint32_t u = (k+1)%3, v = (k+2)%3;
+    glm::vec3 center = incident.center+incident.axis[k]*(side*incident.halfExtents[k]);
+    glm::vec3 eu = incident.axis[u]*incident.halfExtents[u];
+    glm::vec3 ev = incident.axis[v]*incident.halfExtents[v];
+    glm::vec3 polygon[MAX_CLIPPED] = {center+eu+ev, center-eu+ev, center-eu-ev, center+eu-ev};
+    glm::vec3 clipped[MAX_CLIPPED];
+    uint32_t count = 4;
+    //the four side planes of the reference face
+    for(uint32_t m = 1; m < 3 && count > 0; m++){
+      glm::vec3 axis = reference.axis[(face+m)%3];
+      float extent = reference.halfExtents[(face+m)%3];
+      float centerAlong = glm::dot(reference.center,axis);
+      count = clip(polygon, count, axis, centerAlong+extent, clipped);
+      count = clip(clipped, count, -axis, -centerAlong+extent, polygon);
+    }
+    float faceOffset = glm::dot(reference.center,normal)+reference.halfExtents[face];
+    uint32_t kept = 0;
+    for(uint32_t i = 0; i < count; i++){
+      float separation = glm::dot(polygon[i],normal)-faceOffset;
+      if(separation > margin) continue;
+      positions[kept] = polygon[i]-normal*(0.5f*separation);
+      separations[kept] = separation;
+      kept++;
+    }
+    return kept;
+  }
+
+  //the deepest point, the one furthest from it and the two spanning the most area
+  //on either side of the line between them
+  uint32_t reduce(const glm::vec3* positions, const float* separations, uint32_t count, glm::vec3 normal,
+      uint32_t* chosen){
+    if(count <= 4){
+      for(uint32_t i = 0; i < count; i++) chosen[i] = i;
+      return count;
+    }
+    uint32_t first = 0;
+    for(uint32_t i = 1; i < count; i++) if(separations[i] < separations[first]) first = i;
+    uint32_t second = first;
+    float furthest = -1.0f;
+    for(uint32_t i = 0; i < count; i++){
+      glm::vec3 d = positions[i]-positions[first];
+      float distance = glm::dot(d,d);
+      if(distance > furthest){
+        furthest = distance;
+        second = i;
+      }
+    }
+    uint32_t third = first, fourth = first;
+    float most = 0.0f, least = 0.0f;
+    glm::vec3 line = positions[second]-positions[first];
+    for(uint32_t i = 0; i < count; i++){
+      float area = glm::dot(glm::cross(line,positions[i]-positions[first]),normal);
+      if(area > most){
+        most = area;
+        third = i;
+      }
+      if(area < least){
+        least = area;
+        fourth = i;
+      }
+    }
+    uint32_t written = 0;
+    for(uint32_t index : {first, second, third, fourth}){
+      bool seen = false;
+      for(uint32_t i = 0; i < written; i++) seen = seen || chosen[i] == index;
+      if(!seen) chosen[written++] = index;
+    }
+    return written;
+  }
+}
+
+Box Box::of(const BodyArrays& b, uint32_t i){
+  Box box;
+  float x = b.qx[i], y = b.qy[i], z = b.qz[i], w = b.qw[i];
+  box.center = glm::vec3(b.px[i],b.py[i],b.pz[i]);
+  box.axis[0] = glm::vec3(1.0f-2.0f*(y*y+z*z),2.0f*(x*y+w*z),2.0f*(x*z-w*y));
+  box.axis[1] = glm::vec3(2.0f*(x*y-w*z),1.0f-2.0f*(x*x+z*z),2.0f*(y*z+w*x));
+  box.axis[2] = glm::vec3(2.0f*(x*z+w*y),2.0f*(y*z-w*x),1.0f-2.0f*(x*x+y*y));
+  box.halfExtents = glm::vec3(b.hx[i],b.hy[i],b.hz[i]);
+  return box;
+}
+
+bool collideBoxes(const Box& a, const Box& b, float margin, ContactManifold& manifold){
+  glm::vec3 offset = b.center-a.center;
+  float faceA = -FLT_MAX, faceB = -FLT_MAX, edge = -FLT_MAX;
+  uint32_t axisA = 0, axisB = 0, edgeA = 0, edgeB = 0;
+  glm::vec3 edgeAxis(0.0f);
+  for(uint32_t i = 0; i < 3; i++){
+    float separation = std::fabs(glm::dot(offset,a.axis[i]))-(a.halfExtents[i]+radiusAlong(b,a.axis[i]));
+    if(separation > margin) return false;
+    if(separation > faceA){
+      faceA = separation;
+      axisA = i;
+    }
+  }
+  for(uint32_t i = 0; i < 3; i++){
+    float separation = std::fabs(glm::dot(offset,b.axis[i]))-(b.halfExtents[i]+radiusAlong(a,b.axis[i]));
+    if(separation > margin) return false;
+    if(separation > faceB){
+      faceB = separation;
+      axisB = i;
+    }
+  }
+  for(uint32_t i = 0; i < 3; i++){
+    for(uint32_t j = 0; j < 3; j++){
+      glm::vec3 axis = glm::cross(a.axis[i],b.axis[j]);
+      float length = glm::length(axis);
+      //parallel edges, their axis is one of the face axes already tested
+      if(length < 1e-4f) continue;
+      axis = axis*(1.0f/length);
+      float separation = std::fabs(glm::dot(offset,axis))-(radiusAlong(a,axis)+radiusAlong(b,axis));
+      if(separation > margin) return false;
+      if(separation > edge){
+        edge = separation;
+        edgeA = i;
+        edgeB = j;
+        edgeAxis = axis;
+      }
+    }
+  }
+
+  float face = faceA;
+  bool referenceB = faceB > RELATIVE_TOLERANCE*faceA+ABSOLUTE_TOLERANCE;
+  if(referenceB) face = faceB;
+  if(edge > RELATIVE_TOLERANCE*face+ABSOLUTE_TOLERANCE){
+    glm::vec3 normal = glm::dot(edgeAxis,offset) < 0.0f ? -edgeAxis : edgeAxis;
+    //the edge of each box furthest towards the other
+    glm::vec3 onA = a.center, onB = b.center;
+    for(uint32_t k = 0; k < 3; k++){
+      if(k != edgeA) onA += a.axis[k]*(glm::dot(a.axis[k],normal) > 0.0f ? a.halfExtents[k] : -a.halfExtents[k]);
+      if(k != edgeB) onB += b.axis[k]*(glm::dot(b.axis[k],normal) > 0.0f ? -b.halfExtents[k] : b.halfExtents[k]);
+    }
+    //closest points of the two edge lines, clamped to the edges
+    glm::vec3 dA = a.axis[edgeA], dB = b.axis[edgeB];
+    glm::vec3 r = onA-onB;
+    float along = glm::dot(dA,dB);
+    float c = glm::dot(dA,r), f = glm::dot(dB,r);
+    float denominator = 1.0f-along*along;
+    float s = denominator > 1e-6f ? (along*f-c)/denominator : 0.0f;
+    s = std::max(-a.halfExtents[edgeA],std::min(s,a.halfExtents[edgeA]));
+    float t = std::max(-b.halfExtents[edgeB],std::min(f+along*s,b.halfExtents[edgeB]));
+    glm::vec3 pointA = onA+dA*s, pointB = onB+dB*t;
+    manifold.normal = normal;
+    manifold.count = 1;
+    manifold.points[0] = ContactPoint();
+    manifold.points[0].position = (pointA+pointB)*0.5f;
+    manifold.points[0].separation = glm::dot(pointB-pointA,normal);
+    return true;
+  }
+
+  const Box& reference = referenceB ? b : a;
+  const Box& incident = referenceB ? a : b;
+  uint32_t axis = referenceB ? axisB : axisA;
+  glm::vec3 towards = referenceB ? -offset : offset;
+  glm::vec3 normal = glm::dot(reference.axis[axis],towards) < 0.0f ? -reference.axis[axis] : reference.axis[axis];
+  glm::vec3 positions[MAX_CLIPPED];
+  float separations[MAX_CLIPPED];
+  uint32_t count = clipFaces(reference, axis, normal, incident, margin, positions, separations);
+  if(count == 0) return false;
+  uint32_t chosen[4];
+  count = reduce(positions, separations, count, normal, chosen);
+  manifold.normal = referenceB ? -normal : normal;
+  manifold.count = count;
+  for(uint32_t i = 0; i < count; i++){
+    manifold.points[i] = ContactPoint();
+    manifold.points[i].position = positions[chosen[i]];
+    manifold.points[i].separation = separations[chosen[i]];
+  }
+  return true;
+}
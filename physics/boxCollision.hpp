@@ -0,0 +1,49 @@
+//boxCollision.hpp
+#pragma once
+
+#include <cstdint>
+
+#include "rigidBodyWorld.hpp"
+
+//an oriented box in world space, axes are the columns of its rotation
+struct Box{
+  glm::vec3 center;
+  glm::vec3 axis[3];
+  glm::vec3 halfExtents;
+
+  static Box of(const BodyArrays& bodies, uint32_t i);
+};
+
+struct ContactPoint{
+  //halfway between the two surfaces
+  glm::vec3 position;
+  //negative while the boxes overlap
+  float separation = 0.0f;
+  //position in the frame of body a, what points are matched by from step to step
+  glm::vec3 localA;
+  //accumulated by the solver, carried over to warm start the next step
+  float normalImpulse = 0.0f;
+};
+
+//where two bodies touch, or are about to: up to four points sharing one normal
+struct ContactManifold{
+  //body indices in the world's arrays; a is the body with the smaller handle
+  uint32_t a = 0;
+  uint32_t b = 0;
+  //handles of a and b, which stay the same while indices shift
+  uint64_t key = 0;
+  //from a towards b
+  glm::vec3 normal;
+  uint32_t count = 0;
+  ContactPoint points[4];
+  //friction acts once at the center of the points, along two tangents and as a
+  //twist about the normal, so corners cannot hold stress against each other
+  float tangentImpulse[2] = {0.0f,0.0f};
+  float twistImpulse = 0.0f;
+};
+
+//separating axis test over the 15 axes of two boxes. The closest face is clipped
+//against the other box's face to find up to four points; when two edges are
+//closest there is one point between them. False when the boxes are further apart
+//than margin, otherwise manifold.normal, count and points are filled in
+bool collideBoxes(const Box& a, const Box& b, float margin, ContactManifold& manifold);
@@ -0,0 +1,28 @@
+//broadphase.cpp
+#include "broadphase.hpp"
+
+#include <stdexcept>
+
+void Broadphase::setStrategy(Strategy strategy){
+  d_strategy = strategy;
+  d_sweepAndPrune.reset();
+}
+
+void Broadphase::setMargin(float margin){
+  if(margin < 0.0f) throw std::invalid_argument("negative broadphase margin");
+  d_margin = margin;
+}
+
+void Broadphase::update(const RigidBodyWorld& world, PairBuffer& pairs){
+  computeBounds(world.bodies(), world.size(), d_margin, d_bounds);
+  if(d_strategy == Strategy::SpatialHash){
+    d_spatialHash.update(d_bounds, world.size(), pairs);
+    return;
+  }
+  //indices moved, the old order says nothing about the new bodies
+  if(world.version() != d_version){
+    d_sweepAndPrune.reset();
+    d_version = world.version();
+  }
+  d_sweepAndPrune.update(d_bounds, world.size(), pairs);
+}
@@ -0,0 +1,43 @@
+//broadphase.hpp
+#pragma once
+
+#include <cstdint>
+
+#include "bodyBounds.hpp"
+#include "pairBuffer.hpp"
+#include "rigidBodyWorld.hpp"
+#include "spatialHash.hpp"
+#include "sweepAndPrune.hpp"
+
+//finds the pairs of bodies of a world whose bounds overlap, so the narrow phase
+//only looks at those. Sweep and prune suits worlds where bodies move a little each
+//step; the spatial hash keeps no order between steps and suits bodies of similar
+//size that teleport or are created in bulk
+class Broadphase{
+  public:
+    enum class Strategy : uint32_t{
+      SweepAndPrune = 0,
+      SpatialHash = 1
+    };
+
+    void setStrategy(Strategy strategy);
+    Strategy strategy() const { return d_strategy; }
+    //bounds are fattened by this much, so pairs about to touch are found a step early
+    void setMargin(float margin);
+
+    //bounds every body of world and writes the overlapping pairs to pairs
+    void update(const RigidBodyWorld& world, PairBuffer& pairs);
+    const BoundsArrays& bounds() const { return d_bounds; }
+    const SweepAndPrune& sweepAndPrune() const { return d_sweepAndPrune; }
+    SpatialHash& spatialHash() { return d_spatialHash; }
+    const SpatialHash& spatialHash() const { return d_spatialHash; }
+
+  private:
+    Strategy d_strategy = Strategy::SweepAndPrune;
+    float d_margin = 0.0f;
+    BoundsArrays d_bounds;
+    SweepAndPrune d_sweepAndPrune;
+    SpatialHash d_spatialHash;
+    //of the world the sweep's endpoints were built for
+    uint64_t d_version = UINT64_MAX;
+};
@@ -0,0 +1,593 @@
+//contactSolver.cpp
+#include "contactSolver.hpp"
+
+#include "simdLanes.hpp"
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace{
+  //manifolds a narrowphase job takes at least, and batches a solver job
+  const uint32_t PAIR_GRAIN = 256;
+  const uint32_t BATCH_GRAIN = 16;
+  const uint32_t BODY_GRAIN = 4096;
+  //colors a body can take part in, one bit each
+  const uint32_t MAX_COLORS = 64;
+
+  template<typename L>
+  struct Lanes3{
+    typename L::V x, y, z;
+  };
+
+  template<typename L>
+  Lanes3<L> load3(const float* x, const float* y, const float* z){
+    return {L::load(x),L::load(y),L::load(z)};
+  }
+
+  template<typename L>
+  Lanes3<L> cross(const Lanes3<L>& a, const Lanes3<L>& b){
+    return {L::sub(L::mul(a.y,b.z),L::mul(a.z,b.y)),L::sub(L::mul(a.z,b.x),L::mul(a.x,b.z)),
+      L::sub(L::mul(a.x,b.y),L::mul(a.y,b.x))};
+  }
+
+  template<typename L>
+  typename L::V dot(const Lanes3<L>& a, const Lanes3<L>& b){
+    return L::add(L::add(L::mul(a.x,b.x),L::mul(a.y,b.y)),L::mul(a.z,b.z));
+  }
+
+  //a symmetric inverse inertia, xx xy xz yy yz zz, times v
+  template<typename L>
+  Lanes3<L> rotate(const typename L::V* i, const Lanes3<L>& v){
+    return {L::add(L::add(L::mul(i[0],v.x),L::mul(i[1],v.y)),L::mul(i[2],v.z)),
+      L::add(L::add(L::mul(i[1],v.x),L::mul(i[3],v.y)),L::mul(i[4],v.z)),
+      L::add(L::add(L::mul(i[2],v.x),L::mul(i[4],v.y)),L::mul(i[5],v.z))};
+  }
+
+  //velocity of b's contact point relative to a's
+  template<typename L>
+  Lanes3<L> relative(const Lanes3<L>* v, const Lanes3<L>& rA, const Lanes3<L>& rB){
+    Lanes3<L> spinA = cross(v[1],rA), spinB = cross(v[3],rB);
+    return {L::sub(L::add(v[2].x,spinB.x),L::add(v[0].x,spinA.x)),
+      L::sub(L::add(v[2].y,spinB.y),L::add(v[0].y,spinA.y)),
+      L::sub(L::add(v[2].z,spinB.z),L::add(v[0].z,spinA.z))};
+  }
+
+  glm::vec3 tangentOf(glm::vec3 n){
+    //any unit vector perpendicular to n, the same one for the same normal
+    glm::vec3 t = std::fabs(n.x) >= 0.57735f ? glm::vec3(n.y,-n.x,0.0f) : glm::vec3(0.0f,n.z,-n.y);
+    return glm::normalize(t);
+  }
+
+  float quadratic(const float* inertia, glm::vec3 v){
+    return v.x*(inertia[0]*v.x+inertia[1]*v.y+inertia[2]*v.z)
+      +v.y*(inertia[1]*v.x+inertia[3]*v.y+inertia[4]*v.z)
+      +v.z*(inertia[2]*v.x+inertia[4]*v.y+inertia[5]*v.z);
+  }
+
+  //inverse of what an impulse along d at rA and rB changes the relative speed
+  //along d by: both inverse masses plus what each body turns by its moment
+  float effectiveMass(const float* mass, const float (*inertia)[6], glm::vec3 rA, glm::vec3 rB, glm::vec3 d){
+    float k = mass[0]+mass[1]+quadratic(inertia[0],glm::cross(rA,d))+quadratic(inertia[1],glm::cross(rB,d));
+    return k > 0.0f ? 1.0f/k : 0.0f;
+  }
+
+  struct Softness{
+    float biasRate;
+    float massScale;
+    float impulseScale;
+  };
+
+  //a spring and damper solved implicitly over dt, as coefficients of the
+  //velocity error, the effective mass and the accumulated impulse
+  Softness softness(const ContactSolver::Settings& settings, float dt){
+    float omega = 2.0f*3.14159265f*settings.hertz;
+    float zeta = settings.dampingRatio;
+    float stiffness = dt*omega*(2.0f*zeta+dt*omega);
+    Softness soft;
+    soft.biasRate = omega/(2.0f*zeta+dt*omega);
+    soft.massScale = stiffness/(1.0f+stiffness);
+    soft.impulseScale = 1.0f/(1.0f+stiffness);
+    return soft;
+  }
+}
+
+//one pass of every row of a batch, lanes lane to lane+L::width. warmStart
+//applies last step's impulses instead of solving
+template<typename L, typename Batch>
+static void solveLanes(Batch& batch, BodyArrays& b, float friction, bool warmStart, uint32_t lane){
+  using V = typename L::V;
+  const uint32_t W = sizeof(batch.manifold)/sizeof(batch.manifold[0]);
+  //vA wA vB wB, zero for static bodies and empty lanes
+  float gathered[12][W] = {};
+  for(uint32_t l = lane; l < lane+L::width; l++){
+    uint32_t bodies[2] = {batch.bodyA[l],batch.bodyB[l]};
+    for(uint32_t s = 0; s < 2; s++){
+      uint32_t i = bodies[s];
+      if(i == UINT32_MAX) continue;
+      gathered[6*s+0][l] = b.vx[i]; gathered[6*s+1][l] = b.vy[i]; gathered[6*s+2][l] = b.vz[i];
+      gathered[6*s+3][l] = b.wx[i]; gathered[6*s+4][l] = b.wy[i]; gathered[6*s+5][l] = b.wz[i];
+    }
+  }
+  Lanes3<L> v[4];
+  for(uint32_t k = 0; k < 4; k++) v[k] = load3<L>(&gathered[3*k][lane],&gathered[3*k+1][lane],&gathered[3*k+2][lane]);
+  V massA = L::load(&batch.massA[lane]), massB = L::load(&batch.massB[lane]);
+  V inertiaA[6], inertiaB[6];
+  for(uint32_t k = 0; k < 6; k++){
+    inertiaA[k] = L::load(&batch.inertiaA[k][lane]);
+    inertiaB[k] = L::load(&batch.inertiaB[k][lane]);
+  }
+  Lanes3<L> n = load3<L>(&batch.nx[lane],&batch.ny[lane],&batch.nz[lane]);
+  Lanes3<L> t[2] = {load3<L>(&batch.t1x[lane],&batch.t1y[lane],&batch.t1z[lane]),
+    load3<L>(&batch.t2x[lane],&batch.t2y[lane],&batch.t2z[lane])};
+  V zero = L::set(0.0f);
+  //impulse p at rA and rB, pushing b and pulling a
+  auto apply = [&](const Lanes3<L>& rA, const Lanes3<L>& rB, const Lanes3<L>& p){
+    v[0] = {L::sub(v[0].x,L::mul(p.x,massA)),L::sub(v[0].y,L::mul(p.y,massA)),L::sub(v[0].z,L::mul(p.z,massA))};
+    Lanes3<L> spinA = rotate<L>(inertiaA,cross(rA,p));
+    v[1] = {L::sub(v[1].x,spinA.x),L::sub(v[1].y,spinA.y),L::sub(v[1].z,spinA.z)};
+    v[2] = {L::add(v[2].x,L::mul(p.x,massB)),L::add(v[2].y,L::mul(p.y,massB)),L::add(v[2].z,L::mul(p.z,massB))};
+    Lanes3<L> spinB = rotate<L>(inertiaB,cross(rB,p));
+    v[3] = {L::add(v[3].x,spinB.x),L::add(v[3].y,spinB.y),L::add(v[3].z,spinB.z)};
+  };
+  //angular impulse about the normal
+  auto twist = [&](V impulse){
+    Lanes3<L> turn = {L::mul(n.x,impulse),L::mul(n.y,impulse),L::mul(n.z,impulse)};
+    Lanes3<L> spinA = rotate<L>(inertiaA,turn), spinB = rotate<L>(inertiaB,turn);
+    v[1] = {L::sub(v[1].x,spinA.x),L::sub(v[1].y,spinA.y),L::sub(v[1].z,spinA.z)};
+    v[3] = {L::add(v[3].x,spinB.x),L::add(v[3].y,spinB.y),L::add(v[3].z,spinB.z)};
+  };
+  Lanes3<L> cA = load3<L>(&batch.cAx[lane],&batch.cAy[lane],&batch.cAz[lane]);
+  Lanes3<L> cB = load3<L>(&batch.cBx[lane],&batch.cBy[lane],&batch.cBz[lane]);
+  float* tangentImpulses[2] = {batch.tangentImpulse1,batch.tangentImpulse2};
+  float* tangentMasses[2] = {batch.tangentMass1,batch.tangentMass2};
+
+  if(warmStart){
+    V i1 = L::load(&tangentImpulses[0][lane]), i2 = L::load(&tangentImpulses[1][lane]);
+    apply(cA,cB,{L::add(L::mul(t[0].x,i1),L::mul(t[1].x,i2)),L::add(L::mul(t[0].y,i1),L::mul(t[1].y,i2)),
+      L::add(L::mul(t[0].z,i1),L::mul(t[1].z,i2))});
+    twist(L::load(&batch.twistImpulse[lane]));
+  }else{
+    //friction first, bounded by the normal impulses of the last iteration
+    V pressed = zero;
+    for(uint32_t r = 0; r < batch.points; r++) pressed = L::add(pressed,L::load(&batch.rows[r].normalImpulse[lane]));
+    V limit = L::mul(L::set(friction),pressed);
+    for(uint32_t k = 0; k < 2; k++){
+      V speed = dot(relative<L>(v,cA,cB),t[k]);
+      V old = L::load(&tangentImpulses[k][lane]);
+      V updated = L::max(L::sub(zero,limit),L::min(L::sub(old,L::mul(L::load(&tangentMasses[k][lane]),speed)),limit));
+      L::store(&tangentImpulses[k][lane],updated);
+      V delta = L::sub(updated,old);
+      apply(cA,cB,{L::mul(t[k].x,delta),L::mul(t[k].y,delta),L::mul(t[k].z,delta)});
+    }
+    Lanes3<L> spin = {L::sub(v[3].x,v[1].x),L::sub(v[3].y,v[1].y),L::sub(v[3].z,v[1].z)};
+    V twistLimit = L::mul(limit,L::load(&batch.radius[lane]));
+    V old = L::load(&batch.twistImpulse[lane]);
+    V updated = L::max(L::sub(zero,twistLimit),
+      L::min(L::sub(old,L::mul(L::load(&batch.twistMass[lane]),dot(spin,n))),twistLimit));
+    L::store(&batch.twistImpulse[lane],updated);
+    twist(L::sub(updated,old));
+  }
+
+  for(uint32_t r = 0; r < batch.points; r++){
+    auto& row = batch.rows[r];
+    Lanes3<L> rA = load3<L>(&row.rAx[lane],&row.rAy[lane],&row.rAz[lane]);
+    Lanes3<L> rB = load3<L>(&row.rBx[lane],&row.rBy[lane],&row.rBz[lane]);
+    V normalImpulse = L::load(&row.normalImpulse[lane]);
+    V delta = normalImpulse;
+    if(!warmStart){
+      //pushing only
+      V speed = dot(relative<L>(v,rA,rB),n);
+      V lambda = L::sub(L::mul(L::load(&row.normalMass[lane]),L::sub(L::load(&row.bias[lane]),speed)),
+        L::mul(L::load(&row.softness[lane]),normalImpulse));
+      V updated = L::max(zero,L::add(normalImpulse,lambda));
+      L::store(&row.normalImpulse[lane],updated);
+      delta = L::sub(updated,normalImpulse);
+    }
+    apply(rA,rB,{L::mul(n.x,delta),L::mul(n.y,delta),L::mul(n.z,delta)});
+  }
+
+  for(uint32_t k = 0; k < 4; k++){
+    L::store(&gathered[3*k][lane],v[k].x);
+    L::store(&gathered[3*k+1][lane],v[k].y);
+    L::store(&gathered[3*k+2][lane],v[k].z);
+  }
+  for(uint32_t l = lane; l < lane+L::width; l++){
+    uint32_t bodies[2] = {batch.bodyA[l],batch.bodyB[l]};
+    for(uint32_t s = 0; s < 2; s++){
+      uint32_t i = bodies[s];
+      if(i == UINT32_MAX) continue;
+      b.vx[i] = gathered[6*s+0][l]; b.vy[i] = gathered[6*s+1][l]; b.vz[i] = gathered[6*s+2][l];
+      b.wx[i] = gathered[6*s+3][l]; b.wy[i] = gathered[6*s+4][l]; b.wz[i] = gathered[6*s+5][l];
+    }
+  }
+}
+
+template<typename Batch>
+static void solveBatch(Batch& batch, BodyArrays& bodies, float friction, bool warmStart){
+#ifdef PHYSICS_HAS_SSE
+  solveLanes<SSELanes>(batch, bodies, friction, warmStart, 0);
+#else
+  for(uint32_t lane = 0; lane < 4; lane++) solveLanes<ScalarLanes>(batch, bodies, friction, warmStart, lane);
+#endif
+}
+
+ContactSolver::ContactSolver() : ContactSolver(Settings()){}
+
+ContactSolver::ContactSolver(const Settings& settings) : d_settings(settings){
+  if(settings.largeIsland == 0) throw std::invalid_argument("large island threshold must be positive");
+  d_broadphase.setMargin(settings.margin);
+}
+
+void ContactSolver::setThreadPool(ThreadPool* pool){
+  d_pool = pool;
+}
+
+template<typename Body>
+void ContactSolver::parallelFor(uint32_t count, uint32_t grain, Body body){
+  uint32_t jobs = 1;
+  if(d_pool && count > grain){
+    jobs = std::min(static_cast<uint32_t>(d_pool->size())*4,(count+grain-1)/grain);
+  }
+  if(jobs <= 1){
+    if(count > 0) body(0u, 0u, count);
+    return;
+  }
+  for(uint32_t j = 0; j < jobs; j++){
+    uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count)*j/jobs);
+    uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count)*(j+1)/jobs);
+    d_pool->submit([&body, j, begin, end]{ body(j, begin, end); });
+  }
+  d_pool->wait();
+}
+
+void ContactSolver::solve(RigidBodyWorld& world, float dt){
+  d_stats = Stats();
+  BodyArrays& bodies = world.bodies();
+  findContacts(world);
+
+  //world inverse inertia, R diag(i) R^T with R's columns the body axes
+  uint32_t count = world.size();
+  for(std::vector<float>& component : d_inertia) component.resize(count);
+  parallelFor(count, BODY_GRAIN, [&](uint32_t, uint32_t begin, uint32_t end){
+    for(uint32_t i = begin; i < end; i++){
+      Box box = Box::of(bodies, i);
+      glm::vec3 inverse(bodies.ix[i],bodies.iy[i],bodies.iz[i]);
+      const uint32_t rows[6] = {0,0,0,1,1,2}, columns[6] = {0,1,2,1,2,2};
+      for(uint32_t k = 0; k < 6; k++){
+        float sum = 0.0f;
+        for(uint32_t m = 0; m < 3; m++) sum += box.axis[m][rows[k]]*inverse[m]*box.axis[m][columns[k]];
+        d_inertia[k][i] = sum;
+      }
+    }
+  });
+
+  buildIslands(world);
+  uint32_t batchCount = static_cast<uint32_t>(d_batches.size());
+  parallelFor(batchCount, BATCH_GRAIN, [&](uint32_t, uint32_t begin, uint32_t end){
+    for(uint32_t i = begin; i < end; i++) prepare(world, d_batches[i], dt);
+  });
+
+  //small islands whole on one thread each, large ones a color at a time across all threads
+  std::vector<uint32_t> small, large;
+  for(uint32_t i = 0; i < d_islands.size(); i++){
+    (d_islands[i].end-d_islands[i].begin > d_settings.largeIsland ? large : small).push_back(i);
+  }
+  d_stats.islands = static_cast<uint32_t>(d_islands.size());
+  d_stats.largeIslands = static_cast<uint32_t>(large.size());
+  parallelFor(static_cast<uint32_t>(small.size()), 4, [&](uint32_t, uint32_t begin, uint32_t end){
+    for(uint32_t i = begin; i < end; i++) solveIsland(bodies, small[i]);
+  });
+
+  //the same color of different large islands shares no body either, so they run together
+  uint32_t colors = 0;
+  for(uint32_t i : large) colors = std::max(colors, d_islands[i].colors);
+  std::vector<uint32_t> order;
+  std::vector<Range> colorRanges;
+  for(uint32_t c = 0; c < colors; c++){
+    Range range = {static_cast<uint32_t>(order.size()),0};
+    for(uint32_t i : large){
+      if(c >= d_islands[i].colors) continue;
+      const Range& batches = d_colorRanges[d_islands[i].firstColor+c];
+      for(uint32_t b = batches.begin; b < batches.end; b++) order.push_back(b);
+    }
+    range.end = static_cast<uint32_t>(order.size());
+    colorRanges.push_back(range);
+  }
+  d_stats.colors = colors;
+  for(uint32_t pass = 0; pass <= d_settings.iterations && !large.empty(); pass++){
+    bool warmStart = pass == 0;
+    for(const Range& range : colorRanges){
+      parallelFor(range.end-range.begin, BATCH_GRAIN, [&](uint32_t, uint32_t begin, uint32_t end){
+        for(uint32_t i = range.begin+begin; i < range.begin+end; i++){
+          solveBatch(d_batches[order[i]], bodies, d_settings.friction, warmStart);
+        }
+      });
+    }
+    for(uint32_t i : large){
+      const Range& uncolored = d_colorRanges[d_islands[i].firstColor+d_islands[i].colors];
+      for(uint32_t b = uncolored.begin; b < uncolored.end; b++){
+        solveBatch(d_batches[b], bodies, d_settings.friction, warmStart);
+      }
+    }
+  }
+
+  //impulses back to the manifolds, where the next step looks for them
+  parallelFor(batchCount, BATCH_GRAIN, [&](uint32_t, uint32_t begin, uint32_t end){
+    for(uint32_t i = begin; i < end; i++){
+      const Batch& batch = d_batches[i];
+      for(uint32_t lane = 0; lane < WIDTH; lane++){
+        if(batch.manifold[lane] == NONE) continue;
+        ContactManifold& manifold = d_manifolds[batch.manifold[lane]];
+        for(uint32_t p = 0; p < manifold.count; p++) manifold.points[p].normalImpulse = batch.rows[p].normalImpulse[lane];
+        manifold.tangentImpulse[0] = batch.tangentImpulse1[lane];
+        manifold.tangentImpulse[1] = batch.tangentImpulse2[lane];
+        manifold.twistImpulse = batch.twistImpulse[lane];
+      }
+    }
+  });
+  std::sort(d_manifolds.begin(), d_manifolds.end(), [](const ContactManifold& a, const ContactManifold& b){
+    return a.key < b.key;
+  });
+  d_previous.swap(d_manifolds);
+}
+
+void ContactSolver::findContacts(const RigidBodyWorld& world){
+  d_broadphase.update(world, d_pairs);
+  d_stats.pairs = static_cast<uint32_t>(d_pairs.size());
+  const BodyArrays& bodies = world.bodies();
+  uint32_t pairs = static_cast<uint32_t>(d_pairs.size());
+  uint32_t jobs = d_pool ? static_cast<uint32_t>(d_pool->size())*4 : 1;
+  d_found.resize(std::max(jobs, static_cast<uint32_t>(d_found.size())));
+  for(std::vector<ContactManifold>& found : d_found) found.clear();
+  std::vector<uint32_t> warmStarted(d_found.size(), 0);
+
+  parallelFor(pairs, PAIR_GRAIN, [&](uint32_t job, uint32_t begin, uint32_t end){
+    std::vector<ContactManifold>& found = d_found[job];
+    float matchSquared = d_settings.matchDistance*d_settings.matchDistance;
+    for(uint32_t i = begin; i < end; i++){
+      BodyPair pair = d_pairs[i];
+      //ordered by handle, so the manifold is the same one after indices shift
+      if(world.handle(pair.a) > world.handle(pair.b)) std::swap(pair.a, pair.b);
+      Box a = Box::of(bodies, pair.a), b = Box::of(bodies, pair.b);
+      ContactManifold manifold;
+      if(!collideBoxes(a, b, d_settings.margin, manifold)) continue;
+      manifold.a = pair.a;
+      manifold.b = pair.b;
+      manifold.key = static_cast<uint64_t>(world.handle(pair.a))<<32 | world.handle(pair.b);
+      for(uint32_t p = 0; p < manifold.count; p++){
+        glm::vec3 d = manifold.points[p].position-a.center;
+        manifold.points[p].localA = glm::vec3(glm::dot(d,a.axis[0]),glm::dot(d,a.axis[1]),glm::dot(d,a.axis[2]));
+      }
+      auto previous = std::lower_bound(d_previous.begin(), d_previous.end(), manifold.key,
+        [](const ContactManifold& m, uint64_t key){ return m.key < key; });
+      if(previous != d_previous.end() && previous->key == manifold.key){
+        manifold.tangentImpulse[0] = previous->tangentImpulse[0];
+        manifold.tangentImpulse[1] = previous->tangentImpulse[1];
+        manifold.twistImpulse = previous->twistImpulse;
+        for(uint32_t p = 0; p < manifold.count; p++){
+          ContactPoint& point = manifold.points[p];
+          for(uint32_t q = 0; q < previous->count; q++){
+            glm::vec3 d = previous->points[q].localA-point.localA;
+            if(glm::dot(d,d) > matchSquared) continue;
+            point.normalImpulse = previous->points[q].normalImpulse;
+            warmStarted[job]++;
+            break;
+          }
+        }
+      }
+      found.push_back(manifold);
+    }
+  });
+
+  d_manifolds.clear();
+  for(uint32_t j = 0; j < d_found.size(); j++){
+    d_manifolds.insert(d_manifolds.end(), d_found[j].begin(), d_found[j].end());
+    d_stats.warmStarted += warmStarted[j];
+  }
+  d_stats.manifolds = static_cast<uint32_t>(d_manifolds.size());
+  for(const ContactManifold& manifold : d_manifolds) d_stats.points += manifold.count;
+}
+
+void ContactSolver::buildIslands(const RigidBodyWorld& world){
+  const BodyArrays& bodies = world.bodies();
+  uint32_t count = world.size();
+  uint32_t manifolds = static_cast<uint32_t>(d_manifolds.size());
+  auto find = [this](uint32_t i){
+    while(d_parent[i] != i){
+      d_parent[i] = d_parent[d_parent[i]];
+      i = d_parent[i];
+    }
+    return i;
+  };
+  //static bodies join no island, a ground under everything would make one of all
+  d_parent.resize(count);
+  for(uint32_t i = 0; i < count; i++) d_parent[i] = i;
+  for(const ContactManifold& manifold : d_manifolds){
+    if(bodies.invMass[manifold.a] == 0.0f || bodies.invMass[manifold.b] == 0.0f) continue;
+    uint32_t a = find(manifold.a), b = find(manifold.b);
+    if(a != b) d_parent[std::max(a,b)] = std::min(a,b);
+  }
+
+  //manifolds grouped by island with a counting sort
+  d_islandOf.assign(count, NONE);
+  d_islands.clear();
+  std::vector<uint32_t> islandOfManifold(manifolds);
+  for(uint32_t m = 0; m < manifolds; m++){
+    const ContactManifold& manifold = d_manifolds[m];
+    uint32_t root = find(bodies.invMass[manifold.a] != 0.0f ? manifold.a : manifold.b);
+    if(d_islandOf[root] == NONE){
+      d_islandOf[root] = static_cast<uint32_t>(d_islands.size());
+      d_islands.push_back({0,0,0,0});
+    }
+    islandOfManifold[m] = d_islandOf[root];
+    d_islands[d_islandOf[root]].end++;
+  }
+  uint32_t offset = 0;
+  for(Island& island : d_islands){
+    island.begin = offset;
+    offset += island.end;
+    island.end = island.begin;
+  }
+  d_order.resize(manifolds);
+  for(uint32_t m = 0; m < manifolds; m++) d_order[d_islands[islandOfManifold[m]].end++] = m;
+
+  //islands share no dynamic body, so they color independently
+  d_bodyColors.assign(count, 0);
+  d_colorOf.resize(manifolds);
+  parallelFor(static_cast<uint32_t>(d_islands.size()), 16, [&](uint32_t, uint32_t begin, uint32_t end){
+    for(uint32_t i = begin; i < end; i++) colorIsland(bodies, i);
+  });
+
+  //batches laid out island by island and color by color, four manifolds each;
+  //the uncolored ones one each since they may share bodies with anything
+  d_colorRanges.clear();
+  uint32_t batches = 0;
+  for(Island& island : d_islands){
+    island.firstColor = static_cast<uint32_t>(d_colorRanges.size());
+    uint32_t i = island.begin;
+    for(uint32_t c = 0; c <= island.colors; c++){
+      uint32_t end = i;
+      while(end < island.end && d_colorOf[d_order[end]] == c) end++;
+      uint32_t width = c < island.colors ? WIDTH : 1;
+      uint32_t used = (end-i+width-1)/width;
+      d_colorRanges.push_back({batches,batches+used});
+      batches += used;
+      if(c == island.colors) d_stats.uncolored += end-i;
+      i = end;
+    }
+  }
+  d_batches.resize(batches);
+  for(const Island& island : d_islands){
+    uint32_t i = island.begin;
+    for(uint32_t c = 0; c <= island.colors; c++){
+      const Range& range = d_colorRanges[island.firstColor+c];
+      uint32_t width = c < island.colors ? WIDTH : 1;
+      for(uint32_t b = range.begin; b < range.end; b++){
+        for(uint32_t lane = 0; lane < WIDTH; lane++){
+          bool used = lane < width && i < island.end && d_colorOf[d_order[i]] == c;
+          d_batches[b].manifold[lane] = used ? d_order[i++] : NONE;
+        }
+      }
+    }
+  }
+}
+
+void ContactSolver::colorIsland(const BodyArrays& bodies, uint32_t index){
+  //greedy: each manifold takes the lowest color neither of its dynamic bodies has
+  Island& island = d_islands[index];
+  uint32_t colors = 0;
+  for(uint32_t i = island.begin; i < island.end; i++){
+    const ContactManifold& manifold = d_manifolds[d_order[i]];
+    bool dynamicA = bodies.invMass[manifold.a] != 0.0f, dynamicB = bodies.invMass[manifold.b] != 0.0f;
+    uint64_t used = (dynamicA ? d_bodyColors[manifold.a] : 0)|(dynamicB ? d_bodyColors[manifold.b] : 0);
+    //a manifold left uncolored means both its bodies already have every color
+    uint32_t color = 0;
+    while(color < MAX_COLORS && (used>>color)&1u) color++;
+    d_colorOf[d_order[i]] = color;
+    if(color == MAX_COLORS) continue;
+    if(dynamicA) d_bodyColors[manifold.a] |= 1ull<<color;
+    if(dynamicB) d_bodyColors[manifold.b] |= 1ull<<color;
+    colors = std::max(colors, color+1);
+  }
+  //static bodies are shared with islands colored on other threads and were never
+  //marked, only this island's dynamic bodies are cleared
+  for(uint32_t i = island.begin; i < island.end; i++){
+    const ContactManifold& manifold = d_manifolds[d_order[i]];
+    if(bodies.invMass[manifold.a] != 0.0f) d_bodyColors[manifold.a] = 0;
+    if(bodies.invMass[manifold.b] != 0.0f) d_bodyColors[manifold.b] = 0;
+  }
+  std::stable_sort(d_order.begin()+island.begin, d_order.begin()+island.end, [this](uint32_t a, uint32_t b){
+    return d_colorOf[a] < d_colorOf[b];
+  });
+  island.colors = colors;
+}
+
+void ContactSolver::prepare(const RigidBodyWorld& world, Batch& batch, float dt){
+  const BodyArrays& bodies = world.bodies();
+  Softness soft = softness(d_settings, dt);
+  uint32_t manifolds[WIDTH];
+  std::copy(batch.manifold, batch.manifold+WIDTH, manifolds);
+  batch = Batch();
+  std::copy(manifolds, manifolds+WIDTH, batch.manifold);
+  for(uint32_t lane = 0; lane < WIDTH; lane++){
+    batch.bodyA[lane] = batch.bodyB[lane] = NONE;
+    if(manifolds[lane] == NONE) continue;
+    const ContactManifold& manifold = d_manifolds[manifolds[lane]];
+    float inertia[2][6];
+    float mass[2];
+    glm::vec3 center[2];
+    uint32_t ends[2] = {manifold.a,manifold.b};
+    for(uint32_t s = 0; s < 2; s++){
+      uint32_t i = ends[s];
+      bool dynamic = bodies.invMass[i] != 0.0f;
+      (s == 0 ? batch.bodyA : batch.bodyB)[lane] = dynamic ? i : NONE;
+      mass[s] = bodies.invMass[i];
+      for(uint32_t k = 0; k < 6; k++) inertia[s][k] = dynamic ? d_inertia[k][i] : 0.0f;
+      center[s] = glm::vec3(bodies.px[i],bodies.py[i],bodies.pz[i]);
+    }
+    batch.massA[lane] = mass[0];
+    batch.massB[lane] = mass[1];
+    for(uint32_t k = 0; k < 6; k++){
+      batch.inertiaA[k][lane] = inertia[0][k];
+      batch.inertiaB[k][lane] = inertia[1][k];
+    }
+    glm::vec3 n = manifold.normal;
+    glm::vec3 t1 = tangentOf(n);
+    glm::vec3 t2 = glm::cross(n,t1);
+    batch.nx[lane] = n.x; batch.ny[lane] = n.y; batch.nz[lane] = n.z;
+    batch.t1x[lane] = t1.x; batch.t1y[lane] = t1.y; batch.t1z[lane] = t1.z;
+    batch.t2x[lane] = t2.x; batch.t2y[lane] = t2.y; batch.t2z[lane] = t2.z;
+    batch.points = std::max(batch.points, manifold.count);
+    glm::vec3 middle(0.0f);
+    for(uint32_t p = 0; p < manifold.count; p++) middle += manifold.points[p].position;
+    middle = middle*(1.0f/manifold.count);
+    float radius = 0.0f;
+    for(uint32_t p = 0; p < manifold.count; p++){
+      const ContactPoint& point = manifold.points[p];
+      Batch::Row& row = batch.rows[p];
+      glm::vec3 rA = point.position-center[0], rB = point.position-center[1];
+      row.rAx[lane] = rA.x; row.rAy[lane] = rA.y; row.rAz[lane] = rA.z;
+      row.rBx[lane] = rB.x; row.rBy[lane] = rB.y; row.rBz[lane] = rB.z;
+      //apart: may close the gap this step and no more, a hard constraint.
+      //Overlapping: a damped spring pushes apart what is past slop
+      float stiff = effectiveMass(mass, inertia, rA, rB, n);
+      if(point.separation > 0.0f){
+        row.normalMass[lane] = stiff;
+        row.bias[lane] = -point.separation/dt;
+        row.softness[lane] = 0.0f;
+      }else{
+        row.normalMass[lane] = soft.massScale*stiff;
+        row.bias[lane] = std::min(soft.biasRate*std::max(-point.separation-d_settings.slop,0.0f),
+          d_settings.maxPush);
+        row.softness[lane] = soft.impulseScale;
+      }
+      row.normalImpulse[lane] = point.normalImpulse;
+      radius += glm::length(point.position-middle)/manifold.count;
+    }
+    glm::vec3 cA = middle-center[0], cB = middle-center[1];
+    batch.cAx[lane] = cA.x; batch.cAy[lane] = cA.y; batch.cAz[lane] = cA.z;
+    batch.cBx[lane] = cB.x; batch.cBy[lane] = cB.y; batch.cBz[lane] = cB.z;
+    batch.tangentMass1[lane] = effectiveMass(mass, inertia, cA, cB, t1);
+    batch.tangentMass2[lane] = effectiveMass(mass, inertia, cA, cB, t2);
+    float turning = quadratic(inertia[0],n)+quadratic(inertia[1],n);
+    batch.twistMass[lane] = turning > 0.0f ? 1.0f/turning : 0.0f;
+    batch.radius[lane] = radius;
+    batch.tangentImpulse1[lane] = manifold.tangentImpulse[0];
+    batch.tangentImpulse2[lane] = manifold.tangentImpulse[1];
+    batch.twistImpulse[lane] = manifold.twistImpulse;
+  }
+}
+
+void ContactSolver::solveIsland(BodyArrays& bodies, uint32_t index){
+  const Island& island = d_islands[index];
+  for(uint32_t pass = 0; pass <= d_settings.iterations; pass++){
+    for(uint32_t c = 0; c <= island.colors; c++){
+      const Range& range = d_colorRanges[island.firstColor+c];
+      for(uint32_t b = range.begin; b < range.end; b++){
+        solveBatch(d_batches[b], bodies, d_settings.friction, pass == 0);
+      }
+    }
+  }
+}
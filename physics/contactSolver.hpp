@@ -0,0 +1,143 @@
+//contactSolver.hpp
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "boxCollision.hpp"
+#include "broadphase.hpp"
+#include "pairBuffer.hpp"
+#include "rigidBodyWorld.hpp"
+
+class ThreadPool;
+
+//sequential impulses over box contacts, run as a world's velocity solver:
+//  world.setVelocitySolver([&](float dt){ solver.solve(world, dt); });
+//Impulses are carried over between steps for manifolds that persist, so stacks
+//start each step close to resting. Bodies joined by contacts form islands that
+//share nothing and are solved on separate threads; islands with more than
+//Settings::largeIsland manifolds are graph colored instead, and the manifolds of
+//one color, which share no dynamic body, are solved four at a time across the
+//pool with a barrier between colors
+class ContactSolver{
+  public:
+    struct Settings{
+      uint32_t iterations = 8;
+      float friction = 0.5f;
+      //overlap past slop is pushed out by a damped spring, no faster than maxPush.
+      //A soft contact gives back a little of its impulse every iteration, which
+      //damps the rocking a stiff one builds up in tall stacks at few iterations
+      float hertz = 30.0f;
+      float dampingRatio = 1.0f;
+      float maxPush = 3.0f;
+      float slop = 0.005f;
+      //contacts are made this far apart already, so fast bodies slow down before
+      //they meet instead of after
+      float margin = 0.02f;
+      //points closer than this in body a's frame keep last step's impulses
+      float matchDistance = 0.05f;
+      uint32_t largeIsland = 256;
+    };
+    struct Stats{
+      uint32_t pairs = 0;
+      uint32_t manifolds = 0;
+      uint32_t points = 0;
+      uint32_t islands = 0;
+      uint32_t largeIslands = 0;
+      //most colors of a large island, and manifolds solved serially after them
+      //because their bodies ran out of colors
+      uint32_t colors = 0;
+      uint32_t uncolored = 0;
+      //points that found their last step's impulse
+      uint32_t warmStarted = 0;
+    };
+
+    ContactSolver();
+    explicit ContactSolver(const Settings& settings);
+
+    //jobs go to pool, null (the default) solves on the calling thread
+    void setThreadPool(ThreadPool* pool);
+    Broadphase& broadphase() { return d_broadphase; }
+    const Settings& settings() const { return d_settings; }
+
+    //finds the contacts of world's bodies and corrects their velocities
+    void solve(RigidBodyWorld& world, float dt);
+    //the last solve's manifolds with their impulses, ordered by key
+    const std::vector<ContactManifold>& manifolds() const { return d_previous; }
+    const Stats& stats() const { return d_stats; }
+
+  private:
+    static const uint32_t WIDTH = 4;
+    static constexpr uint32_t NONE = UINT32_MAX;
+    //four manifolds of one color side by side, one lane each. Static bodies and
+    //unused lanes read zero velocity and are never written
+    struct Batch{
+      uint32_t manifold[WIDTH];
+      uint32_t bodyA[WIDTH];
+      uint32_t bodyB[WIDTH];
+      uint32_t points;
+      float nx[WIDTH], ny[WIDTH], nz[WIDTH];
+      float t1x[WIDTH], t1y[WIDTH], t1z[WIDTH];
+      float t2x[WIDTH], t2y[WIDTH], t2z[WIDTH];
+      float massA[WIDTH], massB[WIDTH];
+      //world inverse inertia, symmetric: xx xy xz yy yz zz
+      float inertiaA[6][WIDTH], inertiaB[6][WIDTH];
+      //friction at the center of the points, the twist limited by their spread
+      float cAx[WIDTH], cAy[WIDTH], cAz[WIDTH];
+      float cBx[WIDTH], cBy[WIDTH], cBz[WIDTH];
+      float tangentMass1[WIDTH], tangentMass2[WIDTH], twistMass[WIDTH], radius[WIDTH];
+      float tangentImpulse1[WIDTH], tangentImpulse2[WIDTH], twistImpulse[WIDTH];
+      struct Row{
+        float rAx[WIDTH], rAy[WIDTH], rAz[WIDTH];
+        float rBx[WIDTH], rBy[WIDTH], rBz[WIDTH];
+        //normal mass is scaled down and softness of the accumulated impulse taken
+        //off each iteration for overlapping points
+        float normalMass[WIDTH], bias[WIDTH], softness[WIDTH], normalImpulse[WIDTH];
+      } rows[4];
+    };
+    struct Island{
+      //into d_order, manifolds of the island
+      uint32_t begin;
+      uint32_t end;
+      //into d_colorRanges, the island's colors then its uncolored manifolds
+      uint32_t colors;
+      uint32_t firstColor;
+    };
+    struct Range{
+      uint32_t begin;
+      uint32_t end;
+    };
+
+    Settings d_settings;
+    Stats d_stats;
+    ThreadPool* d_pool = nullptr;
+    Broadphase d_broadphase;
+    PairBuffer d_pairs;
+    //one per narrowphase job, joined afterwards
+    std::vector<std::vector<ContactManifold>> d_found;
+    std::vector<ContactManifold> d_manifolds;
+    std::vector<ContactManifold> d_previous;
+    //world inverse inertia of every body, xx xy xz yy yz zz
+    std::vector<float> d_inertia[6];
+    //union find over bodies, then islands and their manifolds grouped in d_order
+    std::vector<uint32_t> d_parent;
+    std::vector<uint32_t> d_islandOf;
+    std::vector<uint32_t> d_order;
+    std::vector<Island> d_islands;
+    //colors in use around each body while coloring
+    std::vector<uint64_t> d_bodyColors;
+    std::vector<uint32_t> d_colorOf;
+    //into d_batches per color of every island; uncolored ones hold one manifold a batch
+    std::vector<Range> d_colorRanges;
+    std::vector<Batch> d_batches;
+
+    //body(job,begin,end) over count items in jobs of at least grain items, on the
+    //pool when there is one
+    template<typename Body>
+    void parallelFor(uint32_t count, uint32_t grain, Body body);
+    void findContacts(const RigidBodyWorld& world);
+    void buildIslands(const RigidBodyWorld& world);
+    void colorIsland(const BodyArrays& bodies, uint32_t island);
+    void prepare(const RigidBodyWorld& world, Batch& batch, float dt);
+    void solveIsland(BodyArrays& bodies, uint32_t island);
+};
@@ -0,0 +1,26 @@
+//pairBuffer.hpp
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//two bodies by their index in the world's arrays, a < b
+struct BodyPair{
+  uint32_t a;
+  uint32_t b;
+};
+
+//where a broadphase writes the pairs whose bounds overlap. Every update clears it
+//without freeing, so after the first few frames no update allocates
+class PairBuffer{
+  public:
+    void clear(){ d_pairs.clear(); }
+    void add(uint32_t a, uint32_t b){ d_pairs.push_back(a < b ? BodyPair{a,b} : BodyPair{b,a}); }
+    size_t size() const { return d_pairs.size(); }
+    bool empty() const { return d_pairs.empty(); }
+    const BodyPair& operator[](size_t i) const { return d_pairs[i]; }
+    const std::vector<BodyPair>& pairs() const { return d_pairs; }
+
+  private:
+    std::vector<BodyPair> d_pairs;
+};
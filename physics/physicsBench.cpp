@@ -0,0 +1,328 @@
+//physicsBench.cpp
+//physics throughput without a renderer. --integrate <bodies> steps that many bodies
+//with every integrator the build supports and reports bodies integrated per second
+//on one core. --broadphase <bodies> times both broadphase strategies over a moving
+//field of that many bodies. --stack <boxes> solves contacts of brick walls with 1
+//to --threads threads and reports the scaling curve. Results go to --out as json.
+#include "broadphase.hpp"
+#include "contactSolver.hpp"
+#include "rigidBodyWorld.hpp"
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct PhysicsBenchOptions{
+  uint32_t integrate = 0;
+  uint32_t broadphase = 0;
+  uint32_t stack = 0;
+  uint32_t threads = 32;
+  uint32_t steps = 200;
+  std::string output = "physics_bench.json";
+};
+
+static double millisecondsSince(Clock::time_point start){
+  return std::chrono::duration<double,std::milli>(Clock::now()-start).count();
+}
+
+struct IntegrationResult{
+  std::string integrator;
+  double ms = 0.0;
+  double bodiesPerSecond = 0.0;
+};
+
+//a cloud of spinning boxes, one in 16 static, integrated for options.steps fixed
+//steps on this thread with a force on every body each step
+static std::vector<IntegrationResult> runIntegration(const PhysicsBenchOptions& options){
+  std::vector<IntegrationResult> results;
+  const std::pair<RigidBodyWorld::Integrator,const char*> integrators[] = {
+    {RigidBodyWorld::Integrator::Scalar,"scalar"},{RigidBodyWorld::Integrator::SSE,"sse"},
+    {RigidBodyWorld::Integrator::AVX,"avx"}};
+  for(const auto& integrator : integrators){
+    if(!RigidBodyWorld::supported(integrator.first)) continue;
+    RigidBodyWorld world;
+    world.setIntegrator(integrator.first);
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.0f,1.0f);
+    for(uint32_t i = 0; i < options.integrate; i++){
+      RigidBodyWorld::BodyDesc body;
+      body.position = glm::vec3(unit(random),unit(random),unit(random))*100.0f;
+      body.velocity = glm::vec3(unit(random),unit(random),unit(random));
+      body.angularVelocity = glm::vec3(unit(random),unit(random),unit(random));
+      body.halfExtents = glm::vec3(0.5f,0.25f+0.25f*unit(random)*unit(random),0.5f);
+      body.mass = i%16 == 0 ? 0.0f : 1.0f;
+      world.add(body);
+    }
+    BodyArrays& bodies = world.bodies();
+    IntegrationResult result;
+    result.integrator = integrator.second;
+    auto start = Clock::now();
+    for(uint32_t s = 0; s < options.steps; s++){
+      //what the solver would leave behind, written as a pass over the arrays
+      std::fill(bodies.fy.begin(),bodies.fy.begin()+world.size(),1.0f);
+      std::fill(bodies.tz.begin(),bodies.tz.begin()+world.size(),0.01f);
+      world.step();
+    }
+    result.ms = millisecondsSince(start);
+    result.bodiesPerSecond = static_cast<double>(options.integrate)*options.steps/(result.ms/1000.0);
+    results.push_back(result);
+  }
+  return results;
+}
+
+struct BroadphaseResult{
+  std::string strategy;
+  //the first update builds from nothing, later ones can reuse the last
+  double buildMs = 0.0;
+  double updateMs = 0.0;
+  double pairs = 0.0;
+  //sweep and prune: endpoint moves per update, spatial hash: cell entries
+  double work = 0.0;
+};
+
+//debris scattered over a wide flat field, four units of ground per body and four
+//high, tumbling in zero gravity so bounds move a little every step. Both
+//strategies see the same motion, the update time excludes the integration
+static std::vector<BroadphaseResult> runBroadphase(const PhysicsBenchOptions& options, uint32_t updates){
+  std::vector<BroadphaseResult> results;
+  const std::pair<Broadphase::Strategy,const char*> strategies[] = {
+    {Broadphase::Strategy::SweepAndPrune,"sweepAndPrune"},{Broadphase::Strategy::SpatialHash,"spatialHash"}};
+  for(const auto& strategy : strategies){
+    RigidBodyWorld::Settings settings;
+    settings.gravity = glm::vec3(0.0f);
+    RigidBodyWorld world(settings);
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> unit(0.0f,1.0f);
+    float side = std::sqrt(4.0f*options.broadphase);
+    for(uint32_t i = 0; i < options.broadphase; i++){
+      RigidBodyWorld::BodyDesc body;
+      body.position = glm::vec3(unit(random)*side,unit(random)*4.0f,unit(random)*side);
+      body.velocity = glm::vec3(unit(random)-0.5f,unit(random)-0.5f,unit(random)-0.5f);
+      body.angularVelocity = glm::vec3(unit(random),unit(random),unit(random));
+      body.halfExtents = glm::vec3(0.25f+0.25f*unit(random),0.25f+0.25f*unit(random),0.25f+0.25f*unit(random));
+      world.add(body);
+    }
+    Broadphase broadphase;
+    broadphase.setStrategy(strategy.first);
+    PairBuffer pairs;
+    BroadphaseResult result;
+    result.strategy = strategy.second;
+    auto start = Clock::now();
+    broadphase.update(world, pairs);
+    result.buildMs = millisecondsSince(start);
+    double ms = 0.0;
+    for(uint32_t u = 0; u < updates; u++){
+      world.step();
+      start = Clock::now();
+      broadphase.update(world, pairs);
+      ms += millisecondsSince(start);
+      result.pairs += static_cast<double>(pairs.size());
+      result.work += strategy.first == Broadphase::Strategy::SweepAndPrune
+        ? static_cast<double>(broadphase.sweepAndPrune().stats().swaps)
+        : static_cast<double>(broadphase.spatialHash().stats().entries);
+    }
+    result.updateMs = ms/updates;
+    result.pairs /= updates;
+    result.work /= updates;
+    results.push_back(result);
+  }
+  return results;
+}
+
+struct StackResult{
+  uint32_t threads = 0;
+  double stepMs = 0.0;
+  double speedup = 1.0;
+  //how far the bricks that moved most got from where they were built
+  double maxDrift = 0.0;
+  uint32_t toppled = 0;
+  ContactSolver::Stats stats;
+};
+
+//walls of 20 courses of bricks standing on a static ground, as many as make up
+//boxes. Courses alternate between 25 and 24 bricks shifted by half a brick, with
+//a gap between neighbours so each brick rests on the two below it. Every thread
+//count solves the same scene from the start: a few steps to settle and warm the
+//caches of impulses, then steps timed whole, integration included
+static std::vector<StackResult> runStack(const PhysicsBenchOptions& options, uint32_t steps){
+  const uint32_t WIDE = 25, HIGH = 20;
+  const uint32_t WARMUP = 10;
+  const glm::vec3 BRICK(0.5f,0.25f,0.5f);
+  const float GAP = 0.05f;
+  const float LENGTH = WIDE*(2.0f*BRICK.x+GAP);
+  uint32_t walls = std::max(1u,options.stack/(WIDE*HIGH-HIGH/2));
+  uint32_t rows = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(walls))));
+  std::vector<StackResult> results;
+  for(uint32_t threads : {1u,2u,4u,8u,16u,24u,32u}){
+    if(threads > options.threads) break;
+    RigidBodyWorld world;
+    RigidBodyWorld::BodyDesc ground;
+    ground.halfExtents = glm::vec3(rows*(LENGTH+5.0f)*0.5f+5.0f,0.5f,rows*3*0.5f+5.0f);
+    ground.position = glm::vec3(ground.halfExtents.x-5.0f,-0.5f,ground.halfExtents.z-5.0f);
+    ground.mass = 0.0f;
+    world.add(ground);
+    std::vector<glm::vec3> built;
+    for(uint32_t w = 0; w < walls; w++){
+      glm::vec3 corner((w%rows)*(LENGTH+5.0f),0.0f,(w/rows)*3.0f);
+      for(uint32_t y = 0; y < HIGH; y++){
+        float shift = y%2 == 0 ? 0.0f : BRICK.x+0.5f*GAP;
+        for(uint32_t x = 0; x < WIDE-y%2; x++){
+          RigidBodyWorld::BodyDesc brick;
+          brick.halfExtents = BRICK;
+          brick.position = corner+glm::vec3(shift+x*(2.0f*BRICK.x+GAP)+BRICK.x,(2*y+1)*BRICK.y,BRICK.z);
+          world.add(brick);
+          built.push_back(brick.position);
+        }
+      }
+    }
+    std::unique_ptr<ThreadPool> pool;
+    if(threads > 1) pool.reset(new ThreadPool(threads));
+    ContactSolver solver;
+    solver.setThreadPool(pool.get());
+    world.setVelocitySolver([&](float dt){ solver.solve(world, dt); });
+    for(uint32_t s = 0; s < WARMUP; s++) world.step();
+
+    StackResult result;
+    result.threads = threads;
+    auto start = Clock::now();
+    for(uint32_t s = 0; s < steps; s++) world.step();
+    result.stepMs = millisecondsSince(start)/steps;
+    result.stats = solver.stats();
+    const BodyArrays& bodies = world.bodies();
+    for(uint32_t i = 1; i < world.size(); i++){
+      double drift = glm::length(glm::vec3(bodies.px[i],bodies.py[i],bodies.pz[i])-built[i-1]);
+      result.maxDrift = std::max(result.maxDrift,drift);
+      if(drift > 0.5) result.toppled++;
+    }
+    if(!results.empty()) result.speedup = results.front().stepMs/result.stepMs;
+    results.push_back(result);
+  }
+  return results;
+}
+
+static std::ofstream openOutput(const std::string& file){
+  std::filesystem::path output(file);
+  if(output.has_parent_path()) std::filesystem::create_directories(output.parent_path());
+  return std::ofstream(file);
+}
+
+int main(int argc, char** argv){
+  PhysicsBenchOptions options;
+  for(int i = 1; i<argc; i++){
+    std::string arg = argv[i];
+    bool hasValue = i+1<argc;
+    if(arg=="--integrate" && hasValue) options.integrate = std::stoul(argv[++i]);
+    else if(arg=="--broadphase" && hasValue) options.broadphase = std::stoul(argv[++i]);
+    else if(arg=="--stack" && hasValue) options.stack = std::stoul(argv[++i]);
+    else if(arg=="--threads" && hasValue) options.threads = std::stoul(argv[++i]);
+    else if(arg=="--steps" && hasValue) options.steps = std::stoul(argv[++i]);
+    else if(arg=="--out" && hasValue) options.output = argv[++i];
+    else{
+      std::cerr<<"usage: physics_bench [--integrate bodies] [--broadphase bodies] [--stack boxes] [--threads n]"
+        " [--steps n] [--out file.json]"<<std::endl;
+      return 2;
+    }
+  }
+  if(options.stack>0){
+    //a quarter of the integration steps, enough for the solver to reach steady state
+    uint32_t steps = std::max(1u,options.steps/4);
+    std::vector<StackResult> results;
+    try{
+      results = runStack(options,steps);
+    }catch(const std::exception& e){
+      std::cerr<<"benchmark failed: "<<e.what()<<std::endl;
+      return 1;
+    }
+    std::ofstream out = openOutput(options.output);
+    out<<"{\n  \"boxes\": "<<options.stack<<", \"steps\": "<<steps
+      <<", \"hardwareThreads\": "<<std::thread::hardware_concurrency()<<",\n  \"scaling\": [";
+    for(size_t i = 0; i<results.size(); i++){
+      const StackResult& result = results[i];
+      const ContactSolver::Stats& stats = result.stats;
+      std::cout<<"stack "<<result.threads<<" threads: "<<result.stepMs<<" ms per step, "<<result.speedup
+        <<"x, "<<stats.manifolds<<" manifolds in "<<stats.islands<<" islands ("<<stats.largeIslands
+        <<" colored, "<<stats.colors<<" colors), "<<result.toppled<<" toppled"<<std::endl;
+      out<<(i==0 ? "\n" : ",\n")<<"    {\"threads\": "<<result.threads<<", \"stepMs\": "<<result.stepMs
+        <<", \"speedup\": "<<result.speedup<<", \"manifolds\": "<<stats.manifolds<<", \"points\": "<<stats.points
+        <<", \"warmStarted\": "<<stats.warmStarted<<", \"islands\": "<<stats.islands
+        <<", \"largeIslands\": "<<stats.largeIslands<<", \"colors\": "<<stats.colors
+        <<", \"uncolored\": "<<stats.uncolored<<", \"maxDrift\": "<<result.maxDrift
+        <<", \"toppled\": "<<result.toppled<<"}";
+    }
+    out<<"\n  ]\n}\n";
+    if(!out.good()){
+      std::cerr<<"failed to write "<<options.output<<std::endl;
+      return 1;
+    }
+    std::cout<<"results written to "<<options.output<<std::endl;
+    return 0;
+  }
+  if(options.broadphase>0){
+    //a tenth of the integration steps, each update is worth far more
+    uint32_t updates = std::max(1u,options.steps/10);
+    std::vector<BroadphaseResult> results;
+    try{
+      results = runBroadphase(options,updates);
+    }catch(const std::exception& e){
+      std::cerr<<"benchmark failed: "<<e.what()<<std::endl;
+      return 1;
+    }
+    std::ofstream out = openOutput(options.output);
+    out<<"{\n  \"bodies\": "<<options.broadphase<<", \"updates\": "<<updates<<",\n  \"broadphase\": [";
+    for(size_t i = 0; i<results.size(); i++){
+      const BroadphaseResult& result = results[i];
+      std::cout<<"broadphase "<<result.strategy<<" "<<options.broadphase<<" bodies: "<<result.updateMs
+        <<" ms per update, "<<result.buildMs<<" ms first, "<<result.pairs<<" pairs"<<std::endl;
+      out<<(i==0 ? "\n" : ",\n")<<"    {\"strategy\": \""<<result.strategy<<"\", \"buildMs\": "<<result.buildMs
+        <<", \"updateMs\": "<<result.updateMs<<", \"pairs\": "<<result.pairs<<", \"work\": "<<result.work<<"}";
+    }
+    out<<"\n  ]\n}\n";
+    if(!out.good()){
+      std::cerr<<"failed to write "<<options.output<<std::endl;
+      return 1;
+    }
+    std::cout<<"results written to "<<options.output<<std::endl;
+    return 0;
+  }
+  if(options.integrate==0){
+    std::cerr<<"nothing to run, pass --integrate, --broadphase or --stack"<<std::endl;
+    return 2;
+  }
+
+  std::vector<IntegrationResult> results;
+  try{
+    results = runIntegration(options);
+  }catch(const std::exception& e){
+    std::cerr<<"benchmark failed: "<<e.what()<<std::endl;
+    return 1;
+  }
+  std::ofstream out = openOutput(options.output);
+  out<<"{\n  \"bodies\": "<<options.integrate<<", \"steps\": "<<options.steps<<",\n  \"integration\": [";
+  for(size_t i = 0; i<results.size(); i++){
+    const IntegrationResult& result = results[i];
+    std::cout<<"integrate "<<result.integrator<<": "<<result.bodiesPerSecond/1e6<<" M bodies/s per core, "
+      <<result.ms<<" ms"<<std::endl;
+    out<<(i==0 ? "\n" : ",\n")<<"    {\"integrator\": \""<<result.integrator<<"\", \"ms\": "<<result.ms
+      <<", \"bodiesPerSecond\": "<<result.bodiesPerSecond<<"}";
+  }
+  out<<"\n  ]\n}\n";
+  if(!out.good()){
+    std::cerr<<"failed to write "<<options.output<<std::endl;
+    return 1;
+  }
+  std::cout<<"results written to "<<options.output<<std::endl;
+  return 0;
+}
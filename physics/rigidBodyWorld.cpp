@@ -0,0 +1,386 @@
+//rigidBodyWorld.cpp
+#include "rigidBodyWorld.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "simdLanes.hpp"
+
+namespace{
+
+struct StepConstants{
+  float dt;
+  glm::vec3 gravity;
+  float linearScale;
+  float angularScale;
+};
+
+//v' = R(I^-1 (R^T v)) for the inverse inertia diagonal in the body frame of q
+template<typename L>
+inline void applyInverseInertia(typename L::V qx, typename L::V qy, typename L::V qz, typename L::V qw,
+    typename L::V ix, typename L::V iy, typename L::V iz,
+    typename L::V& x, typename L::V& y, typename L::V& z){
+  using V = typename L::V;
+  V two = L::set(2.0f);
+  //rotating by q: t = 2 (q.xyz x v), v + w t + q.xyz x t, conjugate first
+  auto rotate = [&](V sx, V sy, V sz, V& vx, V& vy, V& vz){
+    V tx = L::mul(two,L::sub(L::mul(sy,vz),L::mul(sz,vy)));
+    V ty = L::mul(two,L::sub(L::mul(sz,vx),L::mul(sx,vz)));
+    V tz = L::mul(two,L::sub(L::mul(sx,vy),L::mul(sy,vx)));
+    V rx = L::add(L::add(vx,L::mul(qw,tx)),L::sub(L::mul(sy,tz),L::mul(sz,ty)));
+    V ry = L::add(L::add(vy,L::mul(qw,ty)),L::sub(L::mul(sz,tx),L::mul(sx,tz)));
+    V rz = L::add(L::add(vz,L::mul(qw,tz)),L::sub(L::mul(sx,ty),L::mul(sy,tx)));
+    vx = rx; vy = ry; vz = rz;
+  };
+  V zero = L::set(0.0f);
+  rotate(L::sub(zero,qx),L::sub(zero,qy),L::sub(zero,qz),x,y,z);
+  x = L::mul(x,ix);
+  y = L::mul(y,iy);
+  z = L::mul(z,iz);
+  rotate(qx,qy,qz,x,y,z);
+}
+
+//velocities from forces and gravity, then poses from velocities; a solver
+//correcting velocities runs between the two halves
+template<typename L, bool VELOCITIES, bool POSITIONS>
+void integrateLanes(BodyArrays& b, uint32_t count, const StepConstants& c){
+  using V = typename L::V;
+  V dt = L::set(c.dt);
+  V halfDt = L::set(0.5f*c.dt);
+  V gx = L::set(c.gravity.x*c.dt);
+  V gy = L::set(c.gravity.y*c.dt);
+  V gz = L::set(c.gravity.z*c.dt);
+  V linearScale = L::set(c.linearScale);
+  V angularScale = L::set(c.angularScale);
+  V one = L::set(1.0f);
+  for(uint32_t i = 0; i < count; i += L::width){
+    V qx = L::load(&b.qx[i]);
+    V qy = L::load(&b.qy[i]);
+    V qz = L::load(&b.qz[i]);
+    V qw = L::load(&b.qw[i]);
+    V vx, vy, vz, wx, wy, wz;
+    if(VELOCITIES){
+      V invMass = L::load(&b.invMass[i]);
+      V dynamic = L::positive(invMass);
+      V imdt = L::mul(invMass,dt);
+      vx = L::mul(L::add(L::load(&b.vx[i]),L::add(L::mul(L::load(&b.fx[i]),imdt),L::mul(gx,dynamic))),linearScale);
+      vy = L::mul(L::add(L::load(&b.vy[i]),L::add(L::mul(L::load(&b.fy[i]),imdt),L::mul(gy,dynamic))),linearScale);
+      vz = L::mul(L::add(L::load(&b.vz[i]),L::add(L::mul(L::load(&b.fz[i]),imdt),L::mul(gz,dynamic))),linearScale);
+      L::store(&b.vx[i],vx);
+      L::store(&b.vy[i],vy);
+      L::store(&b.vz[i],vz);
+      V ax = L::mul(L::load(&b.tx[i]),dt);
+      V ay = L::mul(L::load(&b.ty[i]),dt);
+      V az = L::mul(L::load(&b.tz[i]),dt);
+      applyInverseInertia<L>(qx,qy,qz,qw,L::load(&b.ix[i]),L::load(&b.iy[i]),L::load(&b.iz[i]),ax,ay,az);
+      wx = L::mul(L::add(L::load(&b.wx[i]),ax),angularScale);
+      wy = L::mul(L::add(L::load(&b.wy[i]),ay),angularScale);
+      wz = L::mul(L::add(L::load(&b.wz[i]),az),angularScale);
+      L::store(&b.wx[i],wx);
+      L::store(&b.wy[i],wy);
+      L::store(&b.wz[i],wz);
+    }else{
+      vx = L::load(&b.vx[i]);
+      vy = L::load(&b.vy[i]);
+      vz = L::load(&b.vz[i]);
+      wx = L::load(&b.wx[i]);
+      wy = L::load(&b.wy[i]);
+      wz = L::load(&b.wz[i]);
+    }
+    if(!POSITIONS) continue;
+
+    V px = L::load(&b.px[i]);
+    V py = L::load(&b.py[i]);
+    V pz = L::load(&b.pz[i]);
+    L::store(&b.ox[i],px);
+    L::store(&b.oy[i],py);
+    L::store(&b.oz[i],pz);
+    L::store(&b.px[i],L::add(px,L::mul(vx,dt)));
+    L::store(&b.py[i],L::add(py,L::mul(vy,dt)));
+    L::store(&b.pz[i],L::add(pz,L::mul(vz,dt)));
+
+    //q += dt/2 (w,0) q, then back onto the unit sphere
+    V nx = L::add(qx,L::mul(halfDt,L::add(L::mul(wx,qw),L::sub(L::mul(wy,qz),L::mul(wz,qy)))));
+    V ny = L::add(qy,L::mul(halfDt,L::add(L::mul(wy,qw),L::sub(L::mul(wz,qx),L::mul(wx,qz)))));
+    V nz = L::add(qz,L::mul(halfDt,L::add(L::mul(wz,qw),L::sub(L::mul(wx,qy),L::mul(wy,qx)))));
+    V nw = L::sub(qw,L::mul(halfDt,L::add(L::add(L::mul(wx,qx),L::mul(wy,qy)),L::mul(wz,qz))));
+    V length = L::sqrt(L::add(L::add(L::mul(nx,nx),L::mul(ny,ny)),L::add(L::mul(nz,nz),L::mul(nw,nw))));
+    V inverse = L::div(one,length);
+    L::store(&b.qx[i],L::mul(nx,inverse));
+    L::store(&b.qy[i],L::mul(ny,inverse));
+    L::store(&b.qz[i],L::mul(nz,inverse));
+    L::store(&b.qw[i],L::mul(nw,inverse));
+  }
+}
+
+template<typename L>
+void integrateWith(BodyArrays& b, uint32_t count, const StepConstants& c, bool velocities, bool positions){
+  if(velocities && positions) integrateLanes<L,true,true>(b,count,c);
+  else if(velocities) integrateLanes<L,true,false>(b,count,c);
+  else if(positions) integrateLanes<L,false,true>(b,count,c);
+}
+
+}
+
+std::array<std::vector<float>*,29> BodyArrays::arrays(){
+  return {{&px,&py,&pz,&ox,&oy,&oz,&vx,&vy,&vz,&fx,&fy,&fz,
+    &qx,&qy,&qz,&qw,&wx,&wy,&wz,&tx,&ty,&tz,&invMass,&ix,&iy,&iz,&hx,&hy,&hz}};
+}
+
+void BodyArrays::resize(uint32_t count){
+  for(std::vector<float>* array : arrays()){
+    array->resize(count,0.0f);
+  }
+}
+
+void BodyArrays::clear(uint32_t i){
+  for(std::vector<float>* array : arrays()){
+    (*array)[i] = 0.0f;
+  }
+  qw[i] = 1.0f;
+}
+
+void BodyArrays::move(uint32_t from, uint32_t to){
+  for(std::vector<float>* array : arrays()){
+    (*array)[to] = (*array)[from];
+  }
+}
+
+RigidBodyWorld::BodyDesc RigidBodyWorld::BodyDesc::fromBounds(const Aabb& bounds, float mass){
+  if(bounds.empty()) throw std::invalid_argument("body from empty bounds");
+  BodyDesc body;
+  body.position = bounds.center();
+  body.halfExtents = bounds.halfExtents();
+  body.mass = mass;
+  return body;
+}
+
+RigidBodyWorld::RigidBodyWorld() : RigidBodyWorld(Settings()){}
+
+RigidBodyWorld::RigidBodyWorld(const Settings& settings) : d_settings(settings){
+  if(!(settings.fixedStep > 0.0f)) throw std::invalid_argument("fixed step must be positive");
+  if(d_settings.planar) d_settings.gravity.z = 0.0f;
+  d_integrator = supported(Integrator::AVX) ? Integrator::AVX
+    : supported(Integrator::SSE) ? Integrator::SSE : Integrator::Scalar;
+}
+
+RigidBodyWorld::Handle RigidBodyWorld::add(const BodyDesc& body){
+  if(body.mass < 0.0f) throw std::invalid_argument("negative body mass");
+  uint32_t i = d_count++;
+  d_version++;
+  if(i % LANES == 0){
+    //a new register of bodies, inert past the one added
+    uint32_t padded = i+LANES;
+    uint32_t old = static_cast<uint32_t>(d_bodies.px.size());
+    if(padded > old){
+      d_bodies.resize(padded);
+      for(uint32_t j = old; j < padded; j++) d_bodies.clear(j);
+    }
+  }
+  BodyArrays& b = d_bodies;
+  glm::vec3 p = body.position;
+  glm::quat q = glm::normalize(body.orientation);
+  glm::vec3 v = body.velocity;
+  glm::vec3 w = body.angularVelocity;
+  if(d_settings.planar){
+    //a rotation about z that keeps q's heading
+    p.z = 0.0f;
+    v.z = 0.0f;
+    w = glm::vec3(0.0f,0.0f,w.z);
+    float yaw = std::atan2(2.0f*(q.w*q.z+q.x*q.y),1.0f-2.0f*(q.y*q.y+q.z*q.z));
+    q = glm::quat(std::cos(0.5f*yaw),0.0f,0.0f,std::sin(0.5f*yaw));
+  }
+  b.clear(i);
+  b.px[i] = b.ox[i] = p.x;
+  b.py[i] = b.oy[i] = p.y;
+  b.pz[i] = b.oz[i] = p.z;
+  b.qx[i] = q.x; b.qy[i] = q.y; b.qz[i] = q.z; b.qw[i] = q.w;
+  b.hx[i] = body.halfExtents.x; b.hy[i] = body.halfExtents.y; b.hz[i] = body.halfExtents.z;
+  if(body.mass > 0.0f){
+    b.vx[i] = v.x; b.vy[i] = v.y; b.vz[i] = v.z;
+    b.wx[i] = w.x; b.wy[i] = w.y; b.wz[i] = w.z;
+    b.invMass[i] = 1.0f/body.mass;
+    //solid box: I = m/3 (b^2+c^2) for half extents b and c
+    glm::vec3 h2 = body.halfExtents*body.halfExtents;
+    auto inverseInertia = [&](float sum){ return sum > 0.0f ? 3.0f/(body.mass*sum) : 0.0f; };
+    b.ix[i] = inverseInertia(h2.y+h2.z);
+    b.iy[i] = inverseInertia(h2.x+h2.z);
+    b.iz[i] = inverseInertia(h2.x+h2.y);
+    if(d_settings.planar) b.ix[i] = b.iy[i] = 0.0f;
+  }
+
+  Handle handle;
+  if(!d_freeHandles.empty()){
+    handle = d_freeHandles.back();
+    d_freeHandles.pop_back();
+  }else{
+    d_slots.push_back(0);
+    handle = static_cast<Handle>(d_slots.size());
+  }
+  d_slots[handle-1] = i;
+  d_handles.push_back(handle);
+  return handle;
+}
+
+void RigidBodyWorld::remove(Handle handle){
+  uint32_t i = checkedIndex(handle);
+  uint32_t last = --d_count;
+  d_version++;
+  if(i != last){
+    d_bodies.move(last,i);
+    d_handles[i] = d_handles[last];
+    d_slots[d_handles[i]-1] = i;
+  }
+  d_bodies.clear(last);
+  d_handles.pop_back();
+  d_slots[handle-1] = UINT32_MAX;
+  d_freeHandles.push_back(handle);
+}
+
+bool RigidBodyWorld::contains(Handle handle) const{
+  return handle > 0 && handle <= d_slots.size() && d_slots[handle-1] != UINT32_MAX;
+}
+
+uint32_t RigidBodyWorld::index(Handle handle) const{
+  return checkedIndex(handle);
+}
+
+uint32_t RigidBodyWorld::checkedIndex(Handle handle) const{
+  if(!contains(handle)) throw std::logic_error("invalid rigid body handle");
+  return d_slots[handle-1];
+}
+
+glm::vec3 RigidBodyWorld::position(Handle handle) const{
+  uint32_t i = checkedIndex(handle);
+  return glm::vec3(d_bodies.px[i],d_bodies.py[i],d_bodies.pz[i]);
+}
+
+glm::quat RigidBodyWorld::orientation(Handle handle) const{
+  uint32_t i = checkedIndex(handle);
+  return glm::quat(d_bodies.qw[i],d_bodies.qx[i],d_bodies.qy[i],d_bodies.qz[i]);
+}
+
+glm::vec3 RigidBodyWorld::velocity(Handle handle) const{
+  uint32_t i = checkedIndex(handle);
+  return glm::vec3(d_bodies.vx[i],d_bodies.vy[i],d_bodies.vz[i]);
+}
+
+void RigidBodyWorld::setVelocity(Handle handle, glm::vec3 velocity){
+  uint32_t i = checkedIndex(handle);
+  if(d_bodies.invMass[i] == 0.0f) return;
+  d_bodies.vx[i] = velocity.x;
+  d_bodies.vy[i] = velocity.y;
+  d_bodies.vz[i] = d_settings.planar ? 0.0f : velocity.z;
+}
+
+void RigidBodyWorld::addForce(Handle handle, glm::vec3 force){
+  uint32_t i = checkedIndex(handle);
+  d_bodies.fx[i] += force.x;
+  d_bodies.fy[i] += force.y;
+  if(!d_settings.planar) d_bodies.fz[i] += force.z;
+}
+
+void RigidBodyWorld::addTorque(Handle handle, glm::vec3 torque){
+  uint32_t i = checkedIndex(handle);
+  if(!d_settings.planar){
+    d_bodies.tx[i] += torque.x;
+    d_bodies.ty[i] += torque.y;
+  }
+  d_bodies.tz[i] += torque.z;
+}
+
+bool RigidBodyWorld::supported(Integrator integrator){
+  switch(integrator){
+    case Integrator::Scalar: return true;
+#ifdef PHYSICS_HAS_SSE
+    case Integrator::SSE: return true;
+#endif
+#ifdef PHYSICS_HAS_AVX
+    case Integrator::AVX: return true;
+#endif
+    default: return false;
+  }
+}
+
+void RigidBodyWorld::setIntegrator(Integrator integrator){
+  if(!supported(integrator)) throw std::invalid_argument("integrator not compiled into this build");
+  d_integrator = integrator;
+}
+
+uint32_t RigidBodyWorld::advance(double seconds){
+  d_accumulator += seconds;
+  uint32_t steps = 0;
+  while(d_accumulator >= d_settings.fixedStep && steps < d_settings.maxSteps){
+    step();
+    d_accumulator -= d_settings.fixedStep;
+    steps++;
+  }
+  //too far behind to catch up, keep at most one step of it
+  if(d_accumulator >= d_settings.fixedStep) d_accumulator = std::fmod(d_accumulator,d_settings.fixedStep);
+  return steps;
+}
+
+void RigidBodyWorld::setVelocitySolver(VelocitySolver solver){
+  d_velocitySolver = std::move(solver);
+}
+
+void RigidBodyWorld::step(){
+  float dt = d_settings.fixedStep;
+  if(d_velocitySolver){
+    integrate(dt,true,false);
+    d_velocitySolver(dt);
+    //solvers work in 3D, planar worlds drop what they added out of the plane
+    if(d_settings.planar){
+      BodyArrays& b = d_bodies;
+      for(uint32_t i = 0; i < d_count; i++) b.vz[i] = b.wx[i] = b.wy[i] = 0.0f;
+    }
+    integrate(dt,false,true);
+  }else{
+    integrate(dt,true,true);
+  }
+  clearForces();
+}
+
+void RigidBodyWorld::integrate(float dt){
+  integrate(dt,true,true);
+}
+
+void RigidBodyWorld::integrate(float dt, bool velocities, bool positions){
+  StepConstants constants;
+  constants.dt = dt;
+  constants.gravity = d_settings.gravity;
+  constants.linearScale = 1.0f/(1.0f+dt*d_settings.linearDamping);
+  constants.angularScale = 1.0f/(1.0f+dt*d_settings.angularDamping);
+  //padding makes the count a whole number of registers for every width
+  uint32_t count = (d_count+LANES-1)/LANES*LANES;
+  switch(d_integrator){
+#ifdef PHYSICS_HAS_AVX
+    case Integrator::AVX: integrateWith<AVXLanes>(d_bodies,count,constants,velocities,positions); break;
+#endif
+#ifdef PHYSICS_HAS_SSE
+    case Integrator::SSE: integrateWith<SSELanes>(d_bodies,count,constants,velocities,positions); break;
+#endif
+    default: integrateWith<ScalarLanes>(d_bodies,count,constants,velocities,positions); break;
+  }
+}
+
+void RigidBodyWorld::clearForces(){
+  for(std::vector<float>* array : {&d_bodies.fx,&d_bodies.fy,&d_bodies.fz,&d_bodies.tx,&d_bodies.ty,&d_bodies.tz}){
+    std::fill(array->begin(),array->begin()+d_count,0.0f);
+  }
+}
+
+glm::vec3 RigidBodyWorld::interpolatedPosition(uint32_t index, float alpha) const{
+  const BodyArrays& b = d_bodies;
+  glm::vec3 previous(b.ox[index],b.oy[index],b.oz[index]);
+  glm::vec3 current(b.px[index],b.py[index],b.pz[index]);
+  return glm::mix(previous,current,alpha);
+}
+
+glm::mat4 RigidBodyWorld::transform(uint32_t index, float alpha) const{
+  const BodyArrays& b = d_bodies;
+  glm::mat4 model = glm::mat4_cast(glm::quat(b.qw[index],b.qx[index],b.qy[index],b.qz[index]));
+  model[3] = glm::vec4(interpolatedPosition(index,alpha),1.0f);
+  return model;
+}
@@ -0,0 +1,151 @@
+//rigidBodyWorld.hpp
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "aabb.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+//every body's state with one array per component, so the integrator streams
+//whole registers of bodies. Arrays are padded to a multiple of RigidBodyWorld::LANES
+//with inert bodies: static, at rest and unrotated
+struct BodyArrays{
+  //position, and where it was before the last step for interpolation
+  std::vector<float> px, py, pz;
+  std::vector<float> ox, oy, oz;
+  std::vector<float> vx, vy, vz;
+  //accumulated until the next step, which clears them
+  std::vector<float> fx, fy, fz;
+  //orientation, angular velocity and accumulated torque
+  std::vector<float> qx, qy, qz, qw;
+  std::vector<float> wx, wy, wz;
+  std::vector<float> tx, ty, tz;
+  //0 for static bodies; inertia is diagonal in the body frame
+  std::vector<float> invMass;
+  std::vector<float> ix, iy, iz;
+  //box half extents in the body frame
+  std::vector<float> hx, hy, hz;
+
+  void resize(uint32_t count);
+  //makes body i inert
+  void clear(uint32_t i);
+  void move(uint32_t from, uint32_t to);
+  //every array above, for passes that treat them alike
+  std::array<std::vector<float>*,29> arrays();
+};
+
+//boxes in 3D, or in the xy plane for 2D worlds, integrated with semi-implicit
+//Euler at a fixed step. The integration pass runs over the arrays SSE or AVX wide
+//where the build allows it; advance() turns real time into whole fixed steps and
+//alpha() tells how far rendering is past the last one.
+class RigidBodyWorld{
+  public:
+    //0 is never a valid handle
+    using Handle = uint32_t;
+    //arrays are padded to this, the widest integrator
+    static const uint32_t LANES = 8;
+    enum class Integrator : uint32_t{
+      Scalar = 0,
+      SSE = 1,
+      AVX = 2
+    };
+    struct BodyDesc{
+      glm::vec3 position = glm::vec3(0.0f);
+      glm::quat orientation = glm::quat(1.0f,0.0f,0.0f,0.0f);
+      glm::vec3 velocity = glm::vec3(0.0f);
+      glm::vec3 angularVelocity = glm::vec3(0.0f);
+      glm::vec3 halfExtents = glm::vec3(0.5f);
+      //0 makes the body static
+      float mass = 1.0f;
+
+      //a box filling bounds, such as a mesh's or a 2D shape's from the renderer
+      static BodyDesc fromBounds(const Aabb& bounds, float mass = 1.0f);
+    };
+    struct Settings{
+      glm::vec3 gravity = glm::vec3(0.0f,-9.81f,0.0f);
+      float fixedStep = 1.0f/60.0f;
+      //steps one advance() may take, the rest of the time is dropped
+      uint32_t maxSteps = 8;
+      //fraction of velocity lost per second
+      float linearDamping = 0.0f;
+      float angularDamping = 0.05f;
+      //keeps bodies in the xy plane, rotating about z only
+      bool planar = false;
+    };
+
+    RigidBodyWorld();
+    explicit RigidBodyWorld(const Settings& settings);
+
+    Handle add(const BodyDesc& body);
+    //moves the last body into the removed one's place
+    void remove(Handle handle);
+    bool contains(Handle handle) const;
+    //position of a body in the arrays, which changes when others are removed
+    uint32_t index(Handle handle) const;
+    Handle handle(uint32_t index) const { return d_handles[index]; }
+    uint32_t size() const { return d_count; }
+    //changes whenever bodies are added or removed, and with it their indices
+    uint64_t version() const { return d_version; }
+    const Settings& settings() const { return d_settings; }
+
+    glm::vec3 position(Handle handle) const;
+    glm::quat orientation(Handle handle) const;
+    glm::vec3 velocity(Handle handle) const;
+    void setVelocity(Handle handle, glm::vec3 velocity);
+    //applied at the center of mass during the next step
+    void addForce(Handle handle, glm::vec3 force);
+    void addTorque(Handle handle, glm::vec3 torque);
+
+    //Scalar always is, SSE and AVX when the build targets them
+    static bool supported(Integrator integrator);
+    //defaults to the widest supported one
+    void setIntegrator(Integrator integrator);
+    Integrator integrator() const { return d_integrator; }
+
+    //corrects velocities in the middle of every step, after forces and gravity
+    //were applied and before poses move, e.g. ContactSolver::solve
+    using VelocitySolver = std::function<void(float dt)>;
+    void setVelocitySolver(VelocitySolver solver);
+
+    //advances by seconds of real time in whole fixed steps and carries the rest
+    //over to the next call, returns the steps taken
+    uint32_t advance(double seconds);
+    //one fixed step
+    void step();
+    //how far past the last step advance() has come, 0 to 1 of a step
+    float alpha() const { return static_cast<float>(d_accumulator/d_settings.fixedStep); }
+    //the integration pass alone: forces and gravity into velocities, velocities
+    //into poses. Does not clear forces
+    void integrate(float dt);
+
+    //pose of the body at index blended between the last two steps by alpha
+    glm::vec3 interpolatedPosition(uint32_t index, float alpha) const;
+    glm::mat4 transform(uint32_t index, float alpha) const;
+
+    const BodyArrays& bodies() const { return d_bodies; }
+    BodyArrays& bodies() { return d_bodies; }
+
+  private:
+    Settings d_settings;
+    Integrator d_integrator;
+    BodyArrays d_bodies;
+    uint32_t d_count = 0;
+    uint64_t d_version = 0;
+    //dense index to handle and handle-1 to dense index, UINT32_MAX once removed
+    std::vector<Handle> d_handles;
+    std::vector<uint32_t> d_slots;
+    std::vector<Handle> d_freeHandles;
+    double d_accumulator = 0.0;
+
+    VelocitySolver d_velocitySolver;
+
+    uint32_t checkedIndex(Handle handle) const;
+    void integrate(float dt, bool velocities, bool positions);
+    void clearForces();
+};
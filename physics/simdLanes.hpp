@@ -0,0 +1,72 @@
+//simdLanes.hpp
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PHYSICS_HAS_SSE 1
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#define PHYSICS_HAS_AVX 1
+#endif
+
+//physics kernels are written once against these and instantiated per instruction
+//set, each lane is one body or contact. Scalar always exists, SSE and AVX when the
+//build targets them
+struct ScalarLanes{
+  using V = float;
+  static const uint32_t width = 1;
+  static V load(const float* p){ return *p; }
+  static void store(float* p, V v){ *p = v; }
+  static V set(float f){ return f; }
+  static V add(V a, V b){ return a+b; }
+  static V sub(V a, V b){ return a-b; }
+  static V mul(V a, V b){ return a*b; }
+  static V div(V a, V b){ return a/b; }
+  static V sqrt(V a){ return std::sqrt(a); }
+  static V min(V a, V b){ return a<b ? a : b; }
+  static V max(V a, V b){ return a>b ? a : b; }
+  //1 where a is positive, 0 elsewhere
+  static V positive(V a){ return a>0.0f ? 1.0f : 0.0f; }
+};
+
+#ifdef PHYSICS_HAS_SSE
+struct SSELanes{
+  using V = __m128;
+  static const uint32_t width = 4;
+  static V load(const float* p){ return _mm_loadu_ps(p); }
+  static void store(float* p, V v){ _mm_storeu_ps(p,v); }
+  static V set(float f){ return _mm_set1_ps(f); }
+  static V add(V a, V b){ return _mm_add_ps(a,b); }
+  static V sub(V a, V b){ return _mm_sub_ps(a,b); }
+  static V mul(V a, V b){ return _mm_mul_ps(a,b); }
+  static V div(V a, V b){ return _mm_div_ps(a,b); }
+  static V sqrt(V a){ return _mm_sqrt_ps(a); }
+  static V min(V a, V b){ return _mm_min_ps(a,b); }
+  static V max(V a, V b){ return _mm_max_ps(a,b); }
+  static V positive(V a){ return _mm_and_ps(_mm_cmpgt_ps(a,_mm_setzero_ps()),_mm_set1_ps(1.0f)); }
+};
+#endif
+
+#ifdef PHYSICS_HAS_AVX
+struct AVXLanes{
+  using V = __m256;
+  static const uint32_t width = 8;
+  static V load(const float* p){ return _mm256_loadu_ps(p); }
+  static void store(float* p, V v){ _mm256_storeu_ps(p,v); }
+  static V set(float f){ return _mm256_set1_ps(f); }
+  static V add(V a, V b){ return _mm256_add_ps(a,b); }
+  static V sub(V a, V b){ return _mm256_sub_ps(a,b); }
+  static V mul(V a, V b){ return _mm256_mul_ps(a,b); }
+  static V div(V a, V b){ return _mm256_div_ps(a,b); }
+  static V sqrt(V a){ return _mm256_sqrt_ps(a); }
+  static V min(V a, V b){ return _mm256_min_ps(a,b); }
+  static V max(V a, V b){ return _mm256_max_ps(a,b); }
+  static V positive(V a){
+    return _mm256_and_ps(_mm256_cmp_ps(a,_mm256_setzero_ps(),_CMP_GT_OQ),_mm256_set1_ps(1.0f));
+  }
+};
+#endif
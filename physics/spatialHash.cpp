@@ -0,0 +1,150 @@
+//spatialHash.cpp
+#include "spatialHash.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace{
+  struct CellRange{
+    int32_t low[3];
+    int32_t high[3];
+    uint64_t count() const{
+      return static_cast<uint64_t>(high[0]-low[0]+1)*(high[1]-low[1]+1)*(high[2]-low[2]+1);
+    }
+  };
+
+  int32_t cellOf(float value, float inverseSize){
+    return static_cast<int32_t>(std::floor(value*inverseSize));
+  }
+
+  //21 bits per axis, so cells a million apart alias; aliases only cost extra tests
+  uint64_t cellKey(int32_t x, int32_t y, int32_t z){
+    const uint64_t mask = (1u<<21)-1;
+    return (static_cast<uint64_t>(x)&mask)<<42 | (static_cast<uint64_t>(y)&mask)<<21 | (static_cast<uint64_t>(z)&mask);
+  }
+
+  uint32_t bucketOf(uint64_t key, uint32_t shift){
+    return static_cast<uint32_t>((key*0x9E3779B97F4A7C15ull)>>shift);
+  }
+
+  CellRange cellsOf(const BoundsArrays& bounds, uint32_t i, float inverseSize){
+    CellRange range;
+    range.low[0] = cellOf(bounds.minX[i], inverseSize);
+    range.low[1] = cellOf(bounds.minY[i], inverseSize);
+    range.low[2] = cellOf(bounds.minZ[i], inverseSize);
+    range.high[0] = cellOf(bounds.maxX[i], inverseSize);
+    range.high[1] = cellOf(bounds.maxY[i], inverseSize);
+    range.high[2] = cellOf(bounds.maxZ[i], inverseSize);
+    return range;
+  }
+
+  template<typename Visit>
+  void forEachCell(const CellRange& range, Visit visit){
+    for(int32_t x = range.low[0]; x <= range.high[0]; x++){
+      for(int32_t y = range.low[1]; y <= range.high[1]; y++){
+        for(int32_t z = range.low[2]; z <= range.high[2]; z++) visit(cellKey(x,y,z));
+      }
+    }
+  }
+
+  bool overlap(const BoundsArrays& bounds, uint32_t a, uint32_t b){
+    return bounds.minX[a] <= bounds.maxX[b] && bounds.minX[b] <= bounds.maxX[a]
+      && bounds.minY[a] <= bounds.maxY[b] && bounds.minY[b] <= bounds.maxY[a]
+      && bounds.minZ[a] <= bounds.maxZ[b] && bounds.minZ[b] <= bounds.maxZ[a];
+  }
+}
+
+void SpatialHash::setCellSize(float size){
+  if(size < 0.0f) throw std::invalid_argument("negative cell size");
+  d_cellSize = size;
+}
+
+void SpatialHash::update(const BoundsArrays& bounds, uint32_t count, PairBuffer& pairs){
+  pairs.clear();
+  d_stats = Stats();
+  d_large.clear();
+  d_entries.clear();
+  if(count == 0) return;
+
+  float cellSize = d_cellSize;
+  if(cellSize == 0.0f){
+    double extent = 0.0;
+    for(uint32_t i = 0; i < count; i++){
+      extent += std::max({bounds.maxX[i]-bounds.minX[i], bounds.maxY[i]-bounds.minY[i],
+        bounds.maxZ[i]-bounds.minZ[i]});
+    }
+    cellSize = static_cast<float>(2.0*extent/count);
+    if(!(cellSize > 0.0f)) cellSize = 1.0f;
+  }
+  float inverseSize = 1.0f/cellSize;
+  d_stats.cellSize = cellSize;
+
+  //every body entered in its cells in body order, then grouped by bucket
+  for(uint32_t i = 0; i < count; i++){
+    CellRange cells = cellsOf(bounds, i, inverseSize);
+    if(cells.count() > MAX_CELLS){
+      d_large.push_back(i);
+      continue;
+    }
+    forEachCell(cells, [&](uint64_t key){ d_entries.push_back({key, i, 0}); });
+  }
+  uint32_t entries = static_cast<uint32_t>(d_entries.size());
+  uint32_t bits = 1;
+  while((1ull<<bits) < entries) bits++;
+  for(Entry& entry : d_entries) entry.bucket = bucketOf(entry.cell, 64-bits);
+  sortByBucket(bits);
+  d_stats.entries = entries;
+  d_stats.buckets = 1u<<bits;
+  d_stats.large = static_cast<uint32_t>(d_large.size());
+
+  for(uint32_t begin = 0; begin < entries;){
+    uint32_t end = begin+1;
+    while(end < entries && d_entries[end].bucket == d_entries[begin].bucket) end++;
+    for(uint32_t i = begin; i+1 < end; i++){
+      const Entry& first = d_entries[i];
+      for(uint32_t j = i+1; j < end; j++){
+        const Entry& second = d_entries[j];
+        if(first.cell != second.cell) continue;
+        uint32_t a = first.body, c = second.body;
+        if(!(bounds.movable[a] || bounds.movable[c]) || !overlap(bounds, a, c)) continue;
+        //only the cell holding the min corner of the overlap reports it
+        uint64_t home = cellKey(cellOf(std::max(bounds.minX[a],bounds.minX[c]), inverseSize),
+          cellOf(std::max(bounds.minY[a],bounds.minY[c]), inverseSize),
+          cellOf(std::max(bounds.minZ[a],bounds.minZ[c]), inverseSize));
+        if(home == first.cell) pairs.add(a, c);
+      }
+    }
+    begin = end;
+  }
+
+  d_isLarge.assign(count, 0);
+  for(uint32_t i : d_large) d_isLarge[i] = 1;
+  //large bodies against everything, pairs of two large ones once
+  for(uint32_t a : d_large){
+    for(uint32_t i = 0; i < count; i++){
+      if(i == a || (d_isLarge[i] && i < a)) continue;
+      if((bounds.movable[a] || bounds.movable[i]) && overlap(bounds, a, i)) pairs.add(a, i);
+    }
+  }
+}
+
+void SpatialHash::sortByBucket(uint32_t bits){
+  //least significant digit first, 11 bits a pass so the histogram stays in cache
+  const uint32_t DIGIT = 11;
+  uint32_t counts[1u<<DIGIT];
+  d_sorted.resize(d_entries.size());
+  for(uint32_t shift = 0; shift < bits; shift += DIGIT){
+    uint32_t mask = (1u<<DIGIT)-1;
+    std::fill(counts, counts+(1u<<DIGIT), 0u);
+    for(const Entry& entry : d_entries) counts[(entry.bucket>>shift)&mask]++;
+    uint32_t offset = 0;
+    for(uint32_t& c : counts){
+      uint32_t n = c;
+      c = offset;
+      offset += n;
+    }
+    for(const Entry& entry : d_entries) d_sorted[counts[(entry.bucket>>shift)&mask]++] = entry;
+    d_entries.swap(d_sorted);
+  }
+}
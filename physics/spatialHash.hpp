@@ -0,0 +1,50 @@
+//spatialHash.hpp
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "bodyBounds.hpp"
+#include "pairBuffer.hpp"
+
+//broadphase over a uniform grid, rebuilt every update. Each body is entered in
+//every cell its bounds touch, cells are hashed into as many buckets as there are
+//entries and entries grouped by bucket with a radix sort, so the build is a few
+//linear passes instead of scattered writes into a table. Bodies in the same cell
+//are tested against each other; a pair sharing several cells is reported only from
+//the cell holding the min corner of its overlap. Bodies spanning more than
+//MAX_CELLS cells, like a ground plane, skip the grid and are tested against all.
+class SpatialHash{
+  public:
+    static const uint32_t MAX_CELLS = 64;
+    struct Stats{
+      float cellSize = 0.0f;
+      //body and cell pairs entered in the table
+      uint32_t entries = 0;
+      uint32_t buckets = 0;
+      //bodies tested against all others instead
+      uint32_t large = 0;
+    };
+
+    //edge length of a cell, 0 (the default) picks twice the mean extent of the
+    //bounds each update so most bodies touch one to eight cells
+    void setCellSize(float size);
+    void update(const BoundsArrays& bounds, uint32_t count, PairBuffer& pairs);
+    const Stats& stats() const { return d_stats; }
+
+  private:
+    struct Entry{
+      uint64_t cell;
+      uint32_t body;
+      uint32_t bucket;
+    };
+
+    float d_cellSize = 0.0f;
+    Stats d_stats;
+    std::vector<Entry> d_entries;
+    std::vector<Entry> d_sorted;
+    std::vector<uint32_t> d_large;
+    std::vector<uint8_t> d_isLarge;
+
+    void sortByBucket(uint32_t bits);
+};
@@ -0,0 +1,166 @@
+//sweepAndPrune.cpp
+#include "sweepAndPrune.hpp"
+
+#include "simdLanes.hpp"
+
+#include <algorithm>
+
+namespace{
+  const std::vector<float>& minOf(const BoundsArrays& bounds, uint32_t axis){
+    return axis == 0 ? bounds.minX : axis == 1 ? bounds.minY : bounds.minZ;
+  }
+  const std::vector<float>& maxOf(const BoundsArrays& bounds, uint32_t axis){
+    return axis == 0 ? bounds.maxX : axis == 1 ? bounds.maxY : bounds.maxZ;
+  }
+  //at equal values min ends sort first, so touching bounds overlap
+  bool before(uint32_t aId, float a, uint32_t bId, float b){
+    return a < b || (a == b && (aId&1u) < (bId&1u));
+  }
+}
+
+void SweepAndPrune::reset(){
+  d_valid = false;
+}
+
+void SweepAndPrune::update(const BoundsArrays& bounds, uint32_t count, PairBuffer& pairs){
+  pairs.clear();
+  d_stats = Stats();
+  if(!d_valid || count != d_count){
+    rebuild(bounds, count);
+  }else{
+    const std::vector<float>& mins = minOf(bounds, d_axis);
+    const std::vector<float>& maxs = maxOf(bounds, d_axis);
+    for(Endpoint& endpoint : d_endpoints){
+      uint32_t body = endpoint.id>>1;
+      endpoint.value = endpoint.id&1u ? maxs[body] : mins[body];
+    }
+    //the previous order is nearly right, each endpoint moves past the few it overtook
+    uint64_t swaps = 0;
+    for(size_t i = 1; i < d_endpoints.size(); i++){
+      Endpoint endpoint = d_endpoints[i];
+      size_t j = i;
+      while(j > 0 && before(endpoint.id, endpoint.value, d_endpoints[j-1].id, d_endpoints[j-1].value)){
+        d_endpoints[j] = d_endpoints[j-1];
+        j--;
+      }
+      d_endpoints[j] = endpoint;
+      swaps += i-j;
+    }
+    d_stats.swaps = swaps;
+  }
+  sweep(bounds, pairs);
+}
+
+void SweepAndPrune::rebuild(const BoundsArrays& bounds, uint32_t count){
+  d_count = count;
+  d_valid = true;
+  d_stats.rebuilt = true;
+  //the axis the centers spread along most keeps the fewest intervals open at once
+  double sum[3] = {0.0,0.0,0.0};
+  double squares[3] = {0.0,0.0,0.0};
+  for(uint32_t axis = 0; axis < 3; axis++){
+    const std::vector<float>& mins = minOf(bounds, axis);
+    const std::vector<float>& maxs = maxOf(bounds, axis);
+    for(uint32_t i = 0; i < count; i++){
+      double center = 0.5*(static_cast<double>(mins[i])+maxs[i]);
+      sum[axis] += center;
+      squares[axis] += center*center;
+    }
+  }
+  double best = -1.0;
+  for(uint32_t axis = 0; axis < 3; axis++){
+    double mean = count > 0 ? sum[axis]/count : 0.0;
+    double variance = count > 0 ? squares[axis]/count-mean*mean : 0.0;
+    if(variance > best){
+      best = variance;
+      d_axis = axis;
+    }
+  }
+
+  const std::vector<float>& mins = minOf(bounds, d_axis);
+  const std::vector<float>& maxs = maxOf(bounds, d_axis);
+  d_endpoints.resize(static_cast<size_t>(count)*2);
+  for(uint32_t i = 0; i < count; i++){
+    d_endpoints[2*i] = {mins[i], i<<1};
+    d_endpoints[2*i+1] = {maxs[i], (i<<1)|1u};
+  }
+  std::sort(d_endpoints.begin(), d_endpoints.end(), [](const Endpoint& a, const Endpoint& b){
+    return before(a.id, a.value, b.id, b.value);
+  });
+  d_activeSlot.assign(count, 0);
+}
+
+void SweepAndPrune::sweep(const BoundsArrays& bounds, PairBuffer& pairs){
+  uint32_t axisB = (d_axis+1)%3;
+  uint32_t axisC = (d_axis+2)%3;
+  const std::vector<float>& minB = minOf(bounds, axisB);
+  const std::vector<float>& maxB = maxOf(bounds, axisB);
+  const std::vector<float>& minC = minOf(bounds, axisC);
+  const std::vector<float>& maxC = maxOf(bounds, axisC);
+  d_activeMinB.clear();
+  d_activeMaxB.clear();
+  d_activeMinC.clear();
+  d_activeMaxC.clear();
+  d_activeBody.clear();
+
+  for(const Endpoint& endpoint : d_endpoints){
+    uint32_t body = endpoint.id>>1;
+    if(endpoint.id&1u){
+      //closes: the last open body takes its slot
+      uint32_t slot = d_activeSlot[body];
+      uint32_t last = static_cast<uint32_t>(d_activeBody.size())-1;
+      if(slot != last){
+        d_activeMinB[slot] = d_activeMinB[last];
+        d_activeMaxB[slot] = d_activeMaxB[last];
+        d_activeMinC[slot] = d_activeMinC[last];
+        d_activeMaxC[slot] = d_activeMaxC[last];
+        d_activeBody[slot] = d_activeBody[last];
+        d_activeSlot[d_activeBody[slot]] = slot;
+      }
+      d_activeMinB.pop_back();
+      d_activeMaxB.pop_back();
+      d_activeMinC.pop_back();
+      d_activeMaxC.pop_back();
+      d_activeBody.pop_back();
+      continue;
+    }
+
+    //opens: overlaps every open body whose other two intervals it meets
+    float bodyMinB = minB[body], bodyMaxB = maxB[body];
+    float bodyMinC = minC[body], bodyMaxC = maxC[body];
+    bool movable = bounds.movable[body] != 0;
+    uint32_t active = static_cast<uint32_t>(d_activeBody.size());
+    uint32_t k = 0;
+#ifdef PHYSICS_HAS_SSE
+    __m128 lowB = _mm_set1_ps(bodyMinB), highB = _mm_set1_ps(bodyMaxB);
+    __m128 lowC = _mm_set1_ps(bodyMinC), highC = _mm_set1_ps(bodyMaxC);
+    for(; k+4 <= active; k += 4){
+      __m128 overlap = _mm_and_ps(
+        _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&d_activeMinB[k]),highB),_mm_cmpge_ps(_mm_loadu_ps(&d_activeMaxB[k]),lowB)),
+        _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&d_activeMinC[k]),highC),_mm_cmpge_ps(_mm_loadu_ps(&d_activeMaxC[k]),lowC)));
+      int mask = _mm_movemask_ps(overlap);
+      if(mask == 0) continue;
+      for(uint32_t lane = 0; lane < 4; lane++){
+        if(!(mask&(1<<lane))) continue;
+        uint32_t other = d_activeBody[k+lane];
+        if(movable || bounds.movable[other]) pairs.add(body, other);
+      }
+    }
+#endif
+    for(; k < active; k++){
+      if(d_activeMinB[k] <= bodyMaxB && d_activeMaxB[k] >= bodyMinB
+          && d_activeMinC[k] <= bodyMaxC && d_activeMaxC[k] >= bodyMinC){
+        uint32_t other = d_activeBody[k];
+        if(movable || bounds.movable[other]) pairs.add(body, other);
+      }
+    }
+
+    d_activeSlot[body] = active;
+    d_activeMinB.push_back(bodyMinB);
+    d_activeMaxB.push_back(bodyMaxB);
+    d_activeMinC.push_back(bodyMinC);
+    d_activeMaxC.push_back(bodyMaxC);
+    d_activeBody.push_back(body);
+    d_stats.maxActive = std::max(d_stats.maxActive, active+1);
+  }
+}
@@ -0,0 +1,56 @@
+//sweepAndPrune.hpp
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "bodyBounds.hpp"
+#include "pairBuffer.hpp"
+
+//broadphase over the endpoints of every body's bounds on one axis, kept sorted
+//from update to update. Bodies move little between steps, so re-sorting the
+//previous order with insertion sort costs about one pass. The sweep then walks the
+//endpoints keeping the bodies whose interval is open, and tests each body that
+//opens against those on the other two axes, four at a time with SSE.
+//
+//The axis is the one the body centers spread along most, picked when the endpoints
+//are rebuilt: on the first update, after reset() and whenever the count changes.
+class SweepAndPrune{
+  public:
+    struct Stats{
+      //endpoint moves by the insertion sort of the last update
+      uint64_t swaps = 0;
+      //most bodies open at once during the last sweep
+      uint32_t maxActive = 0;
+      bool rebuilt = false;
+    };
+
+    //rebuilds on the next update, for when bodies were added or removed
+    void reset();
+    void update(const BoundsArrays& bounds, uint32_t count, PairBuffer& pairs);
+    uint32_t axis() const { return d_axis; }
+    const Stats& stats() const { return d_stats; }
+
+  private:
+    struct Endpoint{
+      float value;
+      //body index shifted left once, the low bit set for the max end
+      uint32_t id;
+    };
+
+    std::vector<Endpoint> d_endpoints;
+    uint32_t d_count = 0;
+    uint32_t d_axis = 0;
+    bool d_valid = false;
+    Stats d_stats;
+
+    //bodies open during the sweep, bounds on the two other axes beside them so
+    //they can be tested a register at a time; d_activeSlot maps bodies back
+    std::vector<float> d_activeMinB, d_activeMaxB;
+    std::vector<float> d_activeMinC, d_activeMaxC;
+    std::vector<uint32_t> d_activeBody;
+    std::vector<uint32_t> d_activeSlot;
+
+    void rebuild(const BoundsArrays& bounds, uint32_t count);
+    void sweep(const BoundsArrays& bounds, PairBuffer& pairs);
+};
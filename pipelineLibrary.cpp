@@ -0,0 +1,118 @@
+//pipelineLibrary.cpp
+#include "pipelineLibrary.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+bool PipelineKey::operator==(const PipelineKey& other) const{
+  return variant==other.variant && blend==other.blend && depthTest==other.depthTest
+    && depthWrite==other.depthWrite && topology==other.topology && alphaCutoff==other.alphaCutoff
+    && screenSpace==other.screenSpace && source==other.source && antialias==other.antialias;
+}
+
+size_t PipelineKeyHash::operator()(const PipelineKey& key) const{
+  uint32_t cutoff;
+  memcpy(&cutoff,&key.alphaCutoff,sizeof(cutoff));
+  uint64_t packed = static_cast<uint64_t>(key.variant)
+    | static_cast<uint64_t>(key.blend)<<8
+    | static_cast<uint64_t>(key.depthTest)<<16
+    | static_cast<uint64_t>(key.depthWrite)<<17
+    | static_cast<uint64_t>(key.screenSpace)<<18
+    | static_cast<uint64_t>(key.source)<<19
+    | static_cast<uint64_t>(key.antialias)<<21
+    | static_cast<uint64_t>(key.topology)<<24
+    | static_cast<uint64_t>(cutoff)<<32;
+  return std::hash<uint64_t>()(packed);
+}
+
+void PipelineLibrary::init(VkDevice device, Builder builder){
+  d_device = device;
+  d_builder = builder;
+  d_running = true;
+  d_thread = std::thread(&PipelineLibrary::work,this);
+}
+
+void PipelineLibrary::shutdown(){
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    if(!d_running) return;
+    d_running = false;
+    d_queue.clear();
+  }
+  d_wake.notify_all();
+  d_thread.join();
+  for(auto& entry : d_pipelines){
+    if(entry.second.pipeline!=VK_NULL_HANDLE){
+      vkDestroyPipeline(d_device,entry.second.pipeline,nullptr);
+    }
+  }
+  d_pipelines.clear();
+}
+
+void PipelineLibrary::enqueue(const PipelineKey& key){
+  d_pipelines[key] = {State::Queued,VK_NULL_HANDLE};
+  d_queue.push_back(key);
+  d_wake.notify_one();
+}
+
+VkPipeline PipelineLibrary::get(const PipelineKey& key){
+  std::lock_guard<std::mutex> lock(d_mutex);
+  auto found = d_pipelines.find(key);
+  if(found==d_pipelines.end()){
+    enqueue(key);
+    return VK_NULL_HANDLE;
+  }
+  return found->second.pipeline;
+}
+
+void PipelineLibrary::prefetch(const PipelineKey& key){
+  std::lock_guard<std::mutex> lock(d_mutex);
+  if(d_pipelines.count(key)==0) enqueue(key);
+}
+
+bool PipelineLibrary::ready(const PipelineKey& key){
+  std::lock_guard<std::mutex> lock(d_mutex);
+  auto found = d_pipelines.find(key);
+  return found!=d_pipelines.end() && found->second.state!=State::Queued;
+}
+
+void PipelineLibrary::retireAll(std::vector<VkPipeline>& retired){
+  std::lock_guard<std::mutex> lock(d_mutex);
+  for(auto& entry : d_pipelines){
+    if(entry.second.pipeline!=VK_NULL_HANDLE) retired.push_back(entry.second.pipeline);
+  }
+  d_pipelines.clear();
+  d_queue.clear();
+  //anything the worker is building right now was built from stale state
+  d_generation++;
+}
+
+void PipelineLibrary::work(){
+  std::unique_lock<std::mutex> lock(d_mutex);
+  while(true){
+    d_wake.wait(lock,[this]{ return !d_running || !d_queue.empty(); });
+    if(!d_running) return;
+
+    PipelineKey key = d_queue.front();
+    d_queue.pop_front();
+    uint64_t generation = d_generation;
+
+    lock.unlock();
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    try{
+      pipeline = d_builder(key);
+    }catch(const std::exception& e){
+      std::cerr<<"pipeline library: "<<e.what()<<std::endl;
+    }
+    lock.lock();
+
+    auto found = d_pipelines.find(key);
+    if(generation!=d_generation || found==d_pipelines.end()){
+      if(pipeline!=VK_NULL_HANDLE) vkDestroyPipeline(d_device,pipeline,nullptr);
+      continue;
+    }
+    found->second.pipeline = pipeline;
+    found->second.state = pipeline!=VK_NULL_HANDLE ? State::Ready : State::Failed;
+  }
+}
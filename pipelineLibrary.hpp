@@ -0,0 +1,103 @@
+//pipelineLibrary.hpp
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//fragment shader permutations, selected through specialization constant 0 of shader.frag
+enum class ShaderVariant : uint32_t{
+  Textured = 0,
+  VertexColor = 1,
+  AlphaTest = 2,
+  DebugTexCoord = 3,
+  DebugDepth = 4
+};
+
+//what the vertex stage reads: Vertex through shader.vert, QuadInstance through quad.vert
+//or LineSegment out of a storage buffer through line.vert. Glyphs are QuadInstances
+//shaded by text.frag from the glyph atlas
+enum class VertexSource : uint32_t{
+  Mesh = 0,
+  InstancedQuads = 1,
+  LineSegments = 2,
+  Glyphs = 3
+};
+
+enum class BlendMode : uint32_t{
+  Opaque = 0,
+  Alpha = 1,
+  Additive = 2
+};
+
+//everything that distinguishes one graphics pipeline from another
+struct PipelineKey{
+  ShaderVariant variant = ShaderVariant::Textured;
+  BlendMode blend = BlendMode::Opaque;
+  bool depthTest = true;
+  bool depthWrite = true;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  float alphaCutoff = 0.5f;
+  //positions are already in screen space (x right, y up, -1 to 1), the uniform
+  //matrices are skipped and nothing is culled. Specialization constant 2 of shader.vert
+  bool screenSpace = false;
+  VertexSource source = VertexSource::Mesh;
+  //coverage based edges for LineSegments, specialization constant 3 of line.vert/line.frag
+  bool antialias = false;
+
+  bool operator==(const PipelineKey& other) const;
+  bool operator!=(const PipelineKey& other) const { return !(*this==other); }
+};
+
+struct PipelineKeyHash{
+  size_t operator()(const PipelineKey& key) const;
+};
+
+//lazily compiled pipeline permutations. The first request for a key queues it
+//on a background thread and returns VK_NULL_HANDLE, callers draw with their
+//fallback pipeline until the permutation is ready.
+class PipelineLibrary{
+  public:
+    //builds one pipeline, runs on the library thread and must be thread safe
+    using Builder = std::function<VkPipeline(const PipelineKey&)>;
+
+    void init(VkDevice device, Builder builder);
+    void shutdown();
+
+    //the ready pipeline for key or VK_NULL_HANDLE, queues a build on first use
+    VkPipeline get(const PipelineKey& key);
+    //queue a build without needing the result yet
+    void prefetch(const PipelineKey& key);
+    bool ready(const PipelineKey& key);
+
+    //hands every built pipeline to the caller to destroy once the GPU is done
+    //with it, and drops builds in flight. Used when shaders or the render pass change.
+    void retireAll(std::vector<VkPipeline>& retired);
+
+  private:
+    enum class State{ Queued, Ready, Failed };
+    struct Entry{
+      State state;
+      VkPipeline pipeline;
+    };
+
+    VkDevice d_device = VK_NULL_HANDLE;
+    Builder d_builder;
+    std::mutex d_mutex;
+    std::condition_variable d_wake;
+    std::unordered_map<PipelineKey,Entry,PipelineKeyHash> d_pipelines;
+    std::deque<PipelineKey> d_queue;
+    uint64_t d_generation = 0;
+    bool d_running = false;
+    std::thread d_thread;
+
+    void enqueue(const PipelineKey& key);
+    void work();
+};
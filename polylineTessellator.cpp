@@ -0,0 +1,319 @@
+//polylineTessellator.cpp
+#include "polylineTessellator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace{
+  const float pi = 3.14159265f;
+
+  enum class JoinShape{
+    None,
+    Bevel,
+    Miter,
+    Round
+  };
+
+  //the corner between the segments with left normals from and to
+  struct Corner{
+    JoinShape shape = JoinShape::None;
+    uint32_t steps = 0;
+    //-1 when the outer side is right of the line, that is for left turns
+    float side = 1.0f;
+  };
+
+  Corner corner(const PolylineStyle& style, glm::vec2 from, glm::vec2 to){
+    Corner result;
+    float cross = from.x*to.y-from.y*to.x;
+    float dot = from.x*to.x+from.y*to.y;
+    if(std::fabs(cross)<1e-6f && dot>0.0f) return result;
+    result.side = cross>0.0f ? -1.0f : 1.0f;
+    switch(style.join){
+      case LineJoin::Miter:
+        //the miter reaches 1/cos(half the turn) half widths out
+        if(dot>-1.0f && std::sqrt(0.5f*(1.0f+dot))*style.miterLimit>=1.0f){
+          result.shape = JoinShape::Miter;
+          return result;
+        }
+        result.shape = JoinShape::Bevel;
+        return result;
+      case LineJoin::Bevel:
+        result.shape = JoinShape::Bevel;
+        return result;
+      case LineJoin::Round:
+        result.shape = JoinShape::Round;
+        result.steps = std::max(1u,static_cast<uint32_t>(std::ceil(
+            std::acos(std::min(std::max(dot,-1.0f),1.0f))/pi*style.roundSegments)));
+        return result;
+    }
+    return result;
+  }
+
+  //on top of the segment quads, whose outer corners the joins and caps reuse
+  void cornerSize(const Corner& corner, uint32_t& vertices, uint32_t& indices){
+    switch(corner.shape){
+      case JoinShape::None: break;
+      case JoinShape::Bevel: vertices += 1; indices += 3; break;
+      case JoinShape::Miter: vertices += 2; indices += 6; break;
+      case JoinShape::Round: vertices += corner.steps; indices += 3*corner.steps; break;
+    }
+  }
+
+  void capSize(const PolylineStyle& style, uint32_t& vertices, uint32_t& indices){
+    switch(style.cap){
+      case LineCap::Butt: break;
+      case LineCap::Square: vertices += 2; indices += 6; break;
+      case LineCap::Round: vertices += style.roundSegments; indices += 3*style.roundSegments; break;
+    }
+  }
+
+  struct Writer{
+    DrawList2D::Vertex* vertices;
+    DrawList2D::Index* indices;
+    uint32_t next;
+    glm::vec3 color;
+
+    uint32_t vertex(glm::vec2 position){
+      *vertices++ = {glm::vec3(position,0.0f),color,glm::vec2(0.0f,0.0f)};
+      return next++;
+    }
+    void triangle(uint32_t a, uint32_t b, uint32_t c){
+      indices[0] = a;
+      indices[1] = b;
+      indices[2] = c;
+      indices += 3;
+    }
+    void quad(uint32_t a, uint32_t b, uint32_t c, uint32_t d){
+      triangle(a,b,c);
+      triangle(c,d,a);
+    }
+    //steps triangles around center from first, at center+radius, turning angle radians
+    //counter-clockwise to last
+    void fan(glm::vec2 center, glm::vec2 radius, float angle, uint32_t steps, uint32_t first, uint32_t last){
+      uint32_t middle = vertex(center);
+      uint32_t previous = first;
+      float s = std::sin(angle/steps), c = std::cos(angle/steps);
+      for(uint32_t i = 1; i<steps; i++){
+        radius = glm::vec2(c*radius.x-s*radius.y,s*radius.x+c*radius.y);
+        uint32_t current = vertex(center+radius);
+        triangle(middle,previous,current);
+        previous = current;
+      }
+      triangle(middle,previous,last);
+    }
+  };
+
+  //segment quads are written start-right, end-right, end-left, start-left of the direction of travel
+  enum QuadCorner : uint32_t{
+    StartRight = 0,
+    EndRight = 1,
+    EndLeft = 2,
+    StartLeft = 3
+  };
+
+  //fromQuad and toQuad are the first vertices of the segments meeting at point
+  void writeCorner(Writer& writer, const PolylineStyle& style, const Corner& corner, glm::vec2 point,
+      glm::vec2 from, glm::vec2 to, uint32_t fromQuad, uint32_t toQuad){
+    float h = 0.5f*style.width*corner.side;
+    uint32_t a = fromQuad+(corner.side>0.0f ? EndLeft : EndRight);
+    uint32_t b = toQuad+(corner.side>0.0f ? StartLeft : StartRight);
+    switch(corner.shape){
+      case JoinShape::None: break;
+      case JoinShape::Bevel:
+        writer.triangle(writer.vertex(point),a,b);
+        break;
+      case JoinShape::Miter:{
+        glm::vec2 middle = from+to;
+        float length = std::sqrt(middle.x*middle.x+middle.y*middle.y);
+        middle = middle*(1.0f/length);
+        //the miter tip lies along the bisector, where both outer edges meet
+        uint32_t center = writer.vertex(point);
+        uint32_t tip = writer.vertex(point+middle*(h/(middle.x*from.x+middle.y*from.y)));
+        writer.triangle(center,a,tip);
+        writer.triangle(center,tip,b);
+        break;
+      }
+      case JoinShape::Round:{
+        //a straight reversal gets +-pi from atan2 either way, the side decides which way round
+        float angle = std::fabs(std::atan2(from.x*to.y-from.y*to.x,from.x*to.x+from.y*to.y));
+        if(corner.side>0.0f) angle = -angle;
+        writer.fan(point,from*h,angle,corner.steps,a,b);
+        break;
+      }
+    }
+  }
+
+  //quad is the first vertex of the segment the cap closes, start is true at the first point
+  void writeCap(Writer& writer, const PolylineStyle& style, glm::vec2 point, glm::vec2 normal, uint32_t quad,
+      bool start){
+    float h = 0.5f*style.width;
+    //walking counter-clockwise round the end of the line, from left to right of it seen from outside
+    glm::vec2 outward = start ? glm::vec2(-normal.y,normal.x)*h : glm::vec2(normal.y,-normal.x)*h;
+    glm::vec2 radius = start ? normal*h : normal*(-h);
+    uint32_t left = quad+(start ? StartLeft : EndRight);
+    uint32_t right = quad+(start ? StartRight : EndLeft);
+    switch(style.cap){
+      case LineCap::Butt: break;
+      case LineCap::Square:{
+        uint32_t leftOut = writer.vertex(point+radius+outward);
+        uint32_t rightOut = writer.vertex(point-radius+outward);
+        writer.quad(left,leftOut,rightOut,right);
+        break;
+      }
+      case LineCap::Round:
+        writer.fan(point,radius,pi,style.roundSegments,left,right);
+        break;
+    }
+  }
+
+  glm::vec2 normalOf(glm::vec2 from, glm::vec2 to){
+    float dx = to.x-from.x, dy = to.y-from.y;
+    float lengthSquared = dx*dx+dy*dy;
+    if(!(lengthSquared>0.0f)) return glm::vec2(0.0f,0.0f);
+    float inverse = 1.0f/std::sqrt(lengthSquared);
+    return glm::vec2(-dy*inverse,dx*inverse);
+  }
+
+  bool isZero(glm::vec2 v){
+    return v.x==0.0f && v.y==0.0f;
+  }
+}
+
+void PolylineTessellator::setStyle(const PolylineStyle& style){
+  if(!(style.width>0.0f)) throw std::logic_error("polyline width has to be positive");
+  if(style.roundSegments==0) throw std::logic_error("round caps and joins need at least one segment");
+  d_style = style;
+}
+
+void PolylineTessellator::computeNormals(const glm::vec2* points, uint32_t count){
+  uint32_t segments = count>0 ? count-1 : 0;
+  if(d_normals.size()<segments) d_normals.resize(segments);
+  const float* p = reinterpret_cast<const float*>(points);
+  float* out = reinterpret_cast<float*>(d_normals.data());
+  uint32_t i = 0;
+#if defined(__SSE2__)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  for(; i+4<=segments; i += 4){
+    //points i..i+3 and i+1..i+4, split into x and y lanes
+    __m128 a0 = _mm_loadu_ps(p+2*i), a1 = _mm_loadu_ps(p+2*i+4);
+    __m128 b0 = _mm_loadu_ps(p+2*i+2), b1 = _mm_loadu_ps(p+2*i+6);
+    __m128 dx = _mm_sub_ps(_mm_shuffle_ps(b0,b1,_MM_SHUFFLE(2,0,2,0)),_mm_shuffle_ps(a0,a1,_MM_SHUFFLE(2,0,2,0)));
+    __m128 dy = _mm_sub_ps(_mm_shuffle_ps(b0,b1,_MM_SHUFFLE(3,1,3,1)),_mm_shuffle_ps(a0,a1,_MM_SHUFFLE(3,1,3,1)));
+    __m128 lengthSquared = _mm_add_ps(_mm_mul_ps(dx,dx),_mm_mul_ps(dy,dy));
+    //repeated points divide by zero, the mask turns their infinities into a zero normal
+    __m128 inverse = _mm_and_ps(_mm_cmpgt_ps(lengthSquared,zero),_mm_div_ps(one,_mm_sqrt_ps(lengthSquared)));
+    __m128 nx = _mm_sub_ps(zero,_mm_mul_ps(dy,inverse));
+    __m128 ny = _mm_mul_ps(dx,inverse);
+    _mm_storeu_ps(out+2*i,_mm_unpacklo_ps(nx,ny));
+    _mm_storeu_ps(out+2*i+4,_mm_unpackhi_ps(nx,ny));
+  }
+#endif
+  for(; i<segments; i++){
+    d_normals[i] = normalOf(points[i],points[i+1]);
+  }
+}
+
+bool PolylineTessellator::add(DrawList2D& list, const glm::vec2* points, uint32_t count, glm::vec3 color){
+  computeNormals(points,count);
+  return tessellate(list,points,d_normals.data(),count,color);
+}
+
+uint32_t PolylineTessellator::addBatch(DrawList2D& list, const glm::vec2* points, const uint32_t* counts,
+    uint32_t polylineCount, const glm::vec3* colors){
+  uint64_t total = 0;
+  for(uint32_t i = 0; i<polylineCount; i++) total += counts[i];
+  if(total>UINT32_MAX) throw std::length_error("polyline batch has more than 2^32 points");
+  //the normals spanning two polylines are computed too and never read
+  computeNormals(points,static_cast<uint32_t>(total));
+  uint32_t offset = 0;
+  for(uint32_t i = 0; i<polylineCount; i++){
+    if(!tessellate(list,points+offset,d_normals.data()+offset,counts[i],colors[i])) return i;
+    offset += counts[i];
+  }
+  return polylineCount;
+}
+
+bool PolylineTessellator::tessellate(DrawList2D& list, const glm::vec2* points, const glm::vec2* normals,
+    uint32_t count, glm::vec3 color, bool startCap, bool endCap){
+  if(count<2) return true;
+  bool closed = d_style.closed && count>2;
+  glm::vec2 closing = closed ? normalOf(points[count-1],points[0]) : glm::vec2(0.0f,0.0f);
+  uint32_t segments = closed ? count : count-1;
+  auto normal = [&](uint32_t segment){ return segment<count-1 ? normals[segment] : closing; };
+
+  //sized up front so the whole polyline is reserved at once or not at all
+  uint32_t first = segments, last = 0;
+  uint32_t vertexCount = 0, indexCount = 0;
+  for(uint32_t s = 0; s<segments; s++){
+    if(isZero(normal(s))) continue;
+    if(first!=segments) cornerSize(corner(d_style,normal(last),normal(s)),vertexCount,indexCount);
+    else first = s;
+    last = s;
+    vertexCount += 4;
+    indexCount += 6;
+  }
+  if(first==segments) return true;
+  if(closed){
+    cornerSize(corner(d_style,normal(last),normal(first)),vertexCount,indexCount);
+  }else{
+    if(startCap) capSize(d_style,vertexCount,indexCount);
+    if(endCap) capSize(d_style,vertexCount,indexCount);
+  }
+
+  if(vertexCount>DrawList2D::CHUNK_VERTICES && count>=4){
+    if(closed){
+      //open, the repeated first segment carries the joins at both of its ends
+      d_opened.assign(points,points+count);
+      d_opened.push_back(points[0]);
+      d_opened.push_back(points[1]);
+      d_openedNormals.assign(normals,normals+count-1);
+      d_openedNormals.push_back(closing);
+      d_openedNormals.push_back(normals[0]);
+      PolylineStyle style = d_style;
+      d_style.closed = false;
+      bool written = tessellate(list,d_opened.data(),d_openedNormals.data(),count+2,color,false,false);
+      d_style = style;
+      return written;
+    }
+    //both halves share the middle segment, the second draws the join at its end
+    uint32_t middle = count/2;
+    return tessellate(list,points,normals,middle+1,color,startCap,false)
+      && tessellate(list,points+middle-1,normals+middle-1,count-middle+1,color,false,endCap);
+  }
+
+  Writer writer;
+  writer.color = color;
+  if(!list.reserve(vertexCount,indexCount,writer.vertices,writer.indices,writer.next)) return false;
+
+  float h = 0.5f*d_style.width;
+  uint32_t firstQuad = 0, previousQuad = 0;
+  glm::vec2 previous(0.0f,0.0f);
+  for(uint32_t s = first; s<=last; s++){
+    glm::vec2 n = normal(s);
+    if(isZero(n)) continue;
+    glm::vec2 start = points[s], end = points[s+1<count ? s+1 : 0];
+    uint32_t quad = writer.vertex(start-n*h);
+    writer.vertex(end-n*h);
+    writer.vertex(end+n*h);
+    writer.vertex(start+n*h);
+    writer.quad(quad+StartRight,quad+EndRight,quad+EndLeft,quad+StartLeft);
+    if(s==first) firstQuad = quad;
+    else writeCorner(writer,d_style,corner(d_style,previous,n),start,previous,n,previousQuad,quad);
+    previous = n;
+    previousQuad = quad;
+  }
+  if(closed){
+    writeCorner(writer,d_style,corner(d_style,previous,normal(first)),points[first],previous,normal(first),
+        previousQuad,firstQuad);
+  }else{
+    if(startCap) writeCap(writer,d_style,points[first],normal(first),firstQuad,true);
+    if(endCap) writeCap(writer,d_style,points[last+1],normal(last),previousQuad,false);
+  }
+  return true;
+}
@@ -0,0 +1,65 @@
+//polylineTessellator.hpp
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "drawList2D.hpp"
+
+enum class LineJoin : uint32_t{
+  Miter = 0,
+  Bevel = 1,
+  Round = 2
+};
+
+enum class LineCap : uint32_t{
+  Butt = 0,
+  Square = 1,
+  Round = 2
+};
+
+struct PolylineStyle{
+  //full width, in the screen space units of DrawList2D
+  float width = 0.01f;
+  LineJoin join = LineJoin::Miter;
+  LineCap cap = LineCap::Butt;
+  //miters reaching further than this many half widths from the point become bevels
+  float miterLimit = 4.0f;
+  //triangles of a round cap, round joins get as many per half turn
+  uint32_t roundSegments = 8;
+  //joins the last point back to the first, no caps
+  bool closed = false;
+};
+
+//turns polylines into triangles written through DrawList2D::reserve. Every segment
+//is its own quad and joins fill the outer side of each corner, so translucent lines
+//show their overlaps. Repeated points are skipped. Segment normals are computed for
+//a whole batch of points at once, four at a time with SSE where available. A
+//polyline needing more vertices than one 16 bit chunk of the list is written as
+//runs overlapping by a segment, so every join is still drawn
+class PolylineTessellator{
+  public:
+    void setStyle(const PolylineStyle& style);
+    const PolylineStyle& style() const { return d_style; }
+
+    //false when the list cannot fit the whole polyline. Nothing is written then,
+    //unless it was split into runs and only the first ones fit
+    bool add(DrawList2D& list, const glm::vec2* points, uint32_t count, glm::vec3 color);
+    //polyline i is counts[i] points long, all stored back to back in points. Returns
+    //how many were written, stopping at the first one that does not fit
+    uint32_t addBatch(DrawList2D& list, const glm::vec2* points, const uint32_t* counts,
+        uint32_t polylineCount, const glm::vec3* colors);
+
+  private:
+    PolylineStyle d_style;
+    //unit left normal of the segment from point i to i+1, zero for repeated points
+    std::vector<glm::vec2> d_normals;
+    //a closed polyline too long for one chunk, opened up with its first two points repeated
+    std::vector<glm::vec2> d_opened;
+    std::vector<glm::vec2> d_openedNormals;
+
+    void computeNormals(const glm::vec2* points, uint32_t count);
+    //caps are left off where a run meets the next
+    bool tessellate(DrawList2D& list, const glm::vec2* points, const glm::vec2* normals,
+        uint32_t count, glm::vec3 color, bool startCap = true, bool endCap = true);
+};
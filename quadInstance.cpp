@@ -0,0 +1,65 @@
+//quadInstance.cpp
+#include "quadInstance.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace{
+  //round to nearest, overflow saturates to infinity, values below the half range flush to zero
+  uint16_t toHalf(float value){
+    uint32_t bits;
+    memcpy(&bits,&value,sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits>>16)&0x8000u);
+    int32_t exponent = static_cast<int32_t>((bits>>23)&0xffu)-127+15;
+    uint32_t mantissa = bits&0x7fffffu;
+    if(exponent<=0) return sign;
+    if(exponent>=31) return static_cast<uint16_t>(sign|0x7c00u);
+    uint32_t half = (static_cast<uint32_t>(exponent)<<10)|(mantissa>>13);
+    //a carry out of the mantissa correctly bumps the exponent
+    if(mantissa&0x1000u) half++;
+    return static_cast<uint16_t>(sign|std::min<uint32_t>(half,0x7c00u));
+  }
+
+  uint16_t toUnorm16(float value){
+    return static_cast<uint16_t>(std::min(std::max(value,0.0f),1.0f)*65535.0f+0.5f);
+  }
+
+  uint32_t toUnorm8(float value){
+    return static_cast<uint32_t>(std::min(std::max(value,0.0f),1.0f)*255.0f+0.5f);
+  }
+}
+
+QuadInstance QuadInstance::make(glm::vec2 center, glm::vec2 size, glm::vec4 color, glm::vec4 uvRect,
+    float rotation, float depth){
+  QuadInstance quad;
+  quad.position = center;
+  quad.sizeRotationDepth[0] = toHalf(size.x);
+  quad.sizeRotationDepth[1] = toHalf(size.y);
+  quad.sizeRotationDepth[2] = toHalf(rotation);
+  quad.sizeRotationDepth[3] = toHalf(depth);
+  //R8G8B8A8_UNORM, red in the lowest byte
+  quad.color = toUnorm8(color.x)|toUnorm8(color.y)<<8|toUnorm8(color.z)<<16|toUnorm8(color.w)<<24;
+  quad.uvRect[0] = toUnorm16(uvRect.x);
+  quad.uvRect[1] = toUnorm16(uvRect.y);
+  quad.uvRect[2] = toUnorm16(uvRect.z);
+  quad.uvRect[3] = toUnorm16(uvRect.w);
+  return quad;
+}
+
+VkVertexInputBindingDescription QuadInstance::getBindingDescription(){
+  VkVertexInputBindingDescription bindingDescription = {};
+  bindingDescription.binding = 0;
+  bindingDescription.stride = sizeof(QuadInstance);
+  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+  return bindingDescription;
+}
+
+std::vector<VkVertexInputAttributeDescription> QuadInstance::getAttributeDescriptions(){
+  return {
+    {0, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(QuadInstance,position))},
+    {1, 0, VK_FORMAT_R16G16B16A16_SFLOAT, static_cast<uint32_t>(offsetof(QuadInstance,sizeRotationDepth))},
+    {2, 0, VK_FORMAT_R8G8B8A8_UNORM, static_cast<uint32_t>(offsetof(QuadInstance,color))},
+    {3, 0, VK_FORMAT_R16G16B16A16_UNORM, static_cast<uint32_t>(offsetof(QuadInstance,uvRect))}
+  };
+}
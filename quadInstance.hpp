@@ -0,0 +1,34 @@
+//quadInstance.hpp
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+//one rectangle or sprite of the instanced quad path (shaders/quad.vert). The
+//vertex shader expands it from a unit quad, so a rectangle costs these 28 bytes
+//instead of four 32 byte vertices and six indices. Sizes, rotation and depth are
+//half floats, texture coordinates 16 bit and the color 8 bit normalized.
+struct QuadInstance{
+  //center, in the screen space of DrawList2D
+  glm::vec2 position;
+  uint16_t sizeRotationDepth[4];
+  uint32_t color;
+  //u0 v0 u1 v1
+  uint16_t uvRect[4];
+
+  //rotation in radians counter-clockwise around the center, depth 0 to 1
+  static QuadInstance make(glm::vec2 center, glm::vec2 size, glm::vec4 color,
+      glm::vec4 uvRect = glm::vec4(0.0f,0.0f,1.0f,1.0f), float rotation = 0.0f, float depth = 0.0f);
+
+  static VkVertexInputBindingDescription getBindingDescription();
+  //formats are packed, so unlike Vertex these cannot be reflected from the shader
+  static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+};
+
+static_assert(sizeof(QuadInstance)==28, "QuadInstance must match the vertex input of quad.vert");
@@ -0,0 +1,254 @@
+//readbackRing.cpp
+#include "readbackRing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+static uint32_t findHostMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter,
+    VkMemoryPropertyFlags properties){
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice,&memProperties);
+  for(uint32_t i = 0; i<memProperties.memoryTypeCount; i++){
+    if((typeFilter & (1u<<i)) && (memProperties.memoryTypes[i].propertyFlags & properties)==properties){
+      return i;
+    }
+  }
+  return UINT32_MAX;
+}
+
+static uint32_t bytesPerPixel(VkFormat format){
+  switch(format){
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+      return 4;
+    default:
+      throw std::runtime_error("readback: unsupported color format "+std::to_string(format));
+  }
+}
+
+ReadbackRing::~ReadbackRing(){
+  shutdown();
+}
+
+void ReadbackRing::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
+    VkExtent2D extent, VkFormat format, uint32_t depth, Consumer consumer, MemoryTracker* tracker){
+  d_device = device;
+  d_tracker = tracker;
+  d_extent = extent;
+  d_format = format;
+  d_rowPitch = static_cast<size_t>(extent.width)*bytesPerPixel(format);
+  d_size = d_rowPitch*extent.height;
+  d_consumer = consumer;
+  d_slots.resize(std::max<uint32_t>(depth,1));
+  d_next = 0;
+  d_oldest = 0;
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = queueFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  if(vkCreateCommandPool(d_device,&poolInfo,nullptr,&d_commandPool)!=VK_SUCCESS){
+    throw std::runtime_error("readback: failed to create command pool");
+  }
+
+  for(auto& slot : d_slots){
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = d_size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if(vkCreateBuffer(d_device,&bufferInfo,nullptr,&slot.buffer)!=VK_SUCCESS){
+      throw std::runtime_error("readback: failed to create buffer");
+    }
+
+    //cached memory makes the CPU reads fast, coherent is the fallback every device has
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(d_device,slot.buffer,&memRequirements);
+    uint32_t memoryType = findHostMemoryType(physicalDevice,memRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    if(memoryType==UINT32_MAX){
+      memoryType = findHostMemoryType(physicalDevice,memRequirements.memoryTypeBits,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    if(memoryType==UINT32_MAX){
+      throw std::runtime_error("readback: no host visible memory type");
+    }
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice,&memProperties);
+    d_coherent = (memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)!=0;
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = memoryType;
+    VkResult allocated = d_tracker!=nullptr ? d_tracker->allocate(allocInfo,MemoryCategory::Readback,slot.memory)
+      : vkAllocateMemory(d_device,&allocInfo,nullptr,&slot.memory);
+    if(allocated!=VK_SUCCESS){
+      throw std::runtime_error("readback: failed to allocate buffer memory");
+    }
+    vkBindBufferMemory(d_device,slot.buffer,slot.memory,0);
+    vkMapMemory(d_device,slot.memory,0,VK_WHOLE_SIZE,0,&slot.mapped);
+
+    VkCommandBufferAllocateInfo commandInfo = {};
+    commandInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandInfo.commandPool = d_commandPool;
+    commandInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandInfo.commandBufferCount = 1;
+    if(vkAllocateCommandBuffers(d_device,&commandInfo,&slot.commandBuffer)!=VK_SUCCESS){
+      throw std::runtime_error("readback: failed to allocate command buffer");
+    }
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if(vkCreateFence(d_device,&fenceInfo,nullptr,&slot.fence)!=VK_SUCCESS){
+      throw std::runtime_error("readback: failed to create fence");
+    }
+  }
+
+  d_running = true;
+  d_thread = std::thread(&ReadbackRing::poll,this);
+}
+
+void ReadbackRing::shutdown(){
+  if(d_device==VK_NULL_HANDLE) return;
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_running = false;
+  }
+  d_changed.notify_all();
+  if(d_thread.joinable()) d_thread.join();
+
+  for(auto& slot : d_slots){
+    vkDestroyFence(d_device,slot.fence,nullptr);
+    vkUnmapMemory(d_device,slot.memory);
+    vkDestroyBuffer(d_device,slot.buffer,nullptr);
+    if(d_tracker!=nullptr) d_tracker->free(slot.memory);
+    else vkFreeMemory(d_device,slot.memory,nullptr);
+  }
+  d_slots.clear();
+  vkDestroyCommandPool(d_device,d_commandPool,nullptr);
+  d_commandPool = VK_NULL_HANDLE;
+  d_device = VK_NULL_HANDLE;
+}
+
+VkCommandBuffer ReadbackRing::record(VkImage image, VkImageLayout layout, uint64_t frameIndex, VkFence& fence){
+  std::unique_lock<std::mutex> lock(d_mutex);
+  Slot& slot = d_slots[d_next];
+  if(slot.state!=State::Free){
+    auto start = std::chrono::steady_clock::now();
+    d_changed.wait(lock,[&slot]{ return slot.state==State::Free; });
+    d_stats.stalls++;
+    d_stats.stallMs += std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+  }
+  d_next = (d_next+1)%d_slots.size();
+  lock.unlock();
+
+  //a free slot is not touched by the polling thread, reset it before it can see it in flight
+  vkResetFences(d_device,1,&slot.fence);
+  vkResetCommandBuffer(slot.commandBuffer,0);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(slot.commandBuffer,&beginInfo);
+
+  VkImageMemoryBarrier toTransfer = {};
+  toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  toTransfer.oldLayout = layout;
+  toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.image = image;
+  toTransfer.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  toTransfer.subresourceRange.levelCount = 1;
+  toTransfer.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(slot.commandBuffer,VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,0,0,nullptr,0,nullptr,1,&toTransfer);
+
+  VkBufferImageCopy region = {};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {d_extent.width,d_extent.height,1};
+  vkCmdCopyImageToBuffer(slot.commandBuffer,image,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,slot.buffer,1,&region);
+
+  VkBufferMemoryBarrier toHost = {};
+  toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.buffer = slot.buffer;
+  toHost.size = VK_WHOLE_SIZE;
+  VkImageMemoryBarrier restore = toTransfer;
+  restore.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  restore.dstAccessMask = 0;
+  restore.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  restore.newLayout = layout;
+  vkCmdPipelineBarrier(slot.commandBuffer,VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT|VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,0,0,nullptr,1,&toHost,
+      layout!=VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? 1 : 0,&restore);
+
+  if(vkEndCommandBuffer(slot.commandBuffer)!=VK_SUCCESS){
+    throw std::runtime_error("readback: failed to record copy");
+  }
+
+  lock.lock();
+  slot.frameIndex = frameIndex;
+  slot.state = State::InFlight;
+  d_changed.notify_all();
+  fence = slot.fence;
+  return slot.commandBuffer;
+}
+
+ReadbackRing::Stats ReadbackRing::stats(){
+  std::lock_guard<std::mutex> lock(d_mutex);
+  return d_stats;
+}
+
+void ReadbackRing::poll(){
+  const uint64_t timeout = 1000000;//1ms, keeps shutdown responsive
+  std::unique_lock<std::mutex> lock(d_mutex);
+  while(true){
+    d_changed.wait(lock,[this]{ return !d_running || d_slots[d_oldest].state==State::InFlight; });
+    Slot& slot = d_slots[d_oldest];
+    if(slot.state!=State::InFlight) return;
+    bool running = d_running;
+    lock.unlock();
+
+    VkResult result = vkWaitForFences(d_device,1,&slot.fence,VK_TRUE,timeout);
+    if(result==VK_TIMEOUT && running){
+      lock.lock();
+      continue;
+    }
+    //shutdown happens with the queue idle, a fence that is still unsignaled then
+    //belongs to a copy that was recorded but never submitted
+    if(result==VK_SUCCESS){
+      if(!d_coherent){
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = slot.memory;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(d_device,1,&range);
+      }
+      Frame frame = {slot.frameIndex,static_cast<const uint8_t*>(slot.mapped),
+        d_extent.width,d_extent.height,d_rowPitch,d_format};
+      try{
+        d_consumer(frame);
+      }catch(const std::exception& e){
+        std::cerr<<"readback consumer: "<<e.what()<<std::endl;
+      }
+    }
+
+    lock.lock();
+    if(result==VK_SUCCESS) d_stats.delivered++;
+    slot.state = State::Free;
+    d_oldest = (d_oldest+1)%d_slots.size();
+    d_changed.notify_all();
+  }
+}
@@ -0,0 +1,93 @@
+//readbackRing.hpp
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "memoryTracker.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//copies rendered frames back to the CPU without stalling the GPU. Each frame
+//copies its color image into the next of N host cached buffers, a polling
+//thread hands every buffer whose fence signaled to the consumer and then
+//recycles it. The renderer only waits when all N buffers are still owned by
+//the consumer, which is the back-pressure for slow consumers.
+class ReadbackRing{
+  public:
+    struct Frame{
+      uint64_t index;
+      const uint8_t* pixels;
+      uint32_t width;
+      uint32_t height;
+      size_t rowPitch;
+      VkFormat format;
+    };
+    //called on the polling thread, pixels are only valid until it returns
+    using Consumer = std::function<void(const Frame& frame)>;
+
+    struct Stats{
+      uint64_t delivered = 0;
+      //frames that had to wait for the consumer to hand a buffer back
+      uint64_t stalls = 0;
+      double stallMs = 0.0;
+    };
+
+    ReadbackRing() = default;
+    ~ReadbackRing();
+    ReadbackRing(const ReadbackRing&) = delete;
+    ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+    //buffers are allocated through tracker when one is given
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
+        VkExtent2D extent, VkFormat format, uint32_t depth, Consumer consumer,
+        MemoryTracker* tracker = nullptr);
+    //delivers everything still in flight, then frees the buffers
+    void shutdown();
+    bool active() const { return d_device!=VK_NULL_HANDLE; }
+
+    //records the copy of image (currently in layout, and returned to it) into the
+    //next free buffer. Submit the command buffer after the frame that rendered
+    //image, signaling fence.
+    VkCommandBuffer record(VkImage image, VkImageLayout layout, uint64_t frameIndex, VkFence& fence);
+    Stats stats();
+
+  private:
+    //slots are used and handed back strictly round robin, so d_next is the one
+    //recorded next and d_oldest the one delivered next
+    enum class State{ Free, InFlight };
+    struct Slot{
+      VkBuffer buffer = VK_NULL_HANDLE;
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+      void* mapped = nullptr;
+      VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+      VkFence fence = VK_NULL_HANDLE;
+      uint64_t frameIndex = 0;
+      State state = State::Free;
+    };
+
+    VkDevice d_device = VK_NULL_HANDLE;
+    MemoryTracker* d_tracker = nullptr;
+    VkCommandPool d_commandPool = VK_NULL_HANDLE;
+    VkExtent2D d_extent = {0,0};
+    VkFormat d_format = VK_FORMAT_UNDEFINED;
+    size_t d_rowPitch = 0;
+    VkDeviceSize d_size = 0;
+    bool d_coherent = false;
+    Consumer d_consumer;
+
+    std::vector<Slot> d_slots;
+    size_t d_next = 0;
+    size_t d_oldest = 0;
+    std::mutex d_mutex;
+    std::condition_variable d_changed;
+    bool d_running = false;
+    Stats d_stats;
+    std::thread d_thread;
+
+    void poll();
+};
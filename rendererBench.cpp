@@ -0,0 +1,947 @@
+//rendererBench.cpp
+//renders a fixed set of scenes headless for a fixed number of frames and writes
+//frame time percentiles, cpu/gpu times and memory as JSON. Registered with CTest,
+//one test per scene so every scene gets a fresh process (and a meaningful peak RSS).
+//--sweep instead renders one scene under every frames in flight / present mode
+//combination and reports throughput against input latency. --tessellate <segments>
+//measures the polyline tessellator alone, on the CPU, in segments per second
+#include "basicRender.hpp"
+#include "drawList2D.hpp"
+#include "polylineTessellator.hpp"
+#include "scene2D.hpp"
+#include "text.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "stb/stb_image_write.h"
+
+using Clock = std::chrono::steady_clock;
+using Vertex = BasicRenderer::Vertex;
+
+struct BenchOptions{
+  uint32_t frames = 300;
+  uint32_t warmup = 10;
+  uint32_t width = 800;
+  uint32_t height = 600;
+  std::string assets = ".";
+  std::string scene;
+  std::string output = "renderer_bench.json";
+  //present modes only exist with a window, offscreen the sweep covers frames in flight
+  bool window = false;
+  bool sweep = false;
+  //frame pacing target in ms, negative leaves pacing off
+  double pace = -1.0;
+  //segments of the tessellation dataset, 0 renders scenes instead
+  uint64_t tessellate = 0;
+  //TrueType font of the text scene, a few common system fonts are tried without it
+  std::string font;
+};
+
+struct Scene{
+  std::string name;
+  //configured but not initialized renderer, or null with a reason to skip
+  std::function<std::unique_ptr<BasicRenderer>(const BenchOptions&, std::string& skipReason)> create;
+  //runs before every draw, frame counts from 0 including warmup
+  std::function<void(BasicRenderer&, uint32_t frame)> beforeFrame;
+  //scene specific numbers for the report, after the last frame
+  std::function<void(BasicRenderer&, const BenchOptions&, std::map<std::string,double>&)> counters = nullptr;
+};
+
+struct Distribution{
+  double mean = 0.0;
+  double p50 = 0.0;
+  double p90 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+struct SceneResult{
+  std::string name;
+  std::string skipReason;
+  std::string device;
+  double startupMs = 0.0;
+  double firstFrameMs = 0.0;
+  std::vector<double> frameMs;
+  std::vector<double> cpuMs;
+  std::map<std::string,std::vector<double>> gpuMs;
+  double rssMb = 0.0;
+  double rssPeakMb = 0.0;
+  double gpuMb = 0.0;
+  double gpuPeakMb = 0.0;
+  std::map<std::string,double> gpuCategoryMb;
+  //device allocations still live after shutdown
+  uint32_t leakedAllocations = 0;
+
+  uint32_t framesInFlight = 0;
+  std::string presentMode;
+  uint32_t images = 0;
+  double fps = 0.0;
+  std::vector<double> latencyMs;
+  FramePacer::Stats pacing;
+  std::map<std::string,double> counters;
+};
+
+static double millisecondsSince(Clock::time_point start){
+  return std::chrono::duration<double,std::milli>(Clock::now()-start).count();
+}
+
+//linear interpolation between closest ranks
+static double percentile(const std::vector<double>& sorted, double p){
+  if(sorted.empty()) return 0.0;
+  double rank = p*(sorted.size()-1);
+  size_t below = static_cast<size_t>(rank);
+  size_t above = std::min(below+1,sorted.size()-1);
+  return sorted[below]+(sorted[above]-sorted[below])*(rank-below);
+}
+
+static Distribution distribution(std::vector<double> samples){
+  Distribution result;
+  if(samples.empty()) return result;
+  std::sort(samples.begin(),samples.end());
+  double sum = 0.0;
+  for(double sample : samples) sum += sample;
+  result.mean = sum/samples.size();
+  result.p50 = percentile(samples,0.50);
+  result.p90 = percentile(samples,0.90);
+  result.p95 = percentile(samples,0.95);
+  result.p99 = percentile(samples,0.99);
+  result.max = samples.back();
+  return result;
+}
+
+//resident set size from procfs, zero where that does not exist
+static double residentMb(const char* field){
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while(std::getline(status,line)){
+    if(line.compare(0,strlen(field),field)==0){
+      return std::stod(line.substr(strlen(field)))/1024.0;
+    }
+  }
+  return 0.0;
+}
+
+static void addQuad(glm::vec3 origin, glm::vec3 right, glm::vec3 up, glm::vec3 color,
+    std::vector<Vertex>& vertices, std::vector<uint32_t>& indices){
+  uint32_t offset = static_cast<uint32_t>(vertices.size());
+  vertices.push_back({origin,color,{0.0f,1.0f}});
+  vertices.push_back({origin+right,color,{1.0f,1.0f}});
+  vertices.push_back({origin+right+up,color,{1.0f,0.0f}});
+  vertices.push_back({origin+up,color,{0.0f,0.0f}});
+  for(uint32_t index : {0u,1u,2u,2u,3u,0u}) indices.push_back(offset+index);
+}
+
+static void addCube(glm::vec3 center, float size, glm::vec3 color,
+    std::vector<Vertex>& vertices, std::vector<uint32_t>& indices){
+  float h = size/2;
+  glm::vec3 x(size,0,0), y(0,size,0), z(0,0,size);
+  addQuad(center+glm::vec3(-h,-h,h),x,y,color,vertices,indices);
+  addQuad(center+glm::vec3(-h,h,-h),x,-y,color,vertices,indices);
+  addQuad(center+glm::vec3(-h,-h,-h),x,z,color,vertices,indices);
+  addQuad(center+glm::vec3(h,h,-h),-x,z,color,vertices,indices);
+  addQuad(center+glm::vec3(-h,h,-h),-y,z,color,vertices,indices);
+  addQuad(center+glm::vec3(h,-h,-h),y,z,color,vertices,indices);
+}
+
+static BasicRenderer::Camera lookAt(glm::vec3 eye, glm::vec3 up){
+  BasicRenderer::Camera camera;
+  camera.eye = eye;
+  camera.up = up;
+  return camera;
+}
+
+static void configure(BasicRenderer& renderer, const BenchOptions& options){
+  if(!options.window) renderer.setHeadless(options.width,options.height);
+  renderer.setGpuProfiling(true);
+  if(options.pace>=0.0){
+    FramePacer::Settings pacing;
+    pacing.enabled = true;
+    pacing.targetLatencyMs = options.pace;
+    renderer.setFramePacing(pacing);
+  }
+}
+
+//squares of the dynamic 2D scene, moved every frame through update()
+static const uint32_t DYNAMIC_SQUARES = 2000;
+
+static void dynamicSquares(float t, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices){
+  vertices.clear();
+  indices.clear();
+  for(uint32_t i = 0; i<DYNAMIC_SQUARES; i++){
+    float column = static_cast<float>(i%50), row = static_cast<float>(i/50);
+    glm::vec3 origin(-1.0f+column*0.04f+0.01f*std::sin(t+row), -1.0f+row*0.05f+0.01f*std::cos(t+column), 0.0f);
+    glm::vec3 color(column/50.0f,row/40.0f,0.5f+0.5f*std::sin(t));
+    addQuad(origin,{0.03f,0,0},{0,0.03f,0},color,vertices,indices);
+  }
+}
+
+//primitives the drawList2d scene writes every frame
+static const uint32_t DRAW_LIST_PRIMITIVES = 1000000;
+//segments of the cpuLines and gpuLines scenes
+static const uint32_t LINE_SEGMENTS = 1000000;
+//the polylines scene plots this many series of POLYLINE_POINTS points
+static const uint32_t POLYLINE_SERIES = 100;
+static const uint32_t POLYLINE_POINTS = 1001;
+
+//short spokes on a grid that turn a little every frame, identical for both line scenes
+static void lineSegment(uint32_t i, uint32_t frame, glm::vec2& start, glm::vec2& end, glm::vec4& color){
+  const uint32_t columns = 1000;
+  const float cell = 2.0f/columns;
+  float angle = frame*0.02f+i*0.001f;
+  start = glm::vec2(-1.0f+(i%columns+0.5f)*cell,-1.0f+(i/columns+0.5f)*cell);
+  end = start+glm::vec2(std::cos(angle),std::sin(angle))*(0.8f*cell);
+  color = glm::vec4((i%columns)/float(columns),(i/columns)/float(columns),0.8f,1.0f);
+}
+
+//random walks left to right across the screen, like the series of a line plot
+static void plotSeries(uint32_t series, uint32_t points, uint32_t seed, std::vector<glm::vec2>& out){
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> step(-0.01f,0.01f);
+  out.resize(static_cast<size_t>(series)*points);
+  for(uint32_t s = 0; s<series; s++){
+    float y = -0.9f+1.8f*s/series;
+    for(uint32_t i = 0; i<points; i++){
+      y += step(random);
+      out[static_cast<size_t>(s)*points+i] = glm::vec2(-1.0f+2.0f*i/(points-1),y);
+    }
+  }
+}
+
+//labels of the text scene, about ten glyphs each
+static const uint32_t TEXT_LABELS = 100000;
+//per frame of the text scene, warmup included
+static std::vector<double> textLayoutMs;
+static std::vector<uint32_t> textGlyphs;
+
+//shapes of the retained2d scene, RETAINED_CHANGES of them change every frame
+static const uint32_t RETAINED_SHAPES = 100000;
+static const uint32_t RETAINED_CHANGES = 1000;
+//bytes each draw of the retained2d scene uploaded, warmup included
+static std::vector<double> retainedUploadBytes;
+
+static std::string findFont(const BenchOptions& options){
+  if(!options.font.empty()) return options.font;
+  const char* candidates[] = {"/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/TTF/DejaVuSans.ttf", "/usr/share/fonts/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/truetype/liberation/LiberationSans-Regular.ttf",
+    "/System/Library/Fonts/Supplemental/Arial.ttf", "C:/Windows/Fonts/arial.ttf"};
+  for(const char* candidate : candidates){
+    if(std::filesystem::exists(candidate)) return candidate;
+  }
+  return "";
+}
+
+//large enough that sampling it is not free, generated so no asset has to be checked in
+static std::string writeLargeTexture(){
+  std::string path = (std::filesystem::temp_directory_path()/"renderer_bench_4096.tga").string();
+  if(std::filesystem::exists(path)) return path;
+  const int size = 4096;
+  std::vector<unsigned char> pixels(static_cast<size_t>(size)*size*4);
+  uint32_t state = 12345;
+  for(size_t i = 0; i<pixels.size(); i += 4){
+    state = state*1664525u+1013904223u;
+    size_t pixel = i/4;
+    bool checker = ((pixel%size)/64+(pixel/size)/64)%2;
+    pixels[i+0] = static_cast<unsigned char>((checker ? 200 : 60)+(state>>28));
+    pixels[i+1] = static_cast<unsigned char>(state>>24);
+    pixels[i+2] = static_cast<unsigned char>(checker ? 80 : 180);
+    pixels[i+3] = 255;
+  }
+  stbi_write_tga_with_rle = 0;
+  if(!stbi_write_tga(path.c_str(),size,size,4,pixels.data())){
+    throw std::runtime_error("failed to write "+path);
+  }
+  return path;
+}
+
+static std::vector<Scene> scenes(){
+  std::vector<Scene> list;
+
+  list.push_back({"chalet",
+      [](const BenchOptions& options, std::string& skipReason) -> std::unique_ptr<BasicRenderer>{
+        std::string model = options.assets+"/models/chalet.obj";
+        if(!std::filesystem::exists(model)){
+          skipReason = model+" not found";
+          return nullptr;
+        }
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer());
+        renderer->setModelPath(model);
+        renderer->setTexturePath(options.assets+"/textures/chalet.jpg");
+        configure(*renderer,options);
+        return renderer;
+      },
+      nullptr});
+
+  //every cube is baked into the one vertex buffer, the renderer has no instanced path
+  list.push_back({"instances10k",
+      [](const BenchOptions& options, std::string&) -> std::unique_ptr<BasicRenderer>{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        for(int i = 0; i<10000; i++){
+          glm::vec3 center(-2.0f+(i%100)*0.04f,-2.0f+(i/100)*0.04f,0.0f);
+          addCube(center,0.025f,glm::vec3(1.0f),vertices,indices);
+        }
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(options.assets+"/textures/chain.png");
+        renderer->setCamera(lookAt({0.0f,-3.0f,3.0f},{0.0f,0.0f,1.0f}));
+        configure(*renderer,options);
+        return renderer;
+      },
+      nullptr});
+
+  list.push_back({"dynamic2d",
+      [](const BenchOptions& options, std::string&) -> std::unique_ptr<BasicRenderer>{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        dynamicSquares(0.0f,vertices,indices);
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(options.assets+"/textures/chain.png");
+        renderer->setCamera(lookAt({0.0f,0.0f,2.4f},{0.0f,1.0f,0.0f}));
+        configure(*renderer,options);
+        return renderer;
+      },
+      [](BasicRenderer& renderer, uint32_t frame){
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        dynamicSquares(frame*0.05f,vertices,indices);
+        renderer.update(vertices,std::vector<uint16_t>(indices.begin(),indices.end()));
+      }});
+
+  //screen filling quads drawn back to front, every one of them samples the 4k texture
+  list.push_back({"textureHeavy",
+      [](const BenchOptions& options, std::string&) -> std::unique_ptr<BasicRenderer>{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        for(int layer = 0; layer<32; layer++){
+          float z = -0.5f+layer*0.02f;
+          addQuad({-1.5f,-1.5f,z},{3.0f,0,0},{0,3.0f,0},glm::vec3(1.0f),vertices,indices);
+        }
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(writeLargeTexture());
+        renderer->setCamera(lookAt({0.0f,0.0f,2.0f},{0.0f,1.0f,0.0f}));
+        configure(*renderer,options);
+        return renderer;
+      },
+      nullptr});
+
+  //rebuilt from scratch every frame straight into the mapped arena, half squares half triangles
+  list.push_back({"drawList2d",
+      [](const BenchOptions& options, std::string&) -> std::unique_ptr<BasicRenderer>{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        addQuad({0,0,0},{0.01f,0,0},{0,0.01f,0},glm::vec3(1.0f),vertices,indices);
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(options.assets+"/textures/chain.png");
+        renderer->setDrawList2DCapacity(DRAW_LIST_PRIMITIVES*4,DRAW_LIST_PRIMITIVES*6);
+        configure(*renderer,options);
+        return renderer;
+      },
+      [](BasicRenderer& renderer, uint32_t frame){
+        DrawList2D& list = renderer.beginDrawList2D();
+        const uint32_t columns = 1000;
+        const float cell = 2.0f/columns;
+        float shift = (frame%100)*0.001f;
+        for(uint32_t i = 0; i<DRAW_LIST_PRIMITIVES; i++){
+          glm::vec2 origin(-1.0f+(i%columns)*cell+shift,-1.0f+(i/columns)*cell);
+          glm::vec3 color((i%columns)/float(columns),(i/columns)/float(columns),0.5f);
+          if(i%2==0){
+            list.addRect(origin,glm::vec2(cell*0.8f),color);
+          }else{
+            list.addTriangle(origin,origin+glm::vec2(cell*0.8f,0.0f),origin+glm::vec2(0.0f,cell*0.8f),color);
+          }
+        }
+      }});
+
+  //the same million rectangles as drawList2d, 28 bytes each through the instanced path
+  list.push_back({"instancedQuads",
+      [](const BenchOptions& options, std::string&) -> std::unique_ptr<BasicRenderer>{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        addQuad({0,0,0},{0.01f,0,0},{0,0.01f,0},glm::vec3(1.0f),vertices,indices);
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(options.assets+"/textures/chain.png");
+        renderer->setDrawList2DCapacity(4,6,DRAW_LIST_PRIMITIVES);
+        configure(*renderer,options);
+        return renderer;
+      },
+      [](BasicRenderer& renderer, uint32_t frame){
+        DrawList2D& list = renderer.beginDrawList2D();
+        QuadInstance* quads = list.reserveQuads(DRAW_LIST_PRIMITIVES);
+        if(quads==nullptr) return;
+        const uint32_t columns = 1000;
+        const float cell = 2.0f/columns;
+        float shift = (frame%100)*0.001f;
+        float rotation = (frame%360)*0.0174533f;
+        for(uint32_t i = 0; i<DRAW_LIST_PRIMITIVES; i++){
+          glm::vec2 center(-1.0f+(i%columns+0.5f)*cell+shift,-1.0f+(i/columns+0.5f)*cell);
+          glm::vec4 color((i%columns)/float(columns),(i/columns)/float(columns),0.5f,1.0f);
+          quads[i] = QuadInstance::make(center,glm::vec2(cell*0.8f),color,glm::vec4(0,0,1,1),rotation);
+        }
+      }});
+
+  //the million segments of gpuLines through DrawList2D::addLine, 4 vertices and 6 indices each
+  list.push_back({"cpuLines",
+      [](const BenchOptions& options, std::string&) -> std::unique_ptr<BasicRenderer>{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        addQuad({0,0,0},{0.01f,0,0},{0,0.01f,0},glm::vec3(1.0f),vertices,indices);
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(options.assets+"/textures/chain.png");
+        renderer->setDrawList2DCapacity(LINE_SEGMENTS*4,LINE_SEGMENTS*6);
+        configure(*renderer,options);
+        return renderer;
+      },
+      [](BasicRenderer& renderer, uint32_t frame){
+        DrawList2D& list = renderer.beginDrawList2D();
+        const float width = 0.0015f;
+        for(uint32_t i = 0; i<LINE_SEGMENTS; i++){
+          glm::vec2 start, end;
+          glm::vec4 color;
+          lineSegment(i,frame,start,end,color);
+          list.addLine(start,end,width,glm::vec3(color.x,color.y,color.z));
+        }
+      }});
+
+  //the same segments as cpuLines, 24 bytes each and expanded by line.vert
+  list.push_back({"gpuLines",
+      [](const BenchOptions& options, std::string&) -> std::unique_ptr<BasicRenderer>{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        addQuad({0,0,0},{0.01f,0,0},{0,0.01f,0},glm::vec3(1.0f),vertices,indices);
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(options.assets+"/textures/chain.png");
+        renderer->setDrawList2DCapacity(4,6,0,LINE_SEGMENTS);
+        configure(*renderer,options);
+        return renderer;
+      },
+      [](BasicRenderer& renderer, uint32_t frame){
+        DrawList2D& list = renderer.beginDrawList2D();
+        LineSegment* segments = list.reserveSegments(LINE_SEGMENTS);
+        if(segments==nullptr) return;
+        const float width = 0.0015f;
+        for(uint32_t i = 0; i<LINE_SEGMENTS; i++){
+          glm::vec2 start, end;
+          glm::vec4 color;
+          lineSegment(i,frame,start,end,color);
+          segments[i] = LineSegment::make(start,end,width,color);
+        }
+      }});
+
+  //a line plot tessellated again every frame, the series drift so nothing can be reused
+  list.push_back({"polylines",
+      [](const BenchOptions& options, std::string&) -> std::unique_ptr<BasicRenderer>{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        addQuad({0,0,0},{0.01f,0,0},{0,0.01f,0},glm::vec3(1.0f),vertices,indices);
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(options.assets+"/textures/chain.png");
+        //a segment and its miter join are at most 6 vertices and 12 indices
+        renderer->setDrawList2DCapacity(POLYLINE_SERIES*POLYLINE_POINTS*6,POLYLINE_SERIES*POLYLINE_POINTS*12);
+        configure(*renderer,options);
+        return renderer;
+      },
+      [](BasicRenderer& renderer, uint32_t frame){
+        static std::vector<glm::vec2> points;
+        static std::vector<uint32_t> counts(POLYLINE_SERIES,POLYLINE_POINTS);
+        static std::vector<glm::vec3> colors;
+        static PolylineTessellator tessellator;
+        if(points.empty()){
+          plotSeries(POLYLINE_SERIES,POLYLINE_POINTS,7,points);
+          for(uint32_t s = 0; s<POLYLINE_SERIES; s++){
+            colors.push_back(glm::vec3(s/float(POLYLINE_SERIES),0.5f,1.0f-s/float(POLYLINE_SERIES)));
+          }
+          PolylineStyle style;
+          style.width = 0.003f;
+          tessellator.setStyle(style);
+        }
+        for(size_t i = 0; i<points.size(); i++){
+          points[i].y += 0.0005f*std::sin(frame*0.1f+i*0.01f);
+        }
+        DrawList2D& list = renderer.beginDrawList2D();
+        tessellator.addBatch(list,points.data(),counts.data(),POLYLINE_SERIES,colors.data());
+      }});
+
+  //every label laid out from its UTF-8 string every frame at five sizes, the atlas
+  //only rasterizes on the first frame
+  list.push_back({"text100k",
+      [](const BenchOptions& options, std::string& skipReason) -> std::unique_ptr<BasicRenderer>{
+        std::string font = findFont(options);
+        if(font.empty()){
+          skipReason = "no font found, pass --font";
+          return nullptr;
+        }
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        addQuad({0,0,0},{0.01f,0,0},{0,0.01f,0},glm::vec3(1.0f),vertices,indices);
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(options.assets+"/textures/chain.png");
+        renderer->setDrawList2DCapacity(4,6,TEXT_LABELS*16);
+        renderer->setTextFont(font);
+        configure(*renderer,options);
+        textLayoutMs.clear();
+        textGlyphs.clear();
+        return renderer;
+      },
+      [](BasicRenderer& renderer, uint32_t frame){
+        static const char* words[] = {"pump","Valve","sensor","Gate","tower","relay","Zone","bridge"};
+        //a sweep renders the scene with a new renderer, and atlas, for each configuration
+        static std::unique_ptr<TextLayout> layout;
+        static GlyphAtlas* atlas = nullptr;
+        if(atlas!=&renderer.glyphAtlas()){
+          atlas = &renderer.glyphAtlas();
+          layout.reset(new TextLayout(*atlas));
+        }
+        DrawList2D& list = renderer.beginDrawList2D();
+        auto start = Clock::now();
+        uint32_t glyphs = 0;
+        char label[32];
+        TextStyle style;
+        for(uint32_t i = 0; i<TEXT_LABELS; i++){
+          snprintf(label,sizeof(label),"%s %u",words[i%8],i+frame);
+          style.size = 8.0f+(i%5)*4.0f;
+          glyphs += layout->add(list,label,glm::vec2(-1.0f+(i%400)*0.005f,1.0f-(i/400)*0.008f),style);
+        }
+        textLayoutMs.push_back(millisecondsSince(start));
+        textGlyphs.push_back(glyphs);
+      },
+      [](BasicRenderer& renderer, const BenchOptions& options, std::map<std::string,double>& counters){
+        double ms = 0.0, glyphs = 0.0;
+        for(size_t i = options.warmup; i<textLayoutMs.size(); i++){
+          ms += textLayoutMs[i];
+          glyphs += textGlyphs[i];
+        }
+        size_t frames = textLayoutMs.size()>options.warmup ? textLayoutMs.size()-options.warmup : 0;
+        counters["glyphsPerFrame"] = frames>0 ? glyphs/frames : 0.0;
+        counters["layoutMs"] = frames>0 ? ms/frames : 0.0;
+        counters["glyphsPerSecond"] = ms>0.0 ? glyphs*1000.0/ms : 0.0;
+        const GlyphAtlas::Stats& atlas = renderer.glyphAtlas().stats();
+        counters["atlasMisses"] = static_cast<double>(atlas.misses);
+        counters["atlasEvictions"] = static_cast<double>(atlas.evictions);
+        counters["atlasDropped"] = static_cast<double>(atlas.dropped);
+      }});
+
+  //a hundred thousand shapes kept in a Scene2D, one percent move every frame and every
+  //tenth frame some are replaced by others of another size, which fragments the buffers
+  list.push_back({"retained2d",
+      [](const BenchOptions& options, std::string&) -> std::unique_ptr<BasicRenderer>{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        addQuad({0,0,0},{0.01f,0,0},{0,0.01f,0},glm::vec3(1.0f),vertices,indices);
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(options.assets+"/textures/chain.png");
+        renderer->setScene2DCapacity(RETAINED_SHAPES*4,RETAINED_SHAPES*6);
+        configure(*renderer,options);
+        retainedUploadBytes.clear();
+        return renderer;
+      },
+      [](BasicRenderer& renderer, uint32_t frame){
+        static std::vector<Scene2D::Handle> handles;
+        const uint32_t columns = 400;
+        const float cell = 2.0f/columns;
+        auto shape = [&](uint32_t i, uint32_t frame){
+          glm::vec2 origin(-1.0f+(i%columns)*cell,-1.0f+(i/columns)*cell*0.8f);
+          origin.x += 0.2f*cell*std::sin(frame*0.1f+i);
+          glm::vec3 color((i%columns)/float(columns),(i/columns)/float(columns),0.5f);
+          if((i+frame/10)%3!=0) return Shape2D::rect(origin,glm::vec2(cell*0.8f),color);
+          //polylines take more room than the rectangles they replace
+          glm::vec2 points[] = {origin,origin+glm::vec2(cell*0.4f,cell*0.6f),origin+glm::vec2(cell*0.8f,0.0f)};
+          PolylineStyle style;
+          style.width = cell*0.1f;
+          return Shape2D::polyline(points,3,style,color);
+        };
+        Scene2D& scene = renderer.scene2D();
+        if(frame==0){
+          handles.clear();
+          for(uint32_t i = 0; i<RETAINED_SHAPES; i++) handles.push_back(scene.add(shape(i,frame)));
+          return;
+        }
+        retainedUploadBytes.push_back(static_cast<double>(scene.stats().uploadBytes));
+        uint32_t first = frame*RETAINED_CHANGES%RETAINED_SHAPES;
+        for(uint32_t i = first; i<first+RETAINED_CHANGES; i++){
+          if(frame%10==0){
+            scene.remove(handles[i]);
+            handles[i] = scene.add(shape(i,frame));
+          }else{
+            scene.set(handles[i],shape(i,frame));
+          }
+        }
+      },
+      [](BasicRenderer& renderer, const BenchOptions& options, std::map<std::string,double>& counters){
+        const Scene2D& scene = renderer.scene2D();
+        retainedUploadBytes.push_back(static_cast<double>(scene.stats().uploadBytes));
+        double bytes = 0.0;
+        for(size_t i = options.warmup; i<retainedUploadBytes.size(); i++) bytes += retainedUploadBytes[i];
+        size_t frames = retainedUploadBytes.size()>options.warmup ? retainedUploadBytes.size()-options.warmup : 0;
+        double fullBytes = static_cast<double>(scene.vertexEnd())*sizeof(Vertex)+static_cast<double>(scene.indexEnd())*scene.indexSize();
+        counters["uploadBytesPerFrame"] = frames>0 ? bytes/frames : 0.0;
+        counters["fullUploadBytes"] = fullBytes;
+        counters["uploadShare"] = frames>0 && fullBytes>0.0 ? bytes/frames/fullBytes : 0.0;
+        counters["compactions"] = scene.stats().compactions;
+      }});
+
+  list.push_back({"resizeStorm",
+      [](const BenchOptions& options, std::string&) -> std::unique_ptr<BasicRenderer>{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        addCube({0,0,0},1.0f,glm::vec3(1.0f),vertices,indices);
+        std::unique_ptr<BasicRenderer> renderer(new BasicRenderer(vertices,indices));
+        renderer->setTexturePath(options.assets+"/textures/chain.png");
+        configure(*renderer,options);
+        return renderer;
+      },
+      [](BasicRenderer& renderer, uint32_t frame){
+        static const uint32_t sizes[][2] = {{1280,720},{640,480},{1024,768},{320,240},{800,600}};
+        if(frame%5==4){
+          const uint32_t* size = sizes[(frame/5)%5];
+          renderer.resize(size[0],size[1]);
+        }
+      }});
+
+  return list;
+}
+
+static SceneResult runScene(const Scene& scene, const BenchOptions& options,
+    const BasicRenderer::SwapchainConfig& swapchain){
+  SceneResult result;
+  result.name = scene.name;
+  std::unique_ptr<BasicRenderer> renderer = scene.create(options,result.skipReason);
+  if(!renderer) return result;
+  renderer->setSwapchainConfig(swapchain);
+
+  auto start = Clock::now();
+  renderer->initialize();
+  result.startupMs = millisecondsSince(start);
+  result.device = renderer->deviceName();
+  result.framesInFlight = swapchain.framesInFlight;
+  result.presentMode = renderer->isHeadless() ? "offscreen" : BasicRenderer::presentModeName(renderer->presentMode());
+  result.images = renderer->swapchainImageCount();
+
+  auto drainGpuSamples = [&](bool keep){
+    for(const auto& sample : renderer->gpuProfiler().takeSamples()){
+      if(keep) result.gpuMs[sample.name].push_back(sample.endMs-sample.startMs);
+    }
+  };
+
+  auto drainLatency = [&](bool keep){
+    for(double latency : renderer->takeLatencySamples()){
+      if(keep) result.latencyMs.push_back(latency);
+    }
+  };
+
+  auto frameEnd = Clock::now();
+  for(uint32_t frame = 0; frame<options.warmup+options.frames; frame++){
+    if(!renderer->isHeadless()) glfwPollEvents();
+    if(scene.beforeFrame) scene.beforeFrame(*renderer,frame);
+    auto drawStart = Clock::now();
+    renderer->draw();
+    auto now = Clock::now();
+    if(frame==0){
+      result.firstFrameMs = std::chrono::duration<double,std::milli>(now-start).count();
+    }
+    if(frame>=options.warmup){
+      result.frameMs.push_back(std::chrono::duration<double,std::milli>(now-frameEnd).count());
+      result.cpuMs.push_back(std::chrono::duration<double,std::milli>(now-drawStart).count());
+    }
+    frameEnd = now;
+    //the profiler only keeps a few thousand samples, drain it well before that
+    if(frame%64==63 || frame+1==options.warmup){
+      drainGpuSamples(frame>=options.warmup);
+      drainLatency(frame>=options.warmup);
+    }
+  }
+  drainLatency(true);
+  result.pacing = renderer->framePacingStats();
+  if(scene.counters) scene.counters(*renderer,options,result.counters);
+  double measuredMs = 0.0;
+  for(double ms : result.frameMs) measuredMs += ms;
+  result.fps = measuredMs>0.0 ? result.frameMs.size()*1000.0/measuredMs : 0.0;
+  result.rssMb = residentMb("VmRSS:");
+  result.rssPeakMb = residentMb("VmHWM:");
+  const MemoryTracker& memory = renderer->memoryTracker();
+  result.gpuMb = memory.total().liveBytes/(1024.0*1024.0);
+  result.gpuPeakMb = memory.total().peakBytes/(1024.0*1024.0);
+  for(size_t i = 0; i<static_cast<size_t>(MemoryCategory::Count); i++){
+    MemoryCategory category = static_cast<MemoryCategory>(i);
+    MemoryTracker::Usage usage = memory.usage(category);
+    if(usage.totalAllocations>0){
+      result.gpuCategoryMb[MemoryTracker::categoryName(category)] = usage.liveBytes/(1024.0*1024.0);
+    }
+  }
+  renderer->shutdown();
+  result.leakedAllocations = memory.total().liveAllocations;
+  drainGpuSamples(true);
+  return result;
+}
+
+struct TessellationResult{
+  std::string join;
+  double ms = 0.0;
+  double segmentsPerSecond = 0.0;
+  //times the arena filled up and was started over
+  uint32_t flushes = 0;
+};
+
+//tessellates options.tessellate segments as plot series of 1000 segments with every join,
+//into a host arena that is started over whenever it fills up, as a frame would be
+static std::vector<TessellationResult> runTessellation(const BenchOptions& options){
+  const uint32_t points = 1001;
+  uint32_t series = static_cast<uint32_t>((options.tessellate+points-2)/(points-1));
+  std::vector<glm::vec2> dataset;
+  plotSeries(series,points,7,dataset);
+  std::vector<uint32_t> counts(series,points);
+  std::vector<glm::vec3> colors(series,glm::vec3(1.0f));
+  const uint32_t arenaVertices = 4000000;
+  std::vector<Vertex> vertices(arenaVertices);
+  std::vector<DrawList2D::Index> indices(arenaVertices*2);
+  DrawList2D::Arena arena;
+  arena.vertices = vertices.data();
+  arena.vertexCapacity = arenaVertices;
+  arena.indices = indices.data();
+  arena.indexCapacity = arenaVertices*2;
+  DrawList2D list;
+
+  std::vector<TessellationResult> results;
+  const std::pair<LineJoin,const char*> joins[] = {
+    {LineJoin::Miter,"miter"},{LineJoin::Bevel,"bevel"},{LineJoin::Round,"round"}};
+  for(const auto& join : joins){
+    PolylineTessellator tessellator;
+    PolylineStyle style;
+    style.width = 0.002f;
+    style.join = join.first;
+    style.cap = LineCap::Round;
+    tessellator.setStyle(style);
+    TessellationResult result;
+    result.join = join.second;
+    auto start = Clock::now();
+    uint32_t done = 0;
+    while(done<series){
+      list.reset(arena);
+      uint32_t written = tessellator.addBatch(list,dataset.data()+static_cast<size_t>(done)*points,
+          counts.data()+done,series-done,colors.data()+done);
+      if(written==0) throw std::runtime_error("a single series does not fit the tessellation arena");
+      done += written;
+      result.flushes++;
+    }
+    result.ms = millisecondsSince(start);
+    result.segmentsPerSecond = static_cast<double>(series)*(points-1)/(result.ms/1000.0);
+    results.push_back(result);
+  }
+  return results;
+}
+
+static void writeDistribution(std::ostream& out, const std::string& name, const std::vector<double>& samples){
+  Distribution d = distribution(samples);
+  out<<"\""<<name<<"\": {\"mean\": "<<d.mean<<", \"p50\": "<<d.p50<<", \"p90\": "<<d.p90
+    <<", \"p95\": "<<d.p95<<", \"p99\": "<<d.p99<<", \"max\": "<<d.max<<"}";
+}
+
+static void writeJson(std::ostream& out, const BenchOptions& options, const std::string& device,
+    const std::vector<SceneResult>& results){
+  out<<"{\n  \"device\": \""<<device<<"\",\n";
+  out<<"  \"frames\": "<<options.frames<<", \"warmup\": "<<options.warmup
+    <<", \"width\": "<<options.width<<", \"height\": "<<options.height<<",\n";
+  out<<(options.sweep ? "  \"sweep\": [" : "  \"scenes\": [");
+  for(size_t i = 0; i<results.size(); i++){
+    const SceneResult& result = results[i];
+    out<<(i==0 ? "\n" : ",\n")<<"    {\"name\": \""<<result.name<<"\"";
+    if(!result.skipReason.empty()){
+      out<<", \"skipped\": \""<<result.skipReason<<"\"}";
+      continue;
+    }
+    out<<", \"framesInFlight\": "<<result.framesInFlight<<", \"presentMode\": \""<<result.presentMode
+      <<"\", \"images\": "<<result.images;
+    out<<",\n     \"startupMs\": "<<result.startupMs<<", \"firstFrameMs\": "<<result.firstFrameMs
+      <<", \"fps\": "<<result.fps<<",\n     ";
+    writeDistribution(out,"frameMs",result.frameMs);
+    out<<",\n     ";
+    writeDistribution(out,"latencyMs",result.latencyMs);
+    out<<",\n     ";
+    writeDistribution(out,"cpuMs",result.cpuMs);
+    out<<",\n     \"gpuMs\": {";
+    bool first = true;
+    for(const auto& zone : result.gpuMs){
+      out<<(first ? "" : ", ");
+      writeDistribution(out,zone.first,zone.second);
+      first = false;
+    }
+    out<<"},\n     \"pacing\": {\"source\": \""<<FramePacer::sourceName(result.pacing.source)
+      <<"\", \"refreshMs\": "<<result.pacing.refreshMs<<", \"intervalMs\": "<<result.pacing.intervalMeanMs
+      <<", \"jitterMs\": "<<result.pacing.jitterMs<<", \"maxDeviationMs\": "<<result.pacing.maxDeviationMs
+      <<", \"sleptMs\": "<<result.pacing.sleptMs;
+    if(!result.counters.empty()){
+      out<<"},\n     \"counters\": {";
+      first = true;
+      for(const auto& counter : result.counters){
+        out<<(first ? "" : ", ")<<"\""<<counter.first<<"\": "<<counter.second;
+        first = false;
+      }
+    }
+    out<<"},\n     \"memory\": {\"rssMb\": "<<result.rssMb<<", \"rssPeakMb\": "<<result.rssPeakMb
+      <<", \"gpuMb\": "<<result.gpuMb<<", \"gpuPeakMb\": "<<result.gpuPeakMb
+      <<", \"leakedAllocations\": "<<result.leakedAllocations<<", \"gpuCategoriesMb\": {";
+    first = true;
+    for(const auto& category : result.gpuCategoryMb){
+      out<<(first ? "" : ", ")<<"\""<<category.first<<"\": "<<category.second;
+      first = false;
+    }
+    out<<"}},\n";
+    out<<"     \"frameSamplesMs\": [";
+    for(size_t f = 0; f<result.frameMs.size(); f++){
+      out<<(f==0 ? "" : ", ")<<result.frameMs[f];
+    }
+    out<<"]}";
+  }
+  out<<"\n  ]\n}\n";
+}
+
+int main(int argc, char** argv){
+  BenchOptions options;
+  for(int i = 1; i<argc; i++){
+    std::string arg = argv[i];
+    bool hasValue = i+1<argc;
+    if(arg=="--frames" && hasValue) options.frames = std::stoul(argv[++i]);
+    else if(arg=="--warmup" && hasValue) options.warmup = std::stoul(argv[++i]);
+    else if(arg=="--width" && hasValue) options.width = std::stoul(argv[++i]);
+    else if(arg=="--height" && hasValue) options.height = std::stoul(argv[++i]);
+    else if(arg=="--assets" && hasValue) options.assets = argv[++i];
+    else if(arg=="--scene" && hasValue) options.scene = argv[++i];
+    else if(arg=="--out" && hasValue) options.output = argv[++i];
+    else if(arg=="--window") options.window = true;
+    else if(arg=="--sweep") options.sweep = true;
+    else if(arg=="--pace" && hasValue) options.pace = std::stod(argv[++i]);
+    else if(arg=="--tessellate" && hasValue) options.tessellate = std::stoull(argv[++i]);
+    else if(arg=="--font" && hasValue) options.font = argv[++i];
+    else{
+      std::cerr<<"usage: renderer_bench [--scene name] [--frames n] [--warmup n] [--width w] [--height h]"
+        " [--assets dir] [--out file.json] [--window] [--sweep] [--pace targetMs] [--tessellate segments]"
+        " [--font file.ttf]"<<std::endl;
+      return 2;
+    }
+  }
+  if(options.tessellate>0){
+    std::vector<TessellationResult> results;
+    try{
+      results = runTessellation(options);
+    }catch(const std::exception& e){
+      std::cerr<<"benchmark failed: "<<e.what()<<std::endl;
+      return 1;
+    }
+    std::filesystem::path output(options.output);
+    if(output.has_parent_path()) std::filesystem::create_directories(output.parent_path());
+    std::ofstream out(options.output);
+    out<<"{\n  \"segments\": "<<options.tessellate<<",\n  \"tessellation\": [";
+    for(size_t i = 0; i<results.size(); i++){
+      const TessellationResult& result = results[i];
+      std::cout<<"tessellate "<<result.join<<": "<<result.segmentsPerSecond/1e6<<" M segments/s, "
+        <<result.ms<<" ms"<<std::endl;
+      out<<(i==0 ? "\n" : ",\n")<<"    {\"join\": \""<<result.join<<"\", \"ms\": "<<result.ms
+        <<", \"segmentsPerSecond\": "<<result.segmentsPerSecond<<", \"flushes\": "<<result.flushes<<"}";
+    }
+    out<<"\n  ]\n}\n";
+    if(!out.good()){
+      std::cerr<<"failed to write "<<options.output<<std::endl;
+      return 1;
+    }
+    std::cout<<"results written to "<<options.output<<std::endl;
+    return 0;
+  }
+  if(options.sweep && options.scene.empty()) options.scene = "instances10k";
+
+  std::vector<SceneResult> results;
+  std::string device;
+  bool leaked = false;
+  try{
+    //interactive use wants the low latency end, batch rendering the high throughput end
+    std::vector<BasicRenderer::SwapchainConfig> configs;
+    std::vector<std::vector<VkPresentModeKHR>> presentModes = {{VK_PRESENT_MODE_FIFO_KHR}};
+    if(options.sweep && options.window){
+      presentModes = {{VK_PRESENT_MODE_FIFO_KHR},{VK_PRESENT_MODE_FIFO_RELAXED_KHR},
+        {VK_PRESENT_MODE_MAILBOX_KHR},{VK_PRESENT_MODE_IMMEDIATE_KHR}};
+    }
+    for(uint32_t framesInFlight = 1; framesInFlight<=4; framesInFlight++){
+      for(const auto& modes : presentModes){
+        BasicRenderer::SwapchainConfig config;
+        config.framesInFlight = framesInFlight;
+        config.presentModes = modes;
+        configs.push_back(config);
+      }
+    }
+    if(!options.sweep) configs = {BasicRenderer::SwapchainConfig()};
+
+    std::vector<std::pair<const Scene*,BasicRenderer::SwapchainConfig>> runs;
+    std::vector<Scene> sceneList = scenes();
+    for(const Scene& scene : sceneList){
+      if(!options.scene.empty() && scene.name!=options.scene) continue;
+      for(const auto& config : configs) runs.push_back({&scene,config});
+    }
+    for(const auto& run : runs){
+      const Scene& scene = *run.first;
+      std::cout<<"bench "<<scene.name;
+      if(options.sweep){
+        std::cout<<", "<<run.second.framesInFlight<<" frames in flight, "
+          <<BasicRenderer::presentModeName(run.second.presentModes.front());
+      }
+      std::cout<<std::endl;
+      results.push_back(runScene(scene,options,run.second));
+      const SceneResult& result = results.back();
+      if(device.empty()) device = result.device;
+      if(!result.skipReason.empty()){
+        std::cout<<"  skipped: "<<result.skipReason<<std::endl;
+        continue;
+      }
+      Distribution frame = distribution(result.frameMs);
+      std::cout<<"  startup "<<result.startupMs<<" ms, frame p50 "<<frame.p50<<" ms, p95 "<<frame.p95
+        <<" ms, peak rss "<<result.rssPeakMb<<" MB, peak device memory "<<result.gpuPeakMb<<" MB"<<std::endl;
+      for(const auto& counter : result.counters){
+        std::cout<<"  "<<counter.first<<" "<<counter.second<<std::endl;
+      }
+      if(result.leakedAllocations>0){
+        std::cerr<<"  "<<result.leakedAllocations<<" device allocation(s) leaked"<<std::endl;
+        leaked = true;
+      }
+    }
+    if(results.empty()){
+      std::cerr<<"no scene named "<<options.scene<<std::endl;
+      return 2;
+    }
+    if(options.sweep){
+      std::cout<<std::endl<<"in flight  present       images       fps  latency p50  latency p95"<<std::endl;
+      for(const SceneResult& result : results){
+        if(!result.skipReason.empty()) continue;
+        Distribution latency = distribution(result.latencyMs);
+        std::cout<<std::fixed<<std::setprecision(2)<<std::setw(9)<<result.framesInFlight<<"  "
+          <<std::left<<std::setw(12)<<result.presentMode<<std::right<<std::setw(8)<<result.images
+          <<std::setw(10)<<result.fps<<std::setw(13)<<latency.p50<<std::setw(13)<<latency.p95<<std::endl;
+      }
+    }
+  }catch(const std::exception& e){
+    std::cerr<<"benchmark failed: "<<e.what()<<std::endl;
+    return 1;
+  }
+
+  std::filesystem::path output(options.output);
+  if(output.has_parent_path()) std::filesystem::create_directories(output.parent_path());
+  std::ofstream out(options.output);
+  writeJson(out,options,device,results);
+  if(!out.good()){
+    std::cerr<<"failed to write "<<options.output<<std::endl;
+    return 1;
+  }
+  std::cout<<"results written to "<<options.output<<std::endl;
+  return leaked ? 1 : 0;
+}
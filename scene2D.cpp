@@ -0,0 +1,373 @@
+//scene2D.cpp
+#include "scene2D.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+//dirty ranges this close together are uploaded as one, a few elements more beat another copy region
+static const uint32_t MERGE_GAP = 32;
+//below this many elements fragmentation is not worth a compaction
+static const uint32_t MIN_COMPACTION = 4096;
+//room of the scratch list before the first shape that needs more
+static const uint32_t SCRATCH_VERTICES = 1024;
+
+Shape2D Shape2D::rect(glm::vec2 bottomLeft, glm::vec2 size, glm::vec3 color){
+  Shape2D shape;
+  shape.kind = Kind::Rect;
+  shape.points = {bottomLeft, size};
+  shape.color = color;
+  return shape;
+}
+
+Shape2D Shape2D::triangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec3 color){
+  Shape2D shape;
+  shape.kind = Kind::Triangle;
+  shape.points = {a, b, c};
+  shape.color = color;
+  return shape;
+}
+
+Shape2D Shape2D::line(glm::vec2 start, glm::vec2 end, float thickness, glm::vec3 color){
+  Shape2D shape;
+  shape.kind = Kind::Line;
+  shape.points = {start, end};
+  shape.color = color;
+  shape.thickness = thickness;
+  return shape;
+}
+
+Shape2D Shape2D::polyline(const glm::vec2* points, uint32_t count, const PolylineStyle& style, glm::vec3 color){
+  Shape2D shape;
+  shape.kind = Kind::Polyline;
+  shape.points.assign(points, points+count);
+  shape.color = color;
+  shape.style = style;
+  return shape;
+}
+
+Aabb Shape2D::bounds() const{
+  Aabb box;
+  if(points.empty()) return box;
+  if(kind == Kind::Rect){
+    box.add(glm::vec3(points[0],0.0f));
+    box.add(glm::vec3(points[0]+points[1],0.0f));
+    return box;
+  }
+  for(glm::vec2 point : points) box.add(glm::vec3(point,0.0f));
+  if(kind == Kind::Triangle) return box;
+  //how far from a point the outline can reach, in half widths
+  float halfWidth = kind == Kind::Line ? 0.5f*thickness : 0.5f*style.width;
+  float reach = 1.0f;
+  if(kind == Kind::Polyline){
+    if(style.join == LineJoin::Miter && !(points.size() < 3 && !style.closed)) reach = std::max(reach, style.miterLimit);
+    if(style.cap == LineCap::Square && !style.closed) reach = std::max(reach, 1.41421356f);
+  }
+  box = box.expanded(halfWidth*reach);
+  box.min.z = box.max.z = 0.0f;
+  return box;
+}
+
+Scene2D::Range Scene2D::SlotAllocator::allocate(uint32_t count){
+  if(count == 0) return Range();
+  for(size_t i = 0; i < d_free.size(); i++){
+    Range& range = d_free[i];
+    if(range.count < count) continue;
+    Range taken{range.first, count};
+    range.first += count;
+    range.count -= count;
+    if(range.count == 0) d_free.erase(d_free.begin()+i);
+    d_freeCount -= count;
+    return taken;
+  }
+  Range taken{d_end, count};
+  d_end += count;
+  return taken;
+}
+
+void Scene2D::SlotAllocator::release(Range range){
+  if(range.count == 0) return;
+  auto next = std::lower_bound(d_free.begin(), d_free.end(), range.first,
+      [](const Range& free, uint32_t first){ return free.first < first; });
+  if(next != d_free.end() && range.first+range.count == next->first){
+    range.count += next->count;
+    d_freeCount -= next->count;
+    next = d_free.erase(next);
+  }
+  if(next != d_free.begin()){
+    Range& previous = *(next-1);
+    if(previous.first+previous.count == range.first){
+      range.first = previous.first;
+      range.count += previous.count;
+      d_freeCount -= previous.count;
+      next = d_free.erase(next-1);
+    }
+  }
+  //free space at the end gives the end back instead
+  if(range.first+range.count == d_end){
+    d_end = range.first;
+    return;
+  }
+  d_free.insert(next, range);
+  d_freeCount += range.count;
+}
+
+void Scene2D::SlotAllocator::reset(uint32_t end){
+  d_free.clear();
+  d_end = end;
+  d_freeCount = 0;
+}
+
+Scene2D::Handle Scene2D::add(const Shape2D& shape){
+  uint32_t index;
+  if(!d_freeEntries.empty()){
+    index = d_freeEntries.back();
+    d_freeEntries.pop_back();
+  }else{
+    index = static_cast<uint32_t>(d_entries.size());
+    d_entries.emplace_back();
+  }
+  Entry& added = d_entries[index];
+  added = Entry();
+  added.shape = shape;
+  added.live = true;
+  added.changed = true;
+  d_changed.push_back(index);
+  d_stats.shapes++;
+  return index+1;
+}
+
+void Scene2D::set(Handle handle, const Shape2D& shape){
+  Entry& changed = entry(handle);
+  changed.shape = shape;
+  if(changed.changed) return;
+  changed.changed = true;
+  d_changed.push_back(handle-1);
+}
+
+void Scene2D::remove(Handle handle){
+  Entry& removed = entry(handle);
+  releaseRanges(removed);
+  removed.live = false;
+  removed.shape = Shape2D();
+  //a pending change of it is skipped by flush, the entry can only be reused after that
+  if(!removed.changed) d_freeEntries.push_back(handle-1);
+  d_stats.shapes--;
+}
+
+bool Scene2D::contains(Handle handle) const{
+  return handle != 0 && handle <= d_entries.size() && d_entries[handle-1].live;
+}
+
+const Shape2D& Scene2D::shape(Handle handle) const{
+  return entry(handle).shape;
+}
+
+void Scene2D::setCompactionThreshold(float share){
+  if(share <= 0.0f || share >= 1.0f) throw std::logic_error("compaction threshold must be between 0 and 1");
+  d_compactionThreshold = share;
+}
+
+void Scene2D::setIndexSize(uint32_t bytes){
+  if(bytes != sizeof(uint16_t) && bytes != sizeof(uint32_t)) throw std::logic_error("indices are 2 or 4 bytes");
+  d_indexSize = bytes;
+  countUpload();
+}
+
+Scene2D::Entry& Scene2D::entry(Handle handle){
+  if(!contains(handle)) throw std::logic_error("invalid Scene2D handle");
+  return d_entries[handle-1];
+}
+
+const Scene2D::Entry& Scene2D::entry(Handle handle) const{
+  if(!contains(handle)) throw std::logic_error("invalid Scene2D handle");
+  return d_entries[handle-1];
+}
+
+void Scene2D::flush(){
+  d_stats.retessellated = 0;
+  for(uint32_t index : d_changed){
+    Entry& changed = d_entries[index];
+    changed.changed = false;
+    if(!changed.live){
+      d_freeEntries.push_back(index);
+      continue;
+    }
+    tessellate(changed.shape);
+    write(changed);
+    d_stats.retessellated++;
+  }
+  d_changed.clear();
+
+  uint32_t vertexEnd = d_vertexSlots.end(), indexEnd = d_indexSlots.end();
+  bool fragmented = d_vertexSlots.freeCount() > d_compactionThreshold*vertexEnd
+    || d_indexSlots.freeCount() > d_compactionThreshold*indexEnd;
+  if(fragmented && vertexEnd+indexEnd >= MIN_COMPACTION){
+    compact();
+    return;
+  }
+  coalesce(d_dirtyVertices, d_vertexSlots.end());
+  coalesce(d_dirtyIndices, d_indexSlots.end());
+  countUpload();
+}
+
+void Scene2D::clearDirty(){
+  d_dirtyVertices.clear();
+  d_dirtyIndices.clear();
+}
+
+void Scene2D::markAllDirty(){
+  d_dirtyVertices.assign(1, Range{0, d_vertexSlots.end()});
+  d_dirtyIndices.assign(1, Range{0, d_indexSlots.end()});
+  coalesce(d_dirtyVertices, d_vertexSlots.end());
+  coalesce(d_dirtyIndices, d_indexSlots.end());
+  countUpload();
+}
+
+void Scene2D::countUpload(){
+  d_stats.vertexRanges = static_cast<uint32_t>(d_dirtyVertices.size());
+  d_stats.indexRanges = static_cast<uint32_t>(d_dirtyIndices.size());
+  d_stats.uploadBytes = 0;
+  for(const Range& range : d_dirtyVertices) d_stats.uploadBytes += range.count*sizeof(Vertex);
+  for(const Range& range : d_dirtyIndices) d_stats.uploadBytes += static_cast<uint64_t>(range.count)*d_indexSize;
+}
+
+void Scene2D::tessellate(const Shape2D& shape){
+  if(d_scratchVertices.empty()){
+    d_scratchVertices.resize(SCRATCH_VERTICES);
+    d_scratchIndices.resize(SCRATCH_VERTICES*3);
+  }
+  //only a long polyline can outgrow the scratch list, it is retried with twice the room
+  while(true){
+    DrawList2D::Arena arena;
+    arena.vertices = d_scratchVertices.data();
+    arena.vertexCapacity = static_cast<uint32_t>(d_scratchVertices.size());
+    arena.indices = d_scratchIndices.data();
+    arena.indexCapacity = static_cast<uint32_t>(d_scratchIndices.size());
+    d_scratch.reset(arena);
+    const std::vector<glm::vec2>& points = shape.points;
+    switch(shape.kind){
+      case Shape2D::Kind::Rect:
+        if(points.size() >= 2) d_scratch.addRect(points[0], points[1], shape.color);
+        break;
+      case Shape2D::Kind::Triangle:
+        if(points.size() >= 3) d_scratch.addTriangle(points[0], points[1], points[2], shape.color);
+        break;
+      case Shape2D::Kind::Line:
+        if(points.size() >= 2) d_scratch.addLine(points[0], points[1], shape.thickness, shape.color);
+        break;
+      case Shape2D::Kind::Polyline:
+        d_tessellator.setStyle(shape.style);
+        d_tessellator.add(d_scratch, points.data(), static_cast<uint32_t>(points.size()), shape.color);
+        break;
+    }
+    if(d_scratch.dropped() == 0) return;
+    //with room for another whole chunk left the list was not what stopped it, a
+    //single primitive was over the chunk size and is left out
+    uint32_t vertexRoom = static_cast<uint32_t>(d_scratchVertices.size())-d_scratch.vertexCount();
+    uint32_t indexRoom = static_cast<uint32_t>(d_scratchIndices.size())-d_scratch.indexCount();
+    if(vertexRoom >= DrawList2D::CHUNK_VERTICES && indexRoom >= 3*DrawList2D::CHUNK_VERTICES) return;
+    d_scratchVertices.resize(d_scratchVertices.size()*2);
+    d_scratchIndices.resize(d_scratchIndices.size()*2);
+  }
+}
+
+void Scene2D::write(Entry& target){
+  uint32_t vertexCount = d_scratch.vertexCount(), indexCount = d_scratch.indexCount();
+  if(vertexCount > target.vertices.count || indexCount > target.indices.count){
+    releaseRanges(target);
+    target.vertices = d_vertexSlots.allocate(vertexCount);
+    target.indices = d_indexSlots.allocate(indexCount);
+    grow();
+  }
+  target.vertexCount = vertexCount;
+  target.indexCount = indexCount;
+  std::copy_n(d_scratchVertices.data(), vertexCount, d_vertices.begin()+target.vertices.first);
+  uint32_t* indices = d_indices.data()+target.indices.first;
+  //the scratch list's indices count from the chunk of their batch
+  for(const DrawList2D::Batch& batch : d_scratch.batches()){
+    uint32_t base = target.vertices.first+static_cast<uint32_t>(batch.vertexOffset);
+    for(uint32_t i = batch.firstIndex; i < batch.firstIndex+batch.indexCount; i++)
+      indices[i] = d_scratchIndices[i]+base;
+  }
+  //a shape that shrank in place leaves degenerate triangles behind
+  std::fill(indices+indexCount, indices+target.indices.count, 0u);
+  if(vertexCount > 0) d_dirtyVertices.push_back(Range{target.vertices.first, vertexCount});
+  if(target.indices.count > 0) d_dirtyIndices.push_back(target.indices);
+}
+
+void Scene2D::releaseRanges(Entry& released){
+  if(released.indices.count > 0){
+    std::fill_n(d_indices.begin()+released.indices.first, released.indices.count, 0u);
+    d_dirtyIndices.push_back(released.indices);
+  }
+  d_vertexSlots.release(released.vertices);
+  d_indexSlots.release(released.indices);
+  released.vertices = Range();
+  released.indices = Range();
+  released.vertexCount = 0;
+  released.indexCount = 0;
+}
+
+void Scene2D::grow(){
+  //geometrically, so the copies amortize over many added shapes
+  if(d_vertexSlots.end() > d_vertices.size())
+    d_vertices.resize(std::max<size_t>(d_vertexSlots.end(), d_vertices.size()*2));
+  if(d_indexSlots.end() > d_indices.size())
+    d_indices.resize(std::max<size_t>(d_indexSlots.end(), d_indices.size()*2), 0u);
+}
+
+void Scene2D::compact(){
+  //shapes move towards the front in order of their old position, so nothing is
+  //overwritten before it was moved; their slack goes too
+  std::vector<uint32_t> order;
+  for(uint32_t i = 0; i < d_entries.size(); i++) if(d_entries[i].live) order.push_back(i);
+
+  std::vector<uint32_t> vertexShift(d_entries.size(), 0);
+  std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b){
+      return d_entries[a].vertices.first < d_entries[b].vertices.first; });
+  uint32_t end = 0;
+  for(uint32_t index : order){
+    Entry& moved = d_entries[index];
+    std::copy_n(d_vertices.begin()+moved.vertices.first, moved.vertexCount, d_vertices.begin()+end);
+    vertexShift[index] = moved.vertices.first-end;
+    moved.vertices = Range{end, moved.vertexCount};
+    end += moved.vertexCount;
+  }
+  d_vertexSlots.reset(end);
+
+  std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b){
+      return d_entries[a].indices.first < d_entries[b].indices.first; });
+  end = 0;
+  for(uint32_t index : order){
+    Entry& moved = d_entries[index];
+    const uint32_t* from = d_indices.data()+moved.indices.first;
+    uint32_t* to = d_indices.data()+end;
+    for(uint32_t i = 0; i < moved.indexCount; i++) to[i] = from[i]-vertexShift[index];
+    moved.indices = Range{end, moved.indexCount};
+    end += moved.indexCount;
+  }
+  std::fill(d_indices.begin()+end, d_indices.begin()+d_indexSlots.end(), 0u);
+  d_indexSlots.reset(end);
+
+  //everything moved, the ranges written before are meaningless now
+  d_stats.compactions++;
+  markAllDirty();
+}
+
+void Scene2D::coalesce(std::vector<Range>& ranges, uint32_t end){
+  std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b){ return a.first < b.first; });
+  size_t kept = 0;
+  for(const Range& range : ranges){
+    //released ranges past the end are not drawn anymore
+    uint32_t last = std::min(range.first+range.count, end);
+    if(last <= range.first) continue;
+    if(kept > 0 && range.first <= ranges[kept-1].first+ranges[kept-1].count+MERGE_GAP){
+      Range& merged = ranges[kept-1];
+      merged.count = std::max(merged.first+merged.count, last)-merged.first;
+      continue;
+    }
+    ranges[kept++] = Range{range.first, last-range.first};
+  }
+  ranges.resize(kept);
+}
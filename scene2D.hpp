@@ -0,0 +1,148 @@
+//scene2D.hpp
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "aabb.hpp"
+#include "drawList2D.hpp"
+#include "polylineTessellator.hpp"
+
+//what a retained shape is made of, in the screen space of DrawList2D
+struct Shape2D{
+  enum class Kind : uint32_t{
+    Rect = 0,
+    Triangle = 1,
+    Line = 2,
+    Polyline = 3
+  };
+  Kind kind = Kind::Rect;
+  //Rect: bottom left corner and size. Triangle: its corners. Line: start and end.
+  //Polyline: every point
+  std::vector<glm::vec2> points;
+  glm::vec3 color = glm::vec3(1.0f);
+  //of a Line, polylines take theirs from style
+  float thickness = 0.0f;
+  PolylineStyle style;
+
+  static Shape2D rect(glm::vec2 bottomLeft, glm::vec2 size, glm::vec3 color);
+  static Shape2D triangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec3 color);
+  static Shape2D line(glm::vec2 start, glm::vec2 end, float thickness, glm::vec3 color);
+  static Shape2D polyline(const glm::vec2* points, uint32_t count, const PolylineStyle& style, glm::vec3 color);
+
+  //of everything tessellation can cover, miters and square caps included, at z 0
+  Aabb bounds() const;
+};
+
+//2D shapes that persist from frame to frame, unlike DrawList2D. Every shape owns a
+//range of vertices and one of indices in buffers that only grow; changing a shape
+//re-tessellates just that shape on the next flush and only the ranges it wrote are
+//uploaded, coalesced with their neighbours. A shape that outgrows its ranges moves to
+//new ones and the old ones join a free list; once free space makes up more than the
+//compaction threshold of either buffer every shape is packed to the front again.
+//
+//The whole index range is drawn in one call, so free indices are kept zero, which
+//makes degenerate triangles. Handles stay valid across compaction until removed.
+class Scene2D{
+  public:
+    using Vertex = BasicRenderer::Vertex;
+    //0 is never a valid handle
+    using Handle = uint32_t;
+    struct Range{
+      uint32_t first = 0;
+      uint32_t count = 0;
+    };
+    struct Stats{
+      uint32_t shapes = 0;
+      //by the last flush
+      uint32_t retessellated = 0;
+      uint64_t uploadBytes = 0;
+      uint32_t vertexRanges = 0;
+      uint32_t indexRanges = 0;
+      //since creation
+      uint32_t compactions = 0;
+    };
+
+    Handle add(const Shape2D& shape);
+    //drawn as shape from the next flush on
+    void set(Handle handle, const Shape2D& shape);
+    void remove(Handle handle);
+    bool contains(Handle handle) const;
+    const Shape2D& shape(Handle handle) const;
+    //share of free space below the end of a buffer that triggers compaction
+    void setCompactionThreshold(float share);
+    //bytes per index in the buffer the renderer uploads to, which uploadBytes counts
+    //indices at: 4 by default, 2 while the renderer stores them at 16 bit
+    void setIndexSize(uint32_t bytes);
+    uint32_t indexSize() const { return d_indexSize; }
+
+    //tessellates the shapes changed since the last flush, compacts if due and
+    //collects the ranges to upload. The renderer calls it every frame
+    void flush();
+    const std::vector<Vertex>& vertices() const { return d_vertices; }
+    const std::vector<uint32_t>& indices() const { return d_indices; }
+    //the used part of each buffer, indices past indexEnd are not drawn
+    uint32_t vertexEnd() const { return d_vertexSlots.end(); }
+    uint32_t indexEnd() const { return d_indexSlots.end(); }
+    //element ranges written by the last flush, sorted and coalesced
+    const std::vector<Range>& dirtyVertices() const { return d_dirtyVertices; }
+    const std::vector<Range>& dirtyIndices() const { return d_dirtyIndices; }
+    void clearDirty();
+    //lists everything in use as dirty, for buffers that were recreated empty
+    void markAllDirty();
+    const Stats& stats() const { return d_stats; }
+
+  private:
+    //first fit over free ranges sorted by position, neighbours merge on release
+    class SlotAllocator{
+      public:
+        Range allocate(uint32_t count);
+        void release(Range range);
+        void reset(uint32_t end);
+        uint32_t end() const { return d_end; }
+        uint32_t freeCount() const { return d_freeCount; }
+      private:
+        std::vector<Range> d_free;
+        uint32_t d_end = 0;
+        uint32_t d_freeCount = 0;
+    };
+    struct Entry{
+      Shape2D shape;
+      Range vertices;
+      Range indices;
+      uint32_t vertexCount = 0;
+      uint32_t indexCount = 0;
+      bool live = false;
+      bool changed = false;
+    };
+
+    std::vector<Entry> d_entries;
+    std::vector<uint32_t> d_freeEntries;
+    std::vector<uint32_t> d_changed;
+    float d_compactionThreshold = 0.25f;
+    uint32_t d_indexSize = sizeof(uint32_t);
+
+    std::vector<Vertex> d_vertices;
+    std::vector<uint32_t> d_indices;
+    SlotAllocator d_vertexSlots;
+    SlotAllocator d_indexSlots;
+    std::vector<Range> d_dirtyVertices;
+    std::vector<Range> d_dirtyIndices;
+    Stats d_stats;
+
+    //shapes are tessellated by DrawList2D into these and copied into their ranges
+    std::vector<Vertex> d_scratchVertices;
+    std::vector<DrawList2D::Index> d_scratchIndices;
+    DrawList2D d_scratch;
+    PolylineTessellator d_tessellator;
+
+    Entry& entry(Handle handle);
+    const Entry& entry(Handle handle) const;
+    void tessellate(const Shape2D& shape);
+    void write(Entry& entry);
+    void releaseRanges(Entry& entry);
+    void compact();
+    void countUpload();
+    void grow();
+    static void coalesce(std::vector<Range>& ranges, uint32_t end);
+};
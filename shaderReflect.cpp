@@ -0,0 +1,645 @@
+//shaderReflect.cpp
+#include "shaderReflect.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+//the handful of SPIR-V enumerants we care about, straight from the spec
+namespace spv{
+  const uint32_t MagicNumber = 0x07230203;
+
+  const uint32_t OpName = 5;
+  const uint32_t OpEntryPoint = 15;
+  const uint32_t OpTypeInt = 21;
+  const uint32_t OpTypeFloat = 22;
+  const uint32_t OpTypeVector = 23;
+  const uint32_t OpTypeMatrix = 24;
+  const uint32_t OpTypeImage = 25;
+  const uint32_t OpTypeSampler = 26;
+  const uint32_t OpTypeSampledImage = 27;
+  const uint32_t OpTypeArray = 28;
+  const uint32_t OpTypeRuntimeArray = 29;
+  const uint32_t OpTypeStruct = 30;
+  const uint32_t OpTypePointer = 32;
+  const uint32_t OpConstant = 43;
+  const uint32_t OpVariable = 59;
+  const uint32_t OpDecorate = 71;
+  const uint32_t OpMemberDecorate = 72;
+
+  const uint32_t DecorationBlock = 2;
+  const uint32_t DecorationBufferBlock = 3;
+  const uint32_t DecorationArrayStride = 6;
+  const uint32_t DecorationMatrixStride = 7;
+  const uint32_t DecorationBuiltIn = 11;
+  const uint32_t DecorationLocation = 30;
+  const uint32_t DecorationBinding = 33;
+  const uint32_t DecorationDescriptorSet = 34;
+  const uint32_t DecorationOffset = 35;
+
+  const uint32_t StorageClassUniformConstant = 0;
+  const uint32_t StorageClassInput = 1;
+  const uint32_t StorageClassUniform = 2;
+  const uint32_t StorageClassPushConstant = 9;
+  const uint32_t StorageClassStorageBuffer = 12;
+
+  const uint32_t DimBuffer = 5;
+  const uint32_t DimSubpassData = 6;
+
+  const uint32_t ExecutionModelVertex = 0;
+  const uint32_t ExecutionModelTessellationControl = 1;
+  const uint32_t ExecutionModelTessellationEvaluation = 2;
+  const uint32_t ExecutionModelGeometry = 3;
+  const uint32_t ExecutionModelFragment = 4;
+  const uint32_t ExecutionModelGLCompute = 5;
+}
+
+namespace{
+
+//deeper type nesting than this is taken for a cycle in a malformed module
+const uint32_t MAX_TYPE_DEPTH = 64;
+
+struct Id{
+  uint32_t opcode = 0;
+  std::vector<uint32_t> operands;//everything after the result id
+  std::string name;
+  bool hasSet = false, hasBinding = false, hasLocation = false;
+  bool block = false, bufferBlock = false, builtIn = false;
+  uint32_t set = 0, binding = 0, location = 0;
+  uint32_t arrayStride = 0;
+  std::unordered_map<uint32_t,uint32_t> memberOffsets;
+  std::unordered_map<uint32_t,uint32_t> memberMatrixStrides;
+  uint32_t constant = 0;
+};
+
+class Parser{
+  public:
+    explicit Parser(const std::vector<char>& code){
+      if(code.size()%4!=0 || code.size()<20){
+        throw std::runtime_error("spirv module has an invalid size");
+      }
+      d_words.resize(code.size()/4);
+      memcpy(d_words.data(),code.data(),code.size());
+      if(d_words[0]!=spv::MagicNumber){
+        throw std::runtime_error("spirv module has a bad magic number");
+      }
+      //ids are defined by instructions of two words or more, a bound past the word
+      //count comes from a corrupt header and is not worth allocating for
+      if(d_words[3]>d_words.size()){
+        throw std::runtime_error("spirv module has an invalid id bound");
+      }
+      d_ids.resize(d_words[3]);
+    }
+
+    ShaderReflection reflect(){
+      parse();
+      ShaderReflection reflection = {};
+      reflection.stage = d_stage;
+
+      for(uint32_t index = 0; index<d_ids.size(); index++){
+        const Id& var = d_ids[index];
+        if(var.opcode!=spv::OpVariable) continue;
+        uint32_t storageClass = var.operands[1];
+        const Id& pointer = id(var.operands[0]);
+        if(pointer.opcode!=spv::OpTypePointer){
+          throw std::runtime_error("spirv variable does not have a pointer type");
+        }
+        uint32_t pointee = operand(pointer,1);
+
+        if(storageClass==spv::StorageClassUniformConstant||storageClass==spv::StorageClassUniform
+            ||storageClass==spv::StorageClassStorageBuffer){
+          ShaderReflection::DescriptorBinding binding = {};
+          binding.set = var.set;
+          binding.binding = var.binding;
+          binding.count = 1;
+          binding.name = var.name;
+          //descriptor arrays only change the count, the type lives underneath
+          for(uint32_t depth = 0; id(pointee).opcode==spv::OpTypeArray||id(pointee).opcode==spv::OpTypeRuntimeArray; depth++){
+            if(depth==MAX_TYPE_DEPTH) throw std::runtime_error("spirv types nest too deeply");
+            const Id& array = id(pointee);
+            if(array.opcode==spv::OpTypeArray){
+              binding.count *= id(operand(array,1)).constant;
+            }
+            pointee = operand(array,0);
+          }
+          binding.type = descriptorType(storageClass,pointee);
+          if(binding.name.empty()) binding.name = id(pointee).name;
+          reflection.bindings.push_back(binding);
+        }
+        else if(storageClass==spv::StorageClassPushConstant){
+          reflection.pushConstantSize = std::max(reflection.pushConstantSize,typeSize(pointee));
+        }
+        else if(storageClass==spv::StorageClassInput && d_stage==VK_SHADER_STAGE_VERTEX_BIT){
+          if(var.builtIn || !var.hasLocation) continue;
+          addVertexInputs(reflection.inputs,var,pointee);
+        }
+      }
+      std::sort(reflection.bindings.begin(),reflection.bindings.end(),
+          [](const ShaderReflection::DescriptorBinding& a,const ShaderReflection::DescriptorBinding& b){
+            return a.set!=b.set ? a.set<b.set : a.binding<b.binding;
+          });
+      std::sort(reflection.inputs.begin(),reflection.inputs.end(),
+          [](const ShaderReflection::VertexInput& a,const ShaderReflection::VertexInput& b){
+            return a.location<b.location;
+          });
+      return reflection;
+    }
+
+  private:
+    std::vector<uint32_t> d_words;
+    std::vector<Id> d_ids;
+    VkShaderStageFlagBits d_stage = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+    static std::string readString(const uint32_t* words,size_t count){
+      const char* str = reinterpret_cast<const char*>(words);
+      return std::string(str,strnlen(str,count*4));
+    }
+
+    void parse(){
+      size_t i = 5;//skip the header
+      while(i<d_words.size()){
+        uint32_t opcode = d_words[i]&0xFFFF;
+        uint32_t wordCount = d_words[i]>>16;
+        if(wordCount==0 || i+wordCount>d_words.size()){
+          throw std::runtime_error("spirv module is truncated");
+        }
+        const uint32_t* ops = &d_words[i+1];
+        uint32_t opCount = wordCount-1;
+        //operands every instruction below reads without looking at opCount
+        auto require = [&](uint32_t count){
+          if(opCount<count) throw std::runtime_error("spirv instruction is missing operands");
+        };
+
+        switch(opcode){
+          case spv::OpEntryPoint:
+            require(1);
+            d_stage = stageFromModel(ops[0]);
+            break;
+          case spv::OpName:
+            require(1);
+            id(ops[0]).name = readString(ops+1,opCount-1);
+            break;
+          case spv::OpDecorate:
+            require(2);
+            decorate(id(ops[0]),ops[1],opCount>2 ? ops[2] : 0);
+            break;
+          case spv::OpMemberDecorate:
+            require(3);
+            if(ops[2]==spv::DecorationOffset || ops[2]==spv::DecorationMatrixStride) require(4);
+            if(ops[2]==spv::DecorationOffset) id(ops[0]).memberOffsets[ops[1]] = ops[3];
+            if(ops[2]==spv::DecorationMatrixStride) id(ops[0]).memberMatrixStrides[ops[1]] = ops[3];
+            if(ops[2]==spv::DecorationBuiltIn) id(ops[0]).builtIn = true;
+            break;
+          case spv::OpTypeInt: case spv::OpTypeFloat: case spv::OpTypeVector: case spv::OpTypeMatrix:
+          case spv::OpTypeImage: case spv::OpTypeSampler: case spv::OpTypeSampledImage:
+          case spv::OpTypeArray: case spv::OpTypeRuntimeArray: case spv::OpTypeStruct:
+          case spv::OpTypePointer:{
+            require(1);
+            Id& type = id(ops[0]);
+            type.opcode = opcode;
+            type.operands.assign(ops+1,ops+opCount);
+            break;
+          }
+          case spv::OpConstant:{
+            require(3);
+            Id& constant = id(ops[1]);
+            constant.opcode = opcode;
+            constant.constant = ops[2];
+            break;
+          }
+          case spv::OpVariable:{
+            require(3);
+            Id& var = id(ops[1]);
+            var.opcode = opcode;
+            var.operands = {ops[0],ops[2]};//pointer type, storage class
+            break;
+          }
+          default:
+            break;
+        }
+        i += wordCount;
+      }
+    }
+
+    //every id a module mentions is checked against the bound in its header
+    Id& id(uint32_t index){
+      if(index>=d_ids.size()) throw std::runtime_error("spirv id out of bounds");
+      return d_ids[index];
+    }
+    const Id& id(uint32_t index) const{
+      if(index>=d_ids.size()) throw std::runtime_error("spirv id out of bounds");
+      return d_ids[index];
+    }
+
+    static uint32_t operand(const Id& type,size_t index){
+      if(index>=type.operands.size()) throw std::runtime_error("spirv instruction is missing operands");
+      return type.operands[index];
+    }
+
+    static void decorate(Id& target,uint32_t decoration,uint32_t value){
+      switch(decoration){
+        case spv::DecorationDescriptorSet: target.hasSet = true; target.set = value; break;
+        case spv::DecorationBinding: target.hasBinding = true; target.binding = value; break;
+        case spv::DecorationLocation: target.hasLocation = true; target.location = value; break;
+        case spv::DecorationBlock: target.block = true; break;
+        case spv::DecorationBufferBlock: target.bufferBlock = true; break;
+        case spv::DecorationBuiltIn: target.builtIn = true; break;
+        case spv::DecorationArrayStride: target.arrayStride = value; break;
+        default: break;
+      }
+    }
+
+    static VkShaderStageFlagBits stageFromModel(uint32_t model){
+      switch(model){
+        case spv::ExecutionModelVertex: return VK_SHADER_STAGE_VERTEX_BIT;
+        case spv::ExecutionModelTessellationControl: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case spv::ExecutionModelTessellationEvaluation: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case spv::ExecutionModelGeometry: return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case spv::ExecutionModelFragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case spv::ExecutionModelGLCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
+      }
+      throw std::runtime_error("unsupported spirv execution model");
+    }
+
+    VkDescriptorType descriptorType(uint32_t storageClass,uint32_t typeId){
+      const Id& type = id(typeId);
+      if(storageClass==spv::StorageClassStorageBuffer) return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      if(storageClass==spv::StorageClassUniform){
+        return type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      }
+      switch(type.opcode){
+        case spv::OpTypeSampledImage: return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        case spv::OpTypeSampler: return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case spv::OpTypeImage:{
+          //OpTypeImage: sampled type, dim, depth, arrayed, ms, sampled, format
+          uint32_t dim = operand(type,1);
+          uint32_t sampled = operand(type,5);
+          if(dim==spv::DimSubpassData) return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+          if(dim==spv::DimBuffer){
+            return sampled==2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+          }
+          return sampled==2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+      }
+      throw std::runtime_error("unsupported descriptor type in spirv module");
+    }
+
+    uint32_t typeSize(uint32_t typeId,uint32_t matrixStride = 0,uint32_t depth = 0){
+      if(depth==MAX_TYPE_DEPTH) throw std::runtime_error("spirv types nest too deeply");
+      const Id& type = id(typeId);
+      switch(type.opcode){
+        case spv::OpTypeInt: case spv::OpTypeFloat:
+          return operand(type,0)/8;
+        case spv::OpTypeVector:
+          return operand(type,1)*typeSize(operand(type,0),0,depth+1);
+        case spv::OpTypeMatrix:{
+          uint32_t column = matrixStride ? matrixStride : typeSize(operand(type,0),0,depth+1);
+          return operand(type,1)*column;
+        }
+        case spv::OpTypeArray:{
+          uint32_t length = id(operand(type,1)).constant;
+          uint32_t stride = type.arrayStride ? type.arrayStride : typeSize(operand(type,0),0,depth+1);
+          return length*stride;
+        }
+        case spv::OpTypeStruct:{
+          uint32_t size = 0;
+          for(uint32_t member = 0; member<type.operands.size(); member++){
+            auto offset = type.memberOffsets.find(member);
+            auto stride = type.memberMatrixStrides.find(member);
+            uint32_t end = (offset!=type.memberOffsets.end() ? offset->second : size)
+              + typeSize(type.operands[member],stride!=type.memberMatrixStrides.end() ? stride->second : 0,depth+1);
+            size = std::max(size,end);
+          }
+          return size;
+        }
+      }
+      return 0;
+    }
+
+    VkFormat vertexFormat(uint32_t typeId){
+      const Id& type = id(typeId);
+      uint32_t components = 1;
+      const Id* scalar = &type;
+      if(type.opcode==spv::OpTypeVector){
+        components = operand(type,1);
+        scalar = &id(operand(type,0));
+      }
+      static const VkFormat floats[] = {VK_FORMAT_R32_SFLOAT,VK_FORMAT_R32G32_SFLOAT,
+        VK_FORMAT_R32G32B32_SFLOAT,VK_FORMAT_R32G32B32A32_SFLOAT};
+      static const VkFormat sints[] = {VK_FORMAT_R32_SINT,VK_FORMAT_R32G32_SINT,
+        VK_FORMAT_R32G32B32_SINT,VK_FORMAT_R32G32B32A32_SINT};
+      static const VkFormat uints[] = {VK_FORMAT_R32_UINT,VK_FORMAT_R32G32_UINT,
+        VK_FORMAT_R32G32B32_UINT,VK_FORMAT_R32G32B32A32_UINT};
+      if(components<1||components>4||scalar->operands.empty()||scalar->operands[0]!=32){
+        throw std::runtime_error("unsupported vertex input type in spirv module");
+      }
+      if(scalar->opcode==spv::OpTypeFloat) return floats[components-1];
+      if(scalar->opcode==spv::OpTypeInt) return operand(*scalar,1) ? sints[components-1] : uints[components-1];
+      throw std::runtime_error("unsupported vertex input type in spirv module");
+    }
+
+    //matrices take one location per column
+    void addVertexInputs(std::vector<ShaderReflection::VertexInput>& inputs,const Id& var,uint32_t typeId){
+      const Id& type = id(typeId);
+      uint32_t columns = 1;
+      uint32_t columnType = typeId;
+      if(type.opcode==spv::OpTypeMatrix){
+        columns = operand(type,1);
+        columnType = operand(type,0);
+      }
+      for(uint32_t column = 0; column<columns; column++){
+        ShaderReflection::VertexInput input = {};
+        input.location = var.location+column;
+        input.format = vertexFormat(columnType);
+        input.size = typeSize(columnType);
+        input.name = var.name;
+        inputs.push_back(input);
+      }
+    }
+};
+
+std::string bindingsKey(const std::vector<VkDescriptorSetLayoutBinding>& bindings){
+  std::string key;
+  for(const auto& binding : bindings){
+    key += std::to_string(binding.binding)+":"+std::to_string(binding.descriptorType)+":"
+      +std::to_string(binding.descriptorCount)+":"+std::to_string(binding.stageFlags)+";";
+  }
+  return key;
+}
+
+}
+
+ShaderReflection reflectShader(const std::vector<char>& code){
+  return Parser(code).reflect();
+}
+
+ShaderLayout mergeReflections(const std::vector<ShaderReflection>& stages){
+  ShaderLayout layout;
+  for(const auto& stage : stages){
+    for(const auto& binding : stage.bindings){
+      auto& set = layout.sets[binding.set];
+      auto existing = std::find_if(set.begin(),set.end(),
+          [&](const VkDescriptorSetLayoutBinding& b){return b.binding==binding.binding;});
+      if(existing!=set.end()){
+        if(existing->descriptorType!=binding.type){
+          throw std::runtime_error("shader stages disagree on the type of descriptor "+binding.name);
+        }
+        existing->stageFlags |= stage.stage;
+        continue;
+      }
+      VkDescriptorSetLayoutBinding layoutBinding = {};
+      layoutBinding.binding = binding.binding;
+      layoutBinding.descriptorType = binding.type;
+      layoutBinding.descriptorCount = binding.count;
+      layoutBinding.stageFlags = stage.stage;
+      layoutBinding.pImmutableSamplers = nullptr;
+      set.push_back(layoutBinding);
+    }
+    //push constant blocks are declared in full by every stage that uses them,
+    //so a single range covering the largest declaration is enough
+    if(stage.pushConstantSize>0){
+      if(layout.pushConstantRanges.empty()){
+        layout.pushConstantRanges.push_back({0,0,0});
+      }
+      layout.pushConstantRanges[0].stageFlags |= stage.stage;
+      layout.pushConstantRanges[0].size = std::max(layout.pushConstantRanges[0].size,stage.pushConstantSize);
+    }
+    if(stage.stage==VK_SHADER_STAGE_VERTEX_BIT){
+      layout.vertexInputs = stage.inputs;
+    }
+  }
+  for(auto& set : layout.sets){
+    std::sort(set.second.begin(),set.second.end(),
+        [](const VkDescriptorSetLayoutBinding& a,const VkDescriptorSetLayoutBinding& b){
+          return a.binding<b.binding;
+        });
+  }
+  return layout;
+}
+
+uint32_t ShaderLayout::vertexAttributes(uint32_t binding,
+    std::vector<VkVertexInputAttributeDescription>& attributes) const{
+  uint32_t offset = 0;
+  attributes.clear();
+  for(const auto& input : vertexInputs){
+    VkVertexInputAttributeDescription attribute = {};
+    attribute.binding = binding;
+    attribute.location = input.location;
+    attribute.format = input.format;
+    attribute.offset = offset;
+    attributes.push_back(attribute);
+    offset += input.size;
+  }
+  return offset;
+}
+
+bool ShaderLayout::compatibleWith(const ShaderLayout& other) const{
+  if(sets.size()!=other.sets.size()) return false;
+  for(const auto& set : sets){
+    auto found = other.sets.find(set.first);
+    if(found==other.sets.end() || bindingsKey(set.second)!=bindingsKey(found->second)) return false;
+  }
+  if(pushConstantRanges.size()!=other.pushConstantRanges.size()) return false;
+  for(size_t i = 0; i<pushConstantRanges.size(); i++){
+    const auto& a = pushConstantRanges[i];
+    const auto& b = other.pushConstantRanges[i];
+    if(a.stageFlags!=b.stageFlags || a.offset!=b.offset || a.size!=b.size) return false;
+  }
+  if(vertexInputs.size()!=other.vertexInputs.size()) return false;
+  for(size_t i = 0; i<vertexInputs.size(); i++){
+    if(vertexInputs[i].location!=other.vertexInputs[i].location
+        || vertexInputs[i].format!=other.vertexInputs[i].format) return false;
+  }
+  return true;
+}
+
+bool ShaderLayout::fitsIn(const ShaderLayout& other) const{
+  for(const auto& set : sets){
+    auto found = other.sets.find(set.first);
+    if(found==other.sets.end()) return false;
+    for(const auto& binding : set.second){
+      bool declared = false;
+      for(const auto& candidate : found->second){
+        if(candidate.binding!=binding.binding) continue;
+        declared = candidate.descriptorType==binding.descriptorType
+          && candidate.descriptorCount==binding.descriptorCount
+          && (candidate.stageFlags&binding.stageFlags)==binding.stageFlags;
+        break;
+      }
+      if(!declared) return false;
+    }
+  }
+  for(const auto& range : pushConstantRanges){
+    bool covered = false;
+    for(const auto& candidate : other.pushConstantRanges){
+      if((candidate.stageFlags&range.stageFlags)==range.stageFlags && candidate.offset<=range.offset
+          && range.offset+range.size<=candidate.offset+candidate.size){
+        covered = true;
+        break;
+      }
+    }
+    if(!covered) return false;
+  }
+  return true;
+}
+
+void DescriptorLayoutCache::init(VkDevice device){
+  d_device = device;
+}
+
+void DescriptorLayoutCache::destroy(){
+  std::lock_guard<std::mutex> lock(d_mutex);
+  for(auto& layout : d_pipelineLayouts){
+    vkDestroyPipelineLayout(d_device,layout.second,nullptr);
+  }
+  for(auto& layout : d_setLayouts){
+    vkDestroyDescriptorSetLayout(d_device,layout.second,nullptr);
+  }
+  for(auto pool : d_pools){
+    vkDestroyDescriptorPool(d_device,pool,nullptr);
+  }
+  d_pipelineLayouts.clear();
+  d_setLayouts.clear();
+  d_setLayoutBindings.clear();
+  d_pools.clear();
+  d_setPools.clear();
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings){
+  std::lock_guard<std::mutex> lock(d_mutex);
+  std::string key = bindingsKey(bindings);
+  auto found = d_setLayouts.find(key);
+  if(found!=d_setLayouts.end()) return found->second;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  VkDescriptorSetLayout layout;
+  if(vkCreateDescriptorSetLayout(d_device,&layoutInfo,nullptr,&layout)!=VK_SUCCESS){
+    throw std::runtime_error("failed to create descriptor set layout");
+  }
+  d_setLayouts[key] = layout;
+  d_setLayoutBindings[layout] = bindings;
+  return layout;
+}
+
+VkPipelineLayout DescriptorLayoutCache::getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+    const std::vector<VkPushConstantRange>& pushConstantRanges){
+  std::string key;
+  for(auto layout : setLayouts){
+    key += std::to_string(reinterpret_cast<uint64_t>(layout))+",";
+  }
+  key += "|";
+  for(const auto& range : pushConstantRanges){
+    key += std::to_string(range.stageFlags)+":"+std::to_string(range.offset)+":"+std::to_string(range.size)+";";
+  }
+  std::lock_guard<std::mutex> lock(d_mutex);
+  auto found = d_pipelineLayouts.find(key);
+  if(found!=d_pipelineLayouts.end()) return found->second;
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+  pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+  VkPipelineLayout layout;
+  if(vkCreatePipelineLayout(d_device,&pipelineLayoutInfo,nullptr,&layout)!=VK_SUCCESS){
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+  d_pipelineLayouts[key] = layout;
+  return layout;
+}
+
+const std::vector<VkDescriptorSetLayoutBinding>& DescriptorLayoutCache::bindings(VkDescriptorSetLayout layout) const{
+  std::lock_guard<std::mutex> lock(d_mutex);
+  auto found = d_setLayoutBindings.find(layout);
+  if(found==d_setLayoutBindings.end()){
+    throw std::logic_error("descriptor set layout was not created by this cache");
+  }
+  return found->second;
+}
+
+//sized for a mix of layouts, grown past the ratios when one request needs more
+VkDescriptorPool DescriptorLayoutCache::createPool(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+    uint32_t count){
+  static const std::pair<VkDescriptorType,uint32_t> ratios[] = {
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,2},{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,2},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,4},{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,1},
+    {VK_DESCRIPTOR_TYPE_SAMPLER,1},{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,1}};
+  uint32_t setCount = std::max(d_poolSets,count);
+  std::map<VkDescriptorType,uint32_t> counts;
+  for(const auto& ratio : ratios){
+    counts[ratio.first] = ratio.second*setCount;
+  }
+  std::map<VkDescriptorType,uint32_t> needed;
+  for(const auto& binding : bindings){
+    needed[binding.descriptorType] += binding.descriptorCount*count;
+  }
+  for(const auto& need : needed){
+    counts[need.first] = std::max(counts[need.first],need.second);
+  }
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for(const auto& descriptors : counts){
+    poolSizes.push_back({descriptors.first,descriptors.second});
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = setCount;
+
+  VkDescriptorPool pool;
+  if(vkCreateDescriptorPool(d_device,&poolInfo,nullptr,&pool)!=VK_SUCCESS){
+    throw std::runtime_error("failed to create descriptor pool");
+  }
+  d_pools.push_back(pool);
+  d_poolSets = std::min(d_poolSets*2,4096u);
+  return pool;
+}
+
+void DescriptorLayoutCache::allocateSets(VkDescriptorSetLayout layout,uint32_t count,VkDescriptorSet* sets){
+  const std::vector<VkDescriptorSetLayoutBinding>& layoutBindings = bindings(layout);
+  std::vector<VkDescriptorSetLayout> layouts(count,layout);
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorSetCount = count;
+  allocInfo.pSetLayouts = layouts.data();
+
+  std::lock_guard<std::mutex> lock(d_mutex);
+  //newest first, sets freed from older pools make room there too
+  for(auto pool = d_pools.rbegin(); pool!=d_pools.rend(); ++pool){
+    allocInfo.descriptorPool = *pool;
+    VkResult result = vkAllocateDescriptorSets(d_device,&allocInfo,sets);
+    if(result==VK_SUCCESS) break;
+    if(result!=VK_ERROR_OUT_OF_POOL_MEMORY && result!=VK_ERROR_FRAGMENTED_POOL){
+      throw std::runtime_error("failed to allocate descriptor sets");
+    }
+    allocInfo.descriptorPool = VK_NULL_HANDLE;
+  }
+  if(allocInfo.descriptorPool==VK_NULL_HANDLE){
+    allocInfo.descriptorPool = createPool(layoutBindings,count);
+    if(vkAllocateDescriptorSets(d_device,&allocInfo,sets)!=VK_SUCCESS){
+      throw std::runtime_error("failed to allocate descriptor sets");
+    }
+  }
+  for(uint32_t i = 0; i<count; i++){
+    d_setPools[sets[i]] = allocInfo.descriptorPool;
+  }
+}
+
+void DescriptorLayoutCache::freeSets(const VkDescriptorSet* sets,uint32_t count){
+  std::lock_guard<std::mutex> lock(d_mutex);
+  for(uint32_t i = 0; i<count; i++){
+    auto found = d_setPools.find(sets[i]);
+    if(found==d_setPools.end()) continue;
+    vkFreeDescriptorSets(d_device,found->second,1,&sets[i]);
+    d_setPools.erase(found);
+  }
+}
@@ -0,0 +1,84 @@
+//shaderReflect.hpp
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//reflection data pulled out of a single SPIR-V module
+struct ShaderReflection{
+  struct DescriptorBinding{
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    uint32_t count;
+    std::string name;
+  };
+  struct VertexInput{
+    uint32_t location;
+    VkFormat format;
+    uint32_t size;//bytes consumed in the vertex stream
+    std::string name;
+  };
+
+  VkShaderStageFlagBits stage;
+  std::vector<DescriptorBinding> bindings;
+  uint32_t pushConstantSize = 0;//0 means the stage declares no push constant block
+  std::vector<VertexInput> inputs;//only filled for vertex shaders, sorted by location
+};
+
+//the union of every stage that goes into one pipeline
+struct ShaderLayout{
+  //set index -> bindings, stage flags merged across stages
+  std::map<uint32_t,std::vector<VkDescriptorSetLayoutBinding>> sets;
+  std::vector<VkPushConstantRange> pushConstantRanges;
+  std::vector<ShaderReflection::VertexInput> vertexInputs;
+
+  //packs the vertex inputs tightly in location order into a single binding,
+  //returns the resulting stride
+  uint32_t vertexAttributes(uint32_t binding,
+      std::vector<VkVertexInputAttributeDescription>& attributes) const;
+  //true when a pipeline built from other can reuse every layout built from this one
+  bool compatibleWith(const ShaderLayout& other) const;
+  //true when every resource used here is declared alike by other, so a pipeline built
+  //from this can use the pipeline layout of other. Vertex inputs are not compared
+  bool fitsIn(const ShaderLayout& other) const;
+};
+
+//parses a SPIR-V binary as returned by readFile, throws on malformed input
+ShaderReflection reflectShader(const std::vector<char>& code);
+ShaderLayout mergeReflections(const std::vector<ShaderReflection>& stages);
+
+//hands out descriptor set and pipeline layouts, identical layouts are only ever
+//created once so every pipeline that agrees on a layout shares the handle.
+//Descriptor sets of every layout come out of one list of pools that grows when
+//the newest pool runs dry. Safe to call from several threads, pipelines are
+//built off the render thread
+class DescriptorLayoutCache{
+  public:
+    void init(VkDevice device);
+    void destroy();
+
+    VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+    VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+        const std::vector<VkPushConstantRange>& pushConstantRanges);
+    //count sets of the given (cached) layout, released by freeSets or destroy()
+    void allocateSets(VkDescriptorSetLayout layout, uint32_t count, VkDescriptorSet* sets);
+    void freeSets(const VkDescriptorSet* sets, uint32_t count);
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings(VkDescriptorSetLayout layout) const;
+  private:
+    VkDevice d_device = VK_NULL_HANDLE;
+    mutable std::mutex d_mutex;
+    std::map<std::string,VkDescriptorSetLayout> d_setLayouts;
+    std::map<VkDescriptorSetLayout,std::vector<VkDescriptorSetLayoutBinding>> d_setLayoutBindings;
+    std::map<std::string,VkPipelineLayout> d_pipelineLayouts;
+    std::vector<VkDescriptorPool> d_pools;
+    std::map<VkDescriptorSet,VkDescriptorPool> d_setPools;
+    uint32_t d_poolSets = 64;//sets the next pool holds, doubles with every pool
+
+    VkDescriptorPool createPool(const std::vector<VkDescriptorSetLayoutBinding>& bindings, uint32_t count);
+};
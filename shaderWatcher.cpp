@@ -0,0 +1,135 @@
+//shaderWatcher.cpp
+#include "shaderWatcher.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <set>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+ShaderWatcher::ShaderWatcher(const std::string& sourceDir, const std::string& outputDir,
+    const std::string& compiler, Callback onCompiled)
+  : d_sourceDir(sourceDir), d_outputDir(outputDir), d_compiler(compiler),
+    d_onCompiled(onCompiled), d_running(true){
+  d_thread = std::thread(&ShaderWatcher::watch,this);
+}
+
+ShaderWatcher::~ShaderWatcher(){
+  d_running = false;
+  if(d_thread.joinable()) d_thread.join();
+}
+
+bool ShaderWatcher::isShaderSource(const std::string& fileName){
+  static const std::set<std::string> extensions = {".vert",".frag",".comp",".geom",".tesc",".tese"};
+  return extensions.count(fs::path(fileName).extension().string())>0;
+}
+
+bool ShaderWatcher::compile(const std::string& compiler, const std::string& source,
+    const std::string& output, std::string& log){
+  std::string staging = output+".tmp";
+  std::string command = "\""+compiler+"\" \""+source+"\" -o \""+staging+"\" 2>&1";
+  log.clear();
+
+  FILE* pipe = popen(command.c_str(),"r");
+  if(!pipe){
+    log = "failed to launch "+compiler;
+    return false;
+  }
+  char buffer[256];
+  while(fgets(buffer,sizeof(buffer),pipe)){
+    log += buffer;
+  }
+  if(pclose(pipe)!=0){
+    std::error_code ignored;
+    fs::remove(staging,ignored);
+    return false;
+  }
+  std::error_code error;
+  fs::rename(staging,output,error);
+  if(error){
+    log = "failed to replace "+output+": "+error.message();
+    return false;
+  }
+  return true;
+}
+
+void ShaderWatcher::rebuild(const std::string& shaderName){
+  std::string log;
+  std::string source = (fs::path(d_sourceDir)/shaderName).string();
+  std::string output = (fs::path(d_outputDir)/(shaderName+".spv")).string();
+  if(!compile(d_compiler,source,output,log)){
+    std::cerr<<"shader reload: "<<shaderName<<" failed to compile"<<std::endl<<log;
+    return;
+  }
+  std::cout<<"shader reload: recompiled "<<shaderName<<std::endl;
+  d_onCompiled(shaderName);
+}
+
+#ifdef __linux__
+void ShaderWatcher::watch(){
+  int fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+  if(fd<0 || inotify_add_watch(fd,d_sourceDir.c_str(),IN_CLOSE_WRITE|IN_MOVED_TO)<0){
+    std::cerr<<"shader reload: unable to watch "<<d_sourceDir<<std::endl;
+    if(fd>=0) close(fd);
+    return;
+  }
+
+  //editors tend to touch a file several times per save, so gather events until
+  //the directory has been quiet for a moment before compiling anything
+  std::set<std::string> changed;
+  alignas(inotify_event) char buffer[4096];
+  while(d_running){
+    pollfd pfd = {fd,POLLIN,0};
+    int ready = poll(&pfd,1,changed.empty() ? 100 : 50);
+    if(ready>0){
+      ssize_t length;
+      while((length = read(fd,buffer,sizeof(buffer)))>0){
+        for(char* ptr = buffer; ptr<buffer+length;){
+          auto event = reinterpret_cast<inotify_event*>(ptr);
+          if(event->len>0 && isShaderSource(event->name)){
+            changed.insert(event->name);
+          }
+          ptr += sizeof(inotify_event)+event->len;
+        }
+      }
+      continue;
+    }
+    for(const auto& shaderName : changed){
+      rebuild(shaderName);
+    }
+    changed.clear();
+  }
+  close(fd);
+}
+#else
+void ShaderWatcher::watch(){
+  std::map<std::string,fs::file_time_type> stamps;
+  auto scan = [&](bool report){
+    std::error_code error;
+    for(const auto& entry : fs::directory_iterator(d_sourceDir,error)){
+      std::string name = entry.path().filename().string();
+      if(!isShaderSource(name)) continue;
+      auto stamp = fs::last_write_time(entry.path(),error);
+      if(error) continue;
+      auto previous = stamps.find(name);
+      bool modified = previous!=stamps.end() && previous->second!=stamp;
+      stamps[name] = stamp;
+      if(report && modified) rebuild(name);
+    }
+  };
+  scan(false);
+  while(d_running){
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    scan(true);
+  }
+}
+#endif
@@ -0,0 +1,41 @@
+//shaderWatcher.hpp
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+//watches a directory of GLSL sources and recompiles them with glslc on a
+//background thread whenever one changes. Uses inotify on Linux and falls back
+//to polling modification times everywhere else.
+class ShaderWatcher{
+  public:
+    //called on the watcher thread with the source file name (e.g. "shader.frag")
+    //once its SPIR-V has been written to the output directory
+    using Callback = std::function<void(const std::string& shaderName)>;
+
+    ShaderWatcher(const std::string& sourceDir, const std::string& outputDir,
+        const std::string& compiler, Callback onCompiled);
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    //compiles source into output, the output is replaced atomically so readers
+    //never observe a half written module. Returns false and fills log on failure.
+    static bool compile(const std::string& compiler, const std::string& source,
+        const std::string& output, std::string& log);
+    static bool isShaderSource(const std::string& fileName);
+
+  private:
+    std::string d_sourceDir;
+    std::string d_outputDir;
+    std::string d_compiler;
+    Callback d_onCompiled;
+    std::atomic<bool> d_running;
+    std::thread d_thread;
+
+    void watch();
+    void rebuild(const std::string& shaderName);
+};
@@ -1,2 +1,10 @@
-/Users/willchambers/Library/vulkansdk-macos-1.1.121.0/macOS/bin/glslc shader.vert -o vert.spv
-/Users/willchambers/Library/vulkansdk-macos-1.1.121.0/macOS/bin/glslc shader.frag -o frag.spv
\ No newline at end of file
+#!/bin/sh
+# compiles every shader next to this script, the CMake build does the same into
+# the build tree. Uses glslc from the Vulkan SDK or PATH, override with GLSLC=...
+cd "$(dirname "$0")"
+GLSLC=${GLSLC:-$(command -v glslc || echo "$VULKAN_SDK/bin/glslc")}
+OUT=${1:-.}
+for shader in *.vert *.frag *.comp; do
+  [ -f "$shader" ] || continue
+  "$GLSLC" "$shader" -o "$OUT/$shader.spv" || exit 1
+done
@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//see PipelineKey::antialias
+layout(constant_id = 3) const bool ANTIALIAS = false;
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in float fragAcross;
+layout(location = 2) flat in float fragHalfWidth;
+
+layout(location = 0) out vec4 outColor;
+void main(){
+    outColor = fragColor;
+    if(ANTIALIAS){
+        //the share of this pixel the line covers, lines under a pixel wide are drawn
+        //one pixel wide at their fraction of the intensity
+        float halfWidth = max(fragHalfWidth,0.5);
+        float coverage = clamp(halfWidth+0.5-abs(fragAcross),0.0,1.0);
+        outColor.a *= coverage*min(2.0*fragHalfWidth,1.0);
+    }
+}
@@ -0,0 +1,51 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//see PipelineKey::antialias
+layout(constant_id = 3) const bool ANTIALIAS = false;
+
+//LineSegment in lineSegment.hpp
+struct Segment{
+  vec2 start;
+  vec2 end;
+  float width;
+  uint color;
+};
+
+//written by the renderer into its 2D arena every frame
+layout(std430, set = 1, binding = 0) readonly buffer Segments{
+  //screen space units per pixel, x and y
+  vec2 pixelSize;
+  Segment segments[];
+};
+
+layout(location = 0) out vec4 fragColor;
+//distance from the center line and half the width, in pixels
+layout(location = 1) out float fragAcross;
+layout(location = 2) flat out float fragHalfWidth;
+
+//along the segment and across it, two counter-clockwise triangles
+const vec2 corners[6] = vec2[](vec2(0.0,-1.0),vec2(1.0,-1.0),vec2(1.0,1.0),
+                               vec2(1.0,1.0),vec2(0.0,1.0),vec2(0.0,-1.0));
+
+//six vertices per segment rather than six per instance, tiny instances waste GPU lanes
+void main() {
+    Segment segment = segments[gl_VertexIndex/6];
+    vec2 corner = corners[gl_VertexIndex%6];
+    vec2 direction = segment.end-segment.start;
+    float len = length(direction);
+    vec2 normal = len > 0.0 ? vec2(-direction.y,direction.x)/len : vec2(0.0);
+    //screen space units covered by one pixel along the normal
+    float pixel = len > 0.0 ? 1.0/length(normal/pixelSize) : 0.0;
+    float halfWidth = 0.5*segment.width;
+    float extent = halfWidth;
+    if(ANTIALIAS){
+        //thin lines keep a pixel and fade instead, plus a pixel of falloff either side
+        extent = max(halfWidth,0.5*pixel)+pixel;
+    }
+    vec2 position = mix(segment.start,segment.end,corner.x)+normal*extent*corner.y;
+    gl_Position = vec4(position.x,-position.y,0.0,1.0);
+    fragColor = unpackUnorm4x8(segment.color);
+    fragAcross = pixel > 0.0 ? extent*corner.y/pixel : 0.0;
+    fragHalfWidth = pixel > 0.0 ? halfWidth/pixel : 0.0;
+}
@@ -0,0 +1,25 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//same permutations as shader.frag where they make sense, see ShaderVariant
+layout(constant_id = 0) const int VARIANT = 0;
+layout(constant_id = 1) const float ALPHA_CUTOFF = 0.5;
+
+layout(binding = 1) uniform sampler2D texSampler;
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+void main(){
+    if(VARIANT == 1){
+        outColor = fragColor;
+    }else if(VARIANT == 3){
+        outColor = vec4(fract(fragTexCoord),0.0,1.0);
+    }else{
+        outColor = fragColor*texture(texSampler,fragTexCoord);
+        if(VARIANT == 2 && outColor.a < ALPHA_CUTOFF){
+            discard;
+        }
+    }
+}
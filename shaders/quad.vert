@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//one instance per rectangle, see QuadInstance in quadInstance.hpp
+layout(location = 0) in vec2 inCenter;
+layout(location = 1) in vec4 inSizeRotationDepth;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in vec4 inUvRect;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+//the shared unit quad, two counter-clockwise triangles
+const vec2 corners[6] = vec2[](vec2(0.0,0.0),vec2(1.0,0.0),vec2(1.0,1.0),
+                               vec2(1.0,1.0),vec2(0.0,1.0),vec2(0.0,0.0));
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 local = (corner-0.5)*inSizeRotationDepth.xy;
+    float s = sin(inSizeRotationDepth.z);
+    float c = cos(inSizeRotationDepth.z);
+    vec2 position = inCenter+vec2(c*local.x-s*local.y,s*local.x+c*local.y);
+    //screen space like DrawList2D, y up
+    gl_Position = vec4(position.x,-position.y,inSizeRotationDepth.w,1.0);
+    fragColor = inColor;
+    fragTexCoord = mix(inUvRect.xy,inUvRect.zw,corner);
+}
@@ -1,6 +1,10 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+//permutation, see ShaderVariant in pipelineLibrary.hpp
+layout(constant_id = 0) const int VARIANT = 0;
+layout(constant_id = 1) const float ALPHA_CUTOFF = 0.5;
+
 layout(binding = 1) uniform sampler2D texSampler;
 
 layout(location = 0) in vec3 fragColor;
@@ -8,5 +12,16 @@ layout(location = 1) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 void main(){
-    outColor = texture(texSampler,fragTexCoord);
+    if(VARIANT == 1){
+        outColor = vec4(fragColor,1.0);
+    }else if(VARIANT == 3){
+        outColor = vec4(fract(fragTexCoord),0.0,1.0);
+    }else if(VARIANT == 4){
+        outColor = vec4(vec3(gl_FragCoord.z),1.0);
+    }else{
+        outColor = texture(texSampler,fragTexCoord);
+        if(VARIANT == 2 && outColor.a < ALPHA_CUTOFF){
+            discard;
+        }
+    }
 }
@@ -1,6 +1,9 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+//2D geometry, see PipelineKey::screenSpace
+layout(constant_id = 2) const bool SCREEN_SPACE = false;
+
 layout(binding = 0) uniform UniformBufferObject{
   mat4 model;
   mat4 view;
@@ -15,7 +18,11 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main() {
-    gl_Position = ubo.proj*ubo.view*ubo.model*vec4(inPosition,1.0);
+    if(SCREEN_SPACE){
+        gl_Position = vec4(inPosition.x,-inPosition.y,inPosition.z,1.0);
+    }else{
+        gl_Position = ubo.proj*ubo.view*ubo.model*vec4(inPosition,1.0);
+    }
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//glyph quads of quad.vert over the signed distance fields of GlyphAtlas
+layout(set = 1, binding = 0) uniform sampler2D glyphAtlas;
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+//the outline, GlyphAtlas writes it as 128 of 255
+const float EDGE = 128.0/255.0;
+
+void main(){
+    float distance = texture(glyphAtlas,fragTexCoord).r;
+    //how much the distance changes over one screen pixel, so the edge is a pixel
+    //wide whether the glyph is magnified or minified
+    float smoothing = max(0.5*fwidth(distance),1.0/255.0);
+    float coverage = smoothstep(EDGE-smoothing,EDGE+smoothing,distance);
+    outColor = vec4(fragColor.rgb,fragColor.a*coverage);
+}
@@ -0,0 +1,138 @@
+//taskGraph.cpp
+#include "taskGraph.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+TaskGraph::TaskId TaskGraph::add(const std::string& name, std::function<void()> work,
+    const std::vector<TaskId>& dependencies){
+  TaskId id = d_tasks.size();
+  Task task;
+  task.name = name;
+  task.work = work;
+  task.dependencyCount = dependencies.size();
+  for(TaskId dependency : dependencies){
+    if(dependency>=id) throw std::logic_error("task "+name+" depends on a task added after it");
+    d_tasks[dependency].dependents.push_back(id);
+  }
+  d_tasks.push_back(task);
+  return id;
+}
+
+TaskGraph::TaskId TaskGraph::addOnCallingThread(const std::string& name, std::function<void()> work,
+    const std::vector<TaskId>& dependencies){
+  TaskId id = add(name,work,dependencies);
+  d_tasks[id].onCallingThread = true;
+  return id;
+}
+
+void TaskGraph::run(ThreadPool& pool){
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<TaskId> callingThreadQueue;
+  std::vector<size_t> waitingOn(d_tasks.size());
+  size_t remaining = d_tasks.size();
+  size_t running = 0;
+  std::exception_ptr failure;
+
+  d_runStart = std::chrono::steady_clock::now();
+  d_callingThread = std::this_thread::get_id();
+  auto elapsed = [this]{
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-d_runStart).count();
+  };
+
+  //both of these expect mutex to be held by the caller
+  std::function<void(TaskId)> schedule;
+  auto execute = [&](TaskId id){
+    Task& task = d_tasks[id];
+    task.thread = std::this_thread::get_id();
+    task.start = elapsed();
+    std::exception_ptr error;
+    try{
+      task.work();
+    }catch(...){
+      error = std::current_exception();
+    }
+    task.end = elapsed();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    running--;
+    remaining--;
+    if(error && !failure) failure = error;
+    if(!failure){
+      for(TaskId dependent : task.dependents){
+        if(--waitingOn[dependent]==0) schedule(dependent);
+      }
+    }
+    changed.notify_all();
+  };
+  schedule = [&](TaskId id){
+    running++;
+    if(d_tasks[id].onCallingThread){
+      callingThreadQueue.push_back(id);
+    }else{
+      pool.submit([&execute,id]{ execute(id); });
+    }
+  };
+
+  std::unique_lock<std::mutex> lock(mutex);
+  for(TaskId id = 0; id<d_tasks.size(); id++){
+    waitingOn[id] = d_tasks[id].dependencyCount;
+  }
+  for(TaskId id = 0; id<d_tasks.size(); id++){
+    if(waitingOn[id]==0) schedule(id);
+  }
+  while(remaining>0 && !(failure && running==0)){
+    changed.wait(lock,[&]{
+      return !callingThreadQueue.empty() || remaining==0 || (failure && running==0);
+    });
+    if(!callingThreadQueue.empty()){
+      TaskId id = callingThreadQueue.front();
+      callingThreadQueue.pop_front();
+      if(failure){
+        running--;
+        continue;
+      }
+      lock.unlock();
+      execute(id);
+      lock.lock();
+    }
+  }
+  if(failure) std::rethrow_exception(failure);
+}
+
+void TaskGraph::printTimeline(std::ostream& out, const std::string& title) const{
+  double total = 0.0;
+  for(const auto& task : d_tasks) total = std::max(total,task.end);
+
+  //number the threads in the order they show up, the calling thread is always "main"
+  std::map<std::thread::id,size_t> lanes;
+  std::vector<size_t> order(d_tasks.size());
+  for(size_t i = 0; i<order.size(); i++) order[i] = i;
+  std::sort(order.begin(),order.end(),[this](size_t a,size_t b){ return d_tasks[a].start<d_tasks[b].start; });
+
+  const int width = 40;
+  out<<title<<" ("<<std::fixed<<std::setprecision(1)<<total<<" ms)"<<std::endl;
+  for(size_t i : order){
+    const Task& task = d_tasks[i];
+    std::string lane = "main";
+    if(task.thread!=d_callingThread){
+      auto found = lanes.find(task.thread);
+      if(found==lanes.end()) found = lanes.emplace(task.thread,lanes.size()+1).first;
+      lane = "w"+std::to_string(found->second);
+    }
+    int from = total>0 ? static_cast<int>(task.start/total*width) : 0;
+    int to = total>0 ? std::max(from+1,static_cast<int>(task.end/total*width)) : 1;
+    std::string bar(width,' ');
+    for(int c = from; c<to && c<width; c++) bar[c] = '#';
+
+    out<<"  "<<std::left<<std::setw(26)<<task.name<<std::right<<std::setw(5)<<lane
+      <<std::setw(9)<<task.start<<std::setw(9)<<task.end-task.start<<"  |"<<bar<<"|"<<std::endl;
+  }
+}
@@ -0,0 +1,48 @@
+//taskGraph.hpp
+#pragma once
+
+#include "threadPool.hpp"
+
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//a set of named jobs with dependencies between them. run() starts every job as
+//soon as its dependencies finish, on the pool or on the calling thread for jobs
+//that are pinned to it, and records when each one ran.
+class TaskGraph{
+  public:
+    using TaskId = size_t;
+
+    TaskId add(const std::string& name, std::function<void()> work,
+        const std::vector<TaskId>& dependencies = {});
+    //for work that has to happen on the thread calling run(), e.g. anything touching GLFW
+    TaskId addOnCallingThread(const std::string& name, std::function<void()> work,
+        const std::vector<TaskId>& dependencies = {});
+
+    //executes the graph, rethrows the first exception a task threw once
+    //everything already running has finished
+    void run(ThreadPool& pool);
+    bool empty() const { return d_tasks.empty(); }
+
+    //start/end of every task relative to the start of run(), one row per task
+    void printTimeline(std::ostream& out, const std::string& title) const;
+
+  private:
+    struct Task{
+      std::string name;
+      std::function<void()> work;
+      std::vector<TaskId> dependents;
+      size_t dependencyCount = 0;
+      bool onCallingThread = false;
+      double start = 0.0;
+      double end = 0.0;
+      std::thread::id thread;
+    };
+    std::vector<Task> d_tasks;
+    std::chrono::steady_clock::time_point d_runStart;
+    std::thread::id d_callingThread;
+};
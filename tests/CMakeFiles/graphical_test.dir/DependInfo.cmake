@@ -1,26 +0,0 @@
-# The set of languages for which implicit dependencies are needed:
-set(CMAKE_DEPENDS_LANGUAGES
-  "CXX"
-  )
-# The set of files for implicit dependencies of each language:
-set(CMAKE_DEPENDS_CHECK_CXX
-  "/Users/willchambers/Projects/astral/src/tests/graphical_test.cpp" "/Users/willchambers/Projects/astral/src/renderer/tests/CMakeFiles/graphical_test.dir/graphical_test.cpp.o"
-  )
-set(CMAKE_CXX_COMPILER_ID "AppleClang")
-
-# The include file search paths:
-set(CMAKE_CXX_TARGET_INCLUDE_PATH
-  "../tests/../world"
-  "glfw-3.3/include"
-  "/usr/local/include"
-  )
-
-# Targets to which this target links.
-set(CMAKE_TARGET_LINKED_INFO_FILES
-  "/Users/willchambers/Projects/astral/src/renderer/renderer/CMakeFiles/basicRenderer.dir/DependInfo.cmake"
-  "/Users/willchambers/Projects/astral/src/renderer/world/CMakeFiles/resourceHandler.dir/DependInfo.cmake"
-  "/Users/willchambers/Projects/astral/src/renderer/renderer/glfw-3.3/src/CMakeFiles/glfw.dir/DependInfo.cmake"
-  )
-
-# Fortran module output directory.
-set(CMAKE_Fortran_TARGET_MODULE_DIR "")
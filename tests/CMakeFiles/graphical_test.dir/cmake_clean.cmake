@@ -1,10 +0,0 @@
-file(REMOVE_RECURSE
-  "CMakeFiles/graphical_test.dir/graphical_test.cpp.o"
-  "graphical_test"
-  "graphical_test.pdb"
-)
-
-# Per-language clean rules from dependency scanning.
-foreach(lang CXX)
-  include(CMakeFiles/graphical_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
-endforeach()
@@ -1,10 +0,0 @@
-file(REMOVE_RECURSE
-  "CMakeFiles/simple_driver.dir/simple_driver.cpp.o"
-  "simple_driver"
-  "simple_driver.pdb"
-)
-
-# Per-language clean rules from dependency scanning.
-foreach(lang CXX)
-  include(CMakeFiles/simple_driver.dir/cmake_clean_${lang}.cmake OPTIONAL)
-endforeach()
@@ -0,0 +1,103 @@
+//broadphaseTest.cpp
+#include "check.hpp"
+#include "broadphase.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace{
+
+std::vector<std::pair<uint32_t,uint32_t>> sorted(const PairBuffer& pairs){
+  std::vector<std::pair<uint32_t,uint32_t>> out;
+  for(const BodyPair& pair : pairs.pairs()) out.emplace_back(pair.a,pair.b);
+  std::sort(out.begin(),out.end());
+  return out;
+}
+
+//every pair of overlapping bounds with at least one body that moves
+std::vector<std::pair<uint32_t,uint32_t>> bruteForce(const BoundsArrays& bounds, uint32_t count){
+  std::vector<std::pair<uint32_t,uint32_t>> out;
+  for(uint32_t a=0;a<count;a++){
+    for(uint32_t b=a+1;b<count;b++){
+      if(!bounds.movable[a] && !bounds.movable[b]) continue;
+      if(bounds.minX[a]<=bounds.maxX[b] && bounds.minX[b]<=bounds.maxX[a]
+          && bounds.minY[a]<=bounds.maxY[b] && bounds.minY[b]<=bounds.maxY[a]
+          && bounds.minZ[a]<=bounds.maxZ[b] && bounds.minZ[b]<=bounds.maxZ[a]){
+        out.emplace_back(a,b);
+      }
+    }
+  }
+  return out;
+}
+
+//a crowd of turning boxes of mixed sizes over a ground plane large enough to skip
+//the grid, with a few static boxes that overlap each other
+void strategiesFindTheSamePairs(){
+  RigidBodyWorld::Settings settings;
+  settings.gravity = glm::vec3(0.0f);
+  RigidBodyWorld world(settings);
+  RigidBodyWorld::BodyDesc ground;
+  ground.position = glm::vec3(10.0f,-0.5f,10.0f);
+  ground.halfExtents = glm::vec3(12.0f,0.5f,12.0f);
+  ground.mass = 0.0f;
+  world.add(ground);
+  for(uint32_t i=0;i<3;i++){
+    RigidBodyWorld::BodyDesc pillar = ground;
+    pillar.position = glm::vec3(5.0f+0.5f*i,1.0f,5.0f);
+    pillar.halfExtents = glm::vec3(0.5f,1.0f,0.5f);
+    world.add(pillar);
+  }
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> unit(0.0f,1.0f);
+  for(uint32_t i=0;i<2000;i++){
+    RigidBodyWorld::BodyDesc body;
+    body.position = glm::vec3(unit(random)*20.0f,unit(random)*3.0f,unit(random)*20.0f);
+    body.velocity = glm::vec3(unit(random)-0.5f,unit(random)-0.5f,unit(random)-0.5f);
+    body.angularVelocity = glm::vec3(unit(random),unit(random),unit(random));
+    body.halfExtents = glm::vec3(0.1f+0.4f*unit(random),0.1f+0.2f*unit(random),0.1f+0.4f*unit(random));
+    world.add(body);
+  }
+
+  Broadphase sweep;
+  sweep.setStrategy(Broadphase::Strategy::SweepAndPrune);
+  Broadphase hash;
+  hash.setStrategy(Broadphase::Strategy::SpatialHash);
+  PairBuffer sweepPairs, hashPairs;
+  //the sweep re-sorts last update's order, so compare over several steps
+  for(uint32_t step=0;step<10;step++){
+    sweep.update(world,sweepPairs);
+    hash.update(world,hashPairs);
+    auto expected = bruteForce(sweep.bounds(),world.size());
+    CHECK(!expected.empty());
+    CHECK(sorted(sweepPairs)==expected);
+    CHECK(sorted(hashPairs)==expected);
+    CHECK(hash.spatialHash().stats().large>=1);
+    world.step();
+  }
+}
+
+void marginFattensBounds(){
+  RigidBodyWorld world;
+  RigidBodyWorld::BodyDesc body;
+  world.add(body);
+  body.position = glm::vec3(1.05f,0.0f,0.0f);
+  world.add(body);
+  for(Broadphase::Strategy strategy : {Broadphase::Strategy::SweepAndPrune,Broadphase::Strategy::SpatialHash}){
+    Broadphase broadphase;
+    broadphase.setStrategy(strategy);
+    PairBuffer pairs;
+    broadphase.update(world,pairs);
+    CHECK(pairs.empty());
+    broadphase.setMargin(0.1f);
+    broadphase.update(world,pairs);
+    CHECK(pairs.size()==1);
+  }
+}
+
+}
+
+int main(){
+  strategiesFindTheSamePairs();
+  marginFattensBounds();
+  return checkFailures();
+}
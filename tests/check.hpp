@@ -0,0 +1,28 @@
+//check.hpp
+#pragma once
+
+#include <exception>
+#include <iostream>
+
+//plain assertions for the unit test executables. A failed check reports where it
+//failed and carries on, main returns checkFailures() so ctest sees the result
+inline int& checkFailures(){
+  static int failures = 0;
+  return failures;
+}
+
+#define CHECK(condition) do{ \
+    if(!(condition)){ \
+      std::cerr<<__FILE__<<":"<<__LINE__<<": CHECK("<<#condition<<") failed"<<std::endl; \
+      checkFailures()++; \
+    } \
+  }while(0)
+
+#define CHECK_THROWS(expression) do{ \
+    bool thrown = false; \
+    try{ expression; }catch(const std::exception&){ thrown = true; } \
+    if(!thrown){ \
+      std::cerr<<__FILE__<<":"<<__LINE__<<": "<<#expression<<" did not throw"<<std::endl; \
+      checkFailures()++; \
+    } \
+  }while(0)
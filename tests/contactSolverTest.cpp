@@ -0,0 +1,84 @@
+//contactSolverTest.cpp
+#include "check.hpp"
+#include "contactSolver.hpp"
+#include "threadPool.hpp"
+
+#include <memory>
+
+namespace{
+
+struct Outcome{
+  std::vector<float> state;
+  ContactSolver::Stats stats;
+};
+
+//a brick wall large enough to be graph colored and a row of small stacks that
+//stay islands of their own, all falling onto a static ground and settling
+Outcome simulate(uint32_t threads){
+  RigidBodyWorld world;
+  RigidBodyWorld::BodyDesc ground;
+  ground.position = glm::vec3(0.0f,-0.5f,0.0f);
+  ground.halfExtents = glm::vec3(30.0f,0.5f,10.0f);
+  ground.mass = 0.0f;
+  world.add(ground);
+  const glm::vec3 BRICK(0.5f,0.25f,0.5f);
+  for(uint32_t y=0;y<8;y++){
+    float shift = y%2==0 ? 0.0f : BRICK.x+0.025f;
+    for(uint32_t x=0;x<10-y%2;x++){
+      RigidBodyWorld::BodyDesc brick;
+      brick.halfExtents = BRICK;
+      brick.position = glm::vec3(-12.0f+shift+x*(2.0f*BRICK.x+0.05f),(2*y+1)*BRICK.y+0.01f,0.0f);
+      world.add(brick);
+    }
+  }
+  for(uint32_t s=0;s<6;s++){
+    for(uint32_t y=0;y<3;y++){
+      RigidBodyWorld::BodyDesc box;
+      box.halfExtents = glm::vec3(0.3f);
+      box.position = glm::vec3(2.0f+2.0f*s+0.05f*y,0.35f+0.7f*y,0.0f);
+      box.angularVelocity = glm::vec3(0.0f,0.2f*s,0.0f);
+      world.add(box);
+    }
+  }
+
+  ContactSolver::Settings settings;
+  settings.largeIsland = 32;
+  ContactSolver solver(settings);
+  std::unique_ptr<ThreadPool> pool;
+  if(threads>1) pool.reset(new ThreadPool(threads));
+  solver.setThreadPool(pool.get());
+  world.setVelocitySolver([&](float dt){ solver.solve(world,dt); });
+  for(uint32_t step=0;step<60;step++) world.step();
+
+  Outcome outcome;
+  outcome.stats = solver.stats();
+  const BodyArrays& bodies = world.bodies();
+  for(const std::vector<float>* values : {&bodies.px,&bodies.py,&bodies.pz,&bodies.vx,&bodies.vy,&bodies.vz,
+      &bodies.qx,&bodies.qy,&bodies.qz,&bodies.qw,&bodies.wx,&bodies.wy,&bodies.wz}){
+    outcome.state.insert(outcome.state.end(),values->begin(),values->begin()+world.size());
+  }
+  return outcome;
+}
+
+//islands and colors split the work without changing the order any body sees
+//its contacts in, so every thread count steps to the same bits
+void threadCountDoesNotChangeTheResult(){
+  Outcome serial = simulate(1);
+  CHECK(serial.stats.largeIslands==1);
+  CHECK(serial.stats.islands>=7);
+  CHECK(serial.stats.colors>1);
+  for(uint32_t threads : {2u,3u,8u}){
+    Outcome threaded = simulate(threads);
+    CHECK(threaded.state==serial.state);
+    CHECK(threaded.stats.manifolds==serial.stats.manifolds);
+    CHECK(threaded.stats.colors==serial.stats.colors);
+    CHECK(threaded.stats.warmStarted==serial.stats.warmStarted);
+  }
+}
+
+}
+
+int main(){
+  threadCountDoesNotChangeTheResult();
+  return checkFailures();
+}
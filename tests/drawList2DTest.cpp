@@ -0,0 +1,77 @@
+//drawList2DTest.cpp
+#include "check.hpp"
+#include "drawList2D.hpp"
+
+#include <algorithm>
+
+namespace{
+
+struct ArenaStorage{
+  std::vector<DrawList2D::Vertex> vertices;
+  std::vector<DrawList2D::Index> indices;
+  DrawList2D::Arena arena;
+
+  ArenaStorage(uint32_t vertexCount, uint32_t indexCount) : vertices(vertexCount), indices(indexCount){
+    arena.vertices = vertices.data();
+    arena.vertexCapacity = vertexCount;
+    arena.indices = indices.data();
+    arena.indexCapacity = indexCount;
+  }
+};
+
+//a rect is 4 vertices and 6 indices, 16384 of them fill a chunk exactly
+const uint32_t RectsPerChunk = DrawList2D::CHUNK_VERTICES/4;
+
+void splitsBatchesAtTheChunkBoundary(){
+  ArenaStorage storage(3*DrawList2D::CHUNK_VERTICES, 3*RectsPerChunk*6);
+  DrawList2D list;
+  list.reset(storage.arena);
+  for(uint32_t i=0; i<RectsPerChunk; i++){
+    list.addRect(glm::vec2(0.0f), glm::vec2(0.1f), glm::vec3(1.0f));
+  }
+  CHECK(list.batches().size()==1);
+  uint32_t largest = 0;
+  for(uint32_t i=0; i<list.indexCount(); i++) largest = std::max<uint32_t>(largest, storage.indices[i]);
+  CHECK(largest==DrawList2D::CHUNK_VERTICES-1);
+
+  list.addRect(glm::vec2(0.0f), glm::vec2(0.1f), glm::vec3(1.0f));
+  CHECK(list.batches().size()==2);
+  if(list.batches().size()==2){
+    const DrawList2D::Batch& next = list.batches()[1];
+    CHECK(next.vertexOffset==static_cast<int32_t>(DrawList2D::CHUNK_VERTICES));
+    CHECK(next.firstIndex==RectsPerChunk*6);
+    CHECK(next.indexCount==6);
+    CHECK(list.batches()[0].indexCount==RectsPerChunk*6);
+  }
+  //the new chunk counts its indices from 0 again
+  largest = 0;
+  for(uint32_t i=RectsPerChunk*6; i<list.indexCount(); i++) largest = std::max<uint32_t>(largest, storage.indices[i]);
+  CHECK(largest==3);
+  CHECK(list.dropped()==0);
+}
+
+void reservesNoMoreThanAChunk(){
+  ArenaStorage storage(2*DrawList2D::CHUNK_VERTICES, 16);
+  DrawList2D list;
+  list.reset(storage.arena);
+  DrawList2D::Vertex* vertices = nullptr;
+  DrawList2D::Index* indices = nullptr;
+  uint32_t baseVertex = 0;
+  CHECK(!list.reserve(DrawList2D::CHUNK_VERTICES+1, 3, vertices, indices, baseVertex));
+  CHECK(list.dropped()==1);
+  CHECK(list.reserve(DrawList2D::CHUNK_VERTICES, 3, vertices, indices, baseVertex));
+  CHECK(baseVertex==0);
+  //does not fit behind the first, so it starts the second chunk
+  CHECK(list.reserve(3, 3, vertices, indices, baseVertex));
+  CHECK(baseVertex==0);
+  CHECK(list.batches().size()==2);
+  CHECK(list.vertexCount()==DrawList2D::CHUNK_VERTICES+3);
+}
+
+}
+
+int main(){
+  splitsBatchesAtTheChunkBoundary();
+  reservesNoMoreThanAChunk();
+  return checkFailures();
+}
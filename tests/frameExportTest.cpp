@@ -0,0 +1,117 @@
+//frameExportTest.cpp
+#include "check.hpp"
+#include "frameExport.hpp"
+
+#include <cstring>
+#include <random>
+
+namespace{
+
+uint32_t read32(const uint8_t* bytes){
+  return uint32_t(bytes[0])<<24 | uint32_t(bytes[1])<<16 | uint32_t(bytes[2])<<8 | bytes[3];
+}
+
+//the decoder of the specification, independent of the encoder under test
+std::vector<uint8_t> decodeQoi(const std::vector<uint8_t>& data, uint32_t& width, uint32_t& height){
+  std::vector<uint8_t> pixels;
+  if(data.size()<22 || memcmp(data.data(),"qoif",4)!=0) return pixels;
+  width = read32(&data[4]);
+  height = read32(&data[8]);
+  size_t pixelCount = static_cast<size_t>(width)*height;
+  uint8_t index[64][4] = {};
+  uint8_t px[4] = {0,0,0,255};
+  size_t p = 14;
+  size_t end = data.size()-8;
+  while(pixels.size()<pixelCount*4 && p<end){
+    uint8_t b = data[p++];
+    int run = 1;
+    if(b==0xfe){
+      px[0] = data[p]; px[1] = data[p+1]; px[2] = data[p+2];
+      p += 3;
+    }else if(b==0xff){
+      memcpy(px,&data[p],4);
+      p += 4;
+    }else if((b&0xc0)==0x00){
+      memcpy(px,index[b],4);
+    }else if((b&0xc0)==0x40){
+      px[0] += ((b>>4)&3)-2;
+      px[1] += ((b>>2)&3)-2;
+      px[2] += (b&3)-2;
+    }else if((b&0xc0)==0x80){
+      int dg = (b&0x3f)-32;
+      uint8_t b2 = data[p++];
+      px[0] += dg-8+((b2>>4)&0x0f);
+      px[1] += dg;
+      px[2] += dg-8+(b2&0x0f);
+    }else{
+      run = (b&0x3f)+1;
+    }
+    memcpy(index[(px[0]*3+px[1]*5+px[2]*7+px[3]*11)%64],px,4);
+    for(int i=0;i<run;i++) pixels.insert(pixels.end(),px,px+4);
+  }
+  return pixels;
+}
+
+void roundTrip(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height){
+  std::vector<uint8_t> encoded = FrameExporter::encode(ImageEncoding::Qoi,rgba.data(),width,height);
+  CHECK(encoded.size()>=22);
+  const uint8_t marker[8] = {0,0,0,0,0,0,0,1};
+  CHECK(memcmp(encoded.data()+encoded.size()-8,marker,8)==0);
+  CHECK(encoded[12]==4);
+  uint32_t decodedWidth = 0, decodedHeight = 0;
+  std::vector<uint8_t> decoded = decodeQoi(encoded,decodedWidth,decodedHeight);
+  CHECK(decodedWidth==width);
+  CHECK(decodedHeight==height);
+  CHECK(decoded==rgba);
+}
+
+void writesTheSpecifiedOps(){
+  std::vector<uint8_t> rgba = {
+    0,0,0,255, 0,0,0,255,//a run of the implicit start pixel
+    10,20,30,255, 0,0,0,255, 10,20,30,255,//rgb twice, then an index hit
+    11,19,30,255,//small difference
+    21,31,44,255,//luma difference
+    21,31,44,128};//alpha change
+  std::vector<uint8_t> encoded = FrameExporter::encode(ImageEncoding::Qoi,rgba.data(),8,1);
+  std::vector<uint8_t> expected = {'q','o','i','f', 0,0,0,8, 0,0,0,1, 4,0,
+    0xc1, 0xfe,10,20,30, 0xfe,0,0,0, 9,
+    0x76,
+    0xac,0x6a,
+    0xff,21,31,44,128,
+    0,0,0,0,0,0,0,1};
+  CHECK(encoded==expected);
+}
+
+void roundTripsEveryOp(){
+  const uint32_t width = 97, height = 61;
+  std::vector<uint8_t> rgba(width*height*4);
+  std::mt19937 random(7);
+  for(uint32_t y=0;y<height;y++){
+    for(uint32_t x=0;x<width;x++){
+      uint8_t* px = &rgba[(y*width+x)*4];
+      switch(y%5){
+        //long runs, longer than one op holds
+        case 0: px[0] = 40; px[1] = 80; px[2] = 120; px[3] = 255; break;
+        //small and luma sized differences
+        case 1: px[0] = x; px[1] = x*2; px[2] = x*3; px[3] = 255; break;
+        //a small palette for index hits
+        case 2: px[0] = (x%4)*60; px[1] = 200; px[2] = (x%3)*70; px[3] = 255; break;
+        //alpha changes
+        case 3: px[0] = x; px[1] = y; px[2] = 9; px[3] = (x*37)&0xff; break;
+        default:
+          for(int c=0;c<4;c++) px[c] = random()&0xff;
+      }
+    }
+  }
+  roundTrip(rgba,width,height);
+  roundTrip(std::vector<uint8_t>(4*300,0),300,1);
+  roundTrip(std::vector<uint8_t>(),0,0);
+}
+
+}
+
+int main(){
+  writesTheSpecifiedOps();
+  roundTripsEveryOp();
+  return checkFailures();
+}
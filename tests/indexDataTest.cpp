@@ -0,0 +1,43 @@
+//indexDataTest.cpp
+#include "check.hpp"
+#include "indexData.hpp"
+
+namespace{
+
+void picksTheNarrowestType(){
+  CHECK(IndexData::typeFor(65536)==VK_INDEX_TYPE_UINT16);
+  CHECK(IndexData::typeFor(65537)==VK_INDEX_TYPE_UINT32);
+
+  std::vector<uint32_t> indices = {0,1,65535};
+  IndexData narrow(indices, 65536);
+  CHECK(narrow.type()==VK_INDEX_TYPE_UINT16);
+  CHECK(narrow.byteSize()==6);
+  CHECK(narrow[2]==65535);
+  CHECK(static_cast<const uint16_t*>(narrow.data())[2]==65535);
+
+  indices.push_back(65536);
+  IndexData wide(indices, 65537);
+  CHECK(wide.type()==VK_INDEX_TYPE_UINT32);
+  CHECK(wide.byteSize()==16);
+  CHECK(wide[3]==65536);
+
+  //16 bit input widened for a mesh that needs it
+  IndexData widened(std::vector<uint16_t>{0,1,2}, 70000);
+  CHECK(widened.type()==VK_INDEX_TYPE_UINT32);
+  CHECK(widened[2]==2);
+}
+
+void rejectsIndicesPastTheVertices(){
+  CHECK_THROWS(IndexData(std::vector<uint32_t>{0,65536}, 65536));
+  CHECK_THROWS(IndexData(std::vector<uint16_t>{0,3}, 3));
+  IndexData empty(std::vector<uint32_t>{}, 0);
+  CHECK(empty.empty());
+}
+
+}
+
+int main(){
+  picksTheNarrowestType();
+  rejectsIndicesPastTheVertices();
+  return checkFailures();
+}
@@ -0,0 +1,145 @@
+//scene2DTest.cpp
+#include "check.hpp"
+#include "scene2D.hpp"
+
+#include <set>
+
+namespace{
+
+Shape2D square(uint32_t i){
+  return Shape2D::rect(glm::vec2(0.001f*i,0.0f),glm::vec2(0.001f),glm::vec3(static_cast<float>(i),0.0f,0.0f));
+}
+
+//every drawn index has to land on a vertex in use
+bool indicesInRange(const Scene2D& scene){
+  for(uint32_t i=0;i<scene.indexEnd();i++){
+    if(scene.indices()[i]>=scene.vertexEnd()) return false;
+  }
+  return true;
+}
+
+void releaseAtTheEndShrinks(){
+  Scene2D scene;
+  Scene2D::Handle first = scene.add(square(0));
+  Scene2D::Handle last = scene.add(square(1));
+  scene.flush();
+  CHECK(scene.vertexEnd()==8);
+  CHECK(scene.indexEnd()==12);
+
+  scene.remove(last);
+  scene.flush();
+  CHECK(scene.vertexEnd()==4);
+  CHECK(scene.indexEnd()==6);
+  CHECK(scene.contains(first));
+  CHECK(!scene.contains(last));
+}
+
+void releasedNeighboursMerge(){
+  Scene2D scene;
+  Scene2D::Handle a = scene.add(square(0));
+  Scene2D::Handle b = scene.add(square(1));
+  Scene2D::Handle c = scene.add(square(2));
+  scene.add(square(3));
+  scene.flush();
+  CHECK(scene.vertexEnd()==16);
+  CHECK(scene.indexEnd()==24);
+
+  //b joins the free ranges either side of it, leaving 12 vertices and 18 indices
+  scene.remove(a);
+  scene.remove(c);
+  scene.remove(b);
+  scene.flush();
+  for(uint32_t i=0;i<18;i++) CHECK(scene.indices()[i]==0);
+
+  //9 vertices and 15 indices only fit into the merged range
+  glm::vec2 points[3] = {{0.0f,0.0f},{0.5f,0.0f},{0.5f,0.5f}};
+  PolylineStyle style;
+  style.join = LineJoin::Bevel;
+  Scene2D::Handle line = scene.add(Shape2D::polyline(points,3,style,glm::vec3(1.0f)));
+  scene.flush();
+  CHECK(scene.vertexEnd()==16);
+  CHECK(scene.indexEnd()==24);
+  CHECK(scene.contains(line));
+  CHECK(indicesInRange(scene));
+  CHECK(scene.dirtyVertices().size()==1);
+  CHECK(scene.dirtyVertices()[0].first==0);
+}
+
+void fragmentationCompacts(){
+  Scene2D scene;
+  const uint32_t count = 1000;
+  std::vector<Scene2D::Handle> handles;
+  for(uint32_t i=0;i<count;i++) handles.push_back(scene.add(square(i)));
+  scene.flush();
+  CHECK(scene.stats().compactions==0);
+  CHECK(scene.vertexEnd()==count*4);
+
+  //a few holes stay below the threshold
+  for(uint32_t i=0;i<10;i++) scene.remove(handles[i*2]);
+  scene.flush();
+  CHECK(scene.stats().compactions==0);
+  CHECK(scene.vertexEnd()==count*4);
+
+  for(uint32_t i=10;i<count/2;i++) scene.remove(handles[i*2]);
+  scene.flush();
+  uint32_t live = count/2;
+  CHECK(scene.stats().compactions==1);
+  CHECK(scene.stats().shapes==live);
+  CHECK(scene.vertexEnd()==live*4);
+  CHECK(scene.indexEnd()==live*6);
+  CHECK(indicesInRange(scene));
+  //everything moved, so everything is uploaded again
+  CHECK(scene.dirtyVertices().size()==1);
+  CHECK(scene.dirtyVertices()[0].count==live*4);
+
+  //handles survive and every rect still draws its own four vertices
+  std::set<uint32_t> colors;
+  for(uint32_t i=1;i<count;i+=2){
+    CHECK(scene.contains(handles[i]));
+    CHECK(scene.shape(handles[i]).color.x==static_cast<float>(i));
+  }
+  for(uint32_t i=0;i<scene.indexEnd();i+=6){
+    float color = scene.vertices()[scene.indices()[i]].color.x;
+    for(uint32_t j=1;j<6;j++) CHECK(scene.vertices()[scene.indices()[i+j]].color.x==color);
+    colors.insert(static_cast<uint32_t>(color));
+  }
+  CHECK(colors.size()==live);
+  CHECK(*colors.begin()==1);
+
+  //the packed buffers keep working as before
+  Scene2D::Handle added = scene.add(square(count));
+  scene.flush();
+  CHECK(scene.contains(added));
+  CHECK(scene.vertexEnd()==live*4+4);
+}
+
+void uploadCountsTheIndexSize(){
+  Scene2D scene;
+  scene.add(square(0));
+  scene.flush();
+  CHECK(scene.stats().uploadBytes==4*sizeof(Scene2D::Vertex)+6*sizeof(uint32_t));
+  scene.setIndexSize(sizeof(uint16_t));
+  CHECK(scene.stats().uploadBytes==4*sizeof(Scene2D::Vertex)+6*sizeof(uint16_t));
+  scene.clearDirty();
+  scene.add(square(1));
+  scene.flush();
+  CHECK(scene.stats().uploadBytes==4*sizeof(Scene2D::Vertex)+6*sizeof(uint16_t));
+}
+
+void rejectsBadSettings(){
+  Scene2D scene;
+  CHECK_THROWS(scene.setCompactionThreshold(0.0f));
+  CHECK_THROWS(scene.setCompactionThreshold(1.0f));
+  CHECK_THROWS(scene.setIndexSize(3));
+}
+
+}
+
+int main(){
+  releaseAtTheEndShrinks();
+  releasedNeighboursMerge();
+  fragmentationCompacts();
+  uploadCountsTheIndexSize();
+  rejectsBadSettings();
+  return checkFailures();
+}
@@ -0,0 +1,153 @@
+//shaderReflectTest.cpp
+#include "check.hpp"
+#include "shaderReflect.hpp"
+
+#include <cstring>
+#include <initializer_list>
+
+namespace{
+
+//hand assembled SPIR-V, only the instructions reflection reads
+struct Module{
+  std::vector<uint32_t> words = {0x07230203,0x00010000,0,0,0};
+
+  void op(uint32_t opcode,std::initializer_list<uint32_t> operands){
+    words.push_back(static_cast<uint32_t>(operands.size()+1)<<16|opcode);
+    words.insert(words.end(),operands);
+  }
+  std::vector<char> code(uint32_t bound) const{
+    std::vector<uint32_t> module = words;
+    module[3] = bound;
+    std::vector<char> bytes(module.size()*4);
+    memcpy(bytes.data(),module.data(),bytes.size());
+    return bytes;
+  }
+};
+
+//layout(set=0,binding=0) uniform UBO{ mat4 mvp; };
+//layout(set=0,binding=1) uniform sampler2D textures[4];
+//layout(location=0) in vec3 position; layout(location=1) in vec2 uv;
+//layout(push_constant) uniform Push{ vec4 tint; };
+const uint32_t VertexBound = 24;
+Module vertexModule(){
+  Module m;
+  m.op(17,{1});//OpCapability Shader
+  m.op(14,{0,1});//OpMemoryModel Logical GLSL450
+  m.op(15,{0,20,0x6e69616d,0,14,16});//OpEntryPoint Vertex %20 "main" %14 %16
+  m.op(5,{14,0x69736f70,0x6e6f6974,0});//OpName %14 "position"
+  m.op(71,{6,2});//Block
+  m.op(72,{6,0,35,0});//Offset 0
+  m.op(72,{6,0,7,16});//MatrixStride 16
+  m.op(71,{8,34,0});
+  m.op(71,{8,33,0});
+  m.op(71,{12,34,0});
+  m.op(71,{12,33,1});
+  m.op(71,{14,30,0});
+  m.op(71,{16,30,1});
+  m.op(71,{17,2});
+  m.op(72,{17,0,35,0});
+  m.op(22,{1,32});//float
+  m.op(23,{2,1,3});//vec3
+  m.op(23,{3,1,2});//vec2
+  m.op(23,{4,1,4});//vec4
+  m.op(24,{5,4,4});//mat4
+  m.op(30,{6,5});//struct UBO
+  m.op(32,{7,2,6});//Uniform pointer
+  m.op(59,{7,8,2});
+  m.op(25,{9,1,1,0,0,0,1,0});//2D image
+  m.op(27,{10,9});
+  m.op(21,{21,32,0});//uint
+  m.op(43,{21,22,4});//constant 4
+  m.op(28,{23,10,22});//sampler2D[4]
+  m.op(32,{11,0,23});//UniformConstant pointer
+  m.op(59,{11,12,0});
+  m.op(32,{13,1,2});
+  m.op(59,{13,14,1});
+  m.op(32,{15,1,3});
+  m.op(59,{15,16,1});
+  m.op(30,{17,4});//struct Push
+  m.op(32,{18,9,17});
+  m.op(59,{18,19,9});
+  return m;
+}
+
+void reflectsWellFormedModule(){
+  ShaderReflection reflection = reflectShader(vertexModule().code(VertexBound));
+  CHECK(reflection.stage==VK_SHADER_STAGE_VERTEX_BIT);
+  CHECK(reflection.bindings.size()==2);
+  if(reflection.bindings.size()==2){
+    CHECK(reflection.bindings[0].binding==0);
+    CHECK(reflection.bindings[0].type==VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    CHECK(reflection.bindings[0].count==1);
+    CHECK(reflection.bindings[1].binding==1);
+    CHECK(reflection.bindings[1].type==VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    CHECK(reflection.bindings[1].count==4);
+  }
+  CHECK(reflection.pushConstantSize==16);
+  CHECK(reflection.inputs.size()==2);
+  if(reflection.inputs.size()==2){
+    CHECK(reflection.inputs[0].location==0);
+    CHECK(reflection.inputs[0].format==VK_FORMAT_R32G32B32_SFLOAT);
+    CHECK(reflection.inputs[0].name=="position");
+    CHECK(reflection.inputs[1].format==VK_FORMAT_R32G32_SFLOAT);
+  }
+  std::vector<VkVertexInputAttributeDescription> attributes;
+  CHECK(mergeReflections({reflection}).vertexAttributes(0,attributes)==20);
+}
+
+void rejectsMalformedModules(){
+  std::vector<char> good = vertexModule().code(VertexBound);
+
+  CHECK_THROWS(reflectShader(std::vector<char>(good.begin(),good.begin()+16)));
+  CHECK_THROWS(reflectShader(std::vector<char>(good.begin(),good.end()-2)));
+  //the last instruction loses its final word
+  CHECK_THROWS(reflectShader(std::vector<char>(good.begin(),good.end()-4)));
+  std::vector<char> magic = good;
+  magic[0] ^= 1;
+  CHECK_THROWS(reflectShader(magic));
+  CHECK_THROWS(reflectShader(vertexModule().code(0xFFFFFFFF)));
+  //ids at or past the bound
+  CHECK_THROWS(reflectShader(vertexModule().code(20)));
+
+  Module badType = vertexModule();
+  badType.op(59,{99,22,2});
+  CHECK_THROWS(reflectShader(badType.code(VertexBound)));
+
+  Module notPointer = vertexModule();
+  notPointer.op(59,{6,22,2});
+  CHECK_THROWS(reflectShader(notPointer.code(VertexBound)));
+
+  Module shortPointer = vertexModule();
+  shortPointer.op(32,{22});
+  shortPointer.op(59,{22,23,2});
+  CHECK_THROWS(reflectShader(shortPointer.code(VertexBound+1)));
+
+  Module shortDecorate = vertexModule();
+  shortDecorate.op(71,{8});
+  CHECK_THROWS(reflectShader(shortDecorate.code(VertexBound)));
+
+  //an array of itself
+  Module cycle;
+  cycle.op(15,{4,1,0});
+  cycle.op(21,{1,32,0});
+  cycle.op(43,{1,2,1});
+  cycle.op(28,{3,3,2});
+  cycle.op(32,{4,2,3});
+  cycle.op(59,{4,5,2});
+  CHECK_THROWS(reflectShader(cycle.code(6)));
+
+  Module cyclicPush;
+  cyclicPush.op(15,{4,1,0});
+  cyclicPush.op(30,{3,3});
+  cyclicPush.op(32,{4,9,3});
+  cyclicPush.op(59,{4,5,9});
+  CHECK_THROWS(reflectShader(cyclicPush.code(6)));
+}
+
+}
+
+int main(){
+  reflectsWellFormedModule();
+  rejectsMalformedModules();
+  return checkFailures();
+}
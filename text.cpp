@@ -0,0 +1,122 @@
+//text.cpp
+#include "text.hpp"
+
+#include <algorithm>
+
+namespace{
+  const uint32_t REPLACEMENT_CHARACTER = 0xfffd;
+
+  //overlong forms and surrogates are decoded as they come, the font has no glyph for them anyway
+  void decodeUtf8(const char* text, std::vector<uint32_t>& out){
+    out.clear();
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text);
+    while(*p != 0){
+      uint32_t lead = *p;
+      uint32_t length = lead < 0x80 ? 1 : (lead>>5) == 0x6 ? 2 : (lead>>4) == 0xe ? 3 : (lead>>3) == 0x1e ? 4 : 0;
+      uint32_t codepoint = length == 1 ? lead : length == 2 ? lead&0x1f : length == 3 ? lead&0x0f : lead&0x07;
+      uint32_t i = 1;
+      for(; i < length && (p[i]&0xc0) == 0x80; i++) codepoint = codepoint<<6 | (p[i]&0x3f);
+      if(length == 0 || i < length){
+        //skip the lead byte alone, what follows may start a valid sequence
+        out.push_back(REPLACEMENT_CHARACTER);
+        p++;
+        continue;
+      }
+      out.push_back(codepoint);
+      p += length;
+    }
+  }
+}
+
+uint32_t TextLayout::add(DrawList2D& list, const char* utf8, glm::vec2 position, const TextStyle& style){
+  glm::vec2 extent;
+  return layout(&list, utf8, position, style, extent);
+}
+
+glm::vec2 TextLayout::measure(const char* utf8, const TextStyle& style){
+  glm::vec2 extent;
+  layout(nullptr, utf8, glm::vec2(0.0f), style, extent);
+  return extent;
+}
+
+uint32_t TextLayout::layout(DrawList2D* list, const char* utf8, glm::vec2 position, const TextStyle& style,
+    glm::vec2& extent){
+  decodeUtf8(utf8, d_codepoints);
+  const float size = style.size;
+  const float lineAdvance = d_atlas.lineHeight()*size*style.lineSpacing;
+  const size_t noBreak = static_cast<size_t>(-1);
+  extent = glm::vec2(0.0f);
+  uint32_t written = 0;
+  float lineTop = 0.0f;
+  float width;
+
+  d_line.clear();
+  float pen = 0.0f;
+  uint32_t previous = 0;
+  size_t breakAt = noBreak;
+  //a newline past the end flushes the last line
+  d_codepoints.push_back('\n');
+  for(uint32_t codepoint : d_codepoints){
+    if(codepoint == '\n'){
+      bool fits = emitLine(list, d_line.size(), position, lineTop, style, written, width);
+      extent = glm::vec2(std::max(extent.x, width), lineTop+lineAdvance);
+      if(!fits) return written;
+      lineTop += lineAdvance;
+      d_line.clear();
+      pen = 0.0f;
+      previous = 0;
+      breakAt = noBreak;
+      continue;
+    }
+    if(previous != 0) pen += d_atlas.kerning(previous, codepoint)*size;
+    const GlyphAtlas::Glyph& glyph = d_atlas.glyph(codepoint);
+    bool space = codepoint == ' ';
+    if(style.maxWidth > 0.0f && !space && breakAt != noBreak && pen+glyph.advance*size > style.maxWidth){
+      bool fits = emitLine(list, breakAt, position, lineTop, style, written, width);
+      extent.x = std::max(extent.x, width);
+      if(!fits) return written;
+      lineTop += lineAdvance;
+      //the word being written moves to the start of the next line
+      float shift = breakAt+1 < d_line.size() ? d_line[breakAt+1].x : pen;
+      d_line.erase(d_line.begin(), d_line.begin()+breakAt+1);
+      for(PlacedGlyph& placed : d_line) placed.x -= shift;
+      pen -= shift;
+      breakAt = noBreak;
+    }
+    d_line.push_back({glyph, pen, space});
+    if(space) breakAt = d_line.size()-1;
+    pen += glyph.advance*size;
+    previous = codepoint;
+  }
+  return written;
+}
+
+bool TextLayout::emitLine(DrawList2D* list, size_t count, glm::vec2 position, float lineTop,
+    const TextStyle& style, uint32_t& written, float& width){
+  const float size = style.size;
+  //trailing spaces neither count towards the width nor shift an aligned line
+  size_t end = count;
+  while(end > 0 && d_line[end-1].space) end--;
+  width = end > 0 ? d_line[end-1].x+d_line[end-1].glyph.advance*size : 0.0f;
+  if(list == nullptr) return true;
+
+  uint32_t visible = 0;
+  for(size_t i = 0; i < end; i++) visible += d_line[i].glyph.visible ? 1 : 0;
+  if(visible == 0) return true;
+  QuadInstance* quads = list->reserveGlyphs(visible);
+  if(quads == nullptr) return false;
+
+  float start = style.align == TextAlign::Left ? 0.0f : style.align == TextAlign::Center ? -0.5f*width : -width;
+  float baseline = lineTop+d_atlas.ascent()*size;
+  glm::vec2 pixel = list->pixelSize();
+  for(size_t i = 0; i < end; i++){
+    const GlyphAtlas::Glyph& glyph = d_line[i].glyph;
+    if(!glyph.visible) continue;
+    //pixels from position, y up like the screen space of the list
+    glm::vec2 center(start+d_line[i].x+(glyph.offset.x+0.5f*glyph.size.x)*size,
+        -baseline+(glyph.offset.y-0.5f*glyph.size.y)*size);
+    *quads++ = QuadInstance::make(position+center*pixel, glyph.size*size*pixel, style.color, glyph.uvRect);
+  }
+  written += visible;
+  return true;
+}
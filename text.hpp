@@ -0,0 +1,61 @@
+//text.hpp
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "drawList2D.hpp"
+#include "glyphAtlas.hpp"
+
+enum class TextAlign : uint32_t{
+  Left = 0,
+  Center = 1,
+  Right = 2
+};
+
+struct TextStyle{
+  //pixel height of the font, ascender to descender
+  float size = 16.0f;
+  glm::vec4 color = glm::vec4(1.0f);
+  //lines are aligned on the position given to TextLayout::add
+  TextAlign align = TextAlign::Left;
+  //multiple of the font's own line height
+  float lineSpacing = 1.0f;
+  //pixels, longer lines wrap at their last space. 0 only breaks at newlines
+  float maxWidth = 0.0f;
+};
+
+//lays UTF-8 text out into glyph quads of a DrawList2D, one reserveGlyphs per line.
+//Sizes are in pixels of the list's target so text stays the same size whatever
+//the resolution; kerning comes from the font. Invalid UTF-8 shows as U+FFFD
+class TextLayout{
+  public:
+    explicit TextLayout(GlyphAtlas& atlas) : d_atlas(atlas) {}
+
+    //position is the top of the first line in screen space, at its left edge, its
+    //center or its right edge depending on style.align. Returns the glyphs written,
+    //a line that does not fit the list ends the text
+    uint32_t add(DrawList2D& list, const char* utf8, glm::vec2 position, const TextStyle& style);
+    //pixel size of what add would draw
+    glm::vec2 measure(const char* utf8, const TextStyle& style);
+
+  private:
+    struct PlacedGlyph{
+      GlyphAtlas::Glyph glyph;
+      //pen position in pixels from the start of the line
+      float x;
+      bool space;
+    };
+
+    GlyphAtlas& d_atlas;
+    std::vector<uint32_t> d_codepoints;
+    //the line being filled, kept so it can be aligned once its width is known
+    std::vector<PlacedGlyph> d_line;
+
+    //measures only when list is null
+    uint32_t layout(DrawList2D* list, const char* utf8, glm::vec2 position, const TextStyle& style,
+        glm::vec2& extent);
+    //writes glyphs [0,count) of d_line, false when the list is full
+    bool emitLine(DrawList2D* list, size_t count, glm::vec2 position, float lineTop, const TextStyle& style,
+        uint32_t& written, float& width);
+};
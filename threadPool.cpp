@@ -0,0 +1,53 @@
+//threadPool.cpp
+#include "threadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount){
+  threadCount = std::max<size_t>(threadCount,1);
+  for(size_t i = 0; i<threadCount; i++){
+    d_threads.emplace_back(&ThreadPool::work,this);
+  }
+}
+
+ThreadPool::~ThreadPool(){
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_running = false;
+  }
+  d_wake.notify_all();
+  for(auto& thread : d_threads){
+    thread.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> job){
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_jobs.push_back(std::move(job));
+  }
+  d_wake.notify_one();
+}
+
+void ThreadPool::wait(){
+  std::unique_lock<std::mutex> lock(d_mutex);
+  d_idle.wait(lock,[this]{ return d_jobs.empty() && d_busy==0; });
+}
+
+void ThreadPool::work(){
+  std::unique_lock<std::mutex> lock(d_mutex);
+  while(true){
+    d_wake.wait(lock,[this]{ return !d_running || !d_jobs.empty(); });
+    //drain what is queued before honouring shutdown so no job is silently dropped
+    if(d_jobs.empty()) return;
+
+    auto job = std::move(d_jobs.front());
+    d_jobs.pop_front();
+    d_busy++;
+    lock.unlock();
+    job();
+    lock.lock();
+    d_busy--;
+    if(d_jobs.empty() && d_busy==0) d_idle.notify_all();
+  }
+}
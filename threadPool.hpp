@@ -0,0 +1,35 @@
+//threadPool.hpp
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//fixed set of worker threads pulling jobs off a shared queue
+class ThreadPool{
+  public:
+    explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> job);
+    //blocks until the queue is empty and every worker is idle
+    void wait();
+    size_t size() const { return d_threads.size(); }
+
+  private:
+    std::vector<std::thread> d_threads;
+    std::deque<std::function<void()>> d_jobs;
+    std::mutex d_mutex;
+    std::condition_variable d_wake;
+    std::condition_variable d_idle;
+    size_t d_busy = 0;
+    bool d_running = true;
+
+    void work();
+};
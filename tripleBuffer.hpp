@@ -0,0 +1,44 @@
+//tripleBuffer.hpp
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+//single producer, single consumer hand-off of the latest value. The writer fills
+//back() and publish()es it, the reader calls update() and reads front(); neither
+//side ever waits for the other, values the reader was too slow to see are skipped.
+//The three slots are owned by writer, reader and the shared middle respectively,
+//publishing and updating swap a private slot with the middle one.
+template<typename T>
+class TripleBuffer{
+  public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    //writer side
+    T& back(){ return d_slots[d_back]; }
+    void publish(){
+      uint8_t previous = d_middle.exchange(static_cast<uint8_t>(d_back | Fresh), std::memory_order_acq_rel);
+      d_back = previous & IndexMask;
+    }
+
+    //reader side, true when something newer than front() was published since the last call
+    bool update(){
+      if(!(d_middle.load(std::memory_order_relaxed) & Fresh)) return false;
+      uint8_t previous = d_middle.exchange(d_front, std::memory_order_acq_rel);
+      d_front = previous & IndexMask;
+      return true;
+    }
+    const T& front() const { return d_slots[d_front]; }
+
+  private:
+    static const uint8_t IndexMask = 3;
+    static const uint8_t Fresh = 4;
+
+    T d_slots[3];
+    //each side's index on its own cache line so they do not bounce between cores
+    alignas(64) uint8_t d_back = 0;
+    alignas(64) std::atomic<uint8_t> d_middle{1};
+    alignas(64) uint8_t d_front = 2;
+};
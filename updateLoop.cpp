@@ -0,0 +1,68 @@
+//updateLoop.cpp
+#include "updateLoop.hpp"
+
+#include <stdexcept>
+
+UpdateLoop::UpdateLoop(double tickRate, Step step) : d_step(std::move(step)){
+  if(tickRate<=0.0) throw std::invalid_argument("tick rate must be positive");
+  d_period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0/tickRate));
+}
+
+UpdateLoop::~UpdateLoop(){
+  stop();
+}
+
+void UpdateLoop::start(){
+  std::lock_guard<std::mutex> lock(d_mutex);
+  if(d_running) return;
+  d_running = true;
+  d_thread = std::thread(&UpdateLoop::loop,this);
+}
+
+void UpdateLoop::stop(){
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_running = false;
+  }
+  d_wake.notify_all();
+  if(d_thread.joinable()) d_thread.join();
+}
+
+UpdateLoop::Stats UpdateLoop::stats() const{
+  Stats stats;
+  stats.ticks = d_ticks.load();
+  stats.skipped = d_skipped.load();
+  stats.maxStepMs = d_maxStepMs.load();
+  return stats;
+}
+
+void UpdateLoop::loop(){
+  const double dt = std::chrono::duration<double>(d_period).count();
+  Clock::time_point next = Clock::now();
+  for(;;){
+    Clock::time_point begin = Clock::now();
+    d_step(dt,d_state);
+    uint64_t tick = d_ticks.load(std::memory_order_relaxed)+1;
+    d_state.tick = tick;
+    d_state.time = tick*dt;
+    //a copy, the renderer may still be reading the packet it took before
+    d_packets.back() = d_state;
+    d_packets.publish();
+    d_ticks.store(tick,std::memory_order_relaxed);
+
+    double stepMs = std::chrono::duration<double,std::milli>(Clock::now()-begin).count();
+    if(stepMs>d_maxStepMs.load(std::memory_order_relaxed)) d_maxStepMs.store(stepMs,std::memory_order_relaxed);
+
+    //fixed tick: run late ticks back to back, but give up on a backlog that would
+    //only grow when a tick takes longer than the period
+    next += d_period;
+    Clock::time_point now = Clock::now();
+    if(now-next > d_period*maxCatchUp){
+      d_skipped.fetch_add(static_cast<uint64_t>((now-next)/d_period),std::memory_order_relaxed);
+      next = now;
+    }
+
+    std::unique_lock<std::mutex> lock(d_mutex);
+    if(d_wake.wait_until(lock,next,[this]{ return !d_running; })) return;
+  }
+}
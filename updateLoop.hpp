@@ -0,0 +1,62 @@
+//updateLoop.hpp
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "basicRender.hpp"
+
+//runs the simulation on its own thread at a fixed tick rate and publishes a frame
+//packet after every tick. Publishing never blocks, so the simulation does not wait
+//on vsync and the renderer (see BasicRenderer::setFramePacketSource) never waits
+//on the simulation, it just draws whichever packet is newest.
+class UpdateLoop{
+  public:
+    //advances the simulation by dt seconds; packet holds what the previous tick
+    //published and is published again once step returns
+    using Step = std::function<void(double dt, BasicRenderer::FramePacket& packet)>;
+    struct Stats{
+      uint64_t ticks = 0;
+      //ticks dropped to catch up after falling more than maxCatchUp ticks behind
+      uint64_t skipped = 0;
+      double maxStepMs = 0.0;
+    };
+
+    UpdateLoop(double tickRate, Step step);
+    ~UpdateLoop();
+
+    UpdateLoop(const UpdateLoop&) = delete;
+    UpdateLoop& operator=(const UpdateLoop&) = delete;
+
+    void start();
+    //waits for the current tick to finish
+    void stop();
+    TripleBuffer<BasicRenderer::FramePacket>& packets() { return d_packets; }
+    Stats stats() const;
+
+    static const uint32_t maxCatchUp = 5;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::duration d_period;
+    Step d_step;
+    TripleBuffer<BasicRenderer::FramePacket> d_packets;
+    BasicRenderer::FramePacket d_state;
+
+    std::thread d_thread;
+    std::mutex d_mutex;
+    std::condition_variable d_wake;
+    bool d_running = false;
+
+    std::atomic<uint64_t> d_ticks{0};
+    std::atomic<uint64_t> d_skipped{0};
+    std::atomic<double> d_maxStepMs{0.0};
+
+    void loop();
+};